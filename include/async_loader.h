@@ -0,0 +1,61 @@
+#ifndef PROJECT_3_ASYNC_LOADER_H
+#define PROJECT_3_ASYNC_LOADER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include "../include/object.h"
+
+// Loads an object in three stages without blocking the render loop:
+//  1. parsing and normal generation (or reading the mesh cache) and packing into the GPU vertex format on a worker thread;
+//  2. GPU upload on the render thread in time-sliced chunks, a few milliseconds per frame;
+//  3. the finished Object is handed over by 'update', until then the old object stays on screen.
+class AsyncObjectLoader
+{
+public:
+    enum class Stage {Idle, Parsing, Uploading};
+
+    AsyncObjectLoader(std::string shader_vert, std::string shader_frag):
+        shader_vert_(std::move(shader_vert)), shader_frag_(std::move(shader_frag)){};
+
+    void start(const std::string& filepath, const MeshLoadOptions& options);
+    void cancel();
+    std::unique_ptr<Object> update();
+
+    Stage stage() const {return stage_;}
+    bool busy() const {return stage_ != Stage::Idle;}
+    float progress() const;
+    const std::string& filepath() const {return filepath_;}
+    std::string takeError();
+
+private:
+    // state shared with the worker thread, the worker keeps it alive even if the job is abandoned
+    struct ParseJob {
+        std::string filepath;
+        MeshLoadOptions options;
+        LoadProgress progress;
+        std::atomic<bool> finished{false};
+        bool failed{false};
+        std::string error;
+        MeshData mesh;
+        PackedMesh packed;
+    };
+
+    std::string shader_vert_;
+    std::string shader_frag_;
+
+    Stage stage_{Stage::Idle};
+    std::string filepath_;
+    std::string error_;
+    std::shared_ptr<ParseJob> job_;
+    std::unique_ptr<Object> pending_object_;
+
+    // share of the progress bar for the worker stage, the rest is the upload stage
+    const float PARSE_PROGRESS_SHARE{0.8f};
+    const double UPLOAD_BUDGET_MS{4.0};
+    const size_t UPLOAD_CHUNK_BYTES{1 << 20};
+
+    static void runParseJob(const std::shared_ptr<ParseJob>& job);
+};
+
+#endif //PROJECT_3_ASYNC_LOADER_H
@@ -0,0 +1,164 @@
+#ifndef PROJECT_3_BVH_H
+#define PROJECT_3_BVH_H
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+#include <glm/glm.hpp>
+#include "../include/mesh_data.h"
+
+// ray in world or object space, the direction does not have to be normalized: distances along the ray are measured
+// in multiples of the direction, so a ray transformed into object space keeps the distances of the world space ray
+struct Ray {
+    glm::vec3 origin{0.0f};
+    glm::vec3 direction{0.0f, 0.0f, -1.0f};
+
+    glm::vec3 at(float distance) const {return origin + direction * distance;}
+    Ray transformed(const glm::mat4& matrix) const;
+};
+
+// axis-aligned bounding box, empty (min above max) by default
+struct Aabb {
+    glm::vec3 min{FLT_MAX};
+    glm::vec3 max{-FLT_MAX};
+
+    void grow(const glm::vec3& point);
+    void grow(const Aabb& box);
+    glm::vec3 center() const {return (min + max) * 0.5f;}
+    float surfaceArea() const;
+    Aabb transformed(const glm::mat4& matrix) const;
+    // distance along the ray where it enters the box, FLT_MAX if it misses the box before max_distance
+    float intersect(const Ray& ray, const glm::vec3& inverse_direction, float max_distance) const;
+};
+
+// Bounding volume hierarchy over boxes of primitives, built top-down with the surface area heuristic over
+// BINS centroid bins per axis (below MAX_SAH_DEPTH, deeper nodes are split at the median to bound the depth of the
+// traversal stack). Nodes are stored depth first: the first child of an inner node follows it,
+// 'offset' is the index of the second child; a leaf covers 'count' primitives from 'offset' in the primitive order.
+class Bvh
+{
+public:
+    static const int BINS = 12;
+    static const int MAX_LEAF_SIZE = 4;
+    static const int MAX_SAH_DEPTH = 32;
+    static const int STACK_SIZE = 64;
+
+    void build(const std::vector<Aabb>& boxes);
+    void clear();
+    bool empty() const {return nodes_.empty();}
+    size_t nodeCount() const {return nodes_.size();}
+    const Aabb& bounds() const {return nodes_.front().bounds;}
+
+    // Returns the distance to the nearest primitive along the ray, FLT_MAX if none is hit before max_distance.
+    // hit_test(primitive, ray, max_distance) returns the distance of its hit or FLT_MAX, nearer children are
+    // visited first and subtrees behind the nearest hit so far are skipped.
+    template <typename HitTest>
+    float intersect(const Ray& ray, float max_distance, HitTest&& hit_test, int* hit_primitive = nullptr) const;
+
+private:
+    struct Node {
+        Aabb bounds;
+        unsigned int offset{0};
+        unsigned int count{0};    // 0 for inner nodes
+    };
+
+    std::vector<Node> nodes_;
+    std::vector<unsigned int> primitives_;
+
+    void buildNode_(size_t node_index, unsigned int begin, unsigned int end, int depth, const std::vector<Aabb>& boxes,
+                    const std::vector<glm::vec3>& centers);
+};
+
+// Bvh over the triangles of the finest level of detail of a mesh, for ray casts in object space. The mesh is not
+// copied, it has to stay alive and unchanged while the TriangleBvh is used.
+class TriangleBvh
+{
+public:
+    void build(const MeshData& mesh);
+    void clear();
+    bool empty() const {return bvh_.empty();}
+    size_t nodeCount() const {return bvh_.nodeCount();}
+    size_t triangleCount() const {return triangle_count_;}
+    float intersect(const Ray& ray, float max_distance) const;
+
+private:
+    Bvh bvh_;
+    const float* vertices_{nullptr};
+    const unsigned int* indices_{nullptr};
+    size_t triangle_count_{0};
+
+    float intersectTriangle_(unsigned int triangle, const Ray& ray, float max_distance) const;
+};
+
+
+template <typename HitTest>
+float Bvh::intersect(const Ray& ray, float max_distance, HitTest&& hit_test, int* hit_primitive) const
+{
+    float nearest = max_distance;
+    if (nodes_.empty())
+    {
+        return FLT_MAX;
+    }
+    glm::vec3 inverse_direction = glm::vec3(1.0f) / ray.direction;
+    // entry distances are kept with the nodes on the stack, a node is skipped if a nearer hit was found meanwhile
+    unsigned int stack[STACK_SIZE];
+    float stack_entry[STACK_SIZE];
+    int stack_size = 0;
+    float root_entry = nodes_[0].bounds.intersect(ray, inverse_direction, nearest);
+    if (root_entry == FLT_MAX)
+    {
+        return FLT_MAX;
+    }
+    stack[stack_size] = 0;
+    stack_entry[stack_size++] = root_entry;
+    bool hit = false;
+    while (stack_size > 0)
+    {
+        stack_size--;
+        if (stack_entry[stack_size] > nearest)
+        {
+            continue;
+        }
+        const Node& node = nodes_[stack[stack_size]];
+        if (node.count > 0)
+        {
+            for (unsigned int i = node.offset; i < node.offset + node.count; i++)
+            {
+                float distance = hit_test(primitives_[i], ray, nearest);
+                if (distance < nearest)
+                {
+                    nearest = distance;
+                    hit = true;
+                    if (hit_primitive != nullptr)
+                    {
+                        *hit_primitive = static_cast<int>(primitives_[i]);
+                    }
+                }
+            }
+            continue;
+        }
+        unsigned int first = stack[stack_size] + 1;
+        unsigned int second = node.offset;
+        float first_entry = nodes_[first].bounds.intersect(ray, inverse_direction, nearest);
+        float second_entry = nodes_[second].bounds.intersect(ray, inverse_direction, nearest);
+        // the nearer child is pushed last, so it is visited first
+        if (first_entry < second_entry)
+        {
+            std::swap(first, second);
+            std::swap(first_entry, second_entry);
+        }
+        if (first_entry != FLT_MAX && stack_size < STACK_SIZE)
+        {
+            stack[stack_size] = first;
+            stack_entry[stack_size++] = first_entry;
+        }
+        if (second_entry != FLT_MAX && stack_size < STACK_SIZE)
+        {
+            stack[stack_size] = second;
+            stack_entry[stack_size++] = second_entry;
+        }
+    }
+    return hit ? nearest : FLT_MAX;
+}
+
+#endif //PROJECT_3_BVH_H
@@ -2,6 +2,7 @@
 #define PROJECT_3_CAMERA_H
 
 #include <glm/glm.hpp>
+#include "../include/bvh.h"
 
 
 class DomeCamera{
@@ -9,10 +10,12 @@ public:
     DomeCamera(glm::vec3 camera_position, glm::vec3 target_position, glm::vec3 up_direction);
     glm::mat4 getViewMatrix();
     glm::mat4 getProjectionMatrix(float window_width, float window_height) const;
+    Ray cursorRay(double cursor_x, double cursor_y, float window_width, float window_height) const;
 
     void zoom(float yoffset);
     void rotate(float delta_x=0, float delta_y=0, float delta_z = 0);
     glm::vec3& cameraPosition(){return camera_position_;}
+    bool takeChanged();
 
 private:
     glm::vec3 camera_position_{};
@@ -28,6 +31,7 @@ private:
     float roll_ = glm::radians(0.0f);
 
     double radius_;
+    bool changed_{true};  // the camera moved or zoomed since the last takeChanged
 
     void updateCameraVectors();
 };
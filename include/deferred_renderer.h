@@ -0,0 +1,69 @@
+#ifndef PROJECT_3_DEFERRED_RENDERER_H
+#define PROJECT_3_DEFERRED_RENDERER_H
+
+#include <memory>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "../include/object.h"
+#include "../include/light_clusters.h"
+#include "../include/shader.h"
+
+// Statistics of the last lighting pass, shown in the menu.
+struct DeferredStats {
+    size_t light_passes{0};
+    size_t culled_lights{0};       // lights whose bounds are outside of the view
+    double scissor_coverage{0};    // average share of the screen covered by the scissor rectangles of the lights
+};
+
+// Deferred shading of the central object: the geometry pass writes world positions, normals, colors and depth of
+// visible surfaces to a G-buffer, the lighting pass then shades every covered pixel once for the ambient light and
+// once for every light inside the scissor rectangle of the light's volume (a sphere for point lights, the bounds of
+// the cone for spotlights), the results are added up with blending. The light model is the one of shader_central.frag,
+// lights are read from the light data texture buffer of LightClusters.
+class DeferredRenderer
+{
+public:
+    // texture units of the G-buffer textures, the units below are used by the light texture buffers (see LightsBlock)
+    // and the units above by the shadow atlas (see ShadowsBlock)
+    static const int POSITION_UNIT = 4;
+    static const int NORMAL_UNIT   = 5;
+    static const int ALBEDO_UNIT   = 6;
+    static const int DEPTH_UNIT    = 7;
+
+    void beginGeometryPass();
+    const ShaderProgram& geometryProgram() const {return *geometry_program_;}
+    void lightingPass(const std::vector<Light>& lights, const LightClusters& clusters, const glm::mat4& view,
+                      const glm::mat4& projection, const glm::vec3& camera_position);
+    void release();
+
+    const DeferredStats& getStats() const {return stats_;}
+
+private:
+    std::unique_ptr<ShaderProgram> geometry_program_;
+    std::unique_ptr<ShaderProgram> lighting_program_;
+    int light_index_location_{-1};
+    int view_pos_location_{-1};
+    int viewport_origin_location_{-1};
+
+    GLuint framebuffer_{};
+    GLuint position_texture_{};
+    GLuint normal_texture_{};
+    GLuint albedo_texture_{};
+    GLuint depth_texture_{};
+    GLuint empty_VAO_{};
+    int width_{0};
+    int height_{0};
+
+    // framebuffer and viewport the frame is drawn to, the lighting pass writes into it
+    GLint target_framebuffer_{0};
+    GLint target_viewport_[4] = {0, 0, 0, 0};
+    DeferredStats stats_{};
+
+    void createResources_();
+    void resizeGBuffer_(int width, int height);
+    bool lightScissor_(const Light& light, const LightClusters& clusters, const glm::mat4& view,
+                       const glm::mat4& projection, GLint rect[4]) const;
+};
+
+#endif //PROJECT_3_DEFERRED_RENDERER_H
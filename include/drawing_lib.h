@@ -12,15 +12,17 @@ public:
     void getWindowSize(GLFWwindow* window);
     void defineCallbackFunction(GLFWwindow* window);
     void drawScene(GLFWwindow* window, bool imGuiCaptureMouse);
+    bool takeChanged();
 
 private:
     Session& session_;
     bool imgui_capture_mouse_{false};
+    // a window event arrived (input, resize, focus) since the last takeChanged, the GUI may react to it
+    bool input_changed_{true};
 
     int window_width_{1920};
     int window_height_{1080};
 
-    bool get_color_{false};
     bool left_button_down_{false};
     bool right_button_down_{false};
 
@@ -29,13 +31,13 @@ private:
 
     double last_click_time_{0.0};
     const double DOUBLE_CLICK_TIME{0.25}; // 250 ms
-    bool left_double_click_{false};
 
     DomeCamera dome_camera_ = DomeCamera(glm::vec3(0.0f, 1.0f, 10.0), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
     void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
     void cursorPositionCallback(GLFWwindow* window, double xpos, double ypos);
     void scrollCallback(GLFWwindow* window, double yoffset);
+    void pickObject(GLFWwindow* window);
 
     std::tuple<double, double> calculateCoordinatesOnMouseMove(int correction_factor) const;
 
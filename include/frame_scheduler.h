@@ -0,0 +1,57 @@
+#ifndef PROJECT_3_FRAME_SCHEDULER_H
+#define PROJECT_3_FRAME_SCHEDULER_H
+
+#include <cstddef>
+
+// frame pacing of the last STATS_INTERVAL seconds, shown in the stats overlay
+struct FrameStats {
+    double fps{0};                // frames drawn per second
+    double skipped_per_second{0}; // frames the frame cap would have allowed but were not needed
+    double idle_percentage{0};    // share of the time spent waiting for events
+    size_t frames_drawn{0};       // since the start
+    size_t frames_skipped{0};
+};
+
+// Paces the main loop: with render on demand the loop blocks in glfwWaitEventsTimeout while the scene is clean and
+// draws only after a change (input, camera, Light objects, objects of the Session) or while something is animated
+// (a central object is loading). Dear ImGui reacts to input with a delay of a frame or two (hover, opening menus),
+// so every change is followed by FRAMES_AFTER_CHANGE frames. Frames are never drawn faster than the frame cap.
+class FrameScheduler
+{
+public:
+    static const int FRAMES_AFTER_CHANGE = 3;
+    static const int MAX_FRAME_CAP = 240;
+    const double IDLE_TIMEOUT{0.5};     // seconds, the loop wakes up at least this often to check for animations
+    const double STATS_INTERVAL{1.0};
+
+    void waitEvents();
+    bool beginFrame(bool changed, bool animating);
+    void endFrame();
+
+    bool& renderOnDemand(){return render_on_demand_;}
+    int& frameCap(){return frame_cap_;}
+    bool& statsOverlay(){return stats_overlay_;}
+    const FrameStats& getStats() const {return stats_;}
+
+private:
+    bool render_on_demand_{true};
+    int frame_cap_{60};           // frames per second, 0 draws as fast as possible
+    bool stats_overlay_{false};
+    int pending_frames_{FRAMES_AFTER_CHANGE};
+
+    double last_frame_time_{0};
+    FrameStats stats_{};
+    // counters of the current stats interval
+    double interval_start_{-1};
+    double interval_idle_{0};
+    size_t interval_frames_{0};
+    size_t interval_skipped_{0};
+    double skipped_budget_{0};
+    bool stats_refreshed_{false};
+
+    double frameInterval_() const;
+    void wait_(double timeout);
+    void updateStats_(double now);
+};
+
+#endif //PROJECT_3_FRAME_SCHEDULER_H
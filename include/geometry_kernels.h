@@ -0,0 +1,56 @@
+#ifndef PROJECT_3_GEOMETRY_KERNELS_H
+#define PROJECT_3_GEOMETRY_KERNELS_H
+
+#include <cstddef>
+#include <vector>
+
+// instruction sets of the geometry kernels, every level includes the lower ones
+enum class SimdLevel {Scalar, SSE, AVX2};
+
+// 3D vectors (positions, normals) in structure-of-arrays layout, the kernels load 4 (SSE) or 8 (AVX2) consecutive
+// components of each axis into one register. Meshes store interleaved xyz, so a mesh is staged into this layout once
+// and then processed by several kernels.
+struct SoaVectors {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+
+    size_t size() const {return x.size();}
+    void resize(size_t count);
+    void assign(const float* interleaved, size_t count);
+    void store(float* interleaved) const;
+};
+
+// Loops of the geometry processing of loaded meshes with SSE and AVX2 versions and a scalar fallback. The highest level
+// that the CPU and the operating system support is detected with CPUID when the program starts. Every level computes
+// the same IEEE operations in the same order per vector (without fused multiply-add), so face normals, accumulated
+// and normalized normals, bounds and bounding radii are equal on all levels and the mesh cache does not depend on the
+// CPU; only the centroid sums in another order. Face normals and accumulation read vertices through indices, SSE has no
+// gather instruction, so these two kernels run scalar on the SSE level.
+class GeometryKernels
+{
+public:
+    static void faceNormals(const SoaVectors& positions, const unsigned int* indices, size_t first_triangle,
+                            size_t last_triangle, bool unit_length, SoaVectors& normals);
+    static void accumulateNormals(const SoaVectors& face_normals, const unsigned int* offsets,
+                                  const unsigned int* corners, const float* corner_weights, size_t first_vertex,
+                                  size_t last_vertex, SoaVectors& sums);
+    static void normalize(SoaVectors& vectors, size_t first, size_t last);
+    static void bounds(const SoaVectors& positions, float min[3], float max[3]);
+    static float boundingRadius(const SoaVectors& positions, const float center[3]);
+    static void centroid(const SoaVectors& positions, float center[3]);
+    // vertex -> triangle corners adjacency read by accumulateNormals, not vectorized
+    static void vertexCorners(const std::vector<unsigned int>& indices, size_t vertices_count,
+                              std::vector<unsigned int>& offsets, std::vector<unsigned int>& corners);
+
+    static SimdLevel level() {return level_;}
+    // selects a lower level than the supported one (for the comparison in geometry_bench), not while kernels run
+    static void setLevel(SimdLevel level);
+    static SimdLevel supportedLevel();
+    static const char* levelName(SimdLevel level);
+
+private:
+    static SimdLevel level_;
+};
+
+#endif //PROJECT_3_GEOMETRY_KERNELS_H
@@ -0,0 +1,82 @@
+#ifndef PROJECT_3_GPU_PROFILER_H
+#define PROJECT_3_GPU_PROFILER_H
+
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+// render passes of a frame that are measured, in drawing order
+enum class GpuPass {LightGizmos, ShadowMaps, CentralObject, Axes, Gui, Count};
+
+// GPU time and shader invocations of one pass in one frame; invocations are 0 without pipeline statistics
+struct GpuPassSample {
+    bool drawn{false};              // the pass ran in the frame (shadows and axes can be switched off)
+    float gpu_ms{0};
+    GLuint64 vertex_invocations{0};
+    GLuint64 fragment_invocations{0};
+};
+
+struct GpuFrameSample {
+    size_t frame{0};
+    GpuPassSample passes[static_cast<int>(GpuPass::Count)];
+};
+
+// Measures every render pass with a GL_TIME_ELAPSED query and, where ARB_pipeline_statistics_query (core in 4.6) is
+// available, with vertex and fragment shader invocation queries. Queries are double-buffered: the queries of a frame
+// are read two frames later, just before they are issued again, and only if their results are available, so the
+// profiler never waits for the GPU; a frame whose results are late is dropped. The last HISTORY_SIZE frames are kept
+// for the graphs of the panel and the CSV export.
+// Time elapsed queries cannot be nested, so the profiler is off by default and has to stay off while another time
+// elapsed query is active (the frame query of lighting_bench).
+class GpuProfiler
+{
+public:
+    static const int PASS_COUNT = static_cast<int>(GpuPass::Count);
+    static const int HISTORY_SIZE = 300;
+
+    void beginFrame();
+    void endFrame();
+    void beginPass(GpuPass pass);
+    void endPass(GpuPass pass);
+    void release();
+    void exportCsv(const std::string& filepath) const;
+
+    bool& enabled(){return enabled_;}
+    bool pipelineStatistics() const {return pipeline_statistics_;}
+    size_t historySize() const {return history_.size();}
+    const GpuFrameSample& historySample(size_t index) const;
+    size_t droppedFrames() const {return dropped_frames_;}
+    static const char* passName(GpuPass pass);
+
+private:
+    // time, vertex and fragment invocation queries of a pass
+    struct PassQueries {
+        GLuint queries[3] = {0, 0, 0};
+        bool issued{false};
+    };
+    struct QuerySet {
+        PassQueries passes[PASS_COUNT];
+        size_t frame{0};
+        bool pending{false};
+    };
+
+    bool enabled_{false};
+    bool created_{false};
+    bool pipeline_statistics_{false};
+    bool frame_open_{false};
+    GpuPass open_pass_{GpuPass::Count};   // pass whose queries are active, Count if none
+    size_t frame_{0};
+    size_t dropped_frames_{0};
+    QuerySet sets_[2];
+
+    // ring of the last frames, history_start_ is the oldest one
+    std::vector<GpuFrameSample> history_;
+    size_t history_start_{0};
+
+    void createQueries_();
+    void endQueries_();
+    void readSet_(QuerySet& set);
+    void pushSample_(const GpuFrameSample& sample);
+};
+
+#endif //PROJECT_3_GPU_PROFILER_H
@@ -2,23 +2,32 @@
 #define PROJECT_3_GUI_H
 
 #include "../include/session.h"
+#include "../include/frame_scheduler.h"
 
 class Gui {
 public:
-    explicit Gui(Session& session) : session_(session){readme_txt_ = readTextFile("../docs/ReadMe.txt");};
+    Gui(Session& session, FrameScheduler& frame_scheduler) : session_(session), frame_scheduler_(frame_scheduler)
+    {readme_txt_ = readTextFile("../docs/ReadMe.txt");};
     void drawMainMenu();
     void drawObjectsPanels();
+    void drawStatsOverlay();
 
 private:
     Session& session_;
+    FrameScheduler& frame_scheduler_;
     bool help_window_{false};
+    bool jobs_window_{false};
     std::string readme_txt_;
+    std::string gpu_profile_path_{"gpu_profile.csv"};
 
     float object_panel_height_ = 210.0f;
     float object_panel_width_ = 230.0f;
 
     static std::string readTextFile(const std::string &filePath);
     void drawHelpWindow();
+    void drawLoadingWindow();
+    void drawGpuProfilerWindow();
+    void drawJobsWindow();
     static void exitConfirmMessage();
     void openFile();
     void drawIndividualPanel(FlashLightObject &object) const;
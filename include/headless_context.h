@@ -0,0 +1,38 @@
+#ifndef PROJECT_3_HEADLESS_CONTEXT_H
+#define PROJECT_3_HEADLESS_CONTEXT_H
+
+#include <string>
+#include <glad/glad.h>
+
+// OpenGL 3.3 core context without a window: an EGL context on the Mesa surfaceless platform (works with llvmpipe on
+// machines without a GPU or a display server) that renders into an offscreen framebuffer with color and depth renderbuffers.
+class HeadlessContext
+{
+public:
+    HeadlessContext() = default;
+    ~HeadlessContext();
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    void create(int width, int height);
+    void resizeFramebuffer(int width, int height);
+    void bindFramebuffer() const;
+    void release();
+
+    int width() const {return width_;}
+    int height() const {return height_;}
+    std::string rendererName() const;
+
+private:
+    // EGLDisplay and EGLContext, EGL headers are only included by the implementation
+    void* display_{nullptr};
+    void* context_{nullptr};
+
+    GLuint framebuffer_{};
+    GLuint color_buffer_{};
+    GLuint depth_buffer_{};
+    int width_{0};
+    int height_{0};
+};
+
+#endif //PROJECT_3_HEADLESS_CONTEXT_H
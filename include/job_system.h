@@ -0,0 +1,95 @@
+#ifndef PROJECT_3_JOB_SYSTEM_H
+#define PROJECT_3_JOB_SYSTEM_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// CPU time of one job of the last frame, in milliseconds since the start of the frame (see JobSystem::beginFrame)
+struct JobTiming {
+    const char* name;
+    unsigned int thread;  // 0 is the thread that submits the jobs (the render thread), workers are 1 and up
+    double start_ms;
+    double end_ms;
+};
+
+// Number of unfinished jobs of a group, the submitting thread waits until it drops to zero (JobSystem::wait).
+class JobCounter
+{
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+    bool done() const {return pending_.load(std::memory_order_acquire) == 0;}
+
+private:
+    friend class JobSystem;
+    std::atomic<int> pending_{0};
+};
+
+// Persistent worker threads for the per-frame CPU work of the render thread, which otherwise would spawn threads
+// every frame (see Parallel). Every thread owns a queue of jobs: it pushes and pops its own jobs at the back (the
+// most recently split, still warm in its cache) and steals from the front of the queues of other threads when its own
+// queue is empty. Idle workers sleep until a job is pushed. A thread that waits for a counter runs jobs meanwhile, so
+// jobs may submit jobs and wait for them, and with a single hardware thread all jobs run on the render thread.
+// Jobs must not throw and must not call OpenGL, only the render thread has a context.
+class JobSystem
+{
+public:
+    // parallelFor splits a range into at most this many chunks per thread, the surplus balances uneven chunks by stealing
+    static const unsigned int CHUNKS_PER_THREAD = 4;
+
+    explicit JobSystem(unsigned int worker_count = defaultWorkerCount());
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    ~JobSystem();
+
+    void run(const char* name, JobCounter& counter, std::function<void()> job);
+    void parallelFor(const char* name, JobCounter& counter, size_t count, size_t min_items,
+                     const std::function<void(size_t, size_t)>& job);
+    void wait(JobCounter& counter);
+
+    void beginFrame();
+    unsigned int threadCount() const {return static_cast<unsigned int>(queues_.size());}
+    const std::vector<JobTiming>& getTimings() const {return timings_;}
+
+    static unsigned int defaultWorkerCount();
+
+private:
+    struct Job {
+        const char* name{nullptr};
+        JobCounter* counter{nullptr};
+        std::function<void()> work;
+    };
+    // the timings are written only by the thread of the queue, so recording a job does not lock
+    struct ThreadQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+        std::vector<JobTiming> timings;
+    };
+
+    std::vector<std::unique_ptr<ThreadQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<int> queued_jobs_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stopping_{false};
+
+    std::chrono::steady_clock::time_point frame_start_{std::chrono::steady_clock::now()};
+    std::vector<JobTiming> timings_;
+
+    void push_(Job job);
+    bool popOrSteal_(unsigned int thread, Job& job);
+    void execute_(unsigned int thread, Job& job);
+    void workerLoop_(unsigned int thread);
+    unsigned int currentThread_() const;
+};
+
+#endif //PROJECT_3_JOB_SYSTEM_H
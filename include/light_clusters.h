@@ -0,0 +1,104 @@
+#ifndef PROJECT_3_LIGHT_CLUSTERS_H
+#define PROJECT_3_LIGHT_CLUSTERS_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "../include/object.h"
+#include "../include/job_system.h"
+#include "../include/stream_buffer.h"
+#include "../include/texture_buffer.h"
+#include "../include/uniform_buffer.h"
+
+// Statistics of the last light assignment, shown in the menu.
+struct ClusterStats {
+    size_t lights{0};
+    size_t clusters{0};
+    size_t light_indices{0};        // sum of lights over all clusters
+    size_t max_cluster_lights{0};
+
+    double averageClusterLights() const
+    {
+        return clusters == 0 ? 0.0 : static_cast<double>(light_indices) / static_cast<double>(clusters);
+    }
+};
+
+// Clustered forward lighting: the view frustum is split into GRID_X x GRID_Y screen tiles and GRID_Z depth slices
+// (exponentially spaced, so clusters are roughly cubic), every light is assigned to the clusters its volume of
+// influence overlaps, and the fragment shader shades only with the lights of its cluster. Assignment runs on the CPU
+// every frame on the job system (the extents of the lights in parallel, then the depth slices in parallel, every slice
+// keeps the order of the lights), the result is uploaded to three texture buffers:
+//     - light data: 4 RGBA32F texels per light (see LightData);
+//     - cluster table: one RGBA32UI texel per cluster, offset of its lights in the light index list, number of its
+//       spotlights and of its point lights (spotlights come first);
+//     - light index list: R32UI indices into the light data.
+class LightClusters
+{
+public:
+    static const int GRID_X = 16;
+    static const int GRID_Y = 9;
+    static const int GRID_Z = 24;
+    // every light adds to the ambient light, the sum is limited to 4 white lights (the former maximum number of lights)
+    // so that scenes with hundreds of lights are not washed out
+    const float AMBIENT_LIMIT{4.0f};
+
+    void update(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, JobSystem& jobs,
+                StreamBuffer& stream, bool assign_clusters = true);
+    void bind() const;
+    void release();
+    float lightRadius(const Light& light) const;
+
+    const ClusterStats& getStats() const {return stats_;}
+    float nearPlane() const {return near_;}
+    float farPlane() const {return far_;}
+
+    static bool projectViewBox(const glm::vec3& box_min, const glm::vec3& box_max, const glm::mat4& projection,
+                               float near, float far, float min_ndc[2], float max_ndc[2]);
+
+private:
+    struct ClusterBounds {
+        glm::vec3 min;
+        glm::vec3 max;
+        glm::vec3 center;
+        float radius;
+    };
+    // view space sphere of influence of a light and the range of clusters its bounding box covers, empty (min_z > max_z)
+    // if the light is outside of the view
+    struct LightExtent {
+        glm::vec3 center;
+        float radius;
+        int min_x, max_x, min_y, max_y, min_z, max_z;
+        bool cone;
+        glm::vec3 cone_direction;
+        float cone_cos, cone_sin;
+    };
+
+    // cluster bounds are in view space, so they depend only on the projection and the viewport
+    glm::mat4 bounds_projection_{0.0f};
+    int viewport_[4] = {0, 0, 0, 0};
+    float near_{0.1f};
+    float far_{100.0f};
+    std::vector<ClusterBounds> bounds_;
+
+    std::vector<LightData> light_data_;
+    std::vector<LightExtent> light_extents_;
+    std::vector<std::vector<GLuint>> cluster_lights_;
+    std::vector<GLuint> cluster_spotlights_;
+    std::vector<GLuint> cluster_table_;
+    std::vector<GLuint> light_indices_;
+    LightsBlock lights_block_{};
+    ClusterStats stats_{};
+
+    TextureBuffer light_data_buffer_{GL_RGBA32F};
+    TextureBuffer cluster_buffer_{GL_RGBA32UI};
+    TextureBuffer light_index_buffer_{GL_R32UI};
+    // the "Lights" block changes with the viewport and the lights, it is written into the stream buffer every frame
+    StreamRange lights_range_{};
+
+    LightExtent lightExtent_(const Light& light, const glm::mat4& view, const glm::mat4& projection) const;
+    void assignSlices_(const std::vector<Light>& lights, int first_slice, int last_slice, bool assign_clusters);
+    void assignLight_(GLuint light_index, const LightExtent& extent, int first_slice, int last_slice);
+    void buildClusterBounds_(const glm::mat4& projection);
+    int sliceOfDepth_(float depth) const;
+};
+
+#endif //PROJECT_3_LIGHT_CLUSTERS_H
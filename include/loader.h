@@ -1,14 +1,49 @@
 #ifndef PROJECT_3_LOADER_H
 #define PROJECT_3_LOADER_H
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include "tiny_obj_loader.h"
+#include "../include/vertex_format.h"
 
 struct Vertex
 {
     float x, y, z;
 };
+
+// defines how the normals of the faces sharing a vertex contribute to the vertex normal
+enum class NormalWeighting {
+    Uniform,  // every adjacent face counts the same (unit face normals are summed)
+    Area,     // faces contribute proportionally to their area
+    Angle     // faces contribute proportionally to the interior angle at the vertex
+};
+
+// options of a mesh load that change the produced geometry
+struct MeshLoadOptions {
+    NormalWeighting weighting{NormalWeighting::Uniform};
+    bool optimize{false};         // weld vertices and reorder triangles and vertices for GPU caches (see MeshOptimizer)
+    float weld_epsilon{1e-5f};    // positions closer than this distance are welded when optimize is set
+    unsigned int lod_levels{4};   // levels of detail including the full mesh, each has about half of the triangles of the previous one
+    VertexFormat vertex_format{}; // layout of the GPU vertex buffer, does not change the cached mesh
+
+    bool operator==(const MeshLoadOptions& other) const
+    {
+        return weighting == other.weighting && optimize == other.optimize && weld_epsilon == other.weld_epsilon &&
+               lod_levels == other.lod_levels && vertex_format == other.vertex_format;
+    }
+    bool operator!=(const MeshLoadOptions& other) const {return !(*this == other);}
+};
+
+// progress of a mesh load, shared between the loading thread and the thread that observes or cancels it
+struct LoadProgress {
+    std::atomic<float> fraction{0.0f};
+    std::atomic<bool> cancelled{false};
+
+    // stores the fraction of work done and throws if the load was cancelled meanwhile
+    void report(float value);
+};
+
 class ObjectLoader
 {
 public:
@@ -16,13 +51,12 @@ public:
     static void loadObjFileData(const std::string &filepath,
                                std::vector<float> &object_vertices,
                                std::vector<float> &object_normals,
-                               std::vector<unsigned int> &indices_);
+                               std::vector<unsigned int> &indices_,
+                               NormalWeighting weighting = NormalWeighting::Uniform,
+                               LoadProgress* progress = nullptr);
 private:
-    static Vertex calculateAverageSurfaceNormal(std::vector<Vertex> const& normals);
-    static Vertex calculateSurfaceNormal(Vertex& v1, Vertex& v2, Vertex& v3);
-    static void loadObjNormals(std::vector<float>& object_normals, std::vector<float>& object_vertices,
-                                                    std::vector<std::vector<unsigned int>>& object_shapes);
-
-
+    static void loadWithTinyObj(const std::string &filepath,
+                                std::vector<float> &object_vertices,
+                                std::vector<unsigned int> &indices_);
 };
 #endif //PROJECT_3_LOADER_H
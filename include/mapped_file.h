@@ -0,0 +1,24 @@
+#ifndef PROJECT_3_MAPPED_FILE_H
+#define PROJECT_3_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. The mapping lives as long as the object.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& filepath);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const {return data_;}
+    size_t size() const {return size_;}
+
+private:
+    const char* data_{nullptr};
+    size_t size_{0};
+};
+
+#endif //PROJECT_3_MAPPED_FILE_H
@@ -0,0 +1,105 @@
+#ifndef PROJECT_3_MESH_ARENA_H
+#define PROJECT_3_MESH_ARENA_H
+
+#include <cstddef>
+#include <map>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "../include/vertex_format.h"
+
+// per-instance data of the instance buffer, read by the vertex shaders from attributes 2-5 (columns of the model matrix)
+// and 6 (color) once per instance; instance transforms are rigid (rotation and translation only)
+struct InstanceData {
+    glm::mat4 model{1.0f};
+    glm::vec4 color{1.0f};
+};
+
+// place of a mesh in the mesh arena: its vertices and indices are ranges of the buffers of one pool
+struct ArenaMesh {
+    int pool{-1};
+    size_t first_vertex{0};
+    size_t vertex_count{0};
+    size_t index_offset{0};   // in bytes
+    size_t index_bytes{0};
+
+    bool allocated() const {return pool >= 0;}
+};
+
+// use of the mesh arena, shown in the menu
+struct MeshArenaStats {
+    size_t pools{0};
+    size_t meshes{0};
+    size_t used_bytes{0};       // vertices and indices of all meshes
+    size_t capacity_bytes{0};   // storage of all pools
+    size_t free_ranges{0};      // holes left by unloaded meshes and the free ends of the buffers
+    size_t resizes{0};
+};
+
+// First-fit free list of the ranges of a buffer, in any unit (vertices or bytes). Free ranges are kept sorted by their
+// offset, so a freed range is merged with its free neighbours and the list does not fragment into small pieces.
+class RangeAllocator
+{
+public:
+    bool allocate(size_t size, size_t alignment, size_t& offset);
+    void free(size_t offset, size_t size);
+    void grow(size_t capacity);
+
+    size_t capacity() const {return capacity_;}
+    size_t used() const {return used_;}
+    size_t freeRangeCount() const {return free_ranges_.size();}
+
+private:
+    std::map<size_t, size_t> free_ranges_;   // offset -> size
+    size_t capacity_{0};
+    size_t used_{0};
+};
+
+// Shared vertex and index storage of all meshes, instead of buffers and a VAO per Object. Meshes with the same vertex
+// layout share a pool: one vertex buffer, one element buffer and one VAO whose attributes are defined once, so drawing
+// one mesh after another needs no VAO switch; a mesh is drawn by its range of indices and a base vertex
+// (glDrawElementsBaseVertex). Ranges are suballocated from the free lists of the pool and freed when a mesh is
+// unloaded; a full pool grows into buffers twice as large and copies its content on the GPU (glCopyBufferSubData).
+// The instance attributes 2-6 are part of the VAO as well, so every draw points them at its own instances.
+// The VAO and the buffer names of a pool stay valid when it grows, only the storage behind the VAO changes.
+class MeshArena
+{
+public:
+    const size_t INITIAL_POOL_VERTICES{64 * 1024};
+    const size_t INITIAL_POOL_INDEX_BYTES{512 * 1024};
+    // 16-bit and 32-bit indices of different meshes share the element buffer
+    const size_t INDEX_ALIGNMENT{4};
+
+    static MeshArena& shared();
+
+    ArenaMesh allocate(const PackedMesh& packed);
+    void free(ArenaMesh& mesh);
+    void writeVertices(const ArenaMesh& mesh, size_t offset, size_t size, const void* data);
+    void writeIndices(const ArenaMesh& mesh, size_t offset, size_t size, const void* data);
+
+    GLuint vao(const ArenaMesh& mesh) const;
+    MeshArenaStats getStats() const;
+
+    static void setupInstanceAttributes(GLuint buffer, GLintptr offset);
+
+private:
+    struct Pool {
+        PackedMesh layout;   // format, stride and normal offset of the vertices, without data
+        GLuint vao{0};
+        GLuint vertex_buffer{0};
+        GLuint index_buffer{0};
+        RangeAllocator vertices;
+        RangeAllocator indices;
+        size_t meshes{0};
+    };
+
+    std::vector<Pool> pools_;
+    size_t resizes_{0};
+
+    int findPool_(const PackedMesh& packed);
+    void growBuffer_(GLuint& buffer, size_t old_bytes, size_t new_bytes);
+    void setupVertexArray_(const Pool& pool);
+    static void write_(GLuint buffer, size_t offset, size_t size, const void* data);
+};
+
+#endif //PROJECT_3_MESH_ARENA_H
@@ -0,0 +1,57 @@
+#ifndef PROJECT_3_MESH_ASSETS_H
+#define PROJECT_3_MESH_ASSETS_H
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include "../include/loader.h"
+#include "../include/mesh_data.h"
+#include "../include/mesh_arena.h"
+
+// Geometry of a mesh shared by all Objects that show it: the CPU data the draws need (levels of detail, meshlets,
+// bounds), the packed vertex layout and the ranges of the mesh in the mesh arena. The ranges are returned to the arena
+// when the last Object releases the asset (this only updates the free lists, no OpenGL call).
+struct MeshAsset {
+    MeshData mesh;
+    PackedMesh packed;          // the data is released once it is on the GPU
+    ArenaMesh arena_mesh;
+    size_t uploaded_bytes{0};   // progress of the upload by Object::uploadBufferChunk
+
+    MeshAsset() = default;
+    MeshAsset(MeshData mesh_data, PackedMesh packed_mesh): mesh(std::move(mesh_data)), packed(std::move(packed_mesh)){}
+    MeshAsset(const MeshAsset&) = delete;
+    MeshAsset& operator=(const MeshAsset&) = delete;
+    ~MeshAsset() {MeshArena::shared().free(arena_mesh);}
+};
+
+// use of the registry, shown in the menu
+struct MeshAssetStats {
+    size_t assets{0};       // meshes loaded from files that are still used
+    size_t references{0};  // Objects that use them
+    size_t loads{0};        // files read and uploaded
+    size_t reuses{0};       // loads that took an asset already in memory instead
+};
+
+// Reference-counted registry of the meshes loaded from .obj files, keyed by the canonical path of the file and the
+// load options. An Object that loads a file asks the registry first and shares the mesh that is already on the GPU,
+// so a file is read and uploaded only once while an Object uses it (e.g. the light gizmos of every Session and a
+// central object that is loaded again). The registry only observes the assets (weak pointers), they are freed with
+// their last Object. It is used by the render thread only.
+class MeshAssets
+{
+public:
+    static std::shared_ptr<MeshAsset> find(const std::string& obj_filepath, const MeshLoadOptions& options);
+    static void add(const std::string& obj_filepath, const MeshLoadOptions& options, const std::shared_ptr<MeshAsset>& asset);
+    static MeshAssetStats getStats();
+
+private:
+    static std::map<std::string, std::weak_ptr<MeshAsset>> assets_;
+    static size_t loads_;
+    static size_t reuses_;
+
+    static std::string key_(const std::string& obj_filepath, const MeshLoadOptions& options);
+    static void removeExpired_();
+};
+
+#endif //PROJECT_3_MESH_ASSETS_H
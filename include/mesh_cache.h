@@ -0,0 +1,72 @@
+#ifndef PROJECT_3_MESH_CACHE_H
+#define PROJECT_3_MESH_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include "../include/loader.h"
+#include "../include/mesh_data.h"
+
+// Versioned binary cache of parsed .obj meshes (positions, normals, indices with the LOD chain, meshlets,
+// bounds and optimization stats).
+// A cache file is written the first time an .obj is loaded and is keyed by the source file's canonical path,
+// size, modification time and content hash. Later loads memory-map the cache file instead of parsing the .obj.
+class MeshCache
+{
+public:
+    static void loadObjMesh(const std::string& obj_filepath, const MeshLoadOptions& options, MeshData& mesh,
+                            LoadProgress* progress = nullptr);
+    static bool load(const std::string& obj_filepath, const MeshLoadOptions& options, MeshData& mesh);
+    static void store(const std::string& obj_filepath, const MeshLoadOptions& options, const MeshData& mesh);
+
+    // an empty directory disables the cache
+    static void setCacheDirectory(const std::string& directory) {cache_directory_ = directory;}
+    static const std::string& cacheDirectory() {return cache_directory_;}
+
+private:
+    static const uint32_t FORMAT_VERSION = 4;
+    static std::string cache_directory_;
+
+    struct SourceKey {
+        std::string canonical_path;
+        uint64_t size;
+        int64_t mtime_ns;
+    };
+
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t normal_weighting;
+        uint32_t optimized;
+        float weld_epsilon;
+        uint32_t welded_vertices;
+        float acmr_before;
+        float acmr_after;
+        float atvr_before;
+        float atvr_after;
+        uint32_t lod_levels;
+        uint64_t path_hash;
+        uint64_t source_size;
+        int64_t source_mtime_ns;
+        uint64_t source_hash;
+        uint64_t vertex_count;
+        uint64_t index_count;
+        float bounds_min[3];
+        float bounds_max[3];
+        uint64_t vertices_offset;
+        uint64_t normals_offset;
+        uint64_t indices_offset;
+        uint64_t lods_offset;
+        uint64_t lod_count;
+        uint64_t meshlets_offset;
+        uint64_t meshlet_count;
+    };
+
+    static bool readSourceKey(const std::string& obj_filepath, SourceKey& key);
+    static std::string cacheFilePath(const SourceKey& key, const MeshLoadOptions& options);
+    static uint64_t hashBytes(const char* data, size_t size, uint64_t hash = 14695981039346656037ULL);
+    static uint64_t hashFile(const std::string& filepath);
+    static void fillHeader(FileHeader& header, const SourceKey& key, uint64_t source_hash, const MeshLoadOptions& options, const MeshData& mesh);
+    static bool updateHeader(const std::string& cache_path, const FileHeader& header);
+};
+
+#endif //PROJECT_3_MESH_CACHE_H
@@ -0,0 +1,84 @@
+#ifndef PROJECT_3_MESH_DATA_H
+#define PROJECT_3_MESH_DATA_H
+
+#include <memory>
+#include <vector>
+#include "../include/mapped_file.h"
+
+// axis-aligned bounding box of a mesh in object space
+struct MeshBounds {
+    float min[3] = {0, 0, 0};
+    float max[3] = {0, 0, 0};
+};
+
+// result of MeshOptimizer: average cache miss ratio (transformed vertices per triangle) and average transform to vertex
+// ratio (transformed vertices per unique vertex) before and after the optimization
+struct MeshOptimizationStats {
+    bool optimized{false};
+    unsigned int welded_vertices{0};
+    float acmr_before{0};
+    float acmr_after{0};
+    float atvr_before{0};
+    float atvr_after{0};
+};
+
+// range of the index buffer that holds one level of detail, levels are stored one after another starting from the full mesh
+struct MeshLod {
+    unsigned int index_offset;
+    unsigned int index_count;
+    float error;    // object space distance between the simplified surface and the full mesh
+    unsigned int meshlet_offset{0};
+    unsigned int meshlet_count{0};
+};
+
+// cluster of neighbouring triangles of one level of detail (a contiguous index range) with its object space bounding
+// sphere and normal cone: the meshlet faces away from a viewer at p if dot(center - p, cone_axis) >= cone_cutoff * |center - p| + radius
+struct Meshlet {
+    unsigned int index_offset;
+    unsigned int index_count;
+    float center[3];
+    float radius;
+    float cone_axis[3];
+    float cone_cutoff;    // 1 disables backface culling of the meshlet
+};
+
+// CPU side geometry of an object: positions and normals (3 floats per vertex) and triangle indices.
+// The index buffer may contain several levels of detail over the same vertices, described by 'lods',
+// and the triangles of every level are grouped into 'meshlets'.
+// When a mesh is read from the binary mesh cache, the vectors stay empty and the data pointers
+// reference the memory-mapped cache file, so it can be handed to OpenGL without copying.
+struct MeshData {
+    std::vector<float> vertices;
+    std::vector<float> normals;
+    std::vector<unsigned int> indices;
+    MeshBounds bounds;
+    MeshOptimizationStats optimization_stats;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+
+    std::shared_ptr<const MappedFile> mapped_file;
+    const float* mapped_vertices{nullptr};
+    const float* mapped_normals{nullptr};
+    const unsigned int* mapped_indices{nullptr};
+    size_t mapped_vertex_count{0};
+    size_t mapped_index_count{0};
+
+    bool isMapped() const {return mapped_file != nullptr;}
+
+    const float* vertexData() const {return isMapped() ? mapped_vertices : vertices.data();}
+    const float* normalData() const {return isMapped() ? mapped_normals : normals.data();}
+    const unsigned int* indexData() const {return isMapped() ? mapped_indices : indices.data();}
+    size_t vertexCount() const {return isMapped() ? mapped_vertex_count : vertices.size() / 3;}
+    size_t indexCount() const {return isMapped() ? mapped_index_count : indices.size();}
+
+    // a mesh without a LOD chain has a single level that spans the whole index buffer
+    size_t lodCount() const {return lods.empty() ? 1 : lods.size();}
+    MeshLod lod(size_t level) const
+    {
+        return lods.empty() ? MeshLod{0, static_cast<unsigned int>(indexCount()), 0.0f} : lods[level];
+    }
+
+    void computeBounds();
+};
+
+#endif //PROJECT_3_MESH_DATA_H
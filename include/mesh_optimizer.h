@@ -0,0 +1,38 @@
+#ifndef PROJECT_3_MESH_OPTIMIZER_H
+#define PROJECT_3_MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+#include "../include/loader.h"
+#include "../include/mesh_data.h"
+
+// Optional optimization stage applied to a mesh produced by ObjectLoader:
+//  1. welds vertices whose positions are closer than an epsilon (normals are rebuilt afterwards);
+//  2. reorders triangles for post-transform vertex cache reuse (Tipsify, Sander et al. 2007);
+//  3. reorders vertices in order of first use for vertex fetch locality.
+class MeshOptimizer
+{
+public:
+    // size of the FIFO post-transform cache used for Tipsify and for ACMR/ATVR measurement
+    static const unsigned int CACHE_SIZE = 16;
+
+    static void optimize(MeshData& mesh, const MeshLoadOptions& options);
+
+    static size_t weldVertices(std::vector<float>& vertices, std::vector<unsigned int>& indices, float epsilon);
+    static size_t removeDegenerateTriangles(std::vector<unsigned int>& indices);
+    static void buildVertexTriangles(const std::vector<unsigned int>& indices, size_t vertices_count,
+                                     std::vector<unsigned int>& offsets, std::vector<unsigned int>& triangles);
+    static void buildVertexTriangles(const unsigned int* indices, size_t index_count, size_t vertices_count,
+                                     std::vector<unsigned int>& offsets, std::vector<unsigned int>& triangles);
+    static void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertices_count, unsigned int cache_size = CACHE_SIZE);
+    static void optimizeVertexFetch(std::vector<float>& vertices, std::vector<float>& normals, std::vector<unsigned int>& indices);
+    static void measureVertexCache(const std::vector<unsigned int>& indices, size_t vertices_count, float& acmr, float& atvr,
+                                   unsigned int cache_size = CACHE_SIZE);
+
+private:
+    static int nextFanningVertex(const std::vector<unsigned int>& candidates, const std::vector<unsigned int>& live_triangles,
+                                 const std::vector<unsigned int>& cache_time, unsigned int time, unsigned int cache_size,
+                                 std::vector<unsigned int>& dead_ends, size_t& cursor);
+};
+
+#endif //PROJECT_3_MESH_OPTIMIZER_H
@@ -0,0 +1,50 @@
+#ifndef PROJECT_3_MESH_SIMPLIFIER_H
+#define PROJECT_3_MESH_SIMPLIFIER_H
+
+#include <cstddef>
+#include <vector>
+#include "../include/loader.h"
+#include "../include/mesh_data.h"
+
+// Quadric error metric simplification (Garland and Heckbert 1997) that builds a chain of levels of detail over
+// the vertices of the full mesh. Edges are collapsed onto one of their end points, so every level only needs
+// its own index buffer: levels are appended to the index buffer of the mesh and described by MeshData::lods.
+// Vertices on open borders are never removed, so silhouettes of open meshes stay in place.
+class MeshSimplifier
+{
+public:
+    // levels with fewer triangles are not generated
+    static const size_t MIN_LOD_TRIANGLES = 64;
+
+    static void buildLodChain(MeshData& mesh, const MeshLoadOptions& options);
+    static void simplify(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                         const std::vector<size_t>& target_index_counts,
+                         std::vector<std::vector<unsigned int>>& lod_indices, std::vector<float>& lod_errors);
+
+private:
+    // symmetric 4x4 matrix of the sum of squared distances to a set of planes, weighted by triangle area
+    struct Quadric {
+        double a2{0}, ab{0}, ac{0}, ad{0}, b2{0}, bc{0}, bd{0}, c2{0}, cd{0}, d2{0};
+        double weight{0};
+
+        void addPlane(double a, double b, double c, double d, double plane_weight);
+        void add(const Quadric& other);
+        double evaluate(const float* point) const;
+    };
+
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        float error;
+    };
+
+    static void buildQuadrics(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                              std::vector<Quadric>& quadrics);
+    static void findLockedVertices(const std::vector<unsigned int>& indices, size_t vertices_count, std::vector<char>& locked);
+    static float collapseError(const Quadric& from, const Quadric& to, const float* point);
+    static bool flipsTriangles(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                               const std::vector<unsigned int>& offsets, const std::vector<unsigned int>& vertex_triangles,
+                               unsigned int from, unsigned int to);
+};
+
+#endif //PROJECT_3_MESH_SIMPLIFIER_H
@@ -0,0 +1,27 @@
+#ifndef PROJECT_3_MESHLET_BUILDER_H
+#define PROJECT_3_MESHLET_BUILDER_H
+
+#include <cstddef>
+#include <vector>
+#include "../include/mesh_data.h"
+
+// Partitions the triangles of every level of detail into meshlets: small clusters of neighbouring triangles that can
+// be culled as a whole. A meshlet is grown from a seed triangle by adding adjacent triangles that bring the fewest
+// new vertices, the triangles of a level are rewritten in meshlet order, so every meshlet is a contiguous index range.
+class MeshletBuilder
+{
+public:
+    static const size_t MAX_VERTICES  = 64;
+    static const size_t MAX_TRIANGLES = 124;
+
+    static void buildMeshlets(MeshData& mesh);
+    static void partition(const std::vector<float>& vertices, unsigned int* indices, size_t index_count,
+                          std::vector<unsigned int>& meshlet_index_counts);
+
+private:
+    static bool isClosed(const unsigned int* indices, size_t index_count);
+    static Meshlet computeBounds(const std::vector<float>& vertices, const unsigned int* indices, unsigned int index_offset,
+                                 unsigned int index_count, bool cone_culling);
+};
+
+#endif //PROJECT_3_MESHLET_BUILDER_H
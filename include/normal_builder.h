@@ -0,0 +1,28 @@
+#ifndef PROJECT_3_NORMAL_BUILDER_H
+#define PROJECT_3_NORMAL_BUILDER_H
+
+#include <cstddef>
+#include <vector>
+#include "../include/loader.h"
+
+class NormalBuilder
+{
+public:
+    static void buildVertexNormals(const std::vector<float>& object_vertices,
+                                   const std::vector<unsigned int>& indices,
+                                   std::vector<float>& object_normals,
+                                   NormalWeighting weighting = NormalWeighting::Uniform,
+                                   unsigned int thread_count = 0);
+
+    static Vertex calculateSurfaceNormal(const Vertex& v1, const Vertex& v2, const Vertex& v3);
+    static void normalize(Vertex& vertex);
+
+private:
+    // meshes below this amount of triangles are processed on the calling thread only
+    static const size_t MIN_TRIANGLES_PER_THREAD = 16384;
+
+    static void computeCornerAngles(const std::vector<float>& object_vertices, const std::vector<unsigned int>& indices,
+                                    size_t first_triangle, size_t last_triangle, std::vector<float>& corner_weights);
+};
+
+#endif //PROJECT_3_NORMAL_BUILDER_H
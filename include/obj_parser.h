@@ -0,0 +1,44 @@
+#ifndef PROJECT_3_OBJ_PARSER_H
+#define PROJECT_3_OBJ_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Built-in .obj front-end for large files. The file is memory-mapped, split at line boundaries into chunks
+// that are parsed by separate threads, and positions and triangle indices are written straight into the output vectors.
+// Only geometry is read: 'v' positions and 'f' faces (polygons are triangulated as fans), all other statements are skipped.
+class ObjParser
+{
+public:
+    static bool parse(const std::string& filepath,
+                      std::vector<float>& object_vertices,
+                      std::vector<unsigned int>& indices,
+                      std::string& error,
+                      unsigned int thread_count = 0);
+
+    static bool parseFloat(const char*& pos, const char* end, float& value);
+    static bool parseIndex(const char*& pos, const char* end, long long& value);
+
+private:
+    // files below this size are parsed on the calling thread only
+    static const size_t MIN_BYTES_PER_THREAD = 4 << 20;
+
+    struct Chunk {
+        const char* begin;
+        const char* end;
+        size_t vertices_count{0};
+        size_t triangles_count{0};
+        size_t vertices_offset{0};
+        size_t triangles_offset{0};
+        std::string error;
+    };
+
+    static void countChunk(Chunk& chunk);
+    static void parseChunk(Chunk& chunk, size_t total_vertices, float* vertices, unsigned int* indices);
+    static uint32_t parseEightDigits(const char* digits);
+    static bool isEightDigits(const char* digits);
+};
+
+#endif //PROJECT_3_OBJ_PARSER_H
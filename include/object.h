@@ -5,6 +5,15 @@
 #include <string>
 #include <vector>
 #include "../include/shader.h"
+#include "../include/loader.h"
+#include "../include/mesh_data.h"
+#include "../include/uniform_buffer.h"
+#include "../include/transform.h"
+#include "../include/render_queue.h"
+#include "../include/job_system.h"
+#include "../include/stream_buffer.h"
+#include "../include/mesh_arena.h"
+#include "../include/mesh_assets.h"
 
 // struct that contains lighting parameters for 2 types of light: point light and spotlight
 struct Light {
@@ -21,49 +30,198 @@ struct Light {
     float outerCutOff{12.5};
 };
 
+// parameters of a light in the light data texture buffer of shader_central.frag (4 RGBA32F texels per light)
+struct LightData {
+    float position[4];     // xyz: position in world space, w: type (0 spotlight, 1 point light)
+    float direction[4];    // xyz: direction of the spotlight, w: intensity
+    float color[4];        // rgb: color, w: linear attenuation factor
+    float attenuation[4];  // x: quadratic attenuation factor, y: cos(cutOff), z: cos(outerCutOff), w: radius
+
+    static LightData fromLight(const Light& light);
+};
+
+// mirror of the std140 uniform block "Lights" of shader_central.frag: global lighting data and the parameters
+// of the cluster grid, the lights themselves are in texture buffers (see LightClusters)
+struct LightsBlock {
+    // texture units of the light data, cluster and light index texture buffers
+    static const int LIGHT_DATA_UNIT    = 1;
+    static const int CLUSTER_UNIT       = 2;
+    static const int LIGHT_INDEX_UNIT   = 3;
+
+    int count[4] = {0, 0, 0, 0};       // x: number of lights, yzw: number of clusters along x, y and depth
+    float ambient[4] = {0, 0, 0, 0};   // rgb: sum of the colors of all lights (limited, see LightClusters)
+    float cluster_scale[4] = {1, 1, 1, 0};  // xy: 1 / cluster size in pixels, z: scale and w: bias of log(depth) to slices
+};
+
+// mirror of the std140 uniform block "Transforms" of the vertex shaders of all objects, written for every draw into the
+// stream buffer of the frame (see Object::bindTransforms)
+struct TransformsBlock {
+    glm::mat4 projection{1.0f};
+    glm::mat4 view{1.0f};
+    glm::mat4 model{1.0f};
+    glm::vec4 normal_matrix[3];  // columns of the mat3, std140 pads them to vec4
+    glm::vec4 view_pos{0.0f};    // xyz: position of the camera
+};
+
+// mirror of the std140 uniform block "Shadows" of shader_central.frag and shader_deferred.frag (see ShadowAtlas)
+struct ShadowsBlock {
+    // texture units of the shadow atlas and its texture buffers of light tiles and tile matrices
+    static const int ATLAS_UNIT         = 8;
+    static const int SHADOW_LIGHT_UNIT  = 9;
+    static const int SHADOW_MATRIX_UNIT = 10;
+
+    int params[4] = {0, 0, 0, 0};    // x: PCF kernel radius in texels, y: tiles per atlas row, z: 1 if shadows are on
+    float scale[4] = {0, 0, 0, 0};   // x: size of an atlas texel, y: size of a tile (in atlas uv), z: depth bias,
+                                     // w: offset of the surface along its normal in shadow map texels
+};
+
+// features of the central object shader that are compiled only if they are used (see ShaderPermutations):
+// bit i of a shader key defines the i-th of defineNames() in the shader
+struct ShaderFeatures {
+    static const unsigned int SPOTLIGHTS   = 1u << 0;
+    static const unsigned int POINT_LIGHTS = 1u << 1;
+    static const unsigned int SPECULAR     = 1u << 2;
+    static const unsigned int SHADOWS      = 1u << 3;
+    static const unsigned int ALL          = SPOTLIGHTS | POINT_LIGHTS | SPECULAR | SHADOWS;
+
+    static std::vector<std::string> defineNames() {return {"SPOTLIGHTS", "POINT_LIGHTS", "SPECULAR", "SHADOWS"};}
+};
+
+// mirror of the std140 uniform block "Material" of shader_central.frag
+struct MaterialBlock {
+    float color[4] = {1, 1, 1, 1};
+    float ambient_strength{0.1f};
+    float specular_strength{0.5f};
+    float shininess{32.0f};
+    float padding{0};
+};
+
+
+// meshlets of the last drawn frame: rejected by the view frustum or by the normal cone, and the number of submitted draws
+struct MeshletCullStats {
+    size_t meshlets{0};
+    size_t frustum_culled{0};
+    size_t backface_culled{0};
+    size_t triangles{0};
+    size_t culled_triangles{0};
+    size_t draws{0};
+
+    float culledPercentage() const {return meshlets == 0 ? 0.0f : 100.0f * static_cast<float>(frustum_culled + backface_culled) / static_cast<float>(meshlets);}
+};
 
 class Object{
 public:
-    Object(const std::string& obj_filepath, const std::string& shader_vert, const std::string& shader_frag);
+    Object(const std::string& obj_filepath, const std::string& shader_vert, const std::string& shader_frag,
+           const MeshLoadOptions& options = MeshLoadOptions());
+    Object(MeshData mesh, PackedMesh packed, const std::string& shader_vert, const std::string& shader_frag);
+    Object(std::shared_ptr<MeshAsset> asset, const std::string& shader_vert, const std::string& shader_frag);
     virtual void loadObjectBuffers();
-    virtual void draw(glm::mat4& view, glm::mat4& projection, glm::vec3 camera_position, std::vector<Light> lights);
-    void loadObjectFile(const std::string& filepath);
+    void beginBufferUpload();
+    bool uploadBufferChunk(size_t max_bytes);
+    float uploadProgress() const;
+    virtual void releaseBuffers();
+    void prepareDraw(JobSystem& jobs, const glm::mat4& view, const glm::mat4& projection,
+                     const glm::vec3& camera_position, float viewport_height);
+    void submit(RenderQueue& queue, StreamBuffer& stream, glm::mat4& view, glm::mat4& projection,
+                glm::vec3 camera_position);
+    void drawWithProgram(const ShaderProgram& program, StreamBuffer& stream, glm::mat4& view, glm::mat4& projection,
+                         glm::vec3 camera_position);
+    void drawShadowCaster(const ShaderProgram& program, const glm::mat4& light_view_projection);
+    void loadObjectFile(const std::string& filepath, const MeshLoadOptions& options = MeshLoadOptions());
     virtual float* getObjectColor(){return rgb_;}
     float& getScale(){return scale_;}
+    const MeshOptimizationStats& getOptimizationStats() const {return asset_->mesh.optimization_stats;}
+    const PackedMesh& getPackedMesh() const {return asset_->packed;}
+    size_t getLod() const {return current_lod_;}
+    size_t getLodCount() const {return asset_->mesh.lodCount();}
+    size_t getTriangleCount() const {return asset_->mesh.lod(current_lod_).index_count / 3;}
+    bool& meshletCulling(){return meshlet_culling_;}
+    const MeshletCullStats& getMeshletCullStats() const {return meshlet_cull_stats_;}
+    void setInstances(std::vector<InstanceData> instances);
+    size_t getInstanceCount() const {return instances_.size();}
+    const std::vector<InstanceData>& getInstances() const {return instances_;}
+    const MeshData& getMesh() const {return asset_->mesh;}
+    const glm::mat4& getModelMatrix() const;
+    float getBoundingRadius() const;
+    void setLightFeatures(unsigned int light_features){light_features_ = light_features & ~ShaderFeatures::SPECULAR;}
+    bool& specularHighlights(){return specular_;}
+    unsigned int getShaderKey() const {return shader_key_;}
+    size_t getShaderVariantCount() const {return shader_variants_.variantCount();}
 
 protected:
-    struct Vertex
-    {
-        float x, y, z;
-    };
     float rgb_[3] = {1,1,1};
     float scale_{1};
-
-    std::vector<GLfloat> vertices_{};
-    std::vector<GLfloat> normals_{};
-    std::vector<GLuint> indices_{};
-
-    GLuint VAO_{};
-    GLuint VBO_{};
-    GLuint NBO_{};
-    GLuint EBO_{};
+    // the scale is edited through getScale(), so it is passed to the transform whenever the model matrix is read
+    mutable Transform transform_;
+    MaterialBlock material_{};
+    UniformBuffer material_buffer_{UniformBuffer::MATERIAL_BINDING};
+
+    // geometry of the Object, shared with the other Objects of the same file (see MeshAssets)
+    std::shared_ptr<MeshAsset> asset_;
+    size_t current_lod_{0};
+    bool meshlet_culling_{true};
+    MeshletCullStats meshlet_cull_stats_{};
+    // result of prepareDraw: the visible meshlet ranges are drawn instead of the whole level of detail
+    bool meshlet_draws_{false};
+    std::vector<unsigned char> meshlet_visibility_;
+    std::vector<GLsizei> draw_counts_;
+    std::vector<const void*> draw_offsets_;
+    std::vector<GLint> draw_base_vertices_;
+
+    // all instances are drawn with a single instanced draw call, a single instance with identity transform by default
+    std::vector<InstanceData> instances_{InstanceData()};
+    size_t instance_capacity_{0};
+    bool instances_dirty_{true};
+
+    // a level of detail is used while its simplification error covers at most this many pixels on the screen,
+    // a coarser level is taken only when its error is below LOD_HYSTERESIS of the limit
+    static constexpr float LOD_ERROR_PIXELS{1.0f};
+    static constexpr float LOD_HYSTERESIS{0.75f};
+
+    GLuint instance_VBO_{};
+    // the shader program is the variant of shader_variants_ for shader_key_, it is switched when the lights or the
+    // material need other features (light types present in the scene, specular highlights)
+    ShaderPermutations shader_variants_;
     ShaderProgram shaderProgram_;
+    unsigned int shader_key_{ShaderFeatures::ALL};
+    unsigned int light_features_{ShaderFeatures::SPOTLIGHTS | ShaderFeatures::POINT_LIGHTS};
+    bool specular_{true};
 
     static std::vector<float> calculateNormalsSimple(std::vector<float> vertices);
+    void ensureNormals();
+    void selectLod(JobSystem& jobs, const glm::mat4& projection, const glm::vec3& camera_position, float viewport_height);
+    void drawLod(size_t level) const;
+    void useShaderVariant(unsigned int key);
+    void setupShaderProgram();
+    void drawWith(const ShaderProgram& program, StreamBuffer& stream, glm::mat4& view, glm::mat4& projection,
+                  glm::vec3 camera_position);
+    void drawBound(StreamBuffer& stream, const glm::mat4& view, const glm::mat4& projection,
+                   const glm::vec3& camera_position);
+    static void bindTransforms(StreamBuffer& stream, const glm::mat4& view, const glm::mat4& projection,
+                               const glm::mat4& model, const glm::mat3& normal_matrix, const glm::vec3& camera_position);
+    void uploadInstances();
+    GLenum indexType() const;
+    const void* indexPointer(size_t first_index) const;
+    glm::mat4 dequantizationMatrix() const;
+    void cullMeshlets(JobSystem& jobs, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& camera_position);
 
 };
 
-class FlashLightObject : public Object {
+// Light source object: keeps the light parameters and the transform of the gizmo. Gizmos are not separate meshes,
+// all Light objects of the same type are instances of one shared GizmoObject (see Session::drawSession).
+class FlashLightObject {
 public:
-    FlashLightObject(const std::string& obj_filepath, const std::string& shader_vert, const std::string& shader_frag, int id, int pick_id=0, float pick_r=0, float pick_g=0, float pick_b=0);
-    bool checkPickColor(int pick_color_id) const;
-    void loadObjectBuffers() override;
-    void draw(glm::mat4& view, glm::mat4& projection, bool get_pick_color = false);
+    explicit FlashLightObject(int id);
+    InstanceData getGizmoInstance();
+    InstanceData getArrowInstance();
 
     void rotateObject(float delta_x=0, float delta_y=0);
+    bool takeShadowDirty();
+    bool takeChanged();
 
     std::string ObjectIdToString() const {return std::to_string(id_);};
-    float* getObjectColor() override {return light_.rgb;}
+    int getId() const {return id_;}
+    float* getObjectColor() {return light_.rgb;}
     float* getObjectCoordinates(){return xyz_;}
     float* getObjectRotation(){return light_obj_params_[light_.type].frame_rotate_xy_;}
 
@@ -77,6 +235,8 @@ public:
 
     void reset();
 
+    static MeshData arrowMesh();
+
 private:
     struct LightObjParams{
         glm::vec3 scale;
@@ -87,56 +247,59 @@ private:
 
     Light light_ = Light({0, {1,0,1}, glm::vec3(0,0,0), glm::vec3(0,0,0), 1.0});
     int id_;
-    int pick_id_;
-    float pick_rgb_[3] = {0,0,0};
 
     bool lightOnOff_{true};
 
-    std::vector<GLfloat> arrow_vertices_{ -0.05f, 0.0f, -3.0f,
-                                          0.05f, 0.0f, -3.0f,
-                                          -0.05f, 0.0f, 8.0f,
-                                          0.05f, 0.0f, 8.0f,
-
-                                          -1.0f,  0.0f, 8.0f,
-                                          0.0f, 0.1f, 9.0f,
-                                          1.0f,  0.0f, 8.0f,
-                                            };
-    std::vector<GLuint> arrow_indices_{
-            0,2,3,
-            0,1,3,
-            4,5,6
-    };
-
-    GLuint arrow_VAO_{};
-    GLuint arrow_VBO_{};
-    GLuint arrow_EBO_{};
-
     LightObjParams flash_light_params_ = LightObjParams({glm::vec3(0.15,0.15,0.15), 90.0f, glm::vec3(1.0, 0.0, 0.0)});
     LightObjParams light_bulb_params_ = LightObjParams({glm::vec3(0.1,0.1,0.1), 180.0f, glm::vec3(1.0, 0.0, 0.0)});
     std::vector<LightObjParams> light_obj_params_ = {flash_light_params_, light_bulb_params_};
 
     float xyz_[3] = {0,3,0};
 
-    glm::vec3 translate_vec_ = glm::vec3(0, 0, 0);
+    // position, rotation, type and cone of the light when its shadow map was rendered (see takeShadowDirty)
+    bool shadow_dirty_{true};
+    float shadow_state_[7] = {0, 0, 0, 0, 0, 0, 0};
+    // everything that is drawn, when the scene was checked for changes the last time (see takeChanged)
+    float redraw_state_[16] = {};
+
+    // position, rotation and scale of the current type; the gizmo mesh is aligned by the initial rotation of the type
+    Transform transform_;
     bool object_gui_{false};
     bool is_position_initialized_{false};
 
-    glm::mat4 getTranslationMatrix(bool initial_rotate = false);
-    glm::vec3 getFlashLightDirection();
-    glm::vec3 getFlashLightPosition();
+    void updateTransform_();
 
 };
 
+// Mesh of a light gizmo (flashlight, light bulb, spotlight arrow) shared by all Light objects that show it:
+// every Light object is one instance, so all of them are drawn with one draw call.
+class GizmoObject : public Object {
+public:
+    GizmoObject(const std::string& obj_filepath, const std::string& shader_vert, const std::string& shader_frag);
+    GizmoObject(MeshData mesh, const std::string& shader_vert, const std::string& shader_frag);
+    void submit(RenderQueue& queue, StreamBuffer& stream, glm::mat4& view, glm::mat4& projection, bool wireframe);
+
+private:
+    // instances with the dequantization of the mesh applied, so all gizmos share the transforms of their batch
+    std::vector<InstanceData> stream_instances_;
+};
+
 class AxisObject : public Object {
 public:
     AxisObject(const std::string& shader_vert, const std::string& shader_frag);
     void loadObjectBuffers() override;
-    void draw(glm::mat4& view, glm::mat4& projection);
+    void releaseBuffers() override;
+    void submit(RenderQueue& queue, StreamBuffer& stream, glm::mat4& view, glm::mat4& projection);
 
 private:
     float axis_scale_{5.0f};
     glm::mat4 model_ = glm::mat4(1.0f);
 
+    // the vertices of the axes have a color instead of a normal, so they are not in the mesh arena: the lines are drawn
+    // from VAO_, the arrow heads from their own VAO, so no attributes are set per frame
+    GLuint VAO_{};
+    GLuint VBO_{};
+    GLuint arrows_VAO_{};
     GLuint arrows_VBO_{};
     GLuint arrows_EBO_{};
 
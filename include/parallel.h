@@ -0,0 +1,16 @@
+#ifndef PROJECT_3_PARALLEL_H
+#define PROJECT_3_PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+// Helpers to split a range of work items into contiguous chunks processed by worker threads.
+class Parallel
+{
+public:
+    static unsigned int threadCount(size_t items_count, size_t min_items_per_thread, unsigned int requested = 0);
+    static void forChunks(size_t count, unsigned int thread_count, const std::function<void(size_t, size_t)>& task);
+    static void forEachChunk(unsigned int chunks_count, const std::function<void(unsigned int)>& task);
+};
+
+#endif //PROJECT_3_PARALLEL_H
@@ -0,0 +1,50 @@
+#ifndef PROJECT_3_PICKER_H
+#define PROJECT_3_PICKER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "../include/bvh.h"
+#include "../include/object.h"
+
+// what a ray cast hit: nothing, the gizmo of a Light object or a copy of the central object
+enum class PickTarget {None, Light, CentralObject};
+
+// nearest surface under the cursor, shown in the menu
+struct PickResult {
+    PickTarget target{PickTarget::None};
+    int index{-1};             // index of the Light object in the Session or of the copy of the central object
+    glm::vec3 point{0.0f};     // hit point in world space
+    float distance{0};         // distance from the camera
+    double time_us{0};         // time of the ray cast (including rebuilt hierarchies)
+};
+
+// Ray casts against the scene on the CPU (no GPU round trip): every mesh has a TriangleBvh in object space and the
+// instances of a mesh are in a Bvh of their world space boxes, a ray is transformed into object space for the
+// triangles of every instance it reaches. The central object hierarchies are kept until the mesh or the layout of
+// the copies change (versions kept by the Session), the hierarchy of the Light objects is built for every ray, as
+// they are moved through pointers from the GUI and are few.
+class Picker
+{
+public:
+    PickResult pick(const Ray& ray, const Object& central_object, unsigned int central_mesh_version,
+                    unsigned int central_layout_version, const std::vector<GizmoObject>& light_gizmos,
+                    std::vector<FlashLightObject>& light_objects);
+    size_t nodeCount() const;
+
+private:
+    TriangleBvh central_mesh_bvh_;
+    Bvh central_copies_bvh_;
+    std::vector<glm::mat4> central_to_object_;
+    unsigned int central_mesh_version_{0};
+    unsigned int central_layout_version_{0};
+
+    std::vector<TriangleBvh> gizmo_bvhs_;
+    Bvh lights_bvh_;
+    std::vector<glm::mat4> light_to_object_;
+    std::vector<size_t> light_types_;
+
+    void updateCentralObject_(const Object& central_object, unsigned int mesh_version, unsigned int layout_version);
+    void updateLights_(const std::vector<GizmoObject>& light_gizmos, std::vector<FlashLightObject>& light_objects);
+};
+
+#endif //PROJECT_3_PICKER_H
@@ -0,0 +1,85 @@
+#ifndef PROJECT_3_RENDER_QUEUE_H
+#define PROJECT_3_RENDER_QUEUE_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <glad/glad.h>
+#include "../include/shader.h"
+#include "../include/gpu_profiler.h"
+
+// passes of the scene in the order they are drawn: the central object first, so it occludes the gizmos and axes
+// behind it before they are shaded
+enum class RenderPass {CentralObject, LightGizmos, Axes};
+
+// state changes of the last executed frame, shown in the menu
+struct RenderQueueStats {
+    size_t packets{0};
+    size_t program_changes{0};
+    size_t vao_changes{0};
+    size_t polygon_mode_changes{0};
+    // draws of batches that reused the setup of the previous draw of their batch (see submitBatched)
+    size_t batched_draws{0};
+    // changes without the queue: every draw sets its program, VAO and polygon mode itself
+    size_t immediate_changes{0};
+
+    size_t stateChanges() const {return program_changes + vao_changes + polygon_mode_changes;}
+};
+
+// indexed draw of a mesh of the mesh arena (range of the element buffer of its pool and base vertex) with its instances
+// at an offset of a buffer, issued by the queue itself
+struct DrawElementsCommand {
+    GLsizei count{0};
+    GLenum index_type{GL_UNSIGNED_INT};
+    GLintptr index_offset{0};   // in bytes
+    GLint base_vertex{0};
+    GLsizei instance_count{1};
+    GLuint instance_buffer{0};
+    GLintptr instance_offset{0};
+};
+
+// Per-frame queue of draw packets. Objects submit their draws with the state they need (program, VAO, polygon mode)
+// instead of setting it themselves; the queue sorts the packets by a 64-bit key
+//     pass (8 bits) | program (16 bits) | VAO (16 bits) | polygon mode (2 bits) | submission order (22 bits)
+// and sets only the state that differs from the previous packet before it calls the draw function of a packet.
+// Draw functions set uniforms and issue draw calls, they must not change the program, the VAO or the polygon mode.
+// The state is unknown at the start of every execution (other passes change it), the polygon mode is GL_FILL again
+// at its end.
+// Batched packets share their per-draw data (uniform blocks) with the other packets of the same batch and carry a draw
+// command instead of a draw function: a run of packets of one batch with the same state calls the setup function only
+// for its first packet and then issues the commands back to back, every one with its instances (the per-draw data that
+// differs). This is the OpenGL 3.3 form of a multi-draw-indirect call, which has neither gl_DrawID nor base instances.
+class RenderQueue
+{
+public:
+    // polygon mode of packets whose draws do not depend on it (line primitives)
+    static const GLenum ANY_POLYGON_MODE = 0;
+
+    void submit(RenderPass pass, const ShaderProgram& program, GLuint vao, GLenum polygon_mode,
+                std::function<void()> draw);
+    void submitBatched(RenderPass pass, const ShaderProgram& program, GLuint vao, GLenum polygon_mode, const void* batch,
+                       std::function<void()> setup, const DrawElementsCommand& command);
+    void execute(GpuProfiler& profiler);
+    const RenderQueueStats& getStats() const {return stats_;}
+
+private:
+    struct Packet {
+        std::uint64_t key;
+        RenderPass pass;
+        const ShaderProgram* program;
+        GLuint vao;
+        GLenum polygon_mode;
+        std::function<void()> draw;
+        const void* batch;
+        DrawElementsCommand command;
+    };
+
+    std::vector<Packet> packets_;
+    std::vector<size_t> order_;
+    RenderQueueStats stats_{};
+
+    static GpuPass gpuPass_(RenderPass pass);
+    static void drawCommand_(const DrawElementsCommand& command);
+};
+
+#endif //PROJECT_3_RENDER_QUEUE_H
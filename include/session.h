@@ -1,36 +1,124 @@
 #ifndef PROJECT_3_SESSION_H
 #define PROJECT_3_SESSION_H
 #include "../include/object.h"
+#include "../include/async_loader.h"
+#include "../include/light_clusters.h"
+#include "../include/deferred_renderer.h"
+#include "../include/shadow_atlas.h"
+#include "../include/picker.h"
+#include "../include/gpu_profiler.h"
+#include "../include/job_system.h"
+#include "../include/stream_buffer.h"
 
+// shading of the central object: a single forward pass with clustered lights, or a G-buffer and a lighting pass per light
+enum class RenderMode {Forward, Deferred};
+
+// The Session is constructed before the window and its OpenGL context, so its members that own GL objects (the deferred
+// renderer, the shadow atlas, the buffers) create them on first use inside a frame.
 class Session{
 public:
     Session() = default;
     void loadCentralObject(const std::string& obj_filepath = "../objects/sphere.obj");
+    void loadCentralObjectAsync(const std::string& obj_filepath);
+    void loadCentralMesh(MeshData mesh);
+    void update();
+    bool takeChanged();
+    bool animating() const {return central_object_loader_.busy();}
     void loadCoordinateSystem();
+    void loadLightGizmos();
+    void setCentralObjectLoadOptions(const MeshLoadOptions& options);
+    void setCentralObjectCopies(int copies);
     void addLightObject();
+    void addLightObjects(int count);
     void removeLightObject(const std::string& id);
     void rotateObject(int object_id, float delta_x=0, float delta_y=0);
-    int getObjectIdByPickColor(const unsigned char* pick_color);
+    const PickResult& pick(const Ray& ray);
 
-    void drawSession(glm::mat4& view, glm::mat4& projection, glm::vec3& camera_position, bool get_pick_color = false);
+    void drawSession(glm::mat4& view, glm::mat4& projection, glm::vec3& camera_position);
+    void releaseGL();
 
     std::vector<FlashLightObject>& getFlashLightObjects(){return light_objects_;};
     bool& coordinate_system(){return coordinate_system_;}
     Object& getCentralObject(){return central_objects_[0];}
+    const MeshLoadOptions& getCentralObjectLoadOptions() const {return central_load_options_;}
+    AsyncObjectLoader& getCentralObjectLoader(){return central_object_loader_;}
+    int getCentralObjectCopies() const {return central_copies_;}
+    const ClusterStats& getLightClusterStats() const {return light_clusters_.getStats();}
+    const DeferredStats& getDeferredStats() const {return deferred_renderer_.getStats();}
+    RenderMode& renderMode(){return render_mode_;}
+    bool& shadows(){return shadows_;}
+    int& shadowPcfRadius(){return shadow_atlas_.pcfRadius();}
+    const ShadowStats& getShadowStats() const {return shadow_atlas_.getStats();}
+    const PickResult& getLastPick() const {return last_pick_;}
+    size_t getPickNodeCount() const {return picker_.nodeCount();}
+    GpuProfiler& getGpuProfiler(){return gpu_profiler_;}
+    const RenderQueueStats& getRenderQueueStats() const {return render_queue_.getStats();}
+    const JobSystem& getJobSystem() const {return job_system_;}
+    const StreamStats& getStreamStats() const {return stream_buffer_.getStats();}
 
 
 private:
     int current_object_id_{0};
-    int current_pick_color_[3]{0, 0, 0};
     int id_to_remove_{-1};
+    // the scene has to be drawn again (see takeChanged), color and scale of the central object at the previous check
+    bool changed_{true};
+    float central_state_[4] = {0, 0, 0, 0};
     bool coordinate_system_{true};
 
+    std::string central_object_path_;
+    MeshLoadOptions central_load_options_{};
+    AsyncObjectLoader central_object_loader_{"../shaders/shader_central.vert", "../shaders/shader_central.frag"};
+    bool keep_central_object_appearance_{false};
+
+    // copies of the central object are instances on a cubic grid, the grid follows the scale of the object
+    int central_copies_{1};
+    float central_copies_scale_{0};
+    bool central_copies_dirty_{true};
+    const float COPIES_SPACING{2.5f}; // distance between copies in bounding radii
+
+    // parameters of the Light objects that are on, assigned to the clusters of the view frustum every frame
+    std::vector<Light> lights_;
+    LightClusters light_clusters_;
+    RenderMode render_mode_{RenderMode::Forward};
+    DeferredRenderer deferred_renderer_;
+    // shadow maps of the lights, cached in the atlas until a light or the central object changes; the version
+    // changes whenever the central object, its copies or its level of detail change
+    bool shadows_{true};
+    ShadowAtlas shadow_atlas_;
+    unsigned int shadow_casters_version_{1};
+    size_t shadow_casters_lod_{0};
+    unsigned int light_seed_{1};
+    // ray casts of mouse clicks, the hierarchy of the central mesh is rebuilt when the mesh version changes
+    Picker picker_;
+    PickResult last_pick_{};
+    unsigned int central_mesh_version_{1};
+    // GPU time of the render passes, the frame is opened and closed by DrawingLib around the passes of the Session
+    GpuProfiler gpu_profiler_;
+    // draws of the frame sorted by their GL state, executed at the end of drawSession
+    RenderQueue render_queue_;
+    // per-frame data of the draws, fenced regions of one buffer for the last StreamBuffer::FRAME_COUNT frames
+    StreamBuffer stream_buffer_;
+    // worker threads for the CPU work of drawSession, the timings of the last frame are shown in the "Jobs" window
+    JobSystem job_system_;
+    // state of every Light object for the frame, written by the jobs of drawSession
+    struct LightUpdate {
+        bool on{false};
+        Light light{};
+        bool shadow_dirty{false};
+        InstanceData gizmo;
+        InstanceData arrow;
+    };
+    std::vector<LightUpdate> light_updates_;
+
     std::vector<Object> central_objects_;
     std::vector<FlashLightObject> light_objects_;
     std::vector<AxisObject> axis_objects_;
+    // one gizmo mesh per light type, Light objects are its instances
+    std::vector<GizmoObject> light_gizmos_;
+    std::vector<GizmoObject> arrow_gizmos_;
 
-    int generatePickColorID_();
-    void generateNewPickColor_();
+    void layoutCentralCopies_();
+    int copiesGridSide_() const;
 
 };
 
@@ -1,24 +1,61 @@
 #ifndef PROJECT_3_SHADER_H
 #define PROJECT_3_SHADER_H
 
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <glm/glm.hpp>
 
 class ShaderProgram{
 public:
-    explicit ShaderProgram(const char* vertexPath, const char* fragmentPath);
+    explicit ShaderProgram(const char* vertexPath, const char* fragmentPath, const std::string& defines = std::string());
     void use() const;
+    unsigned int id() const {return id_;}
+    int uniformLocation(const std::string &name) const;
+    void bindUniformBlock(const char* block_name, unsigned int binding) const;
 
     void setInt(const std::string &name, int value) const;
     void setFloat(const std::string &name, float value) const;
     void setVec3(const std::string &name, const glm::vec3 &value) const;
     void setVec3(const std::string &name, float x, float y, float z) const;
     void setVec4(const std::string &name, float x, float y, float z, float w) const;
+    void setMat3(const std::string &name, const glm::mat3 &mat) const;
     void setMat4(const std::string &name, const glm::mat4 &mat) const;
 
+    // setters for locations resolved in advance with 'uniformLocation', they do not look up the name
+    void setInt(int location, int value) const;
+    void setFloat(int location, float value) const;
+    void setVec3(int location, const glm::vec3 &value) const;
+    void setVec3(int location, float x, float y, float z) const;
+    void setVec4(int location, float x, float y, float z, float w) const;
+    void setMat3(int location, const glm::mat3 &mat) const;
+    void setMat4(int location, const glm::mat4 &mat) const;
+
 private:
     unsigned int id_;
+    // locations of all active uniforms, resolved once after linking
+    std::unordered_map<std::string, int> uniform_locations_;
+
+    void cacheUniformLocations();
+    static std::string injectDefines(const std::string& source, const std::string& defines);
 
     static void checkCompileErrors(unsigned int shader, const std::string& type);
 };
 
+// Variants of one shader program specialized with preprocessor definitions: bit i of a key adds "#define NAME"
+// for the i-th name, so the shader compiles only the code of the features in the key. Variants are compiled on first
+// use and cached by their key; the programs are shared with other permutations of the same files.
+class ShaderPermutations{
+public:
+    ShaderPermutations(std::string vertex_path, std::string fragment_path, std::vector<std::string> define_names);
+    const ShaderProgram& variant(unsigned int key);
+    size_t variantCount() const {return variants_.size();}
+
+private:
+    std::string vertex_path_;
+    std::string fragment_path_;
+    std::vector<std::string> define_names_;
+    std::unordered_map<unsigned int, ShaderProgram> variants_;
+};
+
 #endif //PROJECT_3_SHADER_H
@@ -0,0 +1,100 @@
+#ifndef PROJECT_3_SHADOW_ATLAS_H
+#define PROJECT_3_SHADOW_ATLAS_H
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "../include/object.h"
+#include "../include/light_clusters.h"
+#include "../include/shader.h"
+#include "../include/texture_buffer.h"
+#include "../include/uniform_buffer.h"
+
+// shadow map of one light, shown in the menu
+struct LightShadowStats {
+    int light_id{0};
+    int faces{0};
+    double cpu_ms{0};      // time to submit the last rendering of the map
+    double gpu_ms{0};      // GPU time of the last rendering of the map
+};
+
+// Statistics of the last shadow update, shown in the menu.
+struct ShadowStats {
+    size_t shadowed_lights{0};
+    size_t rendered_lights{0};   // maps rendered in the last frame, the others are reused from the atlas
+    size_t missing_lights{0};    // lights without a shadow map, the atlas is full
+    size_t used_tiles{0};
+    size_t tiles{0};
+    size_t atlas_bytes{0};
+    double cpu_ms{0};            // time to submit the shadow passes of the last frame
+    std::vector<LightShadowStats> lights;
+};
+
+// Shadow maps of the lights in one depth texture: the atlas is split into square tiles, a spotlight gets one tile
+// with a perspective projection of its cone, a point light gets six tiles, the faces of a cube map around it.
+// Maps stay in the atlas while their light is on and are rendered again only when the light moved or turned (dirty
+// flag of FlashLightObject), its range changed or the shadow casters changed (a version number kept by the Session).
+// The shaders find the tiles of a light and their light-space matrices in two texture buffers:
+//     - shadow lights: 2 RGBA32F texels per light (same order as the light data), tiles of the faces 0-3 and 4-5,
+//       -1 for a light without a shadow map;
+//     - shadow matrices: 4 RGBA32F texels (columns of the view-projection matrix) per tile.
+// Shadows are filtered with percentage-closer filtering over (2r+1)^2 hardware-filtered taps, r is pcfRadius().
+class ShadowAtlas
+{
+public:
+    static const int ATLAS_SIZE = 4096;
+    static const int TILE_SIZE  = 512;
+    static const int MAX_PCF_RADIUS = 3;
+    const float NEAR_PLANE{0.05f};
+
+    void update(const std::vector<Light>& lights, const std::vector<int>& light_ids, const std::vector<bool>& lights_dirty,
+                std::vector<Object>& casters, unsigned int casters_version, const LightClusters& clusters);
+    void disable();
+    void bind() const;
+    void release();
+
+    int& pcfRadius(){return pcf_radius_;}
+    const ShadowStats& getStats() const {return stats_;}
+
+private:
+    struct Entry {
+        int faces{0};
+        int tiles[6] = {-1, -1, -1, -1, -1, -1};
+        float range{0};
+        unsigned int casters_version{0};
+        bool used{false};
+        // timestamps at the start and at the end of the last shadow pass of the light
+        GLuint queries[2] = {0, 0};
+        bool query_pending{false};
+        double cpu_ms{0};
+        double gpu_ms{0};
+    };
+
+    int pcf_radius_{1};
+    std::unordered_map<int, Entry> entries_;
+    std::vector<int> free_tiles_;
+    std::vector<glm::mat4> tile_matrices_;
+    std::vector<float> light_tiles_;
+    ShadowsBlock shadows_block_{};
+    ShadowStats stats_{};
+
+    std::unique_ptr<ShaderProgram> depth_program_;
+    GLuint framebuffer_{};
+    GLuint atlas_texture_{};
+
+    TextureBuffer light_buffer_{GL_RGBA32F};
+    TextureBuffer matrix_buffer_{GL_RGBA32F};
+    UniformBuffer shadows_buffer_{UniformBuffer::SHADOWS_BINDING};
+
+    void createResources_();
+    bool allocate_(Entry& entry, int faces);
+    void free_(Entry& entry);
+    void readTimes_(Entry& entry);
+    void renderLight_(Entry& entry, const Light& light, std::vector<Object>& casters);
+    glm::mat4 faceMatrix_(const Light& light, int face, float range) const;
+    void uploadBuffers_();
+};
+
+#endif //PROJECT_3_SHADOW_ATLAS_H
@@ -0,0 +1,84 @@
+#ifndef PROJECT_3_STREAM_BUFFER_H
+#define PROJECT_3_STREAM_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+
+// ARB_buffer_storage is not part of the OpenGL 3.3 core profile that GLAD loads, its entry point is loaded at runtime
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// part of the stream buffer written in the current frame, valid until the end of the frame
+struct StreamRange {
+    GLuint buffer{0};
+    GLintptr offset{0};
+    GLsizeiptr size{0};
+
+    void bindUniform(GLuint binding) const;
+};
+
+// use of the stream buffer, shown in the menu
+struct StreamStats {
+    size_t frames{0};
+    size_t stalls{0};           // frames that waited for the GPU to finish reading their region
+    double stall_ms{0};         // time waited by all stalls
+    size_t frame_writes{0};     // writes of the last frame
+    size_t frame_bytes{0};      // bytes used by the last frame, with the padding of the alignments
+    size_t region_bytes{0};     // capacity of one frame
+    size_t resizes{0};
+    bool persistent{false};     // the buffer is mapped once (ARB_buffer_storage) instead of once per write
+};
+
+// Ring buffer for the data that changes every frame (transforms of the draws, the "Lights" block, instances of the
+// gizmos). One GL buffer is split into FRAME_COUNT regions, a frame writes only into its own region and a fence marks
+// the end of its commands, so a region is reused only after the GPU finished the frame that read it. Writes map their
+// range without synchronization (the fence already guarantees it) and invalidate it, so the driver neither waits nor
+// copies and nothing is allocated during a frame; a frame that has to wait for its fence counts as a stall.
+// Where the context has ARB_buffer_storage (see loadBufferStorage), the buffer is immutable storage mapped once with
+// persistent and coherent mapping and a write is a plain memcpy. On plain OpenGL 3.3 every write maps its range without
+// synchronization and unmaps it after the memcpy. A frame that needs more than a region continues in a buffer twice as large, the old one is
+// deleted at the start of the next frame (the GL keeps it until the draws reading it are finished).
+class StreamBuffer
+{
+public:
+    static const int FRAME_COUNT = 3;
+    const size_t INITIAL_REGION_BYTES{256 * 1024};
+    // vertex attributes and texel data need no more than vec4 alignment
+    const size_t DEFAULT_ALIGNMENT{16};
+
+    void beginFrame();
+    void endFrame();
+    StreamRange write(const void* data, size_t size);
+    StreamRange writeUniform(const void* data, size_t size);
+    void release();
+
+    static void loadBufferStorage(GLADloadproc load_proc);
+
+    const StreamStats& getStats() const {return stats_;}
+
+private:
+    static BufferStorageProc buffer_storage_;
+
+    GLuint buffer_{0};
+    unsigned char* mapped_{nullptr};   // persistent mapping of the whole buffer, nullptr without ARB_buffer_storage
+    size_t region_bytes_{0};
+    int region_{0};
+    size_t offset_{0};
+    size_t uniform_alignment_{256};
+    GLsync fences_[FRAME_COUNT] = {};
+    std::vector<GLuint> retired_buffers_;
+    StreamStats stats_{};
+
+    StreamRange write_(const void* data, size_t size, size_t alignment);
+    void create_(size_t region_bytes);
+    void waitRegion_(int region);
+    void deleteFences_();
+};
+
+#endif //PROJECT_3_STREAM_BUFFER_H
@@ -0,0 +1,31 @@
+#ifndef PROJECT_3_TEXTURE_BUFFER_H
+#define PROJECT_3_TEXTURE_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+
+// Buffer texture (GL_TEXTURE_BUFFER) that shaders read with texelFetch, used for data that is too large for uniform
+// buffers (e.g. lights of the scene). Like UniformBuffer it keeps a CPU-side mirror and uploads only changed data,
+// the GL objects are created on the first update.
+class TextureBuffer
+{
+public:
+    explicit TextureBuffer(GLenum internal_format): internal_format_(internal_format){};
+    bool update(const void* data, size_t size);
+    void bind(int unit) const;
+    void release();
+
+    size_t size() const {return mirror_.size();}
+    size_t uploadCount() const {return upload_count_;}
+
+private:
+    GLenum internal_format_;
+    GLuint buffer_{};
+    GLuint texture_{};
+    size_t capacity_{0};
+    std::vector<unsigned char> mirror_;
+    size_t upload_count_{0};
+};
+
+#endif //PROJECT_3_TEXTURE_BUFFER_H
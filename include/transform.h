@@ -0,0 +1,48 @@
+#ifndef PROJECT_3_TRANSFORM_H
+#define PROJECT_3_TRANSFORM_H
+
+#include <glm/glm.hpp>
+
+// Transform of an object to world space: translation * alignment * rotation * scale, where the rotation is given
+// by angles in degrees around x, y and z (applied in this order from the left) and the alignment is an extra rotation
+// that turns a mesh modelled along another axis (the gizmos of Light objects). The model matrix, the normal matrix
+// (inverse transpose of its upper 3x3 part), the world position and the direction of the forward vector are cached
+// and computed again only after a part changed. The parts of many objects are edited by the GUI through pointers,
+// so they are set every frame: a setter compares the value and marks the cache dirty only if it differs.
+class Transform
+{
+public:
+    void setTranslation(const glm::vec3& translation);
+    void setRotation(const glm::vec3& degrees);
+    void setAlignment(float degrees, const glm::vec3& axis);
+    void setScale(const glm::vec3& scale);
+    void setForward(const glm::vec3& forward);
+
+    // transforms without the alignment: the frame of the object in which its forward vector is defined
+    const glm::mat4& getMatrix() const;
+    const glm::mat3& getNormalMatrix() const;
+    // transform of the aligned mesh
+    const glm::mat4& getAlignedMatrix() const;
+    const glm::vec3& getPosition() const;
+    const glm::vec3& getDirection() const;
+
+private:
+    glm::vec3 translation_{0.0f};
+    glm::vec3 rotation_{0.0f};
+    float alignment_degrees_{0};
+    glm::vec3 alignment_axis_{1.0f, 0.0f, 0.0f};
+    glm::vec3 scale_{1.0f};
+    glm::vec3 forward_{0.0f, 0.0f, -1.0f};
+
+    // cache, filled on the first read after a change
+    mutable bool dirty_{true};
+    mutable glm::mat4 matrix_{1.0f};
+    mutable glm::mat4 aligned_matrix_{1.0f};
+    mutable glm::mat3 normal_matrix_{1.0f};
+    mutable glm::vec3 position_{0.0f};
+    mutable glm::vec3 direction_{0.0f};
+
+    void update_() const;
+};
+
+#endif //PROJECT_3_TRANSFORM_H
@@ -0,0 +1,35 @@
+#ifndef PROJECT_3_UNIFORM_BUFFER_H
+#define PROJECT_3_UNIFORM_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+
+// Uniform buffer object with a CPU-side mirror of its contents: 'update' compares new data with the mirror and uploads
+// it only if something changed. The GL buffer is created on the first update, so the object can be constructed
+// before the OpenGL context exists.
+class UniformBuffer
+{
+public:
+    // binding points shared by all shader programs, see ShaderProgram::bindUniformBlock
+    static const GLuint LIGHTS_BINDING   = 0;
+    static const GLuint MATERIAL_BINDING = 1;
+    static const GLuint SHADOWS_BINDING  = 2;
+    // ranges of the stream buffer, see StreamBuffer
+    static const GLuint TRANSFORMS_BINDING = 3;
+
+    explicit UniformBuffer(GLuint binding): binding_(binding){};
+    bool update(const void* data, size_t size);
+    void bind() const;
+    void release();
+
+    size_t uploadCount() const {return upload_count_;}
+
+private:
+    GLuint binding_;
+    GLuint buffer_{};
+    std::vector<unsigned char> mirror_;
+    size_t upload_count_{0};
+};
+
+#endif //PROJECT_3_UNIFORM_BUFFER_H
@@ -0,0 +1,60 @@
+#ifndef PROJECT_3_VERTEX_FORMAT_H
+#define PROJECT_3_VERTEX_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../include/mesh_data.h"
+
+enum class PositionFormat {
+    Float32,  // 3 x 32-bit float
+    Half16,   // 3 x 16-bit half float, relative to the mesh bounds
+    Int16     // 3 x 16-bit integer, relative to the mesh bounds
+};
+
+enum class NormalFormat {
+    Float32,  // 3 x 32-bit float
+    Int10     // signed normalized 10_10_10_2 (GL_INT_2_10_10_10_REV)
+};
+
+// layout of a vertex in the GPU vertex buffer
+struct VertexFormat {
+    PositionFormat position{PositionFormat::Int16};
+    NormalFormat normal{NormalFormat::Int10};
+
+    bool operator==(const VertexFormat& other) const {return position == other.position && normal == other.normal;}
+    bool operator!=(const VertexFormat& other) const {return !(*this == other);}
+};
+
+// Vertex and index data of a mesh in the layout that is uploaded to the GPU: a single interleaved vertex stream
+// (position at location 0, normal at location 1) and 16-bit indices if the mesh has fewer than 65536 vertices.
+// Quantized positions are relative to the mesh bounds, the object space position is
+// packed position * dequantization_scale + dequantization_offset, so the transform is folded into the model matrix.
+struct PackedMesh {
+    VertexFormat format;
+    unsigned int stride{0};
+    unsigned int normal_offset{0};
+    unsigned int index_size{4};
+    float dequantization_offset[3] = {0, 0, 0};
+    float dequantization_scale{1};
+
+    std::vector<unsigned char> vertices;
+    std::vector<unsigned char> indices;
+    // sizes stay valid after the data is released once it is on the GPU
+    size_t vertex_bytes{0};
+    size_t index_bytes{0};
+
+    void releaseData();
+};
+
+class VertexPacker
+{
+public:
+    static void pack(const MeshData& mesh, const VertexFormat& format, PackedMesh& packed);
+    static void setupAttributes(const PackedMesh& packed);
+
+    static uint16_t floatToHalf(float value);
+    static uint32_t packNormal(const float* normal);
+};
+
+#endif //PROJECT_3_VERTEX_FORMAT_H
@@ -5,9 +5,14 @@ layout (location = 1) in vec3 aColor;
 
 out vec3 ourColor; // output to fragment shader
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Transforms of the draw, written for every draw into the stream buffer (see TransformsBlock)
+layout (std140) uniform Transforms {
+    mat4 projection;
+    mat4 view;
+    mat4 model;
+    mat3 normalMatrix;  // inverse transpose of the upper 3x3 part of model, computed on the CPU once per draw
+    vec4 viewPos;       // xyz: position of the camera
+};
 
 void main()
 {
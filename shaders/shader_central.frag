@@ -1,94 +1,214 @@
 #version 330 core
+// Variants of this shader are compiled with the features that are in use (see ShaderFeatures):
+//     SPOTLIGHTS, POINT_LIGHTS - code for the lights of this type, every type has its own loop without branches;
+//     SPECULAR - specular highlights;
+//     SHADOWS - shadow maps of the lights (see ShadowAtlas).
 out vec4 FragColor;  // Output color of the fragment
 
 in vec3 Normal;      // Normal vector for the current fragment, passed from the vertex shader
 in vec3 FragPos;     // Position of the current fragment in world space
+in vec3 InstanceColor; // Color of the instance, multiplies the base color
+in float ViewDepth;  // Distance from the camera along the view direction
+
+// Transforms of the draw, the same block as in shader_central.vert (only the camera position is used here)
+layout (std140) uniform Transforms {
+    mat4 projection;
+    mat4 view;
+    mat4 model;
+    mat3 normalMatrix;
+    vec4 viewPos;       // xyz: position of the camera
+};
+
+// Lights are clustered (see LightClusters): the view frustum is split into screen tiles and depth slices and
+// every cluster lists the lights that reach it. Parameters of a light are 4 texels of lightData (see LightData):
+//     0 - xyz: position in world space, w: type (0 for spotlight, 1 for point light)
+//     1 - xyz: direction of the spotlight, w: intensity
+//     2 - rgb: color, w: linear attenuation factor
+//     3 - x: quadratic attenuation factor, y: inner cutoff (cosine), z: outer cutoff (cosine), w: radius of a point light
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusters;      // x: offset of the lights of a cluster in lightIndices, y: number of its spotlights,
+                                      // z: number of its point lights (spotlights come first)
+uniform usamplerBuffer lightIndices;  // r: index of a light in lightData
+
+// Global lighting data and the cluster grid (see LightsBlock), written into the stream buffer every frame
+layout (std140) uniform Lights {
+    ivec4 lightCount;    // x: number of active lights, yzw: number of clusters along x, y and depth
+    vec4 ambientColor;   // rgb: sum of the colors of all lights
+    vec4 clusterScale;   // xy: 1 / cluster size in pixels, z: scale and w: bias of log(depth) to the depth slice
+};
 
-// Uniforms passed to the shader
-uniform int numLights;  // Number of active lights
+// Material of the object (see MaterialBlock)
+layout (std140) uniform Material {
+    vec4 objectColor;       // Base color of the object
+    float ambientStrength;  // Ambient light strength
+    float specularStrength; // Specular highlight strength
+    float shininess;        // Shininess factor for specular highlights
+};
+
+#ifdef SHADOWS
+// Shadow maps of the lights in one depth texture (see ShadowAtlas and ShadowsBlock)
+uniform sampler2DShadow shadowAtlas;
+uniform samplerBuffer shadowLights;    // 2 texels per light: tiles of the faces 0-3 and 4-5 (-1 without a shadow map),
+                                       // w of the second texel: size of a shadow map texel at unit distance from the light
+uniform samplerBuffer shadowMatrices;  // 4 texels per tile: columns of the view-projection matrix of the light
 
-uniform vec3 viewPos;  // Position of the camera
-uniform vec3 objectColor;  // Base color of the object
+layout (std140) uniform Shadows {
+    ivec4 shadowParams;  // x: PCF kernel radius in texels, y: tiles per atlas row, z: 1 if shadows are on
+    vec4 shadowScale;    // x: size of an atlas texel, y: size of a tile (in atlas uv), z: depth bias, w: normal offset in texels
+};
 
-uniform int lightType[4];  // Type of each light (0 for spotlight, 1 for point light)
-uniform vec3 lightPos[4];  // Positions of the lights in world space
-uniform vec3 lightDir[4];  // Directions of the lights (for spotlights)
-uniform vec3 lightColor[4];  // Colors of the lights
-uniform float lightIntensity[4];  // Intensity of the lights
+// Face of the shadow cube map of a point light that contains a direction from the light: +x, -x, +y, -y, +z, -z
+int cubeFace(vec3 direction)
+{
+    vec3 size = abs(direction);
+    if (size.x >= size.y && size.x >= size.z)
+    {
+        return direction.x > 0.0 ? 0 : 1;
+    }
+    if (size.y >= size.z)
+    {
+        return direction.y > 0.0 ? 2 : 3;
+    }
+    return direction.z > 0.0 ? 4 : 5;
+}
 
-uniform float linear[4];  // Linear attenuation factor for each light
-uniform float quadratic[4];  // Quadratic attenuation factor for each light
+// Share of the light that reaches a fragment (0 in the shadow, 1 lit), averaged over the taps of the PCF kernel.
+// face is 0 for spotlights and the cube face for point lights.
+float shadowFactor(int lightIndex, int face, vec3 lightPos, vec3 fragPos, vec3 norm)
+{
+    float tile = texelFetch(shadowLights, lightIndex * 2 + face / 4)[face % 4];
+    if (tile < 0.0)
+    {
+        return 1.0;  // the light has no shadow map
+    }
+    int t = int(tile);
+    mat4 lightMatrix = mat4(texelFetch(shadowMatrices, t * 4), texelFetch(shadowMatrices, t * 4 + 1),
+                            texelFetch(shadowMatrices, t * 4 + 2), texelFetch(shadowMatrices, t * 4 + 3));
+    // the surface is moved along its normal by the size of a shadow map texel to avoid shadow acne
+    float texelSize = texelFetch(shadowLights, lightIndex * 2 + 1).w * length(lightPos - fragPos);
+    vec4 clip = lightMatrix * vec4(fragPos + norm * texelSize * shadowScale.w, 1.0);
+    vec3 coords = clip.xyz / clip.w * 0.5 + 0.5;
+    if (clip.w <= 0.0 || coords.z >= 1.0)
+    {
+        return 1.0;  // behind the light or beyond the range of the map
+    }
+
+    // taps are kept half a texel inside the tile, so the bilinear comparison never reads a neighbouring tile
+    vec2 origin = vec2(float(t % shadowParams.y), float(t / shadowParams.y)) * shadowScale.y;
+    vec2 low = origin + vec2(0.5 * shadowScale.x);
+    vec2 high = origin + vec2(shadowScale.y - 0.5 * shadowScale.x);
+    int radius = shadowParams.x;
+    float lit = 0.0;
+    for (int y = -radius; y <= radius; ++y)
+    {
+        for (int x = -radius; x <= radius; ++x)
+        {
+            vec2 uv = clamp(origin + coords.xy * shadowScale.y + vec2(x, y) * shadowScale.x, low, high);
+            lit += texture(shadowAtlas, vec3(uv, coords.z - shadowScale.z));
+        }
+    }
+    return lit / float((2 * radius + 1) * (2 * radius + 1));
+}
+#endif
 
-uniform float cutOff[4];  // Inner cutoff angle (cosine) for spotlights
-uniform float outerCutOff[4];  // Outer cutoff angle (cosine) for spotlights
+// Adds the diffuse and specular light of one light, scaled by the spotlight intensity or the point light attenuation
+void addLight(vec3 lightColor, vec3 lightDirToFrag, float factor, vec3 norm, vec3 viewDir, inout vec3 diffuse, inout vec3 specular)
+{
+    // Diffuse light depends on the angle between the light direction and the surface normal
+    float diff = max(dot(norm, lightDirToFrag), 0.0);  // Lambertian reflectance (diffuse component)
+    diffuse += (diff * lightColor) * factor;
+#ifdef SPECULAR
+    // Specular light depends on the viewer's position and creates highlights
+    vec3 reflectDir = reflect(-lightDirToFrag, norm);  // Reflection vector
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);  // Specular component
+    specular += (specularStrength * spec * lightColor) * factor;
+#endif
+}
 
 void main()
 {
     vec3 norm = normalize(Normal);  // Normalize the normal vector to ensure it has a length of 1
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);  // Direction from the fragment to the viewer
+
+    // Ambient light is constant and affects all surfaces equally, so it is summed over all lights on the CPU
+    vec3 ambient = ambientStrength * ambientColor.rgb;
 
-    // Initialize the ambient, diffuse, and specular components of lighting
-    vec3 ambient = vec3(0.0);
+    // Initialize the diffuse and specular components of lighting
     vec3 diffuse = vec3(0.0);
     vec3 specular = vec3(0.0);
 
-    // Lighting parameters
-    float ambientStrength = 0.1;  // Ambient light strength
-    float specularStrength = 0.5;  // Specular highlight strength
-    float shininess = 32.0;  // Shininess factor for specular highlights
-    float constant = 1.0;  // Constant attenuation factor (used for distance-based attenuation)
+    // Find the cluster of the fragment
+    ivec3 cluster = ivec3(gl_FragCoord.xy * clusterScale.xy, log(max(ViewDepth, 1e-4)) * clusterScale.z + clusterScale.w);
+    cluster = clamp(cluster, ivec3(0), lightCount.yzw - 1);
+    uvec3 clusterLights = texelFetch(clusters, cluster.x + lightCount.y * (cluster.y + lightCount.z * cluster.z)).xyz;
 
-    // Iterate over all lights
-    for (int i = 0; i < numLights; ++i)
+#ifdef SPOTLIGHTS
+    // Spotlights of the cluster
+    for (uint i = 0u; i < clusterLights.y; ++i)
     {
-        // Calculate the distance from the light to the fragment
-        float distance = length(lightPos[i] - FragPos);
-
-        // Calculate attenuation based on distance
-        float attenuation = 1.0 / (constant + linear[i] * distance + quadratic[i] * (distance * distance));
+        int index = int(texelFetch(lightIndices, int(clusterLights.x + i)).r);
+        int light = index * 4;
+        vec3 lightPos = texelFetch(lightData, light).xyz;
+        vec4 direction = texelFetch(lightData, light + 1);  // xyz: direction, w: intensity
+        vec3 lightColor = texelFetch(lightData, light + 2).rgb;
+        vec4 parameters = texelFetch(lightData, light + 3);
+        float cutOff = parameters.y;
+        float outerCutOff = parameters.z;
 
-        // Ambient light is constant and affects all surfaces equally
-        ambient += ambientStrength * lightColor[i];
-
-        // Diffuse light depends on the angle between the light direction and the surface normal
-        vec3 lightDirNormalized = normalize(lightDir[i]);  // Normalize light direction (for spotlights)
-        vec3 lightDirToFrag = normalize(lightPos[i] - FragPos);  // Direction from the fragment to the light
-        float diff = max(dot(norm, lightDirToFrag), 0.0);  // Lambertian reflectance (diffuse component)
+        vec3 lightDirToFrag = normalize(lightPos - FragPos);  // Direction from the fragment to the light
 
         // Spotlight with soft edges is calculated using the dot product between the light direction and the direction to the fragment
-        float theta = dot(lightDirToFrag, -lightDirNormalized);
-        float epsilon = cutOff[i] - outerCutOff[i];  // Difference between inner and outer cutoff angles
-        float intensity = clamp((theta - outerCutOff[i]) / epsilon, 0.0, 1.0);  // Smoothstep to create soft edges
-        intensity *= lightIntensity[i];  // Apply light intensity to the spotlight
-
-        // Apply diffuse lighting based on light type (spotlight or point light)
-        if (lightType[i] == 0)  // Spotlight
+        float theta = dot(lightDirToFrag, -normalize(direction.xyz));
+        float epsilon = cutOff - outerCutOff;  // Difference between inner and outer cutoff angles
+        float intensity = clamp((theta - outerCutOff) / epsilon, 0.0, 1.0);  // Smoothstep to create soft edges
+        intensity *= direction.w;  // Apply light intensity to the spotlight
+#ifdef SHADOWS
+        if (intensity > 0.0)
         {
-            diffuse += (diff * lightColor[i]) * intensity;
-        }
-        else  // Point light
-        {
-            diffuse += (diff * lightColor[i]) * attenuation;
+            intensity *= shadowFactor(index, 0, lightPos, FragPos, norm);
         }
+#endif
 
-        // Specular light depends on the viewer's position and creates highlights
-        vec3 viewDir = normalize(viewPos - FragPos);  // Direction from the fragment to the viewer
-        vec3 reflectDir = reflect(-lightDirToFrag, norm);  // Reflection vector
-        float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);  // Specular component
+        addLight(lightColor, lightDirToFrag, intensity, norm, viewDir, diffuse, specular);
+    }
+#endif
 
-        // Apply specular lighting based on light type (spotlight or point light)
-        if (lightType[i] == 0)  // Spotlight
-        {
-            specular += (specularStrength * spec * lightColor[i]) * intensity;
-        }
-        else  // Point light
+#ifdef POINT_LIGHTS
+    // Point lights of the cluster
+    float constant = 1.0;  // Constant attenuation factor (used for distance-based attenuation)
+    for (uint i = clusterLights.y; i < clusterLights.y + clusterLights.z; ++i)
+    {
+        int index = int(texelFetch(lightIndices, int(clusterLights.x + i)).r);
+        int light = index * 4;
+        vec3 lightPos = texelFetch(lightData, light).xyz;
+        vec4 color = texelFetch(lightData, light + 2);  // rgb: color, w: linear attenuation factor
+        vec4 parameters = texelFetch(lightData, light + 3);
+        float linear = color.w;
+        float quadratic = parameters.x;
+
+        // Calculate the distance from the light to the fragment
+        float distance = length(lightPos - FragPos);
+
+        // Calculate attenuation based on distance
+        float attenuation = 1.0 / (constant + linear * distance + quadratic * (distance * distance));
+        // Point lights fade out smoothly to zero at their radius (where the attenuation is already below 1/256),
+        // so lights outside the cluster would add nothing even if there are hundreds of them
+        float window = clamp(1.0 - pow(distance / max(parameters.w, 1e-4), 4.0), 0.0, 1.0);
+        attenuation *= window * window;
+#ifdef SHADOWS
+        if (attenuation > 0.0)
         {
-            specular += (specularStrength * spec * lightColor[i]) * attenuation;
+            attenuation *= shadowFactor(index, cubeFace(FragPos - lightPos), lightPos, FragPos, norm);
         }
+#endif
+
+        addLight(color.rgb, normalize(lightPos - FragPos), attenuation, norm, viewDir, diffuse, specular);
     }
+#endif
 
     // Combine all lighting components (ambient, diffuse, specular) and multiply by the object's base color
-    vec3 lighting = (ambient + diffuse + specular) * objectColor;
+    vec3 lighting = (ambient + diffuse + specular) * objectColor.rgb * InstanceColor;
 
     // Set the final fragment color
     FragColor = vec4(lighting, 1.0);
-};
+};
\ No newline at end of file
@@ -2,19 +2,32 @@
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+layout (location = 2) in mat4 aInstanceModel;   // per-instance attributes (locations 2-5 and 6)
+layout (location = 6) in vec4 aInstanceColor;
 
 out vec3 FragPos; // output to fragment shader
 out vec3 Normal; // output to fragment shader
+out vec3 InstanceColor; // output to fragment shader
+out float ViewDepth; // distance from the camera along the view direction, selects the depth slice of the light cluster
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Transforms of the draw, written for every draw into the stream buffer (see TransformsBlock)
+layout (std140) uniform Transforms {
+    mat4 projection;
+    mat4 view;
+    mat4 model;
+    mat3 normalMatrix;  // inverse transpose of the upper 3x3 part of model, computed on the CPU once per draw
+    vec4 viewPos;       // xyz: position of the camera
+};
 
 void main()
 {
     // Normal matrix is a trick to keep normals perpendicular even if non-uniform scaling is applied
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    // instance transforms are rigid, so their upper 3x3 part rotates normals as is
+    Normal = mat3(aInstanceModel) * (normalMatrix * aNormal);
+    InstanceColor = aInstanceColor.rgb;
 
-    FragPos = vec3(model * vec4(aPos, 1.0));  // FragPos is used further in fragment shader for lighting calculation
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    FragPos = vec3(aInstanceModel * model * vec4(aPos, 1.0));  // FragPos is used further in fragment shader for lighting calculation
+    vec4 viewSpacePos = view * vec4(FragPos, 1.0);
+    ViewDepth = -viewSpacePos.z;
+    gl_Position = projection * viewSpacePos;
 };
\ No newline at end of file
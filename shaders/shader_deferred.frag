@@ -0,0 +1,166 @@
+#version 330 core
+// Lighting pass of deferred shading: shades one pixel of the G-buffer either with the ambient light of all lights
+// (lightIndex -1) or with one light, the passes are added up with blending. The light model is the one of shader_central.frag.
+out vec4 FragColor;  // Output color of the fragment
+
+// G-buffer written by shader_gbuffer.frag
+uniform sampler2D gPosition;  // xyz: position in world space
+uniform sampler2D gNormal;    // xyz: normal vector
+uniform sampler2D gAlbedo;    // rgb: color of the surface, a: 1 where a surface is drawn
+uniform sampler2D gDepth;     // depth of the surface
+
+uniform vec3 viewPos;         // Position of the camera
+uniform ivec2 viewportOrigin; // Lower left corner of the viewport, the G-buffer starts at it
+uniform int lightIndex;       // Light of this pass, -1 for the ambient pass
+
+// Parameters of a light are 4 texels of lightData (see LightData and shader_central.frag)
+uniform samplerBuffer lightData;
+
+// Global lighting data (see LightsBlock), the cluster grid is not used by deferred shading
+layout (std140) uniform Lights {
+    ivec4 lightCount;    // x: number of active lights
+    vec4 ambientColor;   // rgb: sum of the colors of all lights
+    vec4 clusterScale;
+};
+
+// Material of the object (see MaterialBlock)
+layout (std140) uniform Material {
+    vec4 objectColor;       // Base color of the object
+    float ambientStrength;  // Ambient light strength
+    float specularStrength; // Specular highlight strength
+    float shininess;        // Shininess factor for specular highlights
+};
+
+// Shadow maps of the lights in one depth texture (see ShadowAtlas and shader_central.frag)
+uniform sampler2DShadow shadowAtlas;
+uniform samplerBuffer shadowLights;    // 2 texels per light: tiles of the faces 0-3 and 4-5 (-1 without a shadow map),
+                                       // w of the second texel: size of a shadow map texel at unit distance from the light
+uniform samplerBuffer shadowMatrices;  // 4 texels per tile: columns of the view-projection matrix of the light
+
+layout (std140) uniform Shadows {
+    ivec4 shadowParams;  // x: PCF kernel radius in texels, y: tiles per atlas row, z: 1 if shadows are on
+    vec4 shadowScale;    // x: size of an atlas texel, y: size of a tile (in atlas uv), z: depth bias, w: normal offset in texels
+};
+
+// Face of the shadow cube map of a point light that contains a direction from the light: +x, -x, +y, -y, +z, -z
+int cubeFace(vec3 direction)
+{
+    vec3 size = abs(direction);
+    if (size.x >= size.y && size.x >= size.z)
+    {
+        return direction.x > 0.0 ? 0 : 1;
+    }
+    if (size.y >= size.z)
+    {
+        return direction.y > 0.0 ? 2 : 3;
+    }
+    return direction.z > 0.0 ? 4 : 5;
+}
+
+// Share of the light that reaches a fragment (0 in the shadow, 1 lit), averaged over the taps of the PCF kernel.
+// face is 0 for spotlights and the cube face for point lights.
+float shadowFactor(int lightIndex, int face, vec3 lightPos, vec3 fragPos, vec3 norm)
+{
+    if (shadowParams.z == 0)
+    {
+        return 1.0;  // shadows are off, the texture buffers may be empty
+    }
+    float tile = texelFetch(shadowLights, lightIndex * 2 + face / 4)[face % 4];
+    if (tile < 0.0)
+    {
+        return 1.0;  // the light has no shadow map
+    }
+    int t = int(tile);
+    mat4 lightMatrix = mat4(texelFetch(shadowMatrices, t * 4), texelFetch(shadowMatrices, t * 4 + 1),
+                            texelFetch(shadowMatrices, t * 4 + 2), texelFetch(shadowMatrices, t * 4 + 3));
+    // the surface is moved along its normal by the size of a shadow map texel to avoid shadow acne
+    float texelSize = texelFetch(shadowLights, lightIndex * 2 + 1).w * length(lightPos - fragPos);
+    vec4 clip = lightMatrix * vec4(fragPos + norm * texelSize * shadowScale.w, 1.0);
+    vec3 coords = clip.xyz / clip.w * 0.5 + 0.5;
+    if (clip.w <= 0.0 || coords.z >= 1.0)
+    {
+        return 1.0;  // behind the light or beyond the range of the map
+    }
+
+    // taps are kept half a texel inside the tile, so the bilinear comparison never reads a neighbouring tile
+    vec2 origin = vec2(float(t % shadowParams.y), float(t / shadowParams.y)) * shadowScale.y;
+    vec2 low = origin + vec2(0.5 * shadowScale.x);
+    vec2 high = origin + vec2(shadowScale.y - 0.5 * shadowScale.x);
+    int radius = shadowParams.x;
+    float lit = 0.0;
+    for (int y = -radius; y <= radius; ++y)
+    {
+        for (int x = -radius; x <= radius; ++x)
+        {
+            vec2 uv = clamp(origin + coords.xy * shadowScale.y + vec2(x, y) * shadowScale.x, low, high);
+            lit += texture(shadowAtlas, vec3(uv, coords.z - shadowScale.z));
+        }
+    }
+    return lit / float((2 * radius + 1) * (2 * radius + 1));
+}
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy) - viewportOrigin;
+    vec4 albedo = texelFetch(gAlbedo, pixel, 0);
+    if (albedo.a == 0.0)
+    {
+        discard;  // no surface, the background stays as it is
+    }
+    // the depth of the surface is written for the depth test against the other objects of the scene
+    gl_FragDepth = texelFetch(gDepth, pixel, 0).r;
+
+    if (lightIndex < 0)
+    {
+        // Ambient light is constant and affects all surfaces equally, so it is summed over all lights on the CPU
+        FragColor = vec4(ambientStrength * ambientColor.rgb * albedo.rgb, 1.0);
+        return;
+    }
+
+    vec3 FragPos = texelFetch(gPosition, pixel, 0).xyz;
+    vec3 norm = texelFetch(gNormal, pixel, 0).xyz;
+
+    int light = lightIndex * 4;
+    vec4 position = texelFetch(lightData, light);
+    vec4 direction = texelFetch(lightData, light + 1);
+    vec4 color = texelFetch(lightData, light + 2);
+    vec4 parameters = texelFetch(lightData, light + 3);
+
+    vec3 lightPos = position.xyz;
+    vec3 lightColor = color.rgb;
+    float linear = color.w;
+    float quadratic = parameters.x;
+    float cutOff = parameters.y;
+    float outerCutOff = parameters.z;
+    float constant = 1.0;  // Constant attenuation factor (used for distance-based attenuation)
+
+    // Attenuation of point lights, fades out to zero at the radius of the light
+    float distance = length(lightPos - FragPos);
+    float attenuation = 1.0 / (constant + linear * distance + quadratic * (distance * distance));
+    float window = clamp(1.0 - pow(distance / max(parameters.w, 1e-4), 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+
+    // Diffuse light depends on the angle between the light direction and the surface normal
+    vec3 lightDirNormalized = normalize(direction.xyz);
+    vec3 lightDirToFrag = normalize(lightPos - FragPos);
+    float diff = max(dot(norm, lightDirToFrag), 0.0);
+
+    // Spotlight with soft edges
+    float theta = dot(lightDirToFrag, -lightDirNormalized);
+    float epsilon = cutOff - outerCutOff;
+    float intensity = clamp((theta - outerCutOff) / epsilon, 0.0, 1.0);
+    intensity *= direction.w;
+
+    // Specular light depends on the viewer's position and creates highlights
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 reflectDir = reflect(-lightDirToFrag, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+
+    float factor = position.w == 0.0 ? intensity : attenuation;  // spotlight or point light
+    if (factor > 0.0)
+    {
+        int face = position.w == 0.0 ? 0 : cubeFace(FragPos - lightPos);
+        factor *= shadowFactor(lightIndex, face, lightPos, FragPos, norm);
+    }
+    vec3 lighting = (diff * lightColor + specularStrength * spec * lightColor) * factor;
+    FragColor = vec4(lighting * albedo.rgb, 1.0);
+}
@@ -1,9 +1,9 @@
 #version 330 core
 
 out vec4 FragColor;
-uniform vec4 ourColor;
+in vec4 ourColor; // input from vertex shader
 
 void main()
 {
-   FragColor = ourColor; // color vector is passed as uniform from application
+   FragColor = ourColor; // color vector is passed per instance from application
 };
\ No newline at end of file
@@ -1,14 +1,24 @@
 #version 330 core
 
 layout (location = 0) in vec3 aPos;
+layout (location = 2) in mat4 aInstanceModel;   // per-instance attributes (locations 2-5 and 6)
+layout (location = 6) in vec4 aInstanceColor;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+out vec4 ourColor; // output to fragment shader
+
+// Transforms of the draw, written for every draw into the stream buffer (see TransformsBlock)
+layout (std140) uniform Transforms {
+    mat4 projection;
+    mat4 view;
+    mat4 model;
+    mat3 normalMatrix;  // inverse transpose of the upper 3x3 part of model, computed on the CPU once per draw
+    vec4 viewPos;       // xyz: position of the camera
+};
 
 void main()
 {
     // this is used for objects that are not colored and do not reflect light, therefore there is no need for any
-    // vertex attributes other than position.
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);   // correct order of matrix multiplication
+    // vertex attributes other than position. Every Light object is one instance with its own transform and color.
+    ourColor = aInstanceColor;
+    gl_Position = projection * view * aInstanceModel * model * vec4(aPos, 1.0f);   // correct order of matrix multiplication
 };
\ No newline at end of file
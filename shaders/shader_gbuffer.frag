@@ -0,0 +1,24 @@
+#version 330 core
+// Geometry pass of deferred shading: the surface is stored in the G-buffer, it is lit later by shader_deferred.frag
+layout (location = 0) out vec4 gPosition;  // xyz: position in world space
+layout (location = 1) out vec4 gNormal;    // xyz: normal vector
+layout (location = 2) out vec4 gAlbedo;    // rgb: color of the surface, a: 1 where a surface is drawn
+
+in vec3 Normal;        // Normal vector for the current fragment, passed from the vertex shader
+in vec3 FragPos;       // Position of the current fragment in world space
+in vec3 InstanceColor; // Color of the instance, multiplies the base color
+
+// Material of the object (see MaterialBlock)
+layout (std140) uniform Material {
+    vec4 objectColor;       // Base color of the object
+    float ambientStrength;  // Ambient light strength
+    float specularStrength; // Specular highlight strength
+    float shininess;        // Shininess factor for specular highlights
+};
+
+void main()
+{
+    gPosition = vec4(FragPos, 1.0);
+    gNormal = vec4(normalize(Normal), 0.0);
+    gAlbedo = vec4(objectColor.rgb * InstanceColor, 1.0);
+}
@@ -0,0 +1,6 @@
+#version 330 core
+
+void main()
+{
+    // the shadow map has no color attachment, the depth is written by the fixed pipeline
+};
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in mat4 aInstanceModel;   // per-instance attributes (locations 2-5), the color is not needed
+
+uniform mat4 model;
+uniform mat4 lightViewProjection;  // view and projection of a face of the shadow map (see ShadowAtlas)
+
+void main()
+{
+    // only the depth of the shadow casters is written, seen from the light
+    gl_Position = lightViewProjection * aInstanceModel * model * vec4(aPos, 1.0f);
+};
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include <chrono>
+#include <thread>
+#include "../include/async_loader.h"
+#include "../include/mesh_cache.h"
+
+
+void AsyncObjectLoader::start(const std::string& filepath, const MeshLoadOptions& options)
+/** Cancels the load in progress (if any) and starts parsing the given .obj file on a worker thread. A file that an
+Object already uses with the same options is not parsed again, the new Object shares its mesh (see MeshAssets). */
+{
+    cancel();
+    filepath_ = filepath;
+
+    std::shared_ptr<MeshAsset> asset = MeshAssets::find(filepath, options);
+    if (asset)
+    {
+        pending_object_.reset(new Object(std::move(asset), shader_vert_, shader_frag_));
+        pending_object_->beginBufferUpload();
+        stage_ = Stage::Uploading;
+        return;
+    }
+
+    job_ = std::make_shared<ParseJob>();
+    job_->filepath = filepath;
+    job_->options  = options;
+    stage_    = Stage::Parsing;
+
+    // the worker is detached: a cancelled job is abandoned and finishes (or stops at the next progress report) on its own,
+    // so the render thread never waits for it
+    std::thread(runParseJob, job_).detach();
+}
+
+void AsyncObjectLoader::cancel()
+/** Stops the load in progress, the object that is currently displayed stays unchanged. */
+{
+    if (job_)
+    {
+        job_->progress.cancelled.store(true);
+        job_.reset();
+    }
+    if (pending_object_)
+    {
+        pending_object_->releaseBuffers();
+        pending_object_.reset();
+    }
+    stage_ = Stage::Idle;
+}
+
+std::unique_ptr<Object> AsyncObjectLoader::update()
+/** Advances the load by one frame and must be called from the thread that owns the OpenGL context.
+When the worker has finished, creates the Object and starts its upload; while uploading, copies data to the GPU
+for at most UPLOAD_BUDGET_MS. Returns the Object once it is completely uploaded, otherwise nullptr. */
+{
+    if (stage_ == Stage::Parsing && job_->finished.load())
+    {
+        std::shared_ptr<ParseJob> job = std::move(job_);
+        if (job->failed)
+        {
+            error_ = job->error;
+            stage_ = Stage::Idle;
+            return nullptr;
+        }
+        auto asset = std::make_shared<MeshAsset>(std::move(job->mesh), std::move(job->packed));
+        MeshAssets::add(job->filepath, job->options, asset);
+        pending_object_.reset(new Object(std::move(asset), shader_vert_, shader_frag_));
+        pending_object_->beginBufferUpload();
+        stage_ = Stage::Uploading;
+    }
+
+    if (stage_ == Stage::Uploading)
+    {
+        auto start = std::chrono::steady_clock::now();
+        bool uploaded = false;
+        do
+        {
+            uploaded = pending_object_->uploadBufferChunk(UPLOAD_CHUNK_BYTES);
+        }
+        while (!uploaded && std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < UPLOAD_BUDGET_MS);
+
+        if (uploaded)
+        {
+            stage_ = Stage::Idle;
+            return std::move(pending_object_);
+        }
+    }
+    return nullptr;
+}
+
+float AsyncObjectLoader::progress() const
+/** Returns overall progress of the load in range [0, 1]. */
+{
+    switch (stage_)
+    {
+        case Stage::Parsing:
+            return job_->progress.fraction.load() * PARSE_PROGRESS_SHARE;
+        case Stage::Uploading:
+            return PARSE_PROGRESS_SHARE + pending_object_->uploadProgress() * (1.0f - PARSE_PROGRESS_SHARE);
+        default:
+            return 0.0f;
+    }
+}
+
+std::string AsyncObjectLoader::takeError()
+/** Returns the error message of the last failed load (empty if there is none) and clears it. */
+{
+    std::string error;
+    error.swap(error_);
+    return error;
+}
+
+void AsyncObjectLoader::runParseJob(const std::shared_ptr<ParseJob>& job)
+/** Worker thread body: reads the mesh through the mesh cache, which parses the .obj and calculates normals if needed,
+and packs it into the vertex format of the load options. */
+{
+    try
+    {
+        MeshCache::loadObjMesh(job->filepath, job->options, job->mesh, &job->progress);
+        if (job->mesh.indexCount() == 0)
+        {
+            job->failed = true;
+            job->error  = "The file has no faces: " + job->filepath;
+        }
+        else
+        {
+            VertexPacker::pack(job->mesh, job->options.vertex_format, job->packed);
+        }
+    }
+    catch (const std::string& error)
+    {
+        job->failed = true;
+        job->error  = error;
+    }
+    catch (...)
+    {
+        job->failed = true;
+        job->error  = "Unable to load file: " + job->filepath;
+    }
+    job->finished.store(true);
+}
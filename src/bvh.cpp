@@ -0,0 +1,281 @@
+#include <cmath>
+#include <numeric>
+#include "../include/bvh.h"
+
+Ray Ray::transformed(const glm::mat4& matrix) const
+/** Returns the ray in the space of 'matrix' (e.g. the inverse model matrix of an object), the direction is not
+normalized, so distances along both rays are the same. */
+{
+    Ray ray;
+    ray.origin = glm::vec3(matrix * glm::vec4(origin, 1.0f));
+    ray.direction = glm::vec3(matrix * glm::vec4(direction, 0.0f));
+    return ray;
+}
+
+void Aabb::grow(const glm::vec3& point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void Aabb::grow(const Aabb& box)
+{
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+}
+
+float Aabb::surfaceArea() const
+{
+    glm::vec3 extent = glm::max(max - min, glm::vec3(0.0f));
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+Aabb Aabb::transformed(const glm::mat4& matrix) const
+/** Returns the box around the eight transformed corners of the box. */
+{
+    Aabb box;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 point = glm::vec3((corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z);
+        box.grow(glm::vec3(matrix * glm::vec4(point, 1.0f)));
+    }
+    return box;
+}
+
+float Aabb::intersect(const Ray& ray, const glm::vec3& inverse_direction, float max_distance) const
+/** Slab test: the ray is inside the box between the largest entry and the smallest exit distance of the three pairs
+of planes. A ray that starts inside the box enters it at distance 0. */
+{
+    glm::vec3 t0 = (min - ray.origin) * inverse_direction;
+    glm::vec3 t1 = (max - ray.origin) * inverse_direction;
+    glm::vec3 near = glm::min(t0, t1);
+    glm::vec3 far = glm::max(t0, t1);
+    float entry = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+    float exit = std::min(std::min(far.x, far.y), std::min(far.z, max_distance));
+    // NaN (a zero direction component on a plane of the box) fails the comparison and counts as a miss
+    if (!(entry <= exit))
+    {
+        return FLT_MAX;
+    }
+    return entry;
+}
+
+
+void Bvh::build(const std::vector<Aabb>& boxes)
+/** Builds the hierarchy over the boxes, primitive i of hit tests is boxes[i]. */
+{
+    clear();
+    if (boxes.empty())
+    {
+        return;
+    }
+    std::vector<glm::vec3> centers(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        centers[i] = boxes[i].center();
+    }
+    primitives_.resize(boxes.size());
+    std::iota(primitives_.begin(), primitives_.end(), 0u);
+    // a binary tree with leaves of at least one primitive has fewer than 2n nodes
+    nodes_.reserve(2 * boxes.size());
+    nodes_.emplace_back();
+    buildNode_(0, 0, static_cast<unsigned int>(boxes.size()), 0, boxes, centers);
+    nodes_.shrink_to_fit();
+}
+
+void Bvh::clear()
+{
+    nodes_.clear();
+    primitives_.clear();
+}
+
+void Bvh::buildNode_(size_t node_index, unsigned int begin, unsigned int end, int depth, const std::vector<Aabb>& boxes,
+                     const std::vector<glm::vec3>& centers)
+/** Fills the node of the primitives [begin, end) and builds its children. The split is the plane between centroid
+bins with the lowest surface area cost; the node stays a leaf if no split is cheaper than testing all of its
+primitives and it has at most MAX_LEAF_SIZE of them. */
+{
+    Aabb bounds;
+    Aabb center_bounds;
+    for (unsigned int i = begin; i < end; i++)
+    {
+        bounds.grow(boxes[primitives_[i]]);
+        center_bounds.grow(centers[primitives_[i]]);
+    }
+    nodes_[node_index].bounds = bounds;
+    unsigned int count = end - begin;
+    glm::vec3 extent = center_bounds.max - center_bounds.min;
+    int axis = 0;
+    if (extent.y > extent[axis])
+    {
+        axis = 1;
+    }
+    if (extent.z > extent[axis])
+    {
+        axis = 2;
+    }
+    // all centroids in one point cannot be split by a plane
+    if (count <= 1 || extent[axis] <= 0.0f)
+    {
+        nodes_[node_index].offset = begin;
+        nodes_[node_index].count = count;
+        return;
+    }
+
+    unsigned int middle = begin + count / 2;
+    if (depth < MAX_SAH_DEPTH)
+    {
+        struct Bin {
+            Aabb bounds;
+            unsigned int count{0};
+        };
+        Bin bins[BINS];
+        float bin_scale = static_cast<float>(BINS) / extent[axis];
+        auto binOf = [&](unsigned int primitive) {
+            auto bin = static_cast<int>((centers[primitive][axis] - center_bounds.min[axis]) * bin_scale);
+            return bin < BINS - 1 ? bin : BINS - 1;
+        };
+        for (unsigned int i = begin; i < end; i++)
+        {
+            Bin& bin = bins[binOf(primitives_[i])];
+            bin.bounds.grow(boxes[primitives_[i]]);
+            bin.count++;
+        }
+        // cost of the split after bin i: area of the left boxes times their count plus the same on the right
+        float left_cost[BINS - 1];
+        Aabb left;
+        unsigned int left_count = 0;
+        for (int i = 0; i < BINS - 1; i++)
+        {
+            left.grow(bins[i].bounds);
+            left_count += bins[i].count;
+            left_cost[i] = left_count == 0 ? 0.0f : left.surfaceArea() * static_cast<float>(left_count);
+        }
+        Aabb right;
+        unsigned int right_count = 0;
+        float best_cost = FLT_MAX;
+        int best_split = -1;
+        for (int i = BINS - 1; i > 0; i--)
+        {
+            right.grow(bins[i].bounds);
+            right_count += bins[i].count;
+            if (right_count == 0 || right_count == count)
+            {
+                continue;
+            }
+            float cost = left_cost[i - 1] + right.surfaceArea() * static_cast<float>(right_count);
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_split = i;
+            }
+        }
+        if (best_split < 0)
+        {
+            nodes_[node_index].offset = begin;
+            nodes_[node_index].count = count;
+            return;
+        }
+        // cost of a leaf in the same units: every primitive is tested by a ray that hits the node
+        if (count <= static_cast<unsigned int>(MAX_LEAF_SIZE) && best_cost >= bounds.surfaceArea() * static_cast<float>(count))
+        {
+            nodes_[node_index].offset = begin;
+            nodes_[node_index].count = count;
+            return;
+        }
+        auto split = std::partition(primitives_.begin() + begin, primitives_.begin() + end,
+                                    [&](unsigned int primitive) {return binOf(primitive) < best_split;});
+        middle = static_cast<unsigned int>(split - primitives_.begin());
+    }
+    else
+    {
+        std::nth_element(primitives_.begin() + begin, primitives_.begin() + middle, primitives_.begin() + end,
+                         [&](unsigned int a, unsigned int b) {return centers[a][axis] < centers[b][axis];});
+    }
+
+    size_t first_child = nodes_.size();
+    nodes_.emplace_back();
+    buildNode_(first_child, begin, middle, depth + 1, boxes, centers);
+    size_t second_child = nodes_.size();
+    nodes_.emplace_back();
+    buildNode_(second_child, middle, end, depth + 1, boxes, centers);
+    nodes_[node_index].offset = static_cast<unsigned int>(second_child);
+    nodes_[node_index].count = 0;
+}
+
+
+void TriangleBvh::build(const MeshData& mesh)
+/** Builds the hierarchy over the triangles of the full mesh (level of detail 0). */
+{
+    clear();
+    MeshLod lod = mesh.lod(0);
+    vertices_ = mesh.vertexData();
+    indices_ = mesh.indexData() + lod.index_offset;
+    triangle_count_ = lod.index_count / 3;
+
+    std::vector<Aabb> boxes(triangle_count_);
+    for (size_t triangle = 0; triangle < triangle_count_; triangle++)
+    {
+        for (int corner = 0; corner < 3; corner++)
+        {
+            const float* vertex = vertices_ + 3 * static_cast<size_t>(indices_[3 * triangle + corner]);
+            boxes[triangle].grow(glm::vec3(vertex[0], vertex[1], vertex[2]));
+        }
+    }
+    bvh_.build(boxes);
+}
+
+void TriangleBvh::clear()
+{
+    bvh_.clear();
+    vertices_ = nullptr;
+    indices_ = nullptr;
+    triangle_count_ = 0;
+}
+
+float TriangleBvh::intersect(const Ray& ray, float max_distance) const
+/** Returns the distance to the nearest triangle along the ray, FLT_MAX if no triangle is hit before max_distance.
+Both sides of the triangles are hit. */
+{
+    return bvh_.intersect(ray, max_distance, [this](unsigned int triangle, const Ray& r, float nearest) {
+        return intersectTriangle_(triangle, r, nearest);
+    });
+}
+
+float TriangleBvh::intersectTriangle_(unsigned int triangle, const Ray& ray, float max_distance) const
+/** Moller-Trumbore ray-triangle intersection: solves origin + t * direction = v0 + u * e1 + v * e2 with Cramer's rule. */
+{
+    const float* a = vertices_ + 3 * static_cast<size_t>(indices_[3 * triangle]);
+    const float* b = vertices_ + 3 * static_cast<size_t>(indices_[3 * triangle + 1]);
+    const float* c = vertices_ + 3 * static_cast<size_t>(indices_[3 * triangle + 2]);
+    glm::vec3 v0 = glm::vec3(a[0], a[1], a[2]);
+    glm::vec3 e1 = glm::vec3(b[0], b[1], b[2]) - v0;
+    glm::vec3 e2 = glm::vec3(c[0], c[1], c[2]) - v0;
+
+    glm::vec3 p = glm::cross(ray.direction, e2);
+    float determinant = glm::dot(e1, p);
+    // the ray is parallel to the plane of the triangle
+    if (std::abs(determinant) < 1e-12f)
+    {
+        return FLT_MAX;
+    }
+    float inverse_determinant = 1.0f / determinant;
+    glm::vec3 s = ray.origin - v0;
+    float u = glm::dot(s, p) * inverse_determinant;
+    if (u < 0.0f || u > 1.0f)
+    {
+        return FLT_MAX;
+    }
+    glm::vec3 q = glm::cross(s, e1);
+    float v = glm::dot(ray.direction, q) * inverse_determinant;
+    if (v < 0.0f || u + v > 1.0f)
+    {
+        return FLT_MAX;
+    }
+    float distance = glm::dot(e2, q) * inverse_determinant;
+    if (distance <= 0.0f || distance >= max_distance)
+    {
+        return FLT_MAX;
+    }
+    return distance;
+}
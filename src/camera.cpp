@@ -30,6 +30,23 @@ that sets how large the viewspace is.*/
     return glm::perspective(glm::radians(fov_), static_cast<float>(window_width) / static_cast<float>(window_height), near_, far_);
 }
 
+Ray DomeCamera::cursorRay(double cursor_x, double cursor_y, float window_width, float window_height) const
+/** Returns the ray from the camera through a cursor position (window coordinates, y pointing down): the cursor is
+unprojected at the near and the far plane with the inverse of projection * view, the direction is normalized. */
+{
+    glm::mat4 view = glm::lookAt(camera_position_, target_position_, up_direction_);
+    glm::mat4 inverse_view_projection = glm::inverse(getProjectionMatrix(window_width, window_height) * view);
+    float ndc_x = 2.0f * static_cast<float>(cursor_x) / window_width - 1.0f;
+    float ndc_y = 1.0f - 2.0f * static_cast<float>(cursor_y) / window_height;
+
+    glm::vec4 near_point = inverse_view_projection * glm::vec4(ndc_x, ndc_y, -1.0f, 1.0f);
+    glm::vec4 far_point = inverse_view_projection * glm::vec4(ndc_x, ndc_y, 1.0f, 1.0f);
+    Ray ray;
+    ray.origin = glm::vec3(near_point) / near_point.w;
+    ray.direction = glm::normalize(glm::vec3(far_point) / far_point.w - ray.origin);
+    return ray;
+}
+
 void DomeCamera::zoom(float yoffset)
 /** Adjusts the camera's field of view (fov) value to zoom in or out based on the provided zooming factor.
  The larger field of view, the smaller object will look.*/
@@ -39,6 +56,7 @@ void DomeCamera::zoom(float yoffset)
         fov_ = 10.0f;
     if (fov_ > 100.0f)
         fov_ = 100.0f;
+    changed_ = true;
 }
 
 void DomeCamera::rotate(float delta_x, float delta_y, float delta_z)
@@ -57,6 +75,15 @@ then recalculates the camera's position by calling `updateCameraVectors`. */
         pitch_ = glm::radians(-89.0);
     }
     updateCameraVectors();
+    changed_ = true;
+}
+
+bool DomeCamera::takeChanged()
+/** Returns true if the camera rotated or zoomed since the previous call (the frame has to be drawn again). */
+{
+    bool changed = changed_;
+    changed_ = false;
+    return changed;
 }
 
 void DomeCamera::updateCameraVectors()
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <cmath>
+#include "../include/deferred_renderer.h"
+#include "../include/uniform_buffer.h"
+
+void DeferredRenderer::beginGeometryPass()
+/** Remembers the framebuffer and the viewport the frame is drawn to, binds the G-buffer (resized to the viewport)
+and clears it. Objects drawn with geometryProgram() until lightingPass are written to the G-buffer. */
+{
+    createResources_();
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target_framebuffer_);
+    glGetIntegerv(GL_VIEWPORT, target_viewport_);
+    if (target_viewport_[2] != width_ || target_viewport_[3] != height_)
+    {
+        resizeGBuffer_(target_viewport_[2], target_viewport_[3]);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glViewport(0, 0, width_, height_);
+
+    // zero alpha of the albedo marks pixels without a surface, they are skipped by the lighting pass
+    const GLfloat zero[4] = {0, 0, 0, 0};
+    const GLfloat far_depth = 1.0f;
+    for (GLint attachment = 0; attachment < 3; attachment++)
+    {
+        glClearBufferfv(GL_COLOR, attachment, zero);
+    }
+    glClearBufferfv(GL_DEPTH, 0, &far_depth);
+}
+
+void DeferredRenderer::lightingPass(const std::vector<Light>& lights, const LightClusters& clusters,
+                                    const glm::mat4& view, const glm::mat4& projection, const glm::vec3& camera_position)
+/** Shades the G-buffer into the target framebuffer: a full-screen pass adds the ambient light and writes the depth
+of the surfaces (so objects drawn later are occluded correctly), then every light is added with a full-screen pass
+limited by a scissor rectangle and by the depth test to the pixels of the surfaces. Light i of 'lights' is light i of
+the light data texture buffer, so 'clusters' has to be updated with the same lights and bound. */
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(target_framebuffer_));
+    glViewport(target_viewport_[0], target_viewport_[1], target_viewport_[2], target_viewport_[3]);
+
+    lighting_program_->use();
+    lighting_program_->setVec3(view_pos_location_, camera_position);
+    glUniform2i(viewport_origin_location_, target_viewport_[0], target_viewport_[1]);
+    const GLuint textures[4] = {position_texture_, normal_texture_, albedo_texture_, depth_texture_};
+    for (int i = 0; i < 4; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + POSITION_UNIT + i);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(empty_VAO_);
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+    lighting_program_->setInt(light_index_location_, -1);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    // light passes add to the pixels that the ambient pass has written, the depth of the surface is written again
+    // by the shader, so the equal test passes only where the surface is not hidden by another object
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_EQUAL);
+    glEnable(GL_SCISSOR_TEST);
+
+    stats_ = DeferredStats();
+    double covered_pixels = 0;
+    for (size_t i = 0; i < lights.size(); i++)
+    {
+        GLint rect[4];
+        if (!lightScissor_(lights[i], clusters, view, projection, rect))
+        {
+            stats_.culled_lights++;
+            continue;
+        }
+        glScissor(rect[0], rect[1], rect[2], rect[3]);
+        lighting_program_->setInt(light_index_location_, static_cast<int>(i));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        stats_.light_passes++;
+        covered_pixels += static_cast<double>(rect[2]) * static_cast<double>(rect[3]);
+    }
+    if (stats_.light_passes > 0 && width_ > 0 && height_ > 0)
+    {
+        stats_.scissor_coverage = covered_pixels / (static_cast<double>(stats_.light_passes) * width_ * height_);
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_BLEND);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LEQUAL);
+    glBindVertexArray(0);
+}
+
+void DeferredRenderer::release()
+/** Deletes the G-buffer, the next geometry pass creates it again. */
+{
+    if (framebuffer_ != 0)
+    {
+        glDeleteFramebuffers(1, &framebuffer_);
+        const GLuint textures[4] = {position_texture_, normal_texture_, albedo_texture_, depth_texture_};
+        glDeleteTextures(4, textures);
+        glDeleteVertexArrays(1, &empty_VAO_);
+    }
+    framebuffer_ = position_texture_ = normal_texture_ = albedo_texture_ = depth_texture_ = empty_VAO_ = 0;
+    width_ = height_ = 0;
+}
+
+void DeferredRenderer::createResources_()
+/** Compiles the shader programs and creates the G-buffer framebuffer with its textures. */
+{
+    if (geometry_program_ == nullptr)
+    {
+        // the geometry pass takes the vertex shader of the central object as is
+        geometry_program_.reset(new ShaderProgram("../shaders/shader_central.vert", "../shaders/shader_gbuffer.frag"));
+        geometry_program_->bindUniformBlock("Transforms", UniformBuffer::TRANSFORMS_BINDING);
+        geometry_program_->bindUniformBlock("Material", UniformBuffer::MATERIAL_BINDING);
+
+        lighting_program_.reset(new ShaderProgram("../shaders/shader_deferred.vert", "../shaders/shader_deferred.frag"));
+        lighting_program_->bindUniformBlock("Lights", UniformBuffer::LIGHTS_BINDING);
+        lighting_program_->bindUniformBlock("Material", UniformBuffer::MATERIAL_BINDING);
+        lighting_program_->bindUniformBlock("Shadows", UniformBuffer::SHADOWS_BINDING);
+        lighting_program_->use();
+        lighting_program_->setInt(lighting_program_->uniformLocation("lightData"), LightsBlock::LIGHT_DATA_UNIT);
+        lighting_program_->setInt(lighting_program_->uniformLocation("gPosition"), POSITION_UNIT);
+        lighting_program_->setInt(lighting_program_->uniformLocation("gNormal"), NORMAL_UNIT);
+        lighting_program_->setInt(lighting_program_->uniformLocation("gAlbedo"), ALBEDO_UNIT);
+        lighting_program_->setInt(lighting_program_->uniformLocation("gDepth"), DEPTH_UNIT);
+        lighting_program_->setInt(lighting_program_->uniformLocation("shadowAtlas"), ShadowsBlock::ATLAS_UNIT);
+        lighting_program_->setInt(lighting_program_->uniformLocation("shadowLights"), ShadowsBlock::SHADOW_LIGHT_UNIT);
+        lighting_program_->setInt(lighting_program_->uniformLocation("shadowMatrices"), ShadowsBlock::SHADOW_MATRIX_UNIT);
+        light_index_location_ = lighting_program_->uniformLocation("lightIndex");
+        view_pos_location_ = lighting_program_->uniformLocation("viewPos");
+        viewport_origin_location_ = lighting_program_->uniformLocation("viewportOrigin");
+    }
+    if (framebuffer_ == 0)
+    {
+        glGenFramebuffers(1, &framebuffer_);
+        glGenTextures(1, &position_texture_);
+        glGenTextures(1, &normal_texture_);
+        glGenTextures(1, &albedo_texture_);
+        glGenTextures(1, &depth_texture_);
+        // the full-screen triangle of the lighting pass has no vertex attributes, but core profile needs a VAO to draw
+        glGenVertexArrays(1, &empty_VAO_);
+    }
+}
+
+void DeferredRenderer::resizeGBuffer_(int width, int height)
+/** (Re)allocates the G-buffer textures: world positions (RGBA32F, the precision of half floats is not enough for
+specular highlights far from the origin), normals (RGBA16F), colors (RGBA8) and depth (24 bit). */
+{
+    width_  = width;
+    height_ = height;
+    struct Attachment {
+        GLuint texture;
+        GLenum internal_format;
+        GLenum format;
+        GLenum type;
+        GLenum attachment;
+    };
+    const Attachment attachments[4] = {
+            {position_texture_, GL_RGBA32F, GL_RGBA, GL_FLOAT, GL_COLOR_ATTACHMENT0},
+            {normal_texture_, GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_COLOR_ATTACHMENT1},
+            {albedo_texture_, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT2},
+            {depth_texture_, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, GL_DEPTH_ATTACHMENT}
+    };
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    for (const auto& attachment : attachments)
+    {
+        glBindTexture(GL_TEXTURE_2D, attachment.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(attachment.internal_format), width, height, 0,
+                     attachment.format, attachment.type, nullptr);
+        // G-buffer texels are read with texelFetch only
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment.attachment, GL_TEXTURE_2D, attachment.texture, 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    const GLenum draw_buffers[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+    glDrawBuffers(3, draw_buffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::string("G-buffer framebuffer is incomplete");
+    }
+}
+
+bool DeferredRenderer::lightScissor_(const Light& light, const LightClusters& clusters, const glm::mat4& view,
+                                     const glm::mat4& projection, GLint rect[4]) const
+/** Computes the scissor rectangle (x, y, width, height in pixels of the target viewport) of the volume a light can
+reach: the bounding box of the sphere of a point light, the bounding box of the cone of a spotlight (spotlights
+are not attenuated, their cone ends at the far plane). Returns false if the volume is outside of the view. */
+{
+    glm::vec4 view_position = view * glm::vec4(light.light_pos, 1.0f);
+    glm::vec3 center = glm::vec3(view_position.x, view_position.y, view_position.z);
+    float range = clusters.lightRadius(light);
+    glm::vec3 box_min = center - glm::vec3(range);
+    glm::vec3 box_max = center + glm::vec3(range);
+    if (light.type == 0 && glm::length(light.light_dir) > 0.0f)
+    {
+        glm::vec3 direction = glm::normalize(glm::mat3(view) * light.light_dir);
+        glm::vec3 base_center = center + direction * range;
+        float base_radius = range * std::tan(glm::radians(light.outerCutOff));
+        box_min = glm::min(center, base_center - glm::vec3(base_radius));
+        box_max = glm::max(center, base_center + glm::vec3(base_radius));
+    }
+
+    float min_ndc[2];
+    float max_ndc[2];
+    if (!LightClusters::projectViewBox(box_min, box_max, projection, clusters.nearPlane(), clusters.farPlane(),
+                                       min_ndc, max_ndc))
+    {
+        return false;
+    }
+    auto toPixels = [](float ndc, int size) {
+        return (std::min(std::max(ndc, -1.0f), 1.0f) * 0.5f + 0.5f) * static_cast<float>(size);
+    };
+    auto x0 = static_cast<GLint>(std::floor(toPixels(min_ndc[0], target_viewport_[2])));
+    auto y0 = static_cast<GLint>(std::floor(toPixels(min_ndc[1], target_viewport_[3])));
+    auto x1 = static_cast<GLint>(std::ceil(toPixels(max_ndc[0], target_viewport_[2])));
+    auto y1 = static_cast<GLint>(std::ceil(toPixels(max_ndc[1], target_viewport_[3])));
+    rect[0] = target_viewport_[0] + x0;
+    rect[1] = target_viewport_[1] + y0;
+    rect[2] = x1 - x0;
+    rect[3] = y1 - y0;
+    return rect[2] > 0 && rect[3] > 0;
+}
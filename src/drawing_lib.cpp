@@ -34,63 +34,52 @@ void DrawingLib::drawScene(GLFWwindow *window, bool imGuiCaptureMouse)
     auto projection_mat = dome_camera_.getProjectionMatrix(static_cast<float>(window_width_), static_cast<float>(window_height_));
     auto view_mat = dome_camera_.getViewMatrix();
 
-    if (get_color_)
-    {
-        double x_coord, y_coord;
-        unsigned char color[3] = {0};
-        // When get_color_ is true, Objects are drawn with pick_colors (not general colors), and every Object has a unique pick_color,
-        // that allows to identify Object id.
-        session_.drawSession(view_mat, projection_mat, dome_camera_.cameraPosition(), get_color_);
-
-        glfwGetCursorPos(window, &x_coord, &y_coord);
-        glReadPixels(x_coord, window_height_ - y_coord, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, color);
-        selected_object_id_ = session_.getObjectIdByPickColor(color);
-        if (left_double_click_)
-        {
-            if (selected_object_id_ >= 0)
-            {
-                session_.getFlashLightObjects()[selected_object_id_].switchGuiEnabled();
-            }
-            left_double_click_ = false;
-        }
-    }
-    else
-    {
-        // draw frame with regular colours
-        session_.drawSession(view_mat, projection_mat, dome_camera_.cameraPosition(), get_color_);
-    }
+    auto& gpu_profiler = session_.getGpuProfiler();
+    gpu_profiler.beginFrame();
+    session_.drawSession(view_mat, projection_mat, dome_camera_.cameraPosition());
+
     ImGui::Render(); // Finalizes the ImGui frame and prepares the draw data for rendering.
     // Renders the compiled ImGui draw data using the OpenGL 3 backend.
     // Takes the draw data and issues the necessary OpenGL commands to display the ImGui interface.
+    gpu_profiler.beginPass(GpuPass::Gui);
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    gpu_profiler.endPass(GpuPass::Gui);
+    gpu_profiler.endFrame();
 
-    if (!get_color_)
-    {
-        // Swaps the front and back buffers of the specified window.
-        // In double-buffered mode, rendering is done to the back buffer while the front buffer is displayed on the screen.
-        // Buffers should be swapped only when Objects are drawn with regular colors (not pick_colors).
-        glfwSwapBuffers(window);
-    }
-    get_color_ = false;
-    glfwPollEvents();
+    // Swaps the front and back buffers of the specified window.
+    // In double-buffered mode, rendering is done to the back buffer while the front buffer is displayed on the screen.
+    // Window events are processed by the FrameScheduler, which waits for them while nothing changes.
+    glfwSwapBuffers(window);
+}
+
+bool DrawingLib::takeChanged()
+/** Returns true if a window event arrived or the camera moved since the previous call. */
+{
+    bool changed = dome_camera_.takeChanged() || input_changed_;
+    input_changed_ = false;
+    return changed;
 }
 
 void DrawingLib::mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 /** Handles mouse button events in a GLFW window. If the cursor position is not on any of ImGui elements,
 it performs actions on left-click, double left-click and right-click. */
 {
+    input_changed_ = true;
     if (!imgui_capture_mouse_)
     {
         double currentTime = glfwGetTime();
         if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
         {
-            // get_color_ boolean enables part of the code that reads pixels in cursor position and defines if you interact with Objects
-            get_color_ = true;
+            // the ray under the cursor defines if you interact with a Light object or rotate the camera
+            pickObject(window);
             if (currentTime - last_click_time_ < DOUBLE_CLICK_TIME)
             {
                 // Reset last_click_time_ to avoid detecting triple clicks as double clicks
                 last_click_time_ = 0.0;
-                left_double_click_ = true;
+                if (selected_object_id_ >= 0)
+                {
+                    session_.getFlashLightObjects()[selected_object_id_].switchGuiEnabled();
+                }
             }
             else{
                 last_click_time_ = currentTime;
@@ -100,7 +89,7 @@ it performs actions on left-click, double left-click and right-click. */
 
         if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
         {
-            get_color_ = true;
+            pickObject(window);
             right_button_down_ = true;
         }
         if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE)
@@ -117,11 +106,26 @@ it performs actions on left-click, double left-click and right-click. */
 
 }
 
+void DrawingLib::pickObject(GLFWwindow* window)
+/** Casts the ray under the cursor into the scene (see Session::pick) and selects the Light object it hits first,
+the selection is cleared if the ray hits the central object or nothing. */
+{
+    double x_coord, y_coord;
+    int width, height;
+    glfwGetCursorPos(window, &x_coord, &y_coord);
+    // the cursor position is in screen coordinates, which differ from framebuffer pixels on high-DPI displays
+    glfwGetWindowSize(window, &width, &height);
+    Ray ray = dome_camera_.cursorRay(x_coord, y_coord, static_cast<float>(width), static_cast<float>(height));
+    const PickResult& pick = session_.pick(ray);
+    selected_object_id_ = pick.target == PickTarget::Light ? pick.index : -1;
+}
+
 void DrawingLib::cursorPositionCallback(GLFWwindow* window,
                                         double input_cursor_pos_x,
                                         double input_cursor_pos_y)
 /** Handles cursor movement events in a GLFW window.*/
 {
+    input_changed_ = true;
     prev_pos_x_    = current_pos_x_;
     prev_pos_y_    = current_pos_y_;
     current_pos_x_ = input_cursor_pos_x;
@@ -152,6 +156,7 @@ void DrawingLib::scrollCallback(GLFWwindow* window, double yoffset)
 /** Callback function that handles scroll input from the mouse wheel to zoom in or out of the scene.
 If ImGui is not capturing the mouse input and the zoom level is adjusted based on the scroll direction. */
 {
+    input_changed_ = true;
     if (!imgui_capture_mouse_){
         dome_camera_.zoom(float(yoffset));
     }
@@ -179,6 +184,27 @@ void DrawingLib::defineCallbackFunction(GLFWwindow* window)
         auto* drawing_lib = static_cast<DrawingLib*>(glfwGetWindowUserPointer(win));
         drawing_lib->scrollCallback(win, yoffset);
     });
+
+    // the other events only wake up the render-on-demand loop: keys and characters are handled by ImGui, which
+    // calls these callbacks after its own ones, resizing and exposing the window needs a new frame
+    glfwSetKeyCallback(window, [](GLFWwindow* win, int key, int scancode, int action, int mods) {
+        static_cast<DrawingLib*>(glfwGetWindowUserPointer(win))->input_changed_ = true;
+    });
+    glfwSetCharCallback(window, [](GLFWwindow* win, unsigned int codepoint) {
+        static_cast<DrawingLib*>(glfwGetWindowUserPointer(win))->input_changed_ = true;
+    });
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow* win, int width, int height) {
+        static_cast<DrawingLib*>(glfwGetWindowUserPointer(win))->input_changed_ = true;
+    });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow* win) {
+        static_cast<DrawingLib*>(glfwGetWindowUserPointer(win))->input_changed_ = true;
+    });
+    glfwSetWindowFocusCallback(window, [](GLFWwindow* win, int focused) {
+        static_cast<DrawingLib*>(glfwGetWindowUserPointer(win))->input_changed_ = true;
+    });
+    glfwSetCursorEnterCallback(window, [](GLFWwindow* win, int entered) {
+        static_cast<DrawingLib*>(glfwGetWindowUserPointer(win))->input_changed_ = true;
+    });
 }
 
 std::tuple<double, double> DrawingLib::calculateCoordinatesOnMouseMove(int correction_factor) const
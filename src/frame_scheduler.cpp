@@ -0,0 +1,109 @@
+#include <GLFW/glfw3.h>
+#include "../include/frame_scheduler.h"
+
+void FrameScheduler::waitEvents()
+/** Processes the pending window events (the GLFW callbacks run here). If a frame is due, it waits only until the
+frame cap allows the next frame; if the scene is clean, it blocks until an event arrives or IDLE_TIMEOUT passes.
+The waiting time counts as idle, and every frame interval of it as a skipped frame. */
+{
+    double now = glfwGetTime();
+    if (interval_start_ < 0)
+    {
+        interval_start_ = now;
+        last_frame_time_ = now;
+    }
+    if (render_on_demand_ && pending_frames_ == 0)
+    {
+        wait_(IDLE_TIMEOUT);
+    }
+    else
+    {
+        double next_frame = last_frame_time_ + frameInterval_();
+        // events that arrive before the next frame are processed, the frame is still drawn at its time
+        while (frame_cap_ > 0 && now < next_frame)
+        {
+            wait_(next_frame - now);
+            now = glfwGetTime();
+        }
+        glfwPollEvents();
+    }
+    updateStats_(glfwGetTime());
+}
+
+bool FrameScheduler::beginFrame(bool changed, bool animating)
+/** Returns true if a frame has to be drawn: rendering on demand is off, the scene changed (or changed within the last
+FRAMES_AFTER_CHANGE frames), something is animated or the stats overlay has new numbers to show. */
+{
+    if (changed)
+    {
+        pending_frames_ = FRAMES_AFTER_CHANGE;
+    }
+    if ((animating || (stats_overlay_ && stats_refreshed_)) && pending_frames_ < 1)
+    {
+        pending_frames_ = 1;
+    }
+    stats_refreshed_ = false;
+    if (render_on_demand_ && pending_frames_ == 0)
+    {
+        return false;
+    }
+    if (pending_frames_ > 0)
+    {
+        pending_frames_--;
+    }
+    return true;
+}
+
+void FrameScheduler::endFrame()
+/** Records the time of the frame that was drawn, the frame cap counts from it. */
+{
+    last_frame_time_ = glfwGetTime();
+    interval_frames_++;
+    stats_.frames_drawn++;
+}
+
+double FrameScheduler::frameInterval_() const
+/** Returns the time between frames at the frame cap; skipped frames of an uncapped loop are counted at 60 fps. */
+{
+    if (frame_cap_ > 0)
+    {
+        return 1.0 / static_cast<double>(frame_cap_);
+    }
+    return 1.0 / 60.0;
+}
+
+void FrameScheduler::wait_(double timeout)
+/** Blocks in glfwWaitEventsTimeout and adds the time to the idle time of the stats interval. */
+{
+    double start = glfwGetTime();
+    glfwWaitEventsTimeout(timeout);
+    double waited = glfwGetTime() - start;
+    interval_idle_ += waited;
+    // frames that were not drawn while waiting for events; waiting for the frame cap is not skipping
+    if (render_on_demand_ && pending_frames_ == 0)
+    {
+        skipped_budget_ += waited / frameInterval_();
+        auto skipped = static_cast<size_t>(skipped_budget_);
+        skipped_budget_ -= static_cast<double>(skipped);
+        interval_skipped_ += skipped;
+        stats_.frames_skipped += skipped;
+    }
+}
+
+void FrameScheduler::updateStats_(double now)
+/** Closes the stats interval after STATS_INTERVAL seconds and computes the rates of the stats overlay. */
+{
+    double elapsed = now - interval_start_;
+    if (elapsed < STATS_INTERVAL)
+    {
+        return;
+    }
+    stats_.fps = static_cast<double>(interval_frames_) / elapsed;
+    stats_.skipped_per_second = static_cast<double>(interval_skipped_) / elapsed;
+    stats_.idle_percentage = 100.0 * interval_idle_ / elapsed;
+    interval_start_ = now;
+    interval_idle_ = 0;
+    interval_frames_ = 0;
+    interval_skipped_ = 0;
+    stats_refreshed_ = true;
+}
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../include/geometry_kernels.h"
+
+// Microbenchmark of the geometry kernels that the loader runs on every mesh, reports JSON:
+//     geometry_bench [--segments N] [--runs N] [--output file]
+// The mesh is a generated UV sphere with segments x segments quads (2M triangles by default), staged once in SoA
+// layout. Every kernel runs over the whole mesh on one thread on each SIMD level up to the one the CPU supports, the
+// median of the runs is reported together with the speedup over the scalar loop and the largest difference of the
+// results to the scalar results (0 except for the centroid, see GeometryKernels).
+
+
+namespace {
+    struct KernelResult {
+        std::vector<double> times;      // median ms per level
+        std::vector<float> differences; // largest difference of the results per level to the scalar results
+    };
+}
+
+static void printUsage()
+{
+    std::cout << "Usage: geometry_bench [--segments N] [--runs N] [--output file]" << std::endl;
+}
+
+static void makeSphere(int segments, std::vector<float>& vertices, std::vector<unsigned int>& indices)
+/** Generates a UV sphere of radius 1 with segments x segments quads, the same mesh as in lighting_bench. The
+vertices are moved slightly off the sphere so that the face normals differ from the vertex directions. */
+{
+    const float pi = 3.14159265358979f;
+    for (int ring = 0; ring <= segments; ring++)
+    {
+        float theta = pi * static_cast<float>(ring) / static_cast<float>(segments);
+        for (int segment = 0; segment <= segments; segment++)
+        {
+            float phi = 2.0f * pi * static_cast<float>(segment) / static_cast<float>(segments);
+            float radius = 1.0f + 0.01f * std::sin(7.0f * phi) * std::sin(5.0f * theta);
+            vertices.push_back(radius * std::sin(theta) * std::cos(phi));
+            vertices.push_back(radius * std::cos(theta));
+            vertices.push_back(radius * std::sin(theta) * std::sin(phi));
+        }
+    }
+    auto row = static_cast<unsigned int>(segments + 1);
+    for (unsigned int ring = 0; ring < static_cast<unsigned int>(segments); ring++)
+    {
+        for (unsigned int segment = 0; segment < static_cast<unsigned int>(segments); segment++)
+        {
+            unsigned int a = ring * row + segment;
+            unsigned int b = a + row;
+            unsigned int triangles[6] = {a, b, a + 1, a + 1, b, b + 1};
+            indices.insert(indices.end(), triangles, triangles + 6);
+        }
+    }
+}
+
+static std::vector<float> flatten(const SoaVectors& vectors)
+{
+    std::vector<float> interleaved(vectors.size() * 3);
+    vectors.store(interleaved.data());
+    return interleaved;
+}
+
+static KernelResult measure(const std::vector<SimdLevel>& levels, int runs, const std::function<void()>& kernel,
+                            const std::function<std::vector<float>()>& output)
+/** Runs a kernel on every level and returns the median times and the differences of the outputs. Only the kernel is
+timed, its output buffers are allocated beforehand and read by 'output' after the runs. */
+{
+    KernelResult result;
+    std::vector<std::vector<float>> outputs;
+    for (SimdLevel level : levels)
+    {
+        GeometryKernels::setLevel(level);
+        std::vector<double> times;
+        for (int run = 0; run < runs; run++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            kernel();
+            auto end = std::chrono::steady_clock::now();
+            times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        std::sort(times.begin(), times.end());
+        result.times.push_back(times[times.size() / 2]);
+        outputs.push_back(output());
+    }
+    for (const auto& level_output : outputs)
+    {
+        float difference = 0.0f;
+        for (size_t i = 0; i < level_output.size(); i++)
+        {
+            difference = std::max(difference, std::fabs(level_output[i] - outputs[0][i]));
+        }
+        result.differences.push_back(difference);
+    }
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    int segments = 1024;
+    int runs = 9;
+    std::string output_path;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--segments") == 0 && i + 1 < argc)
+        {
+            segments = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+        {
+            runs = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            output_path = argv[++i];
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+    if (segments < 2 || runs < 1)
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    makeSphere(segments, vertices, indices);
+    size_t vertices_count  = vertices.size() / 3;
+    size_t triangles_count = indices.size() / 3;
+
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> corners;
+    GeometryKernels::vertexCorners(indices, vertices_count, offsets, corners);
+
+    SoaVectors positions;
+    positions.assign(vertices.data(), vertices_count);
+    SoaVectors face_normals;
+    face_normals.resize(triangles_count);
+    GeometryKernels::faceNormals(positions, indices.data(), 0, triangles_count, true, face_normals);
+
+    std::vector<SimdLevel> levels;
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2})
+    {
+        if (level <= GeometryKernels::supportedLevel())
+        {
+            levels.push_back(level);
+        }
+    }
+
+    SoaVectors normals;
+    normals.resize(std::max(triangles_count, vertices_count));
+    SoaVectors vectors;
+    float values[6];
+    const float center[3] = {0.1f, -0.2f, 0.3f};
+    auto normals_output = [&]() {return flatten(normals);};
+    auto vectors_output = [&]() {return flatten(vectors);};
+    auto values_output  = [&]() {return std::vector<float>(values, values + 6);};
+
+    std::vector<std::pair<std::string, KernelResult>> results;
+    results.emplace_back("face_normals", measure(levels, runs, [&]() {
+        GeometryKernels::faceNormals(positions, indices.data(), 0, triangles_count, true, normals);
+    }, normals_output));
+    results.emplace_back("face_normals_area", measure(levels, runs, [&]() {
+        GeometryKernels::faceNormals(positions, indices.data(), 0, triangles_count, false, normals);
+    }, normals_output));
+    results.emplace_back("accumulate_normals", measure(levels, runs, [&]() {
+        GeometryKernels::accumulateNormals(face_normals, offsets.data(), corners.data(), nullptr, 0, vertices_count, normals);
+    }, normals_output));
+    // normalizes a fresh copy of the positions every run, the copy is timed on every level alike
+    results.emplace_back("normalize", measure(levels, runs, [&]() {
+        vectors = positions;
+        GeometryKernels::normalize(vectors, 0, vertices_count);
+    }, vectors_output));
+    results.emplace_back("bounds", measure(levels, runs, [&]() {
+        GeometryKernels::bounds(positions, values, values + 3);
+    }, values_output));
+    results.emplace_back("bounding_radius", measure(levels, runs, [&]() {
+        std::fill(values, values + 6, GeometryKernels::boundingRadius(positions, center));
+    }, values_output));
+    results.emplace_back("centroid", measure(levels, runs, [&]() {
+        GeometryKernels::centroid(positions, values);
+        std::fill(values + 3, values + 6, 0.0f);
+    }, values_output));
+    GeometryKernels::setLevel(GeometryKernels::supportedLevel());
+
+    std::ofstream output_file;
+    if (!output_path.empty())
+    {
+        output_file.open(output_path);
+        if (!output_file.is_open())
+        {
+            std::cerr << "Unable to open file: " << output_path << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = output_path.empty() ? std::cout : output_file;
+    out << "{\n  \"supported_level\": \"" << GeometryKernels::levelName(GeometryKernels::supportedLevel())
+        << "\",\n  \"vertices\": " << vertices_count << ",\n  \"triangles\": " << triangles_count
+        << ",\n  \"runs\": " << runs << ",\n  \"kernels\": [";
+    bool first_kernel = true;
+    for (const auto& result : results)
+    {
+        out << (first_kernel ? "\n" : ",\n") << "    {\"name\": \"" << result.first << "\"";
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            std::string level = GeometryKernels::levelName(levels[i]);
+            std::transform(level.begin(), level.end(), level.begin(), ::tolower);
+            out << ",\n     \"" << level << "\": {\"ms\": " << result.second.times[i] << ", \"speedup\": "
+                << result.second.times[0] / result.second.times[i] << ", \"max_difference\": "
+                << result.second.differences[i] << "}";
+        }
+        out << "}";
+        first_kernel = false;
+    }
+    out << "\n  ]\n}" << std::endl;
+    return 0;
+}
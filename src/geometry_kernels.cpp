@@ -0,0 +1,698 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include "../include/geometry_kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEOMETRY_KERNELS_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+// The SSE and AVX2 versions are compiled for their instruction set with target attributes, so the rest of the program
+// keeps the default flags and runs on every CPU; they are only called on the level detected by supportedLevel.
+// AVX2 is enabled without FMA on purpose, a fused multiply-add would round differently than the scalar code.
+
+void SoaVectors::resize(size_t count)
+{
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+}
+
+void SoaVectors::assign(const float* interleaved, size_t count)
+/** Stages count interleaved xyz vectors. */
+{
+    resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        x[i] = interleaved[i * 3 + 0];
+        y[i] = interleaved[i * 3 + 1];
+        z[i] = interleaved[i * 3 + 2];
+    }
+}
+
+void SoaVectors::store(float* interleaved) const
+/** Writes the vectors back as interleaved xyz, the destination holds size() * 3 floats. */
+{
+    for (size_t i = 0; i < size(); i++)
+    {
+        interleaved[i * 3 + 0] = x[i];
+        interleaved[i * 3 + 1] = y[i];
+        interleaved[i * 3 + 2] = z[i];
+    }
+}
+
+namespace
+{
+
+void faceNormalsScalar(const SoaVectors& positions, const unsigned int* indices, size_t first_triangle,
+                       size_t last_triangle, bool unit_length, SoaVectors& normals)
+{
+    for (size_t triangle = first_triangle; triangle < last_triangle; triangle++)
+    {
+        unsigned int a = indices[triangle * 3 + 0];
+        unsigned int b = indices[triangle * 3 + 1];
+        unsigned int c = indices[triangle * 3 + 2];
+
+        float edge1_x = positions.x[b] - positions.x[a], edge1_y = positions.y[b] - positions.y[a], edge1_z = positions.z[b] - positions.z[a];
+        float edge2_x = positions.x[c] - positions.x[a], edge2_y = positions.y[c] - positions.y[a], edge2_z = positions.z[c] - positions.z[a];
+
+        float normal_x = edge1_y * edge2_z - edge1_z * edge2_y;
+        float normal_y = edge1_z * edge2_x - edge1_x * edge2_z;
+        float normal_z = edge1_x * edge2_y - edge1_y * edge2_x;
+        if (unit_length)
+        {
+            float length = std::sqrt(normal_x * normal_x + normal_y * normal_y + normal_z * normal_z);
+            if (length > 0)
+            {
+                normal_x /= length;
+                normal_y /= length;
+                normal_z /= length;
+            }
+        }
+        normals.x[triangle] = normal_x;
+        normals.y[triangle] = normal_y;
+        normals.z[triangle] = normal_z;
+    }
+}
+
+void accumulateNormalsScalar(const SoaVectors& face_normals, const unsigned int* offsets, const unsigned int* corners,
+                             const float* corner_weights, size_t first_vertex, size_t last_vertex, SoaVectors& sums)
+{
+    for (size_t vertex = first_vertex; vertex < last_vertex; vertex++)
+    {
+        float sum_x = 0.0f, sum_y = 0.0f, sum_z = 0.0f;
+        for (unsigned int i = offsets[vertex]; i < offsets[vertex + 1]; i++)
+        {
+            unsigned int corner = corners[i];
+            unsigned int triangle = corner / 3;
+            float weight = corner_weights ? corner_weights[corner] : 1.0f;
+
+            sum_x += face_normals.x[triangle] * weight;
+            sum_y += face_normals.y[triangle] * weight;
+            sum_z += face_normals.z[triangle] * weight;
+        }
+        sums.x[vertex] = sum_x;
+        sums.y[vertex] = sum_y;
+        sums.z[vertex] = sum_z;
+    }
+}
+
+void normalizeScalar(SoaVectors& vectors, size_t first, size_t last)
+{
+    for (size_t i = first; i < last; i++)
+    {
+        float length = std::sqrt(vectors.x[i] * vectors.x[i] + vectors.y[i] * vectors.y[i] + vectors.z[i] * vectors.z[i]);
+        if (length > 0)
+        {
+            vectors.x[i] /= length;
+            vectors.y[i] /= length;
+            vectors.z[i] /= length;
+        }
+    }
+}
+
+void boundsScalar(const SoaVectors& positions, size_t first, float min[3], float max[3])
+/** Extends bounds that already hold a vector by the vectors from first on. */
+{
+    for (size_t i = first; i < positions.size(); i++)
+    {
+        min[0] = std::min(min[0], positions.x[i]);
+        min[1] = std::min(min[1], positions.y[i]);
+        min[2] = std::min(min[2], positions.z[i]);
+        max[0] = std::max(max[0], positions.x[i]);
+        max[1] = std::max(max[1], positions.y[i]);
+        max[2] = std::max(max[2], positions.z[i]);
+    }
+}
+
+float radiusSquaredScalar(const SoaVectors& positions, size_t first, const float center[3], float radius_sq)
+{
+    for (size_t i = first; i < positions.size(); i++)
+    {
+        float dx = positions.x[i] - center[0], dy = positions.y[i] - center[1], dz = positions.z[i] - center[2];
+        radius_sq = std::max(radius_sq, dx * dx + dy * dy + dz * dz);
+    }
+    return radius_sq;
+}
+
+void sumScalar(const SoaVectors& positions, size_t first, float sum[3])
+{
+    for (size_t i = first; i < positions.size(); i++)
+    {
+        sum[0] += positions.x[i];
+        sum[1] += positions.y[i];
+        sum[2] += positions.z[i];
+    }
+}
+
+#ifdef GEOMETRY_KERNELS_X86
+
+// ---- SSE: 4 vectors per register ----
+
+__attribute__((target("sse2")))
+__m128 normalizedSse(__m128 component, __m128 length, __m128 nonzero)
+/** Divides the lanes with a length above zero, the other lanes are kept (like the scalar 'if (length > 0)'). */
+{
+    return _mm_or_ps(_mm_and_ps(nonzero, _mm_div_ps(component, length)), _mm_andnot_ps(nonzero, component));
+}
+
+__attribute__((target("sse2")))
+void normalizeSse(SoaVectors& vectors, size_t first, size_t last)
+{
+    size_t i = first;
+    for (; i + 4 <= last; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&vectors.x[i]);
+        __m128 y = _mm_loadu_ps(&vectors.y[i]);
+        __m128 z = _mm_loadu_ps(&vectors.z[i]);
+        __m128 length  = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        __m128 nonzero = _mm_cmpgt_ps(length, _mm_setzero_ps());
+        _mm_storeu_ps(&vectors.x[i], normalizedSse(x, length, nonzero));
+        _mm_storeu_ps(&vectors.y[i], normalizedSse(y, length, nonzero));
+        _mm_storeu_ps(&vectors.z[i], normalizedSse(z, length, nonzero));
+    }
+    normalizeScalar(vectors, i, last);
+}
+
+__attribute__((target("sse2")))
+float horizontalMinSse(__m128 v)
+{
+    float lanes[4];
+    _mm_storeu_ps(lanes, v);
+    return std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+}
+
+__attribute__((target("sse2")))
+float horizontalMaxSse(__m128 v)
+{
+    float lanes[4];
+    _mm_storeu_ps(lanes, v);
+    return std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+}
+
+__attribute__((target("sse2")))
+void boundsSse(const SoaVectors& positions, float min[3], float max[3])
+/** Expects bounds that hold the first vector. */
+{
+    size_t count = positions.size();
+    if (count < 4)
+    {
+        boundsScalar(positions, 1, min, max);
+        return;
+    }
+    // the min/max operand order matches std::min/std::max, so equal values resolve the same way
+    __m128 min_x = _mm_loadu_ps(&positions.x[0]), max_x = min_x;
+    __m128 min_y = _mm_loadu_ps(&positions.y[0]), max_y = min_y;
+    __m128 min_z = _mm_loadu_ps(&positions.z[0]), max_z = min_z;
+    size_t i = 4;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&positions.x[i]);
+        __m128 y = _mm_loadu_ps(&positions.y[i]);
+        __m128 z = _mm_loadu_ps(&positions.z[i]);
+        min_x = _mm_min_ps(x, min_x); max_x = _mm_max_ps(x, max_x);
+        min_y = _mm_min_ps(y, min_y); max_y = _mm_max_ps(y, max_y);
+        min_z = _mm_min_ps(z, min_z); max_z = _mm_max_ps(z, max_z);
+    }
+    min[0] = horizontalMinSse(min_x); max[0] = horizontalMaxSse(max_x);
+    min[1] = horizontalMinSse(min_y); max[1] = horizontalMaxSse(max_y);
+    min[2] = horizontalMinSse(min_z); max[2] = horizontalMaxSse(max_z);
+    boundsScalar(positions, i, min, max);
+}
+
+__attribute__((target("sse2")))
+float radiusSquaredSse(const SoaVectors& positions, const float center[3])
+{
+    __m128 center_x = _mm_set1_ps(center[0]);
+    __m128 center_y = _mm_set1_ps(center[1]);
+    __m128 center_z = _mm_set1_ps(center[2]);
+    __m128 radius_sq = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= positions.size(); i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&positions.x[i]), center_x);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&positions.y[i]), center_y);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(&positions.z[i]), center_z);
+        __m128 distance_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        radius_sq = _mm_max_ps(distance_sq, radius_sq);
+    }
+    return radiusSquaredScalar(positions, i, center, horizontalMaxSse(radius_sq));
+}
+
+__attribute__((target("sse2")))
+void sumSse(const SoaVectors& positions, float sum[3])
+{
+    __m128 sum_x = _mm_setzero_ps();
+    __m128 sum_y = _mm_setzero_ps();
+    __m128 sum_z = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= positions.size(); i += 4)
+    {
+        sum_x = _mm_add_ps(sum_x, _mm_loadu_ps(&positions.x[i]));
+        sum_y = _mm_add_ps(sum_y, _mm_loadu_ps(&positions.y[i]));
+        sum_z = _mm_add_ps(sum_z, _mm_loadu_ps(&positions.z[i]));
+    }
+    float lanes[4];
+    __m128 sums[3] = {sum_x, sum_y, sum_z};
+    for (int axis = 0; axis < 3; axis++)
+    {
+        _mm_storeu_ps(lanes, sums[axis]);
+        sum[axis] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+    sumScalar(positions, i, sum);
+}
+
+// ---- AVX2: 8 vectors per register, indexed loads with gathers ----
+
+__attribute__((target("avx2")))
+__m256 normalizedAvx2(__m256 component, __m256 length, __m256 nonzero)
+{
+    return _mm256_blendv_ps(component, _mm256_div_ps(component, length), nonzero);
+}
+
+__attribute__((target("avx2")))
+void faceNormalsAvx2(const SoaVectors& positions, const unsigned int* indices, size_t first_triangle,
+                     size_t last_triangle, bool unit_length, SoaVectors& normals)
+{
+    // offsets of the first corner of 8 consecutive triangles in the index buffer
+    const __m256i corner_offsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i one = _mm256_set1_epi32(1);
+    size_t triangle = first_triangle;
+    for (; triangle + 8 <= last_triangle; triangle += 8)
+    {
+        const int* triangle_indices = reinterpret_cast<const int*>(indices + triangle * 3);
+        __m256i a = _mm256_i32gather_epi32(triangle_indices, corner_offsets, 4);
+        __m256i b = _mm256_i32gather_epi32(triangle_indices, _mm256_add_epi32(corner_offsets, one), 4);
+        __m256i c = _mm256_i32gather_epi32(triangle_indices, _mm256_add_epi32(corner_offsets, _mm256_add_epi32(one, one)), 4);
+
+        __m256 a_x = _mm256_i32gather_ps(positions.x.data(), a, 4);
+        __m256 a_y = _mm256_i32gather_ps(positions.y.data(), a, 4);
+        __m256 a_z = _mm256_i32gather_ps(positions.z.data(), a, 4);
+        __m256 edge1_x = _mm256_sub_ps(_mm256_i32gather_ps(positions.x.data(), b, 4), a_x);
+        __m256 edge1_y = _mm256_sub_ps(_mm256_i32gather_ps(positions.y.data(), b, 4), a_y);
+        __m256 edge1_z = _mm256_sub_ps(_mm256_i32gather_ps(positions.z.data(), b, 4), a_z);
+        __m256 edge2_x = _mm256_sub_ps(_mm256_i32gather_ps(positions.x.data(), c, 4), a_x);
+        __m256 edge2_y = _mm256_sub_ps(_mm256_i32gather_ps(positions.y.data(), c, 4), a_y);
+        __m256 edge2_z = _mm256_sub_ps(_mm256_i32gather_ps(positions.z.data(), c, 4), a_z);
+
+        __m256 normal_x = _mm256_sub_ps(_mm256_mul_ps(edge1_y, edge2_z), _mm256_mul_ps(edge1_z, edge2_y));
+        __m256 normal_y = _mm256_sub_ps(_mm256_mul_ps(edge1_z, edge2_x), _mm256_mul_ps(edge1_x, edge2_z));
+        __m256 normal_z = _mm256_sub_ps(_mm256_mul_ps(edge1_x, edge2_y), _mm256_mul_ps(edge1_y, edge2_x));
+        if (unit_length)
+        {
+            __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normal_x, normal_x),
+                                                                       _mm256_mul_ps(normal_y, normal_y)),
+                                                         _mm256_mul_ps(normal_z, normal_z)));
+            __m256 nonzero = _mm256_cmp_ps(length, _mm256_setzero_ps(), _CMP_GT_OQ);
+            normal_x = normalizedAvx2(normal_x, length, nonzero);
+            normal_y = normalizedAvx2(normal_y, length, nonzero);
+            normal_z = normalizedAvx2(normal_z, length, nonzero);
+        }
+        _mm256_storeu_ps(&normals.x[triangle], normal_x);
+        _mm256_storeu_ps(&normals.y[triangle], normal_y);
+        _mm256_storeu_ps(&normals.z[triangle], normal_z);
+    }
+    faceNormalsScalar(positions, indices, triangle, last_triangle, unit_length, normals);
+}
+
+__attribute__((target("avx2")))
+__m256i divideBy3Avx2(__m256i value)
+/** Exact unsigned division by 3 of 8 lanes: multiplication by ceil(2^33 / 3) and a shift by 33, done on the even and
+the odd lanes separately because _mm256_mul_epu32 only multiplies the even 32-bit lanes into 64 bits. */
+{
+    const __m256i magic = _mm256_set1_epi32(static_cast<int>(0xAAAAAAABu));
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(value, magic), 33);
+    __m256i odd  = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(value, 32), magic), 33);
+    return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+__attribute__((target("avx2")))
+void accumulateNormalsAvx2(const SoaVectors& face_normals, const unsigned int* offsets, const unsigned int* corners,
+                           const float* corner_weights, size_t first_vertex, size_t last_vertex, SoaVectors& sums)
+{
+    // every lane walks the corner list of its own vertex, lanes whose list is done are masked out; each vertex adds its
+    // face normals in the same order as the scalar loop
+    const int* corner_data = reinterpret_cast<const int*>(corners);
+    const __m256i one = _mm256_set1_epi32(1);
+    size_t vertex = first_vertex;
+    for (; vertex + 8 <= last_vertex; vertex += 8)
+    {
+        __m256i cursor = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(offsets + vertex));
+        __m256i end    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(offsets + vertex + 1));
+        __m256 sum_x = _mm256_setzero_ps();
+        __m256 sum_y = _mm256_setzero_ps();
+        __m256 sum_z = _mm256_setzero_ps();
+
+        __m256i active = _mm256_cmpgt_epi32(end, cursor);
+        while (_mm256_movemask_epi8(active) != 0)
+        {
+            __m256 active_lanes = _mm256_castsi256_ps(active);
+            __m256i corner   = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), corner_data, cursor, active, 4);
+            __m256i triangle = divideBy3Avx2(corner);
+            __m256 normal_x = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), face_normals.x.data(), triangle, active_lanes, 4);
+            __m256 normal_y = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), face_normals.y.data(), triangle, active_lanes, 4);
+            __m256 normal_z = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), face_normals.z.data(), triangle, active_lanes, 4);
+            if (corner_weights)
+            {
+                __m256 weight = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), corner_weights, corner, active_lanes, 4);
+                normal_x = _mm256_mul_ps(normal_x, weight);
+                normal_y = _mm256_mul_ps(normal_y, weight);
+                normal_z = _mm256_mul_ps(normal_z, weight);
+            }
+            // a weight of 1 leaves the normal unchanged, so the multiplication is skipped
+            sum_x = _mm256_blendv_ps(sum_x, _mm256_add_ps(sum_x, normal_x), active_lanes);
+            sum_y = _mm256_blendv_ps(sum_y, _mm256_add_ps(sum_y, normal_y), active_lanes);
+            sum_z = _mm256_blendv_ps(sum_z, _mm256_add_ps(sum_z, normal_z), active_lanes);
+
+            cursor = _mm256_add_epi32(cursor, _mm256_and_si256(active, one));
+            active = _mm256_cmpgt_epi32(end, cursor);
+        }
+        _mm256_storeu_ps(&sums.x[vertex], sum_x);
+        _mm256_storeu_ps(&sums.y[vertex], sum_y);
+        _mm256_storeu_ps(&sums.z[vertex], sum_z);
+    }
+    accumulateNormalsScalar(face_normals, offsets, corners, corner_weights, vertex, last_vertex, sums);
+}
+
+__attribute__((target("avx2")))
+void normalizeAvx2(SoaVectors& vectors, size_t first, size_t last)
+{
+    size_t i = first;
+    for (; i + 8 <= last; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(&vectors.x[i]);
+        __m256 y = _mm256_loadu_ps(&vectors.y[i]);
+        __m256 z = _mm256_loadu_ps(&vectors.z[i]);
+        __m256 length  = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)),
+                                                      _mm256_mul_ps(z, z)));
+        __m256 nonzero = _mm256_cmp_ps(length, _mm256_setzero_ps(), _CMP_GT_OQ);
+        _mm256_storeu_ps(&vectors.x[i], normalizedAvx2(x, length, nonzero));
+        _mm256_storeu_ps(&vectors.y[i], normalizedAvx2(y, length, nonzero));
+        _mm256_storeu_ps(&vectors.z[i], normalizedAvx2(z, length, nonzero));
+    }
+    normalizeSse(vectors, i, last);
+}
+
+__attribute__((target("avx2")))
+void boundsAvx2(const SoaVectors& positions, float min[3], float max[3])
+{
+    size_t count = positions.size();
+    if (count < 8)
+    {
+        boundsSse(positions, min, max);
+        return;
+    }
+    __m256 min_x = _mm256_loadu_ps(&positions.x[0]), max_x = min_x;
+    __m256 min_y = _mm256_loadu_ps(&positions.y[0]), max_y = min_y;
+    __m256 min_z = _mm256_loadu_ps(&positions.z[0]), max_z = min_z;
+    size_t i = 8;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(&positions.x[i]);
+        __m256 y = _mm256_loadu_ps(&positions.y[i]);
+        __m256 z = _mm256_loadu_ps(&positions.z[i]);
+        min_x = _mm256_min_ps(x, min_x); max_x = _mm256_max_ps(x, max_x);
+        min_y = _mm256_min_ps(y, min_y); max_y = _mm256_max_ps(y, max_y);
+        min_z = _mm256_min_ps(z, min_z); max_z = _mm256_max_ps(z, max_z);
+    }
+    min[0] = horizontalMinSse(_mm_min_ps(_mm256_castps256_ps128(min_x), _mm256_extractf128_ps(min_x, 1)));
+    min[1] = horizontalMinSse(_mm_min_ps(_mm256_castps256_ps128(min_y), _mm256_extractf128_ps(min_y, 1)));
+    min[2] = horizontalMinSse(_mm_min_ps(_mm256_castps256_ps128(min_z), _mm256_extractf128_ps(min_z, 1)));
+    max[0] = horizontalMaxSse(_mm_max_ps(_mm256_castps256_ps128(max_x), _mm256_extractf128_ps(max_x, 1)));
+    max[1] = horizontalMaxSse(_mm_max_ps(_mm256_castps256_ps128(max_y), _mm256_extractf128_ps(max_y, 1)));
+    max[2] = horizontalMaxSse(_mm_max_ps(_mm256_castps256_ps128(max_z), _mm256_extractf128_ps(max_z, 1)));
+    boundsScalar(positions, i, min, max);
+}
+
+__attribute__((target("avx2")))
+float radiusSquaredAvx2(const SoaVectors& positions, const float center[3])
+{
+    __m256 center_x = _mm256_set1_ps(center[0]);
+    __m256 center_y = _mm256_set1_ps(center[1]);
+    __m256 center_z = _mm256_set1_ps(center[2]);
+    __m256 radius_sq = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= positions.size(); i += 8)
+    {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&positions.x[i]), center_x);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&positions.y[i]), center_y);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(&positions.z[i]), center_z);
+        __m256 distance_sq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        radius_sq = _mm256_max_ps(distance_sq, radius_sq);
+    }
+    float lanes_max = horizontalMaxSse(_mm_max_ps(_mm256_castps256_ps128(radius_sq), _mm256_extractf128_ps(radius_sq, 1)));
+    return radiusSquaredScalar(positions, i, center, lanes_max);
+}
+
+__attribute__((target("avx2")))
+void sumAvx2(const SoaVectors& positions, float sum[3])
+{
+    __m256 sum_x = _mm256_setzero_ps();
+    __m256 sum_y = _mm256_setzero_ps();
+    __m256 sum_z = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= positions.size(); i += 8)
+    {
+        sum_x = _mm256_add_ps(sum_x, _mm256_loadu_ps(&positions.x[i]));
+        sum_y = _mm256_add_ps(sum_y, _mm256_loadu_ps(&positions.y[i]));
+        sum_z = _mm256_add_ps(sum_z, _mm256_loadu_ps(&positions.z[i]));
+    }
+    float lanes[8];
+    __m256 sums[3] = {sum_x, sum_y, sum_z};
+    for (int axis = 0; axis < 3; axis++)
+    {
+        _mm256_storeu_ps(lanes, sums[axis]);
+        sum[axis] = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    }
+    sumScalar(positions, i, sum);
+}
+
+#endif
+
+SimdLevel detectLevel()
+/** Returns AVX2 if the CPU has it and the OS saves the AVX registers on context switches (OSXSAVE and XCR0), SSE if the
+CPU has SSE2 and Scalar otherwise. */
+{
+#ifdef GEOMETRY_KERNELS_X86
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        return SimdLevel::Scalar;
+    }
+    bool sse2 = (edx & bit_SSE2) != 0;
+    bool avx  = (ecx & bit_AVX) != 0 && (ecx & bit_OSXSAVE) != 0;
+    if (avx)
+    {
+        unsigned int xcr0_low = 0, xcr0_high = 0;
+        __asm__ volatile("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+        // XMM and YMM state enabled
+        avx = (xcr0_low & 6) == 6;
+    }
+    bool avx2 = false;
+    if (avx && __get_cpuid_max(0, nullptr) >= 7)
+    {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        avx2 = (ebx & bit_AVX2) != 0;
+    }
+    if (avx2)
+    {
+        return SimdLevel::AVX2;
+    }
+    return sse2 ? SimdLevel::SSE : SimdLevel::Scalar;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+}
+
+SimdLevel GeometryKernels::level_ = GeometryKernels::supportedLevel();
+
+void GeometryKernels::faceNormals(const SoaVectors& positions, const unsigned int* indices, size_t first_triangle,
+                                  size_t last_triangle, bool unit_length, SoaVectors& normals)
+/** Computes the normals (cross product of the edges from the first corner) of the triangles in range
+[first_triangle, last_triangle) into the same range of normals. With unit_length the normals are normalized, otherwise
+their length is twice the triangle area. */
+{
+#ifdef GEOMETRY_KERNELS_X86
+    if (level_ == SimdLevel::AVX2)
+    {
+        faceNormalsAvx2(positions, indices, first_triangle, last_triangle, unit_length, normals);
+        return;
+    }
+#endif
+    faceNormalsScalar(positions, indices, first_triangle, last_triangle, unit_length, normals);
+}
+
+void GeometryKernels::accumulateNormals(const SoaVectors& face_normals, const unsigned int* offsets,
+                                        const unsigned int* corners, const float* corner_weights, size_t first_vertex,
+                                        size_t last_vertex, SoaVectors& sums)
+/** Sums the face normals around every vertex in range [first_vertex, last_vertex) through the CSR adjacency of
+'vertexCorners': corners[offsets[v]..offsets[v+1]) are the positions of v in the index buffer, corner / 3 its triangles.
+Every normal is multiplied by the weight of its corner if corner_weights is not null. */
+{
+#ifdef GEOMETRY_KERNELS_X86
+    if (level_ == SimdLevel::AVX2)
+    {
+        accumulateNormalsAvx2(face_normals, offsets, corners, corner_weights, first_vertex, last_vertex, sums);
+        return;
+    }
+#endif
+    accumulateNormalsScalar(face_normals, offsets, corners, corner_weights, first_vertex, last_vertex, sums);
+}
+
+void GeometryKernels::normalize(SoaVectors& vectors, size_t first, size_t last)
+/** Scales the vectors in range [first, last) to unit length, zero vectors are left untouched. */
+{
+#ifdef GEOMETRY_KERNELS_X86
+    switch (level_)
+    {
+        case SimdLevel::AVX2:
+            normalizeAvx2(vectors, first, last);
+            return;
+        case SimdLevel::SSE:
+            normalizeSse(vectors, first, last);
+            return;
+        default:
+            break;
+    }
+#endif
+    normalizeScalar(vectors, first, last);
+}
+
+void GeometryKernels::bounds(const SoaVectors& positions, float min[3], float max[3])
+/** Calculates the axis-aligned bounding box of all vectors, no vectors give zero bounds. */
+{
+    if (positions.size() == 0)
+    {
+        std::fill(min, min + 3, 0.0f);
+        std::fill(max, max + 3, 0.0f);
+        return;
+    }
+    // the SIMD levels start from the first vector as well if there are fewer vectors than lanes
+    min[0] = max[0] = positions.x[0];
+    min[1] = max[1] = positions.y[0];
+    min[2] = max[2] = positions.z[0];
+#ifdef GEOMETRY_KERNELS_X86
+    switch (level_)
+    {
+        case SimdLevel::AVX2:
+            boundsAvx2(positions, min, max);
+            return;
+        case SimdLevel::SSE:
+            boundsSse(positions, min, max);
+            return;
+        default:
+            break;
+    }
+#endif
+    boundsScalar(positions, 1, min, max);
+}
+
+float GeometryKernels::boundingRadius(const SoaVectors& positions, const float center[3])
+/** Returns the distance from center to the farthest vector, the radius of the bounding sphere around center. */
+{
+    float radius_sq = 0.0f;
+#ifdef GEOMETRY_KERNELS_X86
+    switch (level_)
+    {
+        case SimdLevel::AVX2:
+            radius_sq = radiusSquaredAvx2(positions, center);
+            break;
+        case SimdLevel::SSE:
+            radius_sq = radiusSquaredSse(positions, center);
+            break;
+        default:
+            radius_sq = radiusSquaredScalar(positions, 0, center, 0.0f);
+            break;
+    }
+#else
+    radius_sq = radiusSquaredScalar(positions, 0, center, 0.0f);
+#endif
+    return std::sqrt(radius_sq);
+}
+
+void GeometryKernels::centroid(const SoaVectors& positions, float center[3])
+/** Calculates the average of all vectors, no vectors give the origin. The SIMD levels sum in several lanes, so the
+result may differ from the scalar sum in the last bits. */
+{
+    std::fill(center, center + 3, 0.0f);
+    if (positions.size() == 0)
+    {
+        return;
+    }
+#ifdef GEOMETRY_KERNELS_X86
+    switch (level_)
+    {
+        case SimdLevel::AVX2:
+            sumAvx2(positions, center);
+            break;
+        case SimdLevel::SSE:
+            sumSse(positions, center);
+            break;
+        default:
+            sumScalar(positions, 0, center);
+            break;
+    }
+#else
+    sumScalar(positions, 0, center);
+#endif
+    auto count = static_cast<float>(positions.size());
+    for (int axis = 0; axis < 3; axis++)
+    {
+        center[axis] /= count;
+    }
+}
+
+void GeometryKernels::vertexCorners(const std::vector<unsigned int>& indices, size_t vertices_count,
+                                    std::vector<unsigned int>& offsets, std::vector<unsigned int>& corners)
+/** Builds a compressed sparse row adjacency: corners[offsets[v]..offsets[v+1]) are the positions in the index buffer
+that reference vertex v, stored in increasing order. Throws if an index is not below vertices_count. */
+{
+    offsets.assign(vertices_count + 1, 0);
+    for (auto vertex_ind : indices)
+    {
+        if (vertex_ind >= vertices_count)
+        {
+            throw std::string("GeometryKernels: vertex index " + std::to_string(vertex_ind) + " is out of range.");
+        }
+        offsets[vertex_ind + 1]++;
+    }
+    for (size_t i = 0; i < vertices_count; i++)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+
+    corners.resize(indices.size());
+    std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        corners[cursor[indices[i]]++] = static_cast<unsigned int>(i);
+    }
+}
+
+void GeometryKernels::setLevel(SimdLevel level)
+{
+    level_ = std::min(level, supportedLevel());
+}
+
+SimdLevel GeometryKernels::supportedLevel()
+{
+    static const SimdLevel supported = detectLevel();
+    return supported;
+}
+
+const char* GeometryKernels::levelName(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::AVX2:
+            return "AVX2";
+        case SimdLevel::SSE:
+            return "SSE";
+        default:
+            return "Scalar";
+    }
+}
@@ -0,0 +1,270 @@
+#include <cstring>
+#include <fstream>
+#include "../include/gpu_profiler.h"
+
+// tokens of ARB_pipeline_statistics_query, the GLAD loader of the project is generated for 3.3 core without it
+#ifndef GL_VERTEX_SHADER_INVOCATIONS_ARB
+#define GL_VERTEX_SHADER_INVOCATIONS_ARB 0x82F0
+#endif
+#ifndef GL_FRAGMENT_SHADER_INVOCATIONS_ARB
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+#endif
+
+namespace {
+    const GLenum QUERY_TARGETS[3] = {GL_TIME_ELAPSED, GL_VERTEX_SHADER_INVOCATIONS_ARB, GL_FRAGMENT_SHADER_INVOCATIONS_ARB};
+}
+
+void GpuProfiler::beginFrame()
+/** Opens a frame: reads the results of the queries issued two frames ago into the history, their queries are
+issued again in this frame. */
+{
+    if (!enabled_)
+    {
+        // results of the frames before the profiler was switched off are stale
+        sets_[0].pending = false;
+        sets_[1].pending = false;
+        frame_open_ = false;
+        return;
+    }
+    if (!created_)
+    {
+        createQueries_();
+    }
+    QuerySet& set = sets_[frame_ % 2];
+    if (set.pending)
+    {
+        readSet_(set);
+    }
+    for (auto& pass : set.passes)
+    {
+        pass.issued = false;
+    }
+    set.frame = frame_;
+    frame_open_ = true;
+}
+
+void GpuProfiler::endFrame()
+{
+    if (!frame_open_)
+    {
+        return;
+    }
+    if (open_pass_ != GpuPass::Count)
+    {
+        // a pass that was never ended has no meaningful range, its queries are ended and their results dropped
+        endQueries_();
+        sets_[frame_ % 2].passes[static_cast<int>(open_pass_)].issued = false;
+        open_pass_ = GpuPass::Count;
+    }
+    sets_[frame_ % 2].pending = true;
+    frame_++;
+    frame_open_ = false;
+}
+
+void GpuProfiler::beginPass(GpuPass pass)
+/** Starts the queries of a pass. Passes of a frame must not overlap and every pass is measured once per frame, a pass
+begun while another one is open or for the second time in a frame is ignored. */
+{
+    if (!frame_open_ || open_pass_ != GpuPass::Count)
+    {
+        return;
+    }
+    PassQueries& queries = sets_[frame_ % 2].passes[static_cast<int>(pass)];
+    if (queries.issued)
+    {
+        return;
+    }
+    int query_count = pipeline_statistics_ ? 3 : 1;
+    for (int i = 0; i < query_count; i++)
+    {
+        glBeginQuery(QUERY_TARGETS[i], queries.queries[i]);
+    }
+    queries.issued = true;
+    open_pass_ = pass;
+}
+
+void GpuProfiler::endPass(GpuPass pass)
+/** Ends the queries of the open pass, an end that does not match the pass begun last is ignored. */
+{
+    if (!frame_open_ || pass != open_pass_)
+    {
+        return;
+    }
+    endQueries_();
+    open_pass_ = GpuPass::Count;
+}
+
+void GpuProfiler::endQueries_()
+{
+    int query_count = pipeline_statistics_ ? 3 : 1;
+    for (int i = 0; i < query_count; i++)
+    {
+        glEndQuery(QUERY_TARGETS[i]);
+    }
+}
+
+void GpuProfiler::release()
+{
+    if (!created_)
+    {
+        return;
+    }
+    for (auto& set : sets_)
+    {
+        for (auto& pass : set.passes)
+        {
+            glDeleteQueries(3, pass.queries);
+        }
+        set.pending = false;
+    }
+    created_ = false;
+    frame_open_ = false;
+    open_pass_ = GpuPass::Count;
+}
+
+void GpuProfiler::exportCsv(const std::string& filepath) const
+/** Writes the frames of the history to a CSV file, one row per frame with the time in milliseconds and the vertex
+and fragment shader invocations of every pass; passes that did not run have empty fields. */
+{
+    std::ofstream file(filepath, std::ios::trunc);
+    if (!file.is_open())
+    {
+        throw std::string("unable to create file: " + filepath);
+    }
+    file << "frame";
+    for (int pass = 0; pass < PASS_COUNT; pass++)
+    {
+        const char* name = passName(static_cast<GpuPass>(pass));
+        file << ',' << name << "_ms," << name << "_vertex_invocations," << name << "_fragment_invocations";
+    }
+    file << '\n';
+    for (size_t i = 0; i < history_.size(); i++)
+    {
+        const GpuFrameSample& sample = historySample(i);
+        file << sample.frame;
+        for (const auto& pass : sample.passes)
+        {
+            if (!pass.drawn)
+            {
+                file << ",,,";
+            }
+            else if (!pipeline_statistics_)
+            {
+                file << ',' << pass.gpu_ms << ",,";
+            }
+            else
+            {
+                file << ',' << pass.gpu_ms << ',' << pass.vertex_invocations << ',' << pass.fragment_invocations;
+            }
+        }
+        file << '\n';
+    }
+    if (!file)
+    {
+        throw std::string("unable to write file: " + filepath);
+    }
+}
+
+const GpuFrameSample& GpuProfiler::historySample(size_t index) const
+/** Returns the frame 'index' of the history, 0 is the oldest one. */
+{
+    return history_[(history_start_ + index) % history_.size()];
+}
+
+const char* GpuProfiler::passName(GpuPass pass)
+{
+    switch (pass)
+    {
+        case GpuPass::LightGizmos:
+            return "light_gizmos";
+        case GpuPass::ShadowMaps:
+            return "shadow_maps";
+        case GpuPass::CentralObject:
+            return "central_object";
+        case GpuPass::Axes:
+            return "axes";
+        case GpuPass::Gui:
+            return "imgui";
+        default:
+            return "unknown";
+    }
+}
+
+void GpuProfiler::createQueries_()
+/** Creates the queries of both sets and checks the extension list of the context for pipeline statistics. */
+{
+    GLint extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+    for (GLint i = 0; i < extension_count; i++)
+    {
+        const auto* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (extension != nullptr && std::strcmp(extension, "GL_ARB_pipeline_statistics_query") == 0)
+        {
+            pipeline_statistics_ = true;
+            break;
+        }
+    }
+    for (auto& set : sets_)
+    {
+        for (auto& pass : set.passes)
+        {
+            glGenQueries(3, pass.queries);
+        }
+        set.pending = false;
+    }
+    history_.reserve(HISTORY_SIZE);
+    created_ = true;
+}
+
+void GpuProfiler::readSet_(QuerySet& set)
+/** Moves the results of a frame into the history if all of them are available, the frame is dropped otherwise: its
+queries are issued again in this frame, which discards the old results. */
+{
+    set.pending = false;
+    int query_count = pipeline_statistics_ ? 3 : 1;
+    for (const auto& pass : set.passes)
+    {
+        for (int i = 0; pass.issued && i < query_count; i++)
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(pass.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available == 0)
+            {
+                dropped_frames_++;
+                return;
+            }
+        }
+    }
+    GpuFrameSample sample;
+    sample.frame = set.frame;
+    for (int i = 0; i < PASS_COUNT; i++)
+    {
+        const PassQueries& queries = set.passes[i];
+        GpuPassSample& pass = sample.passes[i];
+        if (!queries.issued)
+        {
+            continue;
+        }
+        GLuint64 elapsed_ns = 0;
+        glGetQueryObjectui64v(queries.queries[0], GL_QUERY_RESULT, &elapsed_ns);
+        pass.drawn = true;
+        pass.gpu_ms = static_cast<float>(static_cast<double>(elapsed_ns) * 1e-6);
+        if (pipeline_statistics_)
+        {
+            glGetQueryObjectui64v(queries.queries[1], GL_QUERY_RESULT, &pass.vertex_invocations);
+            glGetQueryObjectui64v(queries.queries[2], GL_QUERY_RESULT, &pass.fragment_invocations);
+        }
+    }
+    pushSample_(sample);
+}
+
+void GpuProfiler::pushSample_(const GpuFrameSample& sample)
+{
+    if (history_.size() < static_cast<size_t>(HISTORY_SIZE))
+    {
+        history_.push_back(sample);
+        return;
+    }
+    history_[history_start_] = sample;
+    history_start_ = (history_start_ + 1) % history_.size();
+}
@@ -1,3 +1,4 @@
+#include <cfloat>
 #include <fstream>
 #include <sstream>
 #include "imgui.h"
@@ -23,6 +24,119 @@ If corresponding boolean is true, opens Help window.*/
             {
                 session_.addLightObject();
             }
+            if (ImGui::MenuItem("Add 100 light sources"))
+            {
+                session_.addLightObjects(100);
+            }
+            if (ImGui::BeginMenu("Renderer"))
+            {
+                auto& render_mode = session_.renderMode();
+                int mode = static_cast<int>(render_mode);
+                ImGui::RadioButton("forward (clustered)", &mode, static_cast<int>(RenderMode::Forward));
+                ImGui::SameLine();
+                ImGui::RadioButton("deferred", &mode, static_cast<int>(RenderMode::Deferred));
+                render_mode = static_cast<RenderMode>(mode);
+                ImGui::Text("%.2f ms per frame (%.0f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+                if (render_mode == RenderMode::Forward)
+                {
+                    const auto& cluster_stats = session_.getLightClusterStats();
+                    ImGui::Text("%zu lights, %.1f per cluster on average, %zu at most", cluster_stats.lights,
+                                cluster_stats.averageClusterLights(), cluster_stats.max_cluster_lights);
+                }
+                else
+                {
+                    const auto& deferred_stats = session_.getDeferredStats();
+                    ImGui::Text("%zu light passes, %zu lights outside of the view", deferred_stats.light_passes,
+                                deferred_stats.culled_lights);
+                    ImGui::Text("scissor covers %.1f%% of the screen on average", deferred_stats.scissor_coverage * 100.0);
+                }
+                const auto& queue_stats = session_.getRenderQueueStats();
+                ImGui::Text("render queue: %zu draws, %zu state changes (%zu without the queue)", queue_stats.packets,
+                            queue_stats.stateChanges(), queue_stats.immediate_changes);
+                ImGui::Text("programs %zu, VAOs %zu, polygon modes %zu, %zu draws batched", queue_stats.program_changes,
+                            queue_stats.vao_changes, queue_stats.polygon_mode_changes, queue_stats.batched_draws);
+                const auto& stream_stats = session_.getStreamStats();
+                ImGui::Text("stream buffer (%s): %zu writes, %.1f of %.1f KiB per frame",
+                            stream_stats.persistent ? "persistent" : "mapped per write", stream_stats.frame_writes,
+                            static_cast<double>(stream_stats.frame_bytes) / 1024.0,
+                            static_cast<double>(stream_stats.region_bytes) / 1024.0);
+                ImGui::Text("%zu stalls in %zu frames (%.2f ms waited), %zu resizes", stream_stats.stalls,
+                            stream_stats.frames, stream_stats.stall_ms, stream_stats.resizes);
+                auto arena_stats = MeshArena::shared().getStats();
+                ImGui::Text("mesh arena: %zu meshes in %zu pools, %.1f of %.1f MiB used", arena_stats.meshes,
+                            arena_stats.pools, static_cast<double>(arena_stats.used_bytes) / (1024.0 * 1024.0),
+                            static_cast<double>(arena_stats.capacity_bytes) / (1024.0 * 1024.0));
+                ImGui::Text("%zu free ranges, %zu resizes", arena_stats.free_ranges, arena_stats.resizes);
+                auto asset_stats = MeshAssets::getStats();
+                ImGui::Text("mesh assets: %zu files used by %zu objects, %zu loads, %zu shared", asset_stats.assets,
+                            asset_stats.references, asset_stats.loads, asset_stats.reuses);
+                ImGui::EndMenu();
+            }
+            if (ImGui::BeginMenu("Shadows"))
+            {
+                ImGui::Checkbox("shadow maps", &session_.shadows());
+                auto& pcf_radius = session_.shadowPcfRadius();
+                int taps = (2 * pcf_radius + 1) * (2 * pcf_radius + 1);
+                ImGui::SliderInt("PCF radius", &pcf_radius, 0, ShadowAtlas::MAX_PCF_RADIUS, "%d texels");
+                ImGui::Text("%d filtered taps per light and pixel", taps);
+                const auto& shadow_stats = session_.getShadowStats();
+                ImGui::Text("%zu lights with shadows, %zu without (atlas is full)", shadow_stats.shadowed_lights,
+                            shadow_stats.missing_lights);
+                ImGui::Text("atlas: %zu of %zu tiles, %.1f MiB", shadow_stats.used_tiles, shadow_stats.tiles,
+                            static_cast<double>(shadow_stats.atlas_bytes) / (1024.0 * 1024.0));
+                ImGui::Text("%zu maps rendered in the last frame, %.2f ms CPU", shadow_stats.rendered_lights,
+                            shadow_stats.cpu_ms);
+                if (!shadow_stats.lights.empty() &&
+                    ImGui::BeginTable("shadow passes", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY,
+                                      ImVec2(0.0f, 150.0f)))
+                {
+                    // times of the last rendering of every map, cached maps keep their time
+                    ImGui::TableSetupColumn("light");
+                    ImGui::TableSetupColumn("faces");
+                    ImGui::TableSetupColumn("CPU ms");
+                    ImGui::TableSetupColumn("GPU ms");
+                    ImGui::TableHeadersRow();
+                    for (const auto& light : shadow_stats.lights)
+                    {
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%d", light.light_id);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%d", light.faces);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.3f", light.cpu_ms);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.3f", light.gpu_ms);
+                    }
+                    ImGui::EndTable();
+                }
+                ImGui::EndMenu();
+            }
+            if (ImGui::BeginMenu("Picking"))
+            {
+                // the last click: ray cast against the hierarchies of the gizmos and of the central object copies
+                const auto& pick = session_.getLastPick();
+                // a Light object removed after the click is not shown
+                if (pick.target == PickTarget::Light && pick.index < static_cast<int>(session_.getFlashLightObjects().size()))
+                {
+                    ImGui::Text("light source %s", session_.getFlashLightObjects()[pick.index].ObjectIdToString().c_str());
+                }
+                else if (pick.target == PickTarget::CentralObject)
+                {
+                    ImGui::Text("central object, copy %d", pick.index);
+                }
+                else
+                {
+                    ImGui::Text("nothing under the cursor");
+                }
+                if (pick.target != PickTarget::None)
+                {
+                    ImGui::Text("point: (%.3f, %.3f, %.3f), %.3f from the camera", pick.point.x, pick.point.y,
+                                pick.point.z, pick.distance);
+                }
+                ImGui::Text("ray cast: %.1f us, %zu BVH nodes", pick.time_us, session_.getPickNodeCount());
+                ImGui::EndMenu();
+            }
 
             if (ImGui::BeginMenu("Central object"))
             {
@@ -30,9 +144,84 @@ If corresponding boolean is true, opens Help window.*/
                 ImGui::ColorEdit3("color", col);
                 ImGui::Spacing();
                 ImGui::SliderFloat("scale", &session_.getCentralObject().getScale(), 0.1, 10.0f, "x = %.1f");
+                ImGui::Text("LOD %zu of %zu, %zu triangles", session_.getCentralObject().getLod(),
+                            session_.getCentralObject().getLodCount(), session_.getCentralObject().getTriangleCount());
+                int copies = session_.getCentralObjectCopies();
+                if (ImGui::SliderInt("copies", &copies, 1, 20000, "%d", ImGuiSliderFlags_Logarithmic))
+                {
+                    session_.setCentralObjectCopies(copies);
+                }
+                ImGui::Text("%zu instances in one draw call", session_.getCentralObject().getInstanceCount());
+                ImGui::Checkbox("meshlet culling", &session_.getCentralObject().meshletCulling());
+                const auto& cull_stats = session_.getCentralObject().getMeshletCullStats();
+                if (cull_stats.meshlets > 0)
+                {
+                    ImGui::Text("culled: %.1f%% of %zu meshlets (frustum %zu, backface %zu)", cull_stats.culledPercentage(),
+                                cull_stats.meshlets, cull_stats.frustum_culled, cull_stats.backface_culled);
+                    ImGui::Text("drawn: %zu of %zu triangles in %zu draws", cull_stats.triangles - cull_stats.culled_triangles,
+                                cull_stats.triangles, cull_stats.draws);
+                }
+                ImGui::Checkbox("specular highlights", &session_.getCentralObject().specularHighlights());
+                ImGui::Text("shader variant 0x%x, %zu compiled", session_.getCentralObject().getShaderKey(),
+                            session_.getCentralObject().getShaderVariantCount());
+
+                MeshLoadOptions load_options = session_.getCentralObjectLoadOptions();
+                ImGui::SeparatorText("Normals weighting");
+                int weighting = static_cast<int>(load_options.weighting);
+                bool weighting_changed = ImGui::RadioButton("uniform", &weighting, static_cast<int>(NormalWeighting::Uniform));
+                ImGui::SameLine();
+                weighting_changed |= ImGui::RadioButton("area", &weighting, static_cast<int>(NormalWeighting::Area));
+                ImGui::SameLine();
+                weighting_changed |= ImGui::RadioButton("angle", &weighting, static_cast<int>(NormalWeighting::Angle));
+                load_options.weighting = static_cast<NormalWeighting>(weighting);
+
+                ImGui::SeparatorText("Mesh optimization");
+                bool options_changed = ImGui::Checkbox("optimize on load", &load_options.optimize);
+
+                ImGui::SeparatorText("Vertex format");
+                int position_format = static_cast<int>(load_options.vertex_format.position);
+                options_changed |= ImGui::RadioButton("float", &position_format, static_cast<int>(PositionFormat::Float32));
+                ImGui::SameLine();
+                options_changed |= ImGui::RadioButton("half", &position_format, static_cast<int>(PositionFormat::Half16));
+                ImGui::SameLine();
+                options_changed |= ImGui::RadioButton("int16", &position_format, static_cast<int>(PositionFormat::Int16));
+                load_options.vertex_format.position = static_cast<PositionFormat>(position_format);
+                int normal_format = static_cast<int>(load_options.vertex_format.normal);
+                options_changed |= ImGui::RadioButton("float normals", &normal_format, static_cast<int>(NormalFormat::Float32));
+                ImGui::SameLine();
+                options_changed |= ImGui::RadioButton("10_10_10_2 normals", &normal_format, static_cast<int>(NormalFormat::Int10));
+                load_options.vertex_format.normal = static_cast<NormalFormat>(normal_format);
+                const auto& packed = session_.getCentralObject().getPackedMesh();
+                ImGui::Text("GPU memory: %.2f MB (%u bytes per vertex, %u-bit indices)",
+                            static_cast<double>(packed.vertex_bytes + packed.index_bytes) / (1024.0 * 1024.0),
+                            packed.stride, packed.index_size * 8);
+
+                if (weighting_changed || options_changed)
+                {
+                    session_.setCentralObjectLoadOptions(load_options);
+                }
+                const auto& stats = session_.getCentralObject().getOptimizationStats();
+                if (stats.optimized)
+                {
+                    ImGui::Text("welded vertices: %u", stats.welded_vertices);
+                    ImGui::Text("ACMR: %.3f -> %.3f", stats.acmr_before, stats.acmr_after);
+                    ImGui::Text("ATVR: %.3f -> %.3f", stats.atvr_before, stats.atvr_after);
+                }
                 ImGui::EndMenu();
             }
             ImGui::MenuItem("Coordinate system", nullptr, &session_.coordinate_system());
+            // the profiler measures the passes only while its panel is open
+            ImGui::MenuItem("GPU profiler", nullptr, &session_.getGpuProfiler().enabled());
+            ImGui::MenuItem("Jobs", nullptr, &jobs_window_);
+            if (ImGui::BeginMenu("Frame pacing"))
+            {
+                // with render on demand the scene is drawn only after changes, the loop sleeps otherwise
+                ImGui::Checkbox("render on demand", &frame_scheduler_.renderOnDemand());
+                ImGui::SliderInt("frame cap", &frame_scheduler_.frameCap(), 0, FrameScheduler::MAX_FRAME_CAP,
+                                 frame_scheduler_.frameCap() == 0 ? "off" : "%d fps");
+                ImGui::Checkbox("stats overlay", &frame_scheduler_.statsOverlay());
+                ImGui::EndMenu();
+            }
 
             if (ImGui::MenuItem("Help"))
             {
@@ -50,6 +239,202 @@ If corresponding boolean is true, opens Help window.*/
     {
         drawHelpWindow();
     }
+    if (session_.getGpuProfiler().enabled())
+    {
+        drawGpuProfilerWindow();
+    }
+    if (jobs_window_)
+    {
+        drawJobsWindow();
+    }
+    if (session_.getCentralObjectLoader().busy())
+    {
+        drawLoadingWindow();
+    }
+}
+
+void Gui::drawStatsOverlay()
+/** Draws a small transparent window in the bottom left corner with the frame rate, the frames skipped by rendering
+on demand and the share of idle time. The numbers change once per stats interval. */
+{
+    if (!frame_scheduler_.statsOverlay())
+    {
+        return;
+    }
+    const auto& stats = frame_scheduler_.getStats();
+    const ImVec2 display_size = ImGui::GetIO().DisplaySize;
+    ImGui::SetNextWindowPos(ImVec2(10.0f, display_size.y - 10.0f), ImGuiCond_Always, ImVec2(0.0f, 1.0f));
+    ImGui::SetNextWindowBgAlpha(0.35f);
+    ImGui::Begin("Stats overlay", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+                                           ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing |
+                                           ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoMove);
+    ImGui::Text("%.1f frames/s drawn, %.1f skipped/s", stats.fps, stats.skipped_per_second);
+    ImGui::Text("idle: %.1f%%", stats.idle_percentage);
+    ImGui::Text("total: %zu drawn, %zu skipped", stats.frames_drawn, stats.frames_skipped);
+    ImGui::End();
+}
+
+void Gui::drawGpuProfilerWindow()
+/** Draws the GPU profiler panel: the last measured frame and the averages of the history for every render pass,
+a graph of the GPU time of every pass over the history and a button that exports the history as CSV. */
+{
+    auto& profiler = session_.getGpuProfiler();
+    ImGui::SetNextWindowSize(ImVec2(520.0f, 0.0f), ImGuiCond_FirstUseEver);
+    ImGui::Begin("GPU profiler", &profiler.enabled());
+    ImGui::Text("pipeline statistics: %s", profiler.pipelineStatistics() ? "available" : "not supported by the driver");
+    ImGui::Text("%zu frames in the history, %zu dropped (results were late)", profiler.historySize(),
+                profiler.droppedFrames());
+    if (profiler.historySize() == 0)
+    {
+        ImGui::End();
+        return;
+    }
+
+    const GpuFrameSample& last = profiler.historySample(profiler.historySize() - 1);
+    if (ImGui::BeginTable("gpu passes", 5, ImGuiTableFlags_Borders))
+    {
+        ImGui::TableSetupColumn("pass");
+        ImGui::TableSetupColumn("GPU ms");
+        ImGui::TableSetupColumn("average ms");
+        ImGui::TableSetupColumn("vertices");
+        ImGui::TableSetupColumn("fragments");
+        ImGui::TableHeadersRow();
+        for (int pass = 0; pass < GpuProfiler::PASS_COUNT; pass++)
+        {
+            double total_ms = 0;
+            size_t drawn_frames = 0;
+            for (size_t i = 0; i < profiler.historySize(); i++)
+            {
+                const GpuPassSample& sample = profiler.historySample(i).passes[pass];
+                if (sample.drawn)
+                {
+                    total_ms += sample.gpu_ms;
+                    drawn_frames++;
+                }
+            }
+            const GpuPassSample& sample = last.passes[pass];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", GpuProfiler::passName(static_cast<GpuPass>(pass)));
+            ImGui::TableNextColumn();
+            if (sample.drawn)
+            {
+                ImGui::Text("%.3f", sample.gpu_ms);
+            }
+            else
+            {
+                ImGui::TextDisabled("-");
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", drawn_frames > 0 ? total_ms / static_cast<double>(drawn_frames) : 0.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(sample.vertex_invocations));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(sample.fragment_invocations));
+        }
+        ImGui::EndTable();
+    }
+
+    // one graph per pass, frames in which the pass did not run are drawn as 0
+    struct PlotData {
+        const GpuProfiler* profiler;
+        int pass;
+    };
+    for (int pass = 0; pass < GpuProfiler::PASS_COUNT; pass++)
+    {
+        PlotData data{&profiler, pass};
+        ImGui::PlotLines(GpuProfiler::passName(static_cast<GpuPass>(pass)), [](void* plot_data, int index) {
+            const auto* plot = static_cast<const PlotData*>(plot_data);
+            return plot->profiler->historySample(static_cast<size_t>(index)).passes[plot->pass].gpu_ms;
+        }, &data, static_cast<int>(profiler.historySize()), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 40.0f));
+    }
+
+    if (ImGui::Button("Export CSV"))
+    {
+        try
+        {
+            profiler.exportCsv(gpu_profile_path_);
+            pfd::notify("System event", "GPU profile saved to " + gpu_profile_path_, pfd::icon::info);
+        }
+        catch (const std::string& error)
+        {
+            pfd::notify("System event", error, pfd::icon::error);
+        }
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled("%s", gpu_profile_path_.c_str());
+    ImGui::End();
+}
+
+void Gui::drawJobsWindow()
+/** Draws the CPU jobs of the last drawn frame: busy time and number of jobs of every thread of the job system and
+every job with its thread, start and duration in milliseconds since the start of the frame. */
+{
+    const JobSystem& jobs = session_.getJobSystem();
+    const auto& timings = jobs.getTimings();
+    ImGui::SetNextWindowSize(ImVec2(420.0f, 360.0f), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Jobs", &jobs_window_);
+    ImGui::Text("%u threads (the render thread and %u workers), %zu jobs in the last frame", jobs.threadCount(),
+                jobs.threadCount() - 1, timings.size());
+
+    if (ImGui::BeginTable("job threads", 3, ImGuiTableFlags_Borders))
+    {
+        ImGui::TableSetupColumn("thread");
+        ImGui::TableSetupColumn("jobs");
+        ImGui::TableSetupColumn("busy ms");
+        ImGui::TableHeadersRow();
+        for (unsigned int thread = 0; thread < jobs.threadCount(); thread++)
+        {
+            size_t job_count = 0;
+            double busy_ms = 0;
+            for (const auto& timing : timings)
+            {
+                if (timing.thread == thread)
+                {
+                    job_count++;
+                    busy_ms += timing.end_ms - timing.start_ms;
+                }
+            }
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            if (thread == 0)
+            {
+                ImGui::Text("render");
+            }
+            else
+            {
+                ImGui::Text("worker %u", thread);
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu", job_count);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", busy_ms);
+        }
+        ImGui::EndTable();
+    }
+
+    if (ImGui::BeginTable("job timings", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY))
+    {
+        ImGui::TableSetupColumn("job");
+        ImGui::TableSetupColumn("thread");
+        ImGui::TableSetupColumn("start ms");
+        ImGui::TableSetupColumn("duration ms");
+        ImGui::TableHeadersRow();
+        for (const auto& timing : timings)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", timing.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", timing.thread);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", timing.start_ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", timing.end_ms - timing.start_ms);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
 }
 
 void Gui::drawObjectsPanels()
@@ -91,14 +476,9 @@ void Gui::drawIndividualPanel(FlashLightObject &object) const
         std::string toggle_name = "Turn on/off##" + object.ObjectIdToString();
         ImGui::Toggle(toggle_name.c_str(), &object.lightOnOff(), ImGuiToggleFlags_Animated);
 
-        if (ImGui::RadioButton("Spotlight", &object.lightObjectType(), 0)){
-            object.loadObjectFile("../objects/Flashlight.obj");
-            object.loadObjectBuffers();
-        }
-        if (ImGui::RadioButton("Point light", &object.lightObjectType(), 1)){
-            object.loadObjectFile("../objects/LightBulb.obj");
-            object.loadObjectBuffers();
-        }
+        // the gizmo of the Light object is an instance of the shared mesh of its type, so only the type is switched
+        ImGui::RadioButton("Spotlight", &object.lightObjectType(), 0);
+        ImGui::RadioButton("Point light", &object.lightObjectType(), 1);
         ImGui::Spacing();
 
         ImGui::SeparatorText("Light colour");
@@ -157,7 +537,7 @@ void Gui::openFile()
                                     { "Object Files", "*.obj"}).result();
     if (!selection.empty())
     {
-        session_.loadCentralObject(selection[0]);
+        session_.loadCentralObjectAsync(selection[0]);
     }
     else
     {
@@ -166,6 +546,23 @@ void Gui::openFile()
     }
 }
 
+void Gui::drawLoadingWindow()
+/** Draws a small window with the progress of the central object load in the background and a button to cancel it. */
+{
+    auto& loader = session_.getCentralObjectLoader();
+    const char* stage = loader.stage() == AsyncObjectLoader::Stage::Parsing ? "Parsing" : "Uploading";
+
+    ImGui::SetNextWindowSize(ImVec2(object_panel_width_ * 1.5f, 0));
+    ImGui::Begin("Loading central object", nullptr, ImGuiWindowFlags_NoResize);
+    ImGui::TextWrapped("%s", loader.filepath().c_str());
+    ImGui::ProgressBar(loader.progress(), ImVec2(-1, 0), stage);
+    if (ImGui::Button("Cancel"))
+    {
+        loader.cancel();
+    }
+    ImGui::End();
+}
+
 void Gui::exitConfirmMessage()
 /** Displays a confirmation dialog asking if the user wants to exit, exits the program if 'Yes' is selected. */
 {
@@ -0,0 +1,139 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "../include/headless_context.h"
+#include "../include/stream_buffer.h"
+
+HeadlessContext::~HeadlessContext()
+{
+    release();
+}
+
+void HeadlessContext::create(int width, int height)
+/** Creates an OpenGL 3.3 core context on the Mesa surfaceless EGL platform (the default EGL display if the platform
+is not available), makes it current without any surface, loads OpenGL functions with GLAD and creates the offscreen
+framebuffer. Throws a string with the reason if any step fails. */
+{
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    EGLDisplay display = EGL_NO_DISPLAY;
+    if (getPlatformDisplay != nullptr)
+    {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY)
+    {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+    {
+        throw std::string("Unable to initialize an EGL display");
+    }
+    display_ = display;
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        throw std::string("EGL display does not support desktop OpenGL");
+    }
+    // nothing is rendered to EGL surfaces, the pbuffer bit only selects configs the surfaceless platform exposes
+    const EGLint config_attributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count) || config_count == 0)
+    {
+        // the framebuffer is the only render target, so a context without a config works as well (EGL_KHR_no_config_context)
+        config = EGL_NO_CONFIG_KHR;
+    }
+
+    const EGLint context_attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+    if (context == EGL_NO_CONTEXT)
+    {
+        throw std::string("Unable to create an OpenGL 3.3 core context with EGL");
+    }
+    context_ = context;
+
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        throw std::string("Unable to make the EGL context current without a surface");
+    }
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress)))
+    {
+        throw std::string("Failed to initialize GLAD");
+    }
+    StreamBuffer::loadBufferStorage(reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+    resizeFramebuffer(width, height);
+}
+
+void HeadlessContext::resizeFramebuffer(int width, int height)
+/** (Re)creates the offscreen framebuffer with an RGBA8 color and a 24-bit depth renderbuffer of the given size
+and leaves it bound with the viewport covering it. */
+{
+    if (framebuffer_ == 0)
+    {
+        glGenFramebuffers(1, &framebuffer_);
+        glGenRenderbuffers(1, &color_buffer_);
+        glGenRenderbuffers(1, &depth_buffer_);
+    }
+    width_  = width;
+    height_ = height;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, color_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::string("Offscreen framebuffer is incomplete");
+    }
+    bindFramebuffer();
+}
+
+void HeadlessContext::bindFramebuffer() const
+/** Binds the offscreen framebuffer for drawing and sets the viewport to its size. */
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glViewport(0, 0, width_, height_);
+}
+
+std::string HeadlessContext::rendererName() const
+/** Returns the GL_RENDERER string of the context, e.g. "llvmpipe (LLVM 15.0.7, 256 bits)". */
+{
+    const auto* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    return renderer == nullptr ? std::string() : std::string(renderer);
+}
+
+void HeadlessContext::release()
+/** Deletes the framebuffer and destroys the EGL context. */
+{
+    if (framebuffer_ != 0)
+    {
+        glDeleteFramebuffers(1, &framebuffer_);
+        glDeleteRenderbuffers(1, &color_buffer_);
+        glDeleteRenderbuffers(1, &depth_buffer_);
+        framebuffer_ = color_buffer_ = depth_buffer_ = 0;
+    }
+    if (context_ != nullptr)
+    {
+        eglMakeCurrent(static_cast<EGLDisplay>(display_), EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(static_cast<EGLDisplay>(display_), static_cast<EGLContext>(context_));
+        context_ = nullptr;
+    }
+    if (display_ != nullptr)
+    {
+        eglTerminate(static_cast<EGLDisplay>(display_));
+        display_ = nullptr;
+    }
+}
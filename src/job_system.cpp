@@ -0,0 +1,185 @@
+#include <algorithm>
+#include "../include/job_system.h"
+
+namespace {
+    // index of the running thread in the job system it belongs to, other threads count as the submitting thread 0
+    thread_local const JobSystem* current_system = nullptr;
+    thread_local unsigned int current_thread = 0;
+}
+
+JobSystem::JobSystem(unsigned int worker_count)
+{
+    for (unsigned int i = 0; i <= worker_count; i++)
+    {
+        queues_.push_back(std::unique_ptr<ThreadQueue>(new ThreadQueue()));
+    }
+    for (unsigned int i = 1; i <= worker_count; i++)
+    {
+        workers_.emplace_back(&JobSystem::workerLoop_, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+/** Lets the workers finish the queued jobs and joins them. */
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+void JobSystem::run(const char* name, JobCounter& counter, std::function<void()> job)
+/** Queues a job, the name has to be a string literal (it is kept in the timings). */
+{
+    counter.pending_.fetch_add(1, std::memory_order_relaxed);
+    push_(Job{name, &counter, std::move(job)});
+}
+
+void JobSystem::parallelFor(const char* name, JobCounter& counter, size_t count, size_t min_items,
+                            const std::function<void(size_t, size_t)>& job)
+/** Splits range [0, count) into contiguous chunks of at least min_items items and queues job(first, last) for every
+chunk. There are at most CHUNKS_PER_THREAD chunks per thread, so a thread that finishes early steals the rest. */
+{
+    if (count == 0)
+    {
+        return;
+    }
+    size_t chunks_count = std::max<size_t>(1, count / std::max<size_t>(1, min_items));
+    chunks_count = std::min<size_t>(chunks_count, static_cast<size_t>(threadCount()) * CHUNKS_PER_THREAD);
+    size_t chunk = (count + chunks_count - 1) / chunks_count;
+    for (size_t first = 0; first < count; first += chunk)
+    {
+        size_t last = std::min(count, first + chunk);
+        run(name, counter, [job, first, last]() {job(first, last);});
+    }
+}
+
+void JobSystem::wait(JobCounter& counter)
+/** Runs queued jobs (own ones first, then stolen ones) until all jobs of the counter are finished. */
+{
+    unsigned int thread = currentThread_();
+    while (!counter.done())
+    {
+        Job job;
+        if (popOrSteal_(thread, job))
+        {
+            execute_(thread, job);
+        }
+        else
+        {
+            // the remaining jobs of the counter are running on other threads
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::beginFrame()
+/** Moves the timings of the jobs since the previous call into getTimings(), sorted by thread and start, and starts
+the clock of a new frame. No job may be running. */
+{
+    timings_.clear();
+    for (auto& queue : queues_)
+    {
+        timings_.insert(timings_.end(), queue->timings.begin(), queue->timings.end());
+        queue->timings.clear();
+    }
+    std::sort(timings_.begin(), timings_.end(), [](const JobTiming& a, const JobTiming& b) {
+        return a.thread != b.thread ? a.thread < b.thread : a.start_ms < b.start_ms;
+    });
+    frame_start_ = std::chrono::steady_clock::now();
+}
+
+unsigned int JobSystem::defaultWorkerCount()
+/** Returns one worker per hardware thread besides the render thread. */
+{
+    unsigned int hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads > 1 ? hardware_threads - 1 : 0;
+}
+
+void JobSystem::push_(Job job)
+{
+    unsigned int thread = currentThread_();
+    {
+        std::lock_guard<std::mutex> lock(queues_[thread]->mutex);
+        queues_[thread]->jobs.push_back(std::move(job));
+    }
+    queued_jobs_.fetch_add(1, std::memory_order_release);
+    // the sleeping workers check the number of queued jobs under the mutex, so they cannot miss the notification
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    wake_.notify_one();
+}
+
+bool JobSystem::popOrSteal_(unsigned int thread, Job& job)
+/** Takes the newest job of the own queue or the oldest job of another queue. */
+{
+    {
+        ThreadQueue& queue = *queues_[thread];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty())
+        {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            queued_jobs_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues_.size(); i++)
+    {
+        ThreadQueue& victim = *queues_[(thread + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty())
+        {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            queued_jobs_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute_(unsigned int thread, Job& job)
+/** Runs a job and records its timing before the job counts as finished, so the timings of a frame are complete once
+the render thread has waited for all of its jobs. */
+{
+    auto start = std::chrono::steady_clock::now();
+    job.work();
+    auto end = std::chrono::steady_clock::now();
+    queues_[thread]->timings.push_back(JobTiming{job.name, thread,
+                                                 std::chrono::duration<double, std::milli>(start - frame_start_).count(),
+                                                 std::chrono::duration<double, std::milli>(end - frame_start_).count()});
+    job.counter->pending_.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::workerLoop_(unsigned int thread)
+{
+    current_system = this;
+    current_thread = thread;
+    while (true)
+    {
+        Job job;
+        if (popOrSteal_(thread, job))
+        {
+            execute_(thread, job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wake_.wait(lock, [this]() {return stopping_ || queued_jobs_.load(std::memory_order_acquire) > 0;});
+        if (stopping_ && queued_jobs_.load(std::memory_order_acquire) == 0)
+        {
+            return;
+        }
+    }
+}
+
+unsigned int JobSystem::currentThread_() const
+{
+    return current_system == this ? current_thread : 0;
+}
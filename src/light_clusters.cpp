@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <cmath>
+#include "../include/light_clusters.h"
+
+void LightClusters::update(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection,
+                           JobSystem& jobs, StreamBuffer& stream, bool assign_clusters)
+/** Assigns lights to the clusters of the view frustum (see assignSlices_) and uploads the light data, the cluster table
+and the light index list. Without assign_clusters only the light data is uploaded and all clusters are empty (deferred shading reads the lights directly). */
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (bounds_.empty() || projection != bounds_projection_)
+    {
+        buildClusterBounds_(projection);
+    }
+    std::copy(viewport, viewport + 4, viewport_);
+
+    const size_t cluster_count = static_cast<size_t>(GRID_X) * GRID_Y * GRID_Z;
+    cluster_lights_.resize(cluster_count);
+    cluster_spotlights_.resize(cluster_count);
+    light_data_.resize(lights.size());
+    light_extents_.resize(lights.size());
+
+    JobCounter lights_counter;
+    jobs.parallelFor("light data", lights_counter, lights.size(), 64, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+        {
+            light_data_[i] = LightData::fromLight(lights[i]);
+            // point lights fade out to zero at the radius in the shader, so a light outside a cluster adds nothing there
+            light_data_[i].attenuation[3] = lights[i].type == 0 ? 0.0f : lightRadius(lights[i]);
+            if (assign_clusters)
+            {
+                light_extents_[i] = lightExtent_(lights[i], view, projection);
+            }
+        }
+    });
+    float ambient[3] = {0, 0, 0};
+    for (const auto& light: lights)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            ambient[i] += light.rgb[i];
+        }
+    }
+    jobs.wait(lights_counter);
+
+    // every job fills the clusters of its own depth slices, so the lists need no locks
+    JobCounter slices_counter;
+    jobs.parallelFor("light binning", slices_counter, static_cast<size_t>(GRID_Z), 1, [&](size_t first, size_t last) {
+        assignSlices_(lights, static_cast<int>(first), static_cast<int>(last), assign_clusters);
+    });
+    jobs.wait(slices_counter);
+
+    // flatten the lists of the clusters into the cluster table and the light index list
+    cluster_table_.resize(cluster_count * 4);
+    light_indices_.clear();
+    stats_ = ClusterStats();
+    stats_.lights = lights.size();
+    stats_.clusters = cluster_count;
+    for (size_t cluster = 0; cluster < cluster_count; cluster++)
+    {
+        auto count = static_cast<GLuint>(cluster_lights_[cluster].size());
+        cluster_table_[cluster * 4] = static_cast<GLuint>(light_indices_.size());
+        cluster_table_[cluster * 4 + 1] = cluster_spotlights_[cluster];
+        cluster_table_[cluster * 4 + 2] = count - cluster_spotlights_[cluster];
+        cluster_table_[cluster * 4 + 3] = 0;
+        light_indices_.insert(light_indices_.end(), cluster_lights_[cluster].begin(), cluster_lights_[cluster].end());
+        stats_.max_cluster_lights = std::max(stats_.max_cluster_lights, cluster_lights_[cluster].size());
+    }
+    stats_.light_indices = light_indices_.size();
+
+    lights_block_.count[0] = static_cast<int>(lights.size());
+    lights_block_.count[1] = GRID_X;
+    lights_block_.count[2] = GRID_Y;
+    lights_block_.count[3] = GRID_Z;
+    for (int i = 0; i < 3; i++)
+    {
+        lights_block_.ambient[i] = std::min(ambient[i], AMBIENT_LIMIT);
+    }
+    lights_block_.cluster_scale[0] = static_cast<float>(GRID_X) / static_cast<float>(std::max(viewport_[2], 1));
+    lights_block_.cluster_scale[1] = static_cast<float>(GRID_Y) / static_cast<float>(std::max(viewport_[3], 1));
+    float log_depth_range = std::log(far_ / near_);
+    lights_block_.cluster_scale[2] = static_cast<float>(GRID_Z) / log_depth_range;
+    lights_block_.cluster_scale[3] = -static_cast<float>(GRID_Z) * std::log(near_) / log_depth_range;
+
+    light_data_buffer_.update(light_data_.data(), light_data_.size() * sizeof(LightData));
+    cluster_buffer_.update(cluster_table_.data(), cluster_table_.size() * sizeof(GLuint));
+    light_index_buffer_.update(light_indices_.data(), light_indices_.size() * sizeof(GLuint));
+    lights_range_ = stream.writeUniform(&lights_block_, sizeof(lights_block_));
+}
+
+LightClusters::LightExtent LightClusters::lightExtent_(const Light& light, const glm::mat4& view,
+                                                      const glm::mat4& projection) const
+/** Limits a light to the screen tiles and depth slices covered by the bounding box of its sphere of influence. */
+{
+    LightExtent extent{};
+    extent.radius = lightRadius(light);
+    glm::vec4 view_position = view * glm::vec4(light.light_pos, 1.0f);
+    extent.center = glm::vec3(view_position.x, view_position.y, view_position.z);
+    // depths are positive distances along the view direction
+    float min_depth = std::max(-extent.center.z - extent.radius, near_);
+    float max_depth = std::min(-extent.center.z + extent.radius, far_);
+    // screen tiles covered by the bounding box of the sphere
+    float min_ndc[2];
+    float max_ndc[2];
+    if (!projectViewBox(extent.center - glm::vec3(extent.radius), extent.center + glm::vec3(extent.radius), projection,
+                        near_, far_, min_ndc, max_ndc))
+    {
+        extent.min_z = 0;
+        extent.max_z = -1;
+        return extent;
+    }
+    auto tileOf = [](float ndc, int tiles) {
+        auto tile = static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * static_cast<float>(tiles)));
+        return std::min(std::max(tile, 0), tiles - 1);
+    };
+    extent.min_x = tileOf(min_ndc[0], GRID_X);
+    extent.max_x = tileOf(max_ndc[0], GRID_X);
+    extent.min_y = tileOf(min_ndc[1], GRID_Y);
+    extent.max_y = tileOf(max_ndc[1], GRID_Y);
+    extent.min_z = sliceOfDepth_(min_depth);
+    extent.max_z = sliceOfDepth_(max_depth);
+
+    extent.cone = light.type == 0 && glm::length(light.light_dir) > 0.0f;
+    extent.cone_direction = glm::vec3(0.0f);
+    extent.cone_cos = glm::cos(glm::radians(light.outerCutOff));
+    extent.cone_sin = glm::sin(glm::radians(light.outerCutOff));
+    if (extent.cone)
+    {
+        extent.cone_direction = glm::normalize(glm::mat3(view) * light.light_dir);
+        extent.cone = extent.cone_direction != glm::vec3(0.0f);
+    }
+    return extent;
+}
+
+void LightClusters::assignSlices_(const std::vector<Light>& lights, int first_slice, int last_slice,
+                                  bool assign_clusters)
+/** Fills the light lists of the clusters in depth slices [first_slice, last_slice) with the lights in the order of
+the vector. Spotlights are assigned first, so the lights of every cluster are sorted by type: the shader runs one loop
+over the spotlights and one over the point lights of a cluster and does not branch on the type of every light. */
+{
+    const size_t first_cluster = static_cast<size_t>(GRID_X) * GRID_Y * static_cast<size_t>(first_slice);
+    const size_t last_cluster = static_cast<size_t>(GRID_X) * GRID_Y * static_cast<size_t>(last_slice);
+    for (size_t cluster = first_cluster; cluster < last_cluster; cluster++)
+    {
+        cluster_lights_[cluster].clear();
+        cluster_spotlights_[cluster] = 0;
+    }
+    if (!assign_clusters)
+    {
+        return;
+    }
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            if ((lights[i].type == 0) == (pass == 0))
+            {
+                assignLight_(static_cast<GLuint>(i), light_extents_[i], first_slice, last_slice);
+            }
+        }
+        if (pass == 0)
+        {
+            for (size_t cluster = first_cluster; cluster < last_cluster; cluster++)
+            {
+                cluster_spotlights_[cluster] = static_cast<GLuint>(cluster_lights_[cluster].size());
+            }
+        }
+    }
+}
+
+void LightClusters::assignLight_(GLuint light_index, const LightExtent& extent, int first_slice, int last_slice)
+/** Adds a light to the lists of the clusters it reaches within depth slices [first_slice, last_slice). The clusters
+of its extent are tested exactly against their bounds (spotlights also against their cone). */
+{
+    const glm::vec3& center = extent.center;
+    float radius = extent.radius;
+    int last_z = std::min(extent.max_z, last_slice - 1);
+    for (int z = std::max(extent.min_z, first_slice); z <= last_z; z++)
+    {
+        for (int y = extent.min_y; y <= extent.max_y; y++)
+        {
+            for (int x = extent.min_x; x <= extent.max_x; x++)
+            {
+                size_t cluster = static_cast<size_t>(x) + GRID_X * (static_cast<size_t>(y) + GRID_Y * static_cast<size_t>(z));
+                const auto& bounds = bounds_[cluster];
+                glm::vec3 closest = glm::min(glm::max(center, bounds.min), bounds.max);
+                glm::vec3 offset = closest - center;
+                if (glm::dot(offset, offset) > radius * radius)
+                {
+                    continue;
+                }
+                if (extent.cone)
+                {
+                    // distance from the bounding sphere of the cluster to the cone of the spotlight
+                    glm::vec3 to_cluster = bounds.center - center;
+                    float along = glm::dot(to_cluster, extent.cone_direction);
+                    float across = std::sqrt(std::max(glm::dot(to_cluster, to_cluster) - along * along, 0.0f));
+                    float cone_distance = extent.cone_cos * across - extent.cone_sin * along;
+                    if (cone_distance > bounds.radius || along < -bounds.radius)
+                    {
+                        continue;
+                    }
+                }
+                cluster_lights_[cluster].push_back(light_index);
+            }
+        }
+    }
+}
+
+void LightClusters::bind() const
+/** Binds the range of the "Lights" block in the stream buffer and the texture buffers to the units the central object
+shader reads them from. */
+{
+    lights_range_.bindUniform(UniformBuffer::LIGHTS_BINDING);
+    light_data_buffer_.bind(LightsBlock::LIGHT_DATA_UNIT);
+    cluster_buffer_.bind(LightsBlock::CLUSTER_UNIT);
+    light_index_buffer_.bind(LightsBlock::LIGHT_INDEX_UNIT);
+}
+
+void LightClusters::release()
+/** Deletes the GL buffers, the next update creates new ones. */
+{
+    light_data_buffer_.release();
+    cluster_buffer_.release();
+    light_index_buffer_.release();
+}
+
+void LightClusters::buildClusterBounds_(const glm::mat4& projection)
+/** Computes view space bounding boxes (and bounding spheres) of all clusters. Near and far planes are recovered from
+the perspective projection matrix, depth slices split [near, far] exponentially: slice k starts at near * (far / near)^(k / GRID_Z). */
+{
+    bounds_projection_ = projection;
+    near_ = projection[3][2] / (projection[2][2] - 1.0f);
+    far_ = projection[3][2] / (projection[2][2] + 1.0f);
+    glm::mat4 inverse_projection = glm::inverse(projection);
+
+    // directions of the rays through the tile corners, scaled to depth 1
+    std::vector<glm::vec3> rays;
+    for (int y = 0; y <= GRID_Y; y++)
+    {
+        for (int x = 0; x <= GRID_X; x++)
+        {
+            glm::vec4 ndc = glm::vec4(-1.0f + 2.0f * static_cast<float>(x) / GRID_X,
+                                      -1.0f + 2.0f * static_cast<float>(y) / GRID_Y, -1.0f, 1.0f);
+            glm::vec4 point = inverse_projection * ndc;
+            rays.push_back(glm::vec3(point.x, point.y, point.z) / -point.z);
+        }
+    }
+
+    bounds_.resize(static_cast<size_t>(GRID_X) * GRID_Y * GRID_Z);
+    for (int z = 0; z < GRID_Z; z++)
+    {
+        float slice_near = near_ * std::pow(far_ / near_, static_cast<float>(z) / GRID_Z);
+        float slice_far = near_ * std::pow(far_ / near_, static_cast<float>(z + 1) / GRID_Z);
+        for (int y = 0; y < GRID_Y; y++)
+        {
+            for (int x = 0; x < GRID_X; x++)
+            {
+                auto& bounds = bounds_[x + GRID_X * (y + GRID_Y * z)];
+                bounds.min = glm::vec3(INFINITY);
+                bounds.max = glm::vec3(-INFINITY);
+                for (int corner = 0; corner < 4; corner++)
+                {
+                    const auto& ray = rays[(x + (corner & 1)) + (GRID_X + 1) * (y + (corner >> 1))];
+                    for (float depth: {slice_near, slice_far})
+                    {
+                        bounds.min = glm::min(bounds.min, ray * depth);
+                        bounds.max = glm::max(bounds.max, ray * depth);
+                    }
+                }
+                bounds.center = (bounds.min + bounds.max) * 0.5f;
+                bounds.radius = glm::length(bounds.max - bounds.center);
+            }
+        }
+    }
+}
+
+float LightClusters::lightRadius(const Light& light) const
+/** Returns the distance at which the light stops contributing visibly: the attenuation of point lights falls below
+1/256 of the brightest color channel. Spotlights are not attenuated with distance in the shader, so they reach the far plane. */
+{
+    if (light.type == 0)
+    {
+        return far_;
+    }
+    float brightness = std::max(std::max(light.rgb[0], light.rgb[1]), light.rgb[2]);
+    // solve 1 + linear * d + quadratic * d^2 = 256 * brightness
+    float threshold = 256.0f * brightness - 1.0f;
+    if (threshold <= 0.0f)
+    {
+        return 0.0f;
+    }
+    float radius = far_;
+    if (light.quadratic > 0.0f)
+    {
+        radius = (-light.linear + std::sqrt(light.linear * light.linear + 4.0f * light.quadratic * threshold)) /
+                 (2.0f * light.quadratic);
+    }
+    else if (light.linear > 0.0f)
+    {
+        radius = threshold / light.linear;
+    }
+    return std::min(radius, far_);
+}
+
+bool LightClusters::projectViewBox(const glm::vec3& box_min, const glm::vec3& box_max, const glm::mat4& projection,
+                                   float near, float far, float min_ndc[2], float max_ndc[2])
+/** Computes the rectangle in normalized device coordinates that a view space box covers on the screen, the part of
+the box in front of the near plane and behind the far plane is clipped away (so every corner projects correctly).
+Returns false if no part of the box is in the view. */
+{
+    float min_depth = std::max(-box_max.z, near);
+    float max_depth = std::min(-box_min.z, far);
+    if (min_depth > max_depth)
+    {
+        return false;
+    }
+    min_ndc[0] = min_ndc[1] = INFINITY;
+    max_ndc[0] = max_ndc[1] = -INFINITY;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec4 point = glm::vec4((corner & 1) ? box_max.x : box_min.x, (corner & 2) ? box_max.y : box_min.y,
+                                    (corner & 4) ? -min_depth : -max_depth, 1.0f);
+        glm::vec4 clip = projection * point;
+        for (int axis = 0; axis < 2; axis++)
+        {
+            min_ndc[axis] = std::min(min_ndc[axis], clip[axis] / clip.w);
+            max_ndc[axis] = std::max(max_ndc[axis], clip[axis] / clip.w);
+        }
+    }
+    return max_ndc[0] >= -1.0f && min_ndc[0] <= 1.0f && max_ndc[1] >= -1.0f && min_ndc[1] <= 1.0f;
+}
+
+int LightClusters::sliceOfDepth_(float depth) const
+/** Returns the depth slice that contains a positive view space depth, the same mapping as in shader_central.frag. */
+{
+    auto slice = static_cast<int>(std::floor(std::log(depth / near_) / std::log(far_ / near_) * GRID_Z));
+    return std::min(std::max(slice, 0), GRID_Z - 1);
+}
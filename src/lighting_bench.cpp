@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "../include/headless_context.h"
+#include "../include/session.h"
+#include "../include/camera.h"
+
+// Benchmark that renders scripted scenes without a window (see HeadlessContext) and reports frame times as JSON:
+//     lighting_bench [--frames N] [--warmup N] [--scene name filter] [--renderer forward|deferred] [--shadows on|off]
+//                    [--output file]
+// Scenes vary the number of lights, the size of the central mesh (generated UV spheres) and the resolution, every
+// scene is drawn with the selected renderer (clustered forward shading by default) and with shadow maps unless they
+// are turned off. Lights do not move, so shadow maps are rendered in the first warmup frame and reused afterwards.
+// CPU time is the time to submit a frame (Session::update and Session::drawSession), GPU time is measured with
+// a GL_TIME_ELAPSED query and frame time is the time until the frame is finished (glFinish). Software rasterizers
+// such as llvmpipe defer the work past the query, so there the frame time is the one to compare.
+
+
+namespace {
+    struct SceneMesh {
+        std::string name;
+        int segments;
+    };
+
+    struct Resolution {
+        int width;
+        int height;
+    };
+
+    struct FrameTimes {
+        double mean{0};
+        double p50{0};
+        double p95{0};
+        double p99{0};
+    };
+
+    const int SCENE_LIGHTS[] = {1, 2, 4, 64, 512};
+    const SceneMesh SCENE_MESHES[] = {{"sphere_8k", 64}, {"sphere_130k", 256}, {"sphere_2m", 1024}};
+    const Resolution SCENE_RESOLUTIONS[] = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+}
+
+static void printUsage()
+{
+    std::cout << "Usage: lighting_bench [--frames N] [--warmup N] [--scene name filter] [--renderer forward|deferred] "
+                 "[--shadows on|off] [--output file]" << std::endl;
+}
+
+static MeshData makeSphere(int segments)
+/** Generates a UV sphere of radius 1 with segments x segments quads (2 * segments * (segments - 1) triangles). */
+{
+    MeshData mesh;
+    const float pi = 3.14159265358979f;
+    for (int ring = 0; ring <= segments; ring++)
+    {
+        float theta = pi * static_cast<float>(ring) / static_cast<float>(segments);
+        for (int segment = 0; segment <= segments; segment++)
+        {
+            float phi = 2.0f * pi * static_cast<float>(segment) / static_cast<float>(segments);
+            float normal[3] = {std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+            mesh.vertices.insert(mesh.vertices.end(), normal, normal + 3);
+            mesh.normals.insert(mesh.normals.end(), normal, normal + 3);
+        }
+    }
+    auto row = static_cast<unsigned int>(segments + 1);
+    for (unsigned int ring = 0; ring < static_cast<unsigned int>(segments); ring++)
+    {
+        for (unsigned int segment = 0; segment < static_cast<unsigned int>(segments); segment++)
+        {
+            unsigned int a = ring * row + segment;
+            unsigned int b = a + row;
+            // the triangles touching the poles are degenerate in a UV sphere
+            if (ring != 0)
+            {
+                mesh.indices.insert(mesh.indices.end(), {a, a + 1, b});
+            }
+            if (ring + 1 != static_cast<unsigned int>(segments))
+            {
+                mesh.indices.insert(mesh.indices.end(), {a + 1, b + 1, b});
+            }
+        }
+    }
+    mesh.computeBounds();
+    return mesh;
+}
+
+static FrameTimes summarize(std::vector<double> times)
+/** Returns the mean and the 50th, 95th and 99th percentiles (nearest rank) of frame times. */
+{
+    FrameTimes summary;
+    if (times.empty())
+    {
+        return summary;
+    }
+    std::sort(times.begin(), times.end());
+    auto percentile = [&](double p) {
+        auto rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(times.size())));
+        return times[std::max<size_t>(rank, 1) - 1];
+    };
+    for (double time : times)
+    {
+        summary.mean += time;
+    }
+    summary.mean /= static_cast<double>(times.size());
+    summary.p50 = percentile(50);
+    summary.p95 = percentile(95);
+    summary.p99 = percentile(99);
+    return summary;
+}
+
+static void writeFrameTimes(std::ostream& out, const char* name, const FrameTimes& times)
+{
+    out << "\"" << name << "\": {\"mean\": " << times.mean << ", \"p50\": " << times.p50 << ", \"p95\": " << times.p95
+        << ", \"p99\": " << times.p99 << "}";
+}
+
+static void placeLights(Session& session, int light_count)
+/** Adds Light objects on a circle above the central object, spotlights and point lights alternate. Scenes with many
+lights use the random local point lights of Session::addLightObjects instead, the same ones as in the menu. */
+{
+    if (light_count > 4)
+    {
+        session.addLightObjects(light_count);
+        return;
+    }
+    const float pi = 3.14159265358979f;
+    for (int i = 0; i < light_count; i++)
+    {
+        session.addLightObject();
+        auto& light_object = session.getFlashLightObjects().back();
+        float angle = 2.0f * pi * static_cast<float>(i) / static_cast<float>(light_count);
+        float* xyz = light_object.getObjectCoordinates();
+        xyz[0] = 4.0f * std::cos(angle);
+        xyz[1] = 3.0f;
+        xyz[2] = 4.0f * std::sin(angle);
+        light_object.lightObjectType() = i % 2;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int frames = 300;
+    int warmup = 30;
+    std::string scene_filter;
+    std::string output_path;
+    RenderMode render_mode = RenderMode::Forward;
+    bool shadows = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frames = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+        {
+            warmup = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+        {
+            scene_filter = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--renderer") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "forward") == 0)
+        {
+            render_mode = RenderMode::Forward;
+            i++;
+        }
+        else if (std::strcmp(argv[i], "--renderer") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "deferred") == 0)
+        {
+            render_mode = RenderMode::Deferred;
+            i++;
+        }
+        else if (std::strcmp(argv[i], "--shadows") == 0 && i + 1 < argc &&
+                 (std::strcmp(argv[i + 1], "on") == 0 || std::strcmp(argv[i + 1], "off") == 0))
+        {
+            shadows = std::strcmp(argv[++i], "on") == 0;
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            output_path = argv[++i];
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+    if (frames < 1 || warmup < 0)
+    {
+        printUsage();
+        return 1;
+    }
+
+    HeadlessContext context;
+    try
+    {
+        context.create(SCENE_RESOLUTIONS[0].width, SCENE_RESOLUTIONS[0].height);
+    }
+    catch (const std::string& error)
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    GLuint query;
+    glGenQueries(1, &query);
+
+    std::ofstream output_file;
+    if (!output_path.empty())
+    {
+        output_file.open(output_path);
+        if (!output_file.is_open())
+        {
+            std::cerr << "Unable to open file: " << output_path << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = output_path.empty() ? std::cout : output_file;
+    out << "{\n  \"renderer\": \"" << context.rendererName() << "\",\n  \"frames\": " << frames
+        << ",\n  \"warmup\": " << warmup << ",\n  \"renderer_mode\": \""
+        << (render_mode == RenderMode::Deferred ? "deferred" : "forward") << "\",\n  \"shadows\": "
+        << (shadows ? "true" : "false") << ",\n  \"scenes\": [";
+
+    bool first_scene = true;
+    for (const auto& scene_mesh : SCENE_MESHES)
+    {
+        MeshData sphere = makeSphere(scene_mesh.segments);
+        for (const auto& resolution : SCENE_RESOLUTIONS)
+        {
+            for (int light_count : SCENE_LIGHTS)
+            {
+                std::string name = scene_mesh.name + "_" + std::to_string(resolution.width) + "x" +
+                                   std::to_string(resolution.height) + "_lights" + std::to_string(light_count);
+                if (!scene_filter.empty() && name.find(scene_filter) == std::string::npos)
+                {
+                    continue;
+                }
+                context.resizeFramebuffer(resolution.width, resolution.height);
+
+                Session session;
+                session.renderMode() = render_mode;
+                session.shadows() = shadows;
+                session.loadCentralMesh(sphere);
+                session.loadLightGizmos();
+                placeLights(session, light_count);
+                size_t triangles = session.getCentralObject().getTriangleCount();
+
+                DomeCamera camera = DomeCamera(glm::vec3(0.0f, 1.0f, 10.0), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+                auto projection = camera.getProjectionMatrix(static_cast<float>(resolution.width), static_cast<float>(resolution.height));
+
+                std::vector<double> cpu_times;
+                std::vector<double> gpu_times;
+                std::vector<double> frame_times;
+                for (int frame = 0; frame < warmup + frames; frame++)
+                {
+                    // the camera orbits the central object once per measured run
+                    camera.rotate(2.0f * 3.14159265f / static_cast<float>(frames));
+                    auto view = camera.getViewMatrix();
+
+                    context.bindFramebuffer();
+                    glEnable(GL_DEPTH_TEST);
+                    glDepthFunc(GL_LEQUAL);
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                    glBeginQuery(GL_TIME_ELAPSED, query);
+                    auto start = std::chrono::steady_clock::now();
+                    session.update();
+                    session.drawSession(view, projection, camera.cameraPosition());
+                    auto submitted = std::chrono::steady_clock::now();
+                    glEndQuery(GL_TIME_ELAPSED);
+                    glFinish();
+                    auto finished = std::chrono::steady_clock::now();
+
+                    GLuint64 gpu_elapsed = 0;
+                    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpu_elapsed);
+                    if (frame >= warmup)
+                    {
+                        cpu_times.push_back(std::chrono::duration<double, std::milli>(submitted - start).count());
+                        gpu_times.push_back(static_cast<double>(gpu_elapsed) * 1e-6);
+                        frame_times.push_back(std::chrono::duration<double, std::milli>(finished - start).count());
+                    }
+                }
+
+                out << (first_scene ? "\n" : ",\n") << "    {\"name\": \"" << name << "\", \"lights\": " << light_count
+                    << ", \"triangles\": " << triangles << ", \"width\": " << resolution.width << ", \"height\": "
+                    << resolution.height << ",\n     ";
+                writeFrameTimes(out, "cpu_ms", summarize(cpu_times));
+                out << ",\n     ";
+                writeFrameTimes(out, "gpu_ms", summarize(gpu_times));
+                out << ",\n     ";
+                writeFrameTimes(out, "frame_ms", summarize(frame_times));
+                out << "}";
+                out.flush();
+                first_scene = false;
+
+                session.releaseGL();
+            }
+        }
+    }
+    out << "\n  ]\n}" << std::endl;
+
+    glDeleteQueries(1, &query);
+    return 0;
+}
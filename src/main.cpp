@@ -10,6 +10,7 @@
 #include "../include/session.h"
 #include "../include/drawing_lib.h"
 #include "../include/gui.h"
+#include "../include/frame_scheduler.h"
 
 
 
@@ -21,9 +22,10 @@ int main() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    Session session = Session();
+    Session session;
     DrawingLib drawingLib = DrawingLib(session);
-    Gui gui = Gui(session);
+    FrameScheduler frameScheduler;
+    Gui gui = Gui(session, frameScheduler);
 
 
     GLFWwindow* window = drawingLib.createWindow();
@@ -41,6 +43,7 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    StreamBuffer::loadBufferStorage((GLADloadproc)glfwGetProcAddress);
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGui_ImplGlfw_InitForOpenGL(window, true);
@@ -51,22 +54,37 @@ int main() {
 
     session.loadCentralObject();
     session.loadCoordinateSystem();
+    session.loadLightGizmos();
     session.addLightObject();
 
     while (!glfwWindowShouldClose(window))
     {
+        // blocks while the scene is clean, a frame is drawn only after a change or while something is animated
+        frameScheduler.waitEvents();
+        session.update();
+        bool changed = drawingLib.takeChanged();
+        changed = session.takeChanged() || changed;
+        // the text cursor of an active ImGui input field blinks
+        bool animating = session.animating() || ImGui::GetIO().WantTextInput;
+        if (!frameScheduler.beginFrame(changed, animating))
+        {
+            continue;
+        }
+
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
         gui.drawMainMenu();
         gui.drawObjectsPanels();
+        gui.drawStatsOverlay();
 
         // Check if ImGui wants to capture the mouse
         bool ioWantCaptureMouse = ImGui::GetIO().WantCaptureMouse;
 
         drawingLib.getWindowSize(window);
         drawingLib.drawScene(window, ioWantCaptureMouse);
+        frameScheduler.endFrame();
     }
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
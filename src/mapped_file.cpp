@@ -0,0 +1,47 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/mapped_file.h"
+
+
+MappedFile::MappedFile(const std::string& filepath)
+/** Opens the file and maps its whole content into memory for reading. Throws a string with an error message
+if the file cannot be opened or mapped. Empty files produce an empty mapping. */
+{
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::string("MappedFile: unable to open file: " + filepath);
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+        throw std::string("MappedFile: unable to read file size: " + filepath);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+
+    if (size_ > 0)
+    {
+        void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(fd);
+            throw std::string("MappedFile: unable to map file: " + filepath);
+        }
+        // the whole file is read front to back by the loaders
+        madvise(mapping, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(mapping);
+    }
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr)
+    {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
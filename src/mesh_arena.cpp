@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <iterator>
+#include "../include/mesh_arena.h"
+
+bool RangeAllocator::allocate(size_t size, size_t alignment, size_t& offset)
+/** Takes the first free range that fits size units at an offset aligned to alignment, the rest of the free range
+stays free. Returns false if no free range is large enough (the buffer has to grow then). */
+{
+    if (size == 0)
+    {
+        offset = 0;
+        return true;
+    }
+    for (auto range = free_ranges_.begin(); range != free_ranges_.end(); ++range)
+    {
+        size_t range_start = range->first;
+        size_t range_end   = range->first + range->second;
+        size_t start = (range_start + alignment - 1) / alignment * alignment;
+        if (start + size > range_end)
+        {
+            continue;
+        }
+        free_ranges_.erase(range);
+        if (start > range_start)
+        {
+            free_ranges_[range_start] = start - range_start;
+        }
+        if (start + size < range_end)
+        {
+            free_ranges_[start + size] = range_end - start - size;
+        }
+        used_ += size;
+        offset = start;
+        return true;
+    }
+    return false;
+}
+
+void RangeAllocator::free(size_t offset, size_t size)
+/** Returns a range taken by 'allocate' to the free list and merges it with the free ranges right before and after it. */
+{
+    if (size == 0)
+    {
+        return;
+    }
+    used_ -= size;
+    auto next = free_ranges_.lower_bound(offset);
+    if (next != free_ranges_.end() && offset + size == next->first)
+    {
+        size += next->second;
+        next = free_ranges_.erase(next);
+    }
+    if (next != free_ranges_.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset)
+        {
+            previous->second += size;
+            return;
+        }
+    }
+    free_ranges_[offset] = size;
+}
+
+void RangeAllocator::grow(size_t capacity)
+/** Adds the units between the old and the new capacity to the free list. */
+{
+    if (capacity <= capacity_)
+    {
+        return;
+    }
+    size_t added = capacity - capacity_;
+    size_t old_capacity = capacity_;
+    capacity_ = capacity;
+    // the new end is a free range that is merged with a free end of the old capacity
+    used_ += added;
+    free(old_capacity, added);
+}
+
+MeshArena& MeshArena::shared()
+/** Returns the arena of all Objects. It is created on first use and its GL objects live as long as the OpenGL context
+(they are created by the thread that owns it). */
+{
+    static MeshArena arena;
+    return arena;
+}
+
+ArenaMesh MeshArena::allocate(const PackedMesh& packed)
+/** Reserves ranges for the vertices and indices of a packed mesh in the pool of its vertex layout without copying any
+data, see writeVertices and writeIndices. A pool that is too small grows. */
+{
+    int pool_index = findPool_(packed);
+    Pool& pool = pools_[pool_index];
+
+    ArenaMesh mesh;
+    mesh.pool = pool_index;
+    mesh.vertex_count = packed.vertex_bytes / pool.layout.stride;
+    mesh.index_bytes  = packed.index_bytes;
+
+    while (!pool.vertices.allocate(mesh.vertex_count, 1, mesh.first_vertex))
+    {
+        size_t capacity = std::max(pool.vertices.capacity() * 2, pool.vertices.capacity() + mesh.vertex_count);
+        growBuffer_(pool.vertex_buffer, pool.vertices.capacity() * pool.layout.stride, capacity * pool.layout.stride);
+        pool.vertices.grow(capacity);
+        setupVertexArray_(pool);
+        resizes_++;
+    }
+    while (!pool.indices.allocate(mesh.index_bytes, INDEX_ALIGNMENT, mesh.index_offset))
+    {
+        size_t capacity = std::max(pool.indices.capacity() * 2, pool.indices.capacity() + mesh.index_bytes + INDEX_ALIGNMENT);
+        growBuffer_(pool.index_buffer, pool.indices.capacity(), capacity);
+        pool.indices.grow(capacity);
+        setupVertexArray_(pool);
+        resizes_++;
+    }
+    pool.meshes++;
+    return mesh;
+}
+
+void MeshArena::free(ArenaMesh& mesh)
+/** Returns the ranges of a mesh to the free lists of its pool, the mesh must not be drawn afterwards. The storage of
+the pool is kept for the next meshes. */
+{
+    if (!mesh.allocated())
+    {
+        return;
+    }
+    Pool& pool = pools_[mesh.pool];
+    pool.vertices.free(mesh.first_vertex, mesh.vertex_count);
+    pool.indices.free(mesh.index_offset, mesh.index_bytes);
+    pool.meshes--;
+    mesh = ArenaMesh();
+}
+
+void MeshArena::writeVertices(const ArenaMesh& mesh, size_t offset, size_t size, const void* data)
+/** Copies packed vertex data to the range of a mesh, the offset is in bytes from the first vertex of the mesh. */
+{
+    const Pool& pool = pools_[mesh.pool];
+    write_(pool.vertex_buffer, mesh.first_vertex * pool.layout.stride + offset, size, data);
+}
+
+void MeshArena::writeIndices(const ArenaMesh& mesh, size_t offset, size_t size, const void* data)
+/** Copies packed indices to the range of a mesh, the offset is in bytes from the first index of the mesh. Indices
+are relative to the first vertex of the mesh, draws add it as the base vertex. */
+{
+    write_(pools_[mesh.pool].index_buffer, mesh.index_offset + offset, size, data);
+}
+
+GLuint MeshArena::vao(const ArenaMesh& mesh) const
+/** Returns the VAO of the pool of a mesh, the same for all meshes of the pool. */
+{
+    return mesh.allocated() ? pools_[mesh.pool].vao : 0;
+}
+
+MeshArenaStats MeshArena::getStats() const
+{
+    MeshArenaStats stats;
+    stats.pools = pools_.size();
+    stats.resizes = resizes_;
+    for (const auto& pool : pools_)
+    {
+        stats.meshes += pool.meshes;
+        stats.used_bytes += pool.vertices.used() * pool.layout.stride + pool.indices.used();
+        stats.capacity_bytes += pool.vertices.capacity() * pool.layout.stride + pool.indices.capacity();
+        stats.free_ranges += pool.vertices.freeRangeCount() + pool.indices.freeRangeCount();
+    }
+    return stats;
+}
+
+void MeshArena::setupInstanceAttributes(GLuint buffer, GLintptr offset)
+/** Defines vertex attributes 2-5 (model matrix, one column per attribute) and 6 (color) of the bound VAO for instances
+that start at an offset of a buffer (the instance buffer of an Object or the stream buffer). The divisor 1 advances
+these attributes once per instance instead of once per vertex. */
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    auto stride = static_cast<GLsizei>(sizeof(InstanceData));
+    auto base = static_cast<uintptr_t>(offset);
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<const void*>(base + offsetof(InstanceData, model) + sizeof(glm::vec4) * column));
+        glEnableVertexAttribArray(2 + column);
+        glVertexAttribDivisor(2 + column, 1);
+    }
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(base + offsetof(InstanceData, color)));
+    glEnableVertexAttribArray(6);
+    glVertexAttribDivisor(6, 1);
+}
+
+int MeshArena::findPool_(const PackedMesh& packed)
+/** Returns the pool of the vertex layout of a mesh, a new pool is created for a layout that has none yet. */
+{
+    for (size_t i = 0; i < pools_.size(); i++)
+    {
+        if (pools_[i].layout.format == packed.format && pools_[i].layout.stride == packed.stride)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    Pool pool;
+    pool.layout.format = packed.format;
+    pool.layout.stride = packed.stride;
+    pool.layout.normal_offset = packed.normal_offset;
+    glGenVertexArrays(1, &pool.vao);
+    growBuffer_(pool.vertex_buffer, 0, INITIAL_POOL_VERTICES * pool.layout.stride);
+    growBuffer_(pool.index_buffer, 0, INITIAL_POOL_INDEX_BYTES);
+    pool.vertices.grow(INITIAL_POOL_VERTICES);
+    pool.indices.grow(INITIAL_POOL_INDEX_BYTES);
+    setupVertexArray_(pool);
+    pools_.push_back(std::move(pool));
+    return static_cast<int>(pools_.size() - 1);
+}
+
+void MeshArena::growBuffer_(GLuint& buffer, size_t old_bytes, size_t new_bytes)
+/** Replaces a buffer with a larger one and copies the old content to its start on the GPU. The copy targets are used,
+so neither the bound VAO nor the vertex buffer binding changes. */
+{
+    GLuint grown = 0;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(new_bytes), nullptr, GL_STATIC_DRAW);
+    if (buffer != 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(old_bytes));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        // draws that still read the old buffer keep it alive until they are finished
+        glDeleteBuffers(1, &buffer);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    buffer = grown;
+}
+
+void MeshArena::setupVertexArray_(const Pool& pool)
+/** Points the vertex attributes 0 (position) and 1 (normal) and the element buffer of the VAO of a pool at its current
+buffers. */
+{
+    glBindVertexArray(pool.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, pool.vertex_buffer);
+    VertexPacker::setupAttributes(pool.layout);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.index_buffer);
+    glBindVertexArray(0);
+}
+
+void MeshArena::write_(GLuint buffer, size_t offset, size_t size, const void* data)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
@@ -0,0 +1,92 @@
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include "../include/mesh_assets.h"
+
+std::map<std::string, std::weak_ptr<MeshAsset>> MeshAssets::assets_;
+size_t MeshAssets::loads_ = 0;
+size_t MeshAssets::reuses_ = 0;
+
+std::shared_ptr<MeshAsset> MeshAssets::find(const std::string& obj_filepath, const MeshLoadOptions& options)
+/** Returns the asset of a file loaded with the same options that is still used by an Object, otherwise nullptr. */
+{
+    std::string key = key_(obj_filepath, options);
+    if (key.empty())
+    {
+        return nullptr;
+    }
+    auto found = assets_.find(key);
+    if (found == assets_.end())
+    {
+        return nullptr;
+    }
+    std::shared_ptr<MeshAsset> asset = found->second.lock();
+    if (!asset)
+    {
+        assets_.erase(found);
+        return nullptr;
+    }
+    reuses_++;
+    return asset;
+}
+
+void MeshAssets::add(const std::string& obj_filepath, const MeshLoadOptions& options, const std::shared_ptr<MeshAsset>& asset)
+/** Registers the asset of a newly loaded file, the next loads of the file with the same options share it. */
+{
+    std::string key = key_(obj_filepath, options);
+    if (key.empty() || !asset)
+    {
+        return;
+    }
+    removeExpired_();
+    assets_[key] = asset;
+    loads_++;
+}
+
+MeshAssetStats MeshAssets::getStats()
+{
+    MeshAssetStats stats;
+    stats.loads = loads_;
+    stats.reuses = reuses_;
+    for (const auto& entry : assets_)
+    {
+        long references = entry.second.use_count();
+        if (references > 0)
+        {
+            stats.assets++;
+            stats.references += static_cast<size_t>(references);
+        }
+    }
+    return stats;
+}
+
+std::string MeshAssets::key_(const std::string& obj_filepath, const MeshLoadOptions& options)
+/** Returns the canonical path of the file followed by the options that change the mesh or its vertex layout, or an
+empty key if the file does not exist. */
+{
+    char resolved_path[PATH_MAX];
+    if (obj_filepath.empty() || realpath(obj_filepath.c_str(), resolved_path) == nullptr)
+    {
+        return std::string();
+    }
+    char options_key[96];
+    std::snprintf(options_key, sizeof(options_key), "\n%d %d %.9g %u %d %d", static_cast<int>(options.weighting),
+                  options.optimize ? 1 : 0, options.weld_epsilon, options.lod_levels,
+                  static_cast<int>(options.vertex_format.position), static_cast<int>(options.vertex_format.normal));
+    return std::string(resolved_path) + options_key;
+}
+
+void MeshAssets::removeExpired_()
+{
+    for (auto entry = assets_.begin(); entry != assets_.end();)
+    {
+        if (entry->second.expired())
+        {
+            entry = assets_.erase(entry);
+        }
+        else
+        {
+            ++entry;
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#include <dirent.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../include/mesh_cache.h"
+
+// Command line tool that pre-bakes every .obj file of a directory into the binary mesh cache:
+//     mesh_bake <obj directory> [cache directory] [--normals uniform|area|angle] [--optimize [weld epsilon]] [--lods levels]
+
+
+static bool hasObjExtension(const std::string& filename)
+{
+    return filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".obj") == 0;
+}
+
+static void printUsage()
+{
+    std::cout << "Usage: mesh_bake <obj directory> [cache directory] [--normals uniform|area|angle] [--optimize [weld epsilon]] [--lods levels]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> positional;
+    MeshLoadOptions options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--normals") == 0 && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (value == "uniform") options.weighting = NormalWeighting::Uniform;
+            else if (value == "area") options.weighting = NormalWeighting::Area;
+            else if (value == "angle") options.weighting = NormalWeighting::Angle;
+            else
+            {
+                printUsage();
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--lods") == 0 && i + 1 < argc)
+        {
+            int levels = std::atoi(argv[++i]);
+            if (levels < 1)
+            {
+                printUsage();
+                return 1;
+            }
+            options.lod_levels = static_cast<unsigned int>(levels);
+        }
+        else if (std::strcmp(argv[i], "--optimize") == 0)
+        {
+            options.optimize = true;
+            char* end = nullptr;
+            if (i + 1 < argc)
+            {
+                float epsilon = std::strtof(argv[i + 1], &end);
+                if (end != argv[i + 1] && *end == '\0')
+                {
+                    options.weld_epsilon = epsilon;
+                    i++;
+                }
+            }
+        }
+        else
+        {
+            positional.emplace_back(argv[i]);
+        }
+    }
+    if (positional.empty() || positional.size() > 2)
+    {
+        printUsage();
+        return 1;
+    }
+    const std::string& obj_directory = positional[0];
+    if (positional.size() == 2)
+    {
+        MeshCache::setCacheDirectory(positional[1]);
+    }
+
+    DIR* directory = opendir(obj_directory.c_str());
+    if (directory == nullptr)
+    {
+        std::cerr << "Unable to open directory: " << obj_directory << std::endl;
+        return 1;
+    }
+    std::vector<std::string> obj_files;
+    while (dirent* entry = readdir(directory))
+    {
+        if (hasObjExtension(entry->d_name))
+        {
+            obj_files.push_back(obj_directory + "/" + entry->d_name);
+        }
+    }
+    closedir(directory);
+
+    int failed = 0;
+    for (const auto& obj_file : obj_files)
+    {
+        auto start = std::chrono::steady_clock::now();
+        MeshData mesh;
+        try
+        {
+            MeshCache::loadObjMesh(obj_file, options, mesh);
+        }
+        catch (...)
+        {
+            std::cerr << "Failed: " << obj_file << std::endl;
+            failed++;
+            continue;
+        }
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << (mesh.isMapped() ? "Cached: " : "Baked:  ") << obj_file << " (" << mesh.vertexCount() << " vertices, "
+                  << mesh.lod(0).index_count / 3 << " triangles, " << elapsed << " ms)" << std::endl;
+        for (size_t level = 1; level < mesh.lodCount(); level++)
+        {
+            std::cout << "        LOD " << level << ": " << mesh.lod(level).index_count / 3 << " triangles, error "
+                      << mesh.lod(level).error << std::endl;
+        }
+        const auto& stats = mesh.optimization_stats;
+        if (stats.optimized)
+        {
+            std::cout << "        welded " << stats.welded_vertices << " vertices, ACMR " << stats.acmr_before << " -> "
+                      << stats.acmr_after << ", ATVR " << stats.atvr_before << " -> " << stats.atvr_after << std::endl;
+        }
+    }
+    std::cout << obj_files.size() - failed << " of " << obj_files.size() << " files are in cache "
+              << MeshCache::cacheDirectory() << std::endl;
+
+    return failed == 0 ? 0 : 1;
+}
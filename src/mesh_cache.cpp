@@ -0,0 +1,314 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <climits>
+#include <cstdlib>
+#include <sys/stat.h>
+#include "../include/mesh_cache.h"
+#include "../include/mesh_optimizer.h"
+#include "../include/mesh_simplifier.h"
+#include "../include/meshlet_builder.h"
+
+std::string MeshCache::cache_directory_ = "../cache";
+
+namespace {
+    const char CACHE_MAGIC[4] = {'L', 'M', 'S', 'H'};
+    const uint64_t SECTION_ALIGNMENT = 16;
+
+    uint64_t alignOffset(uint64_t offset)
+    {
+        return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+    }
+
+    bool sectionFits(uint64_t offset, uint64_t count, uint64_t element_size, uint64_t file_size)
+    {
+        return offset % SECTION_ALIGNMENT == 0 && offset <= file_size && count <= (file_size - offset) / element_size;
+    }
+}
+
+
+void MeshCache::loadObjMesh(const std::string& obj_filepath, const MeshLoadOptions& options, MeshData& mesh,
+                            LoadProgress* progress)
+/** Loads a mesh from the binary cache if there is a valid cache file for the .obj and load options, otherwise parses
+the .obj with ObjectLoader, optimizes it if requested, builds its LOD chain and meshlets, calculates its bounds and writes a new cache file.
+Failing to write the cache is not an error. */
+{
+    if (load(obj_filepath, options, mesh))
+    {
+        if (progress) progress->report(1.0f);
+        return;
+    }
+    mesh = MeshData();
+    ObjectLoader::loadObjFileData(obj_filepath, mesh.vertices, mesh.normals, mesh.indices, options.weighting, progress);
+    mesh.computeBounds();
+    MeshOptimizer::optimize(mesh, options);
+    MeshSimplifier::buildLodChain(mesh, options);
+    MeshletBuilder::buildMeshlets(mesh);
+    if (mesh.optimization_stats.optimized)
+    {
+        // meshlets reorder the triangles once more, so the final order of the full mesh is measured
+        std::vector<unsigned int> full_mesh(mesh.indices.begin(), mesh.indices.begin() + mesh.lod(0).index_count);
+        MeshOptimizer::measureVertexCache(full_mesh, mesh.vertexCount(), mesh.optimization_stats.acmr_after,
+                                          mesh.optimization_stats.atvr_after);
+    }
+
+    if (cache_directory_.empty())
+    {
+        return;
+    }
+    try
+    {
+        store(obj_filepath, options, mesh);
+    }
+    catch (const std::string& error)
+    {
+        std::cerr << "MeshCache: " << error << std::endl;
+    }
+}
+
+bool MeshCache::load(const std::string& obj_filepath, const MeshLoadOptions& options, MeshData& mesh)
+/** Memory-maps the cache file of the .obj and points mesh data to its sections without copying.
+The cache is valid when its format version, load options, source path and size match, and either the source
+modification time matches or the source content hash is unchanged (the stored time is refreshed in that case).
+Returns false if there is no valid cache file. */
+{
+    SourceKey key;
+    if (cache_directory_.empty() || !readSourceKey(obj_filepath, key))
+    {
+        return false;
+    }
+    std::string cache_path = cacheFilePath(key, options);
+
+    std::shared_ptr<MappedFile> file;
+    try
+    {
+        file = std::make_shared<MappedFile>(cache_path);
+    }
+    catch (const std::string&)
+    {
+        return false;
+    }
+    if (file->size() < sizeof(FileHeader))
+    {
+        return false;
+    }
+    FileHeader header{};
+    std::memcpy(&header, file->data(), sizeof(FileHeader));
+
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.version != FORMAT_VERSION ||
+        header.normal_weighting != static_cast<uint32_t>(options.weighting) ||
+        header.optimized != static_cast<uint32_t>(options.optimize) ||
+        (options.optimize && header.weld_epsilon != options.weld_epsilon) ||
+        header.lod_levels != options.lod_levels ||
+        header.path_hash != hashBytes(key.canonical_path.data(), key.canonical_path.size()) ||
+        header.source_size != key.size)
+    {
+        return false;
+    }
+    if (!sectionFits(header.vertices_offset, header.vertex_count * 3, sizeof(float), file->size()) ||
+        !sectionFits(header.normals_offset, header.vertex_count * 3, sizeof(float), file->size()) ||
+        !sectionFits(header.indices_offset, header.index_count, sizeof(unsigned int), file->size()) ||
+        !sectionFits(header.lods_offset, header.lod_count, sizeof(MeshLod), file->size()) ||
+        !sectionFits(header.meshlets_offset, header.meshlet_count, sizeof(Meshlet), file->size()))
+    {
+        return false;
+    }
+    if (header.source_mtime_ns != key.mtime_ns)
+    {
+        // the source was touched or rewritten with the same size: trust the cache only if the content is the same
+        if (hashFile(obj_filepath) != header.source_hash)
+        {
+            return false;
+        }
+        header.source_mtime_ns = key.mtime_ns;
+        updateHeader(cache_path, header);
+    }
+
+    mesh = MeshData();
+    mesh.mapped_file         = file;
+    mesh.mapped_vertices     = reinterpret_cast<const float*>(file->data() + header.vertices_offset);
+    mesh.mapped_normals      = reinterpret_cast<const float*>(file->data() + header.normals_offset);
+    mesh.mapped_indices      = reinterpret_cast<const unsigned int*>(file->data() + header.indices_offset);
+    mesh.mapped_vertex_count = header.vertex_count;
+    mesh.mapped_index_count  = header.index_count;
+    std::copy(header.bounds_min, header.bounds_min + 3, mesh.bounds.min);
+    std::copy(header.bounds_max, header.bounds_max + 3, mesh.bounds.max);
+
+    mesh.optimization_stats.optimized       = header.optimized != 0;
+    mesh.optimization_stats.welded_vertices = header.welded_vertices;
+    mesh.optimization_stats.acmr_before     = header.acmr_before;
+    mesh.optimization_stats.acmr_after      = header.acmr_after;
+    mesh.optimization_stats.atvr_before     = header.atvr_before;
+    mesh.optimization_stats.atvr_after      = header.atvr_after;
+
+    // LOD and meshlet tables are small and read on every frame, so they are copied instead of being referenced in the mapping
+    mesh.lods.resize(header.lod_count);
+    std::memcpy(mesh.lods.data(), file->data() + header.lods_offset, header.lod_count * sizeof(MeshLod));
+    mesh.meshlets.resize(header.meshlet_count);
+    std::memcpy(mesh.meshlets.data(), file->data() + header.meshlets_offset, header.meshlet_count * sizeof(Meshlet));
+    for (const auto& lod : mesh.lods)
+    {
+        if (static_cast<uint64_t>(lod.index_offset) + lod.index_count > header.index_count ||
+            static_cast<uint64_t>(lod.meshlet_offset) + lod.meshlet_count > header.meshlet_count)
+        {
+            return false;
+        }
+    }
+    for (const auto& meshlet : mesh.meshlets)
+    {
+        if (static_cast<uint64_t>(meshlet.index_offset) + meshlet.index_count > header.index_count)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void MeshCache::store(const std::string& obj_filepath, const MeshLoadOptions& options, const MeshData& mesh)
+/** Writes the mesh into the cache file of the .obj. The file is written under a temporary name and renamed,
+so a partially written cache file is never picked up by load. Throws a string with an error message on failure. */
+{
+    SourceKey key;
+    if (!readSourceKey(obj_filepath, key))
+    {
+        throw std::string("unable to read source file: " + obj_filepath);
+    }
+    if (mesh.normals.size() != mesh.vertices.size() && !mesh.isMapped())
+    {
+        throw std::string("mesh has no normal per vertex: " + obj_filepath);
+    }
+    mkdir(cache_directory_.c_str(), 0755);
+
+    FileHeader header{};
+    fillHeader(header, key, hashFile(obj_filepath), options, mesh);
+
+    std::string cache_path = cacheFilePath(key, options);
+    std::string temp_path  = cache_path + ".tmp";
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        throw std::string("unable to create cache file: " + temp_path);
+    }
+
+    const char padding[SECTION_ALIGNMENT] = {0};
+    auto writeSection = [&](uint64_t offset, const void* data, uint64_t size) {
+        uint64_t position = static_cast<uint64_t>(file.tellp());
+        file.write(padding, static_cast<std::streamsize>(offset - position));
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+    writeSection(header.vertices_offset, mesh.vertexData(), header.vertex_count * 3 * sizeof(float));
+    writeSection(header.normals_offset, mesh.normalData(), header.vertex_count * 3 * sizeof(float));
+    writeSection(header.indices_offset, mesh.indexData(), header.index_count * sizeof(unsigned int));
+    writeSection(header.lods_offset, mesh.lods.data(), header.lod_count * sizeof(MeshLod));
+    writeSection(header.meshlets_offset, mesh.meshlets.data(), header.meshlet_count * sizeof(Meshlet));
+    file.close();
+
+    if (!file || std::rename(temp_path.c_str(), cache_path.c_str()) != 0)
+    {
+        std::remove(temp_path.c_str());
+        throw std::string("unable to write cache file: " + cache_path);
+    }
+}
+
+void MeshCache::fillHeader(FileHeader& header, const SourceKey& key, uint64_t source_hash, const MeshLoadOptions& options, const MeshData& mesh)
+/** Fills in the cache file header: source key, load options, section layout, bounds, optimization stats, LOD and meshlet counts of the mesh. */
+{
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version          = FORMAT_VERSION;
+    header.normal_weighting = static_cast<uint32_t>(options.weighting);
+    header.optimized        = static_cast<uint32_t>(options.optimize);
+    header.weld_epsilon     = options.optimize ? options.weld_epsilon : 0.0f;
+    header.welded_vertices  = mesh.optimization_stats.welded_vertices;
+    header.acmr_before      = mesh.optimization_stats.acmr_before;
+    header.acmr_after       = mesh.optimization_stats.acmr_after;
+    header.atvr_before      = mesh.optimization_stats.atvr_before;
+    header.atvr_after       = mesh.optimization_stats.atvr_after;
+    header.lod_levels       = options.lod_levels;
+    header.lod_count        = mesh.lods.size();
+    header.meshlet_count    = mesh.meshlets.size();
+    header.path_hash        = hashBytes(key.canonical_path.data(), key.canonical_path.size());
+    header.source_size      = key.size;
+    header.source_mtime_ns  = key.mtime_ns;
+    header.source_hash      = source_hash;
+    header.vertex_count     = mesh.vertexCount();
+    header.index_count      = mesh.indexCount();
+    std::copy(mesh.bounds.min, mesh.bounds.min + 3, header.bounds_min);
+    std::copy(mesh.bounds.max, mesh.bounds.max + 3, header.bounds_max);
+
+    header.vertices_offset = alignOffset(sizeof(FileHeader));
+    header.normals_offset  = alignOffset(header.vertices_offset + header.vertex_count * 3 * sizeof(float));
+    header.indices_offset  = alignOffset(header.normals_offset + header.vertex_count * 3 * sizeof(float));
+    header.lods_offset     = alignOffset(header.indices_offset + header.index_count * sizeof(unsigned int));
+    header.meshlets_offset = alignOffset(header.lods_offset + header.lod_count * sizeof(MeshLod));
+}
+
+bool MeshCache::updateHeader(const std::string& cache_path, const FileHeader& header)
+/** Overwrites the header of an existing cache file in place. */
+{
+    std::fstream file(cache_path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+    return static_cast<bool>(file);
+}
+
+bool MeshCache::readSourceKey(const std::string& obj_filepath, SourceKey& key)
+/** Resolves the canonical path of the source file and reads its size and modification time. */
+{
+    char resolved_path[PATH_MAX];
+    struct stat file_stat{};
+    if (realpath(obj_filepath.c_str(), resolved_path) == nullptr || stat(resolved_path, &file_stat) != 0)
+    {
+        return false;
+    }
+    key.canonical_path = resolved_path;
+    key.size           = static_cast<uint64_t>(file_stat.st_size);
+    key.mtime_ns       = static_cast<int64_t>(file_stat.st_mtim.tv_sec) * 1000000000LL + file_stat.st_mtim.tv_nsec;
+
+    return true;
+}
+
+std::string MeshCache::cacheFilePath(const SourceKey& key, const MeshLoadOptions& options)
+/** Returns the path of the cache file: a hash of the canonical source path followed by the normal weighting, the
+number of levels of detail and, for optimized meshes, an 'o' with the bits of the weld epsilon. Every combination of
+options that 'readCache' tells apart has its own file, so versions of a mesh loaded with different options are cached
+side by side instead of replacing each other. */
+{
+    char optimized[16] = "";
+    if (options.optimize)
+    {
+        uint32_t epsilon_bits;
+        std::memcpy(&epsilon_bits, &options.weld_epsilon, sizeof(epsilon_bits));
+        std::snprintf(optimized, sizeof(optimized), "_o%08x", epsilon_bits);
+    }
+    char name[80];
+    std::snprintf(name, sizeof(name), "%016llx_%u_l%u%s.mesh",
+                  static_cast<unsigned long long>(hashBytes(key.canonical_path.data(), key.canonical_path.size())),
+                  static_cast<unsigned int>(options.weighting), options.lod_levels, optimized);
+
+    return cache_directory_ + "/" + name;
+}
+
+uint64_t MeshCache::hashBytes(const char* data, size_t size, uint64_t hash)
+/** 64-bit FNV-1a hash of a byte range. */
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t MeshCache::hashFile(const std::string& filepath)
+/** Hashes the whole content of a file through a read-only memory mapping. */
+{
+    MappedFile file(filepath);
+    return hashBytes(file.data(), file.size());
+}
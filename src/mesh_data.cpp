@@ -0,0 +1,17 @@
+#include "../include/mesh_data.h"
+#include "../include/geometry_kernels.h"
+
+
+void MeshData::computeBounds()
+/** Calculates the axis-aligned bounding box of all vertices, an empty mesh gets zero bounds. */
+{
+    bounds = MeshBounds();
+    size_t count = vertexCount();
+    if (count == 0)
+    {
+        return;
+    }
+    SoaVectors positions;
+    positions.assign(vertexData(), count);
+    GeometryKernels::bounds(positions, bounds.min, bounds.max);
+}
@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include "../include/mesh_optimizer.h"
+#include "../include/normal_builder.h"
+
+namespace {
+    const unsigned int NO_VERTEX = std::numeric_limits<unsigned int>::max();
+
+    uint64_t hashCell(int64_t x, int64_t y, int64_t z)
+    {
+        return static_cast<uint64_t>(x) * 73856093ULL ^ static_cast<uint64_t>(y) * 19349663ULL ^ static_cast<uint64_t>(z) * 83492791ULL;
+    }
+}
+
+
+void MeshOptimizer::optimize(MeshData& mesh, const MeshLoadOptions& options)
+/** Runs the whole optimization stage on a freshly loaded mesh if options ask for it and stores ACMR/ATVR
+before and after the optimization in mesh.optimization_stats. Meshes read from the mesh cache are already optimized. */
+{
+    if (!options.optimize || mesh.isMapped() || mesh.indices.empty())
+    {
+        return;
+    }
+    MeshOptimizationStats stats;
+    stats.optimized = true;
+    measureVertexCache(mesh.indices, mesh.vertexCount(), stats.acmr_before, stats.atvr_before);
+
+    stats.welded_vertices = static_cast<unsigned int>(weldVertices(mesh.vertices, mesh.indices, options.weld_epsilon));
+    if (stats.welded_vertices > 0)
+    {
+        // merged vertices share faces that were not adjacent before, so normals are averaged again
+        removeDegenerateTriangles(mesh.indices);
+        NormalBuilder::buildVertexNormals(mesh.vertices, mesh.indices, mesh.normals, options.weighting);
+    }
+    optimizeVertexCache(mesh.indices, mesh.vertexCount());
+    optimizeVertexFetch(mesh.vertices, mesh.normals, mesh.indices);
+    mesh.computeBounds();
+
+    measureVertexCache(mesh.indices, mesh.vertexCount(), stats.acmr_after, stats.atvr_after);
+    mesh.optimization_stats = stats;
+}
+
+size_t MeshOptimizer::weldVertices(std::vector<float>& vertices, std::vector<unsigned int>& indices, float epsilon)
+/** Merges vertices whose positions are within epsilon of an already kept vertex and remaps indices.
+Kept positions are bucketed in a hashed uniform grid with cell size epsilon, so each vertex is compared only with
+vertices of the 27 neighbouring cells. With epsilon <= 0 only bit-identical positions are merged.
+Returns the number of removed vertices. */
+{
+    size_t vertices_count = vertices.size() / 3;
+    bool exact = epsilon <= 0;
+    float epsilon_sq = epsilon * epsilon;
+
+    std::vector<float> welded;
+    welded.reserve(vertices.size());
+    std::vector<unsigned int> remap(vertices_count);
+    std::vector<unsigned int> next_in_cell;
+    next_in_cell.reserve(vertices_count);
+    std::unordered_map<uint64_t, unsigned int> cell_heads;
+    cell_heads.reserve(vertices_count);
+
+    for (size_t v = 0; v < vertices_count; v++)
+    {
+        const float* position = &vertices[v * 3];
+        int64_t cell[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (exact)
+            {
+                uint32_t bits;
+                std::memcpy(&bits, &position[axis], sizeof(bits));
+                cell[axis] = bits;
+            }
+            else
+            {
+                cell[axis] = static_cast<int64_t>(std::floor(position[axis] / epsilon));
+            }
+        }
+
+        unsigned int found = NO_VERTEX;
+        int range = exact ? 0 : 1;
+        for (int dx = -range; dx <= range && found == NO_VERTEX; dx++)
+        for (int dy = -range; dy <= range && found == NO_VERTEX; dy++)
+        for (int dz = -range; dz <= range && found == NO_VERTEX; dz++)
+        {
+            auto head = cell_heads.find(hashCell(cell[0] + dx, cell[1] + dy, cell[2] + dz));
+            for (unsigned int kept = head == cell_heads.end() ? NO_VERTEX : head->second; kept != NO_VERTEX; kept = next_in_cell[kept])
+            {
+                const float* other = &welded[kept * 3];
+                float dist_x = other[0] - position[0], dist_y = other[1] - position[1], dist_z = other[2] - position[2];
+                float dist_sq = dist_x * dist_x + dist_y * dist_y + dist_z * dist_z;
+                if ((exact && dist_sq == 0) || (!exact && dist_sq <= epsilon_sq))
+                {
+                    found = kept;
+                    break;
+                }
+            }
+        }
+
+        if (found == NO_VERTEX)
+        {
+            found = static_cast<unsigned int>(welded.size() / 3);
+            welded.insert(welded.end(), position, position + 3);
+
+            auto& head = cell_heads.emplace(hashCell(cell[0], cell[1], cell[2]), NO_VERTEX).first->second;
+            next_in_cell.push_back(head);
+            head = found;
+        }
+        remap[v] = found;
+    }
+
+    for (auto& index : indices)
+    {
+        index = remap[index];
+    }
+    size_t removed = vertices_count - welded.size() / 3;
+    vertices.swap(welded);
+
+    return removed;
+}
+
+size_t MeshOptimizer::removeDegenerateTriangles(std::vector<unsigned int>& indices)
+/** Removes triangles that reference the same vertex more than once. Returns the number of removed triangles. */
+{
+    size_t kept = 0;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a != b && b != c && a != c)
+        {
+            indices[kept++] = a;
+            indices[kept++] = b;
+            indices[kept++] = c;
+        }
+    }
+    size_t removed = (indices.size() - kept) / 3;
+    indices.resize(kept);
+
+    return removed;
+}
+
+void MeshOptimizer::buildVertexTriangles(const std::vector<unsigned int>& indices, size_t vertices_count,
+                                         std::vector<unsigned int>& offsets, std::vector<unsigned int>& triangles)
+/** CSR adjacency: triangles[offsets[v]..offsets[v+1]) are the triangles that use vertex v. */
+{
+    buildVertexTriangles(indices.data(), indices.size(), vertices_count, offsets, triangles);
+}
+
+void MeshOptimizer::buildVertexTriangles(const unsigned int* indices, size_t index_count, size_t vertices_count,
+                                         std::vector<unsigned int>& offsets, std::vector<unsigned int>& triangles)
+/** Same adjacency for a range of index_count indices, triangles are numbered from the start of the range. */
+{
+    offsets.assign(vertices_count + 1, 0);
+    for (size_t i = 0; i < index_count; i++)
+    {
+        offsets[indices[i] + 1]++;
+    }
+    for (size_t i = 0; i < vertices_count; i++)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+    triangles.resize(index_count);
+    std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < index_count; i++)
+    {
+        triangles[cursor[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertices_count, unsigned int cache_size)
+/** Reorders triangles with Tipsify: triangles are emitted as fans around a fanning vertex, and the next fanning
+vertex is picked among the vertices of the last fan that will most likely still be in the cache (or from a dead-end
+stack of recently used vertices). Runs in linear time, winding of every triangle is preserved. */
+{
+    size_t triangles_count = indices.size() / 3;
+    if (triangles_count == 0)
+    {
+        return;
+    }
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> vertex_triangles;
+    buildVertexTriangles(indices, vertices_count, offsets, vertex_triangles);
+
+    std::vector<unsigned int> live_triangles(vertices_count);
+    for (size_t v = 0; v < vertices_count; v++)
+    {
+        live_triangles[v] = offsets[v + 1] - offsets[v];
+    }
+    std::vector<unsigned int> cache_time(vertices_count, 0);
+    std::vector<char> emitted(triangles_count, 0);
+    std::vector<unsigned int> dead_ends;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    unsigned int time = cache_size + 1;
+    size_t cursor = 0;
+    int fanning = nextFanningVertex(candidates, live_triangles, cache_time, time, cache_size, dead_ends, cursor);
+
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        for (unsigned int i = offsets[fanning]; i < offsets[fanning + 1]; i++)
+        {
+            unsigned int triangle = vertex_triangles[i];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = indices[triangle * 3 + corner];
+                output.push_back(v);
+                dead_ends.push_back(v);
+                candidates.push_back(v);
+                live_triangles[v]--;
+
+                // the vertex is not in the cache anymore, so it is transformed (and cached) again
+                if (time - cache_time[v] > cache_size)
+                {
+                    cache_time[v] = time++;
+                }
+            }
+            emitted[triangle] = 1;
+        }
+        fanning = nextFanningVertex(candidates, live_triangles, cache_time, time, cache_size, dead_ends, cursor);
+    }
+    indices.swap(output);
+}
+
+int MeshOptimizer::nextFanningVertex(const std::vector<unsigned int>& candidates, const std::vector<unsigned int>& live_triangles,
+                                     const std::vector<unsigned int>& cache_time, unsigned int time, unsigned int cache_size,
+                                     std::vector<unsigned int>& dead_ends, size_t& cursor)
+/** Picks the candidate with live triangles that stays in the cache for the longest time after its fan is emitted.
+If no candidate has live triangles, takes the latest vertex from the dead-end stack, then the next vertex in
+index order that still has live triangles. Returns -1 when all triangles are emitted. */
+{
+    int best = -1;
+    int best_priority = -1;
+    for (auto v : candidates)
+    {
+        if (live_triangles[v] == 0)
+        {
+            continue;
+        }
+        int priority = 0;
+        if (time - cache_time[v] + 2 * live_triangles[v] <= cache_size)
+        {
+            priority = static_cast<int>(time - cache_time[v]);
+        }
+        if (priority > best_priority)
+        {
+            best_priority = priority;
+            best = static_cast<int>(v);
+        }
+    }
+    if (best >= 0)
+    {
+        return best;
+    }
+
+    while (!dead_ends.empty())
+    {
+        unsigned int v = dead_ends.back();
+        dead_ends.pop_back();
+        if (live_triangles[v] > 0)
+        {
+            return static_cast<int>(v);
+        }
+    }
+    while (cursor < live_triangles.size())
+    {
+        if (live_triangles[cursor] > 0)
+        {
+            return static_cast<int>(cursor);
+        }
+        cursor++;
+    }
+    return -1;
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<float>& vertices, std::vector<float>& normals, std::vector<unsigned int>& indices)
+/** Renumbers vertices in the order they are first referenced by the index buffer, so vertex fetches of consecutive
+triangles hit neighbouring memory. Vertices that are not referenced are dropped. */
+{
+    size_t vertices_count = vertices.size() / 3;
+    std::vector<unsigned int> remap(vertices_count, NO_VERTEX);
+    std::vector<float> new_vertices;
+    std::vector<float> new_normals;
+    new_vertices.reserve(vertices.size());
+    new_normals.reserve(normals.size());
+
+    for (auto& index : indices)
+    {
+        if (remap[index] == NO_VERTEX)
+        {
+            remap[index] = static_cast<unsigned int>(new_vertices.size() / 3);
+            new_vertices.insert(new_vertices.end(), &vertices[index * 3], &vertices[index * 3] + 3);
+            new_normals.insert(new_normals.end(), &normals[index * 3], &normals[index * 3] + 3);
+        }
+        index = remap[index];
+    }
+    vertices.swap(new_vertices);
+    normals.swap(new_normals);
+}
+
+void MeshOptimizer::measureVertexCache(const std::vector<unsigned int>& indices, size_t vertices_count, float& acmr, float& atvr,
+                                       unsigned int cache_size)
+/** Simulates a FIFO post-transform cache of cache_size entries and calculates ACMR (transformed vertices per triangle,
+0.5 is the ideal for a regular mesh, 3 is the worst) and ATVR (transformed vertices per referenced vertex, 1 is ideal). */
+{
+    std::vector<unsigned int> cached_at(vertices_count, NO_VERTEX);
+    std::vector<char> referenced(vertices_count, 0);
+    unsigned int transformed = 0;
+    size_t unique_vertices = 0;
+
+    for (auto index : indices)
+    {
+        if (cached_at[index] == NO_VERTEX || transformed - cached_at[index] >= cache_size)
+        {
+            cached_at[index] = transformed++;
+        }
+        if (!referenced[index])
+        {
+            referenced[index] = 1;
+            unique_vertices++;
+        }
+    }
+    size_t triangles_count = indices.size() / 3;
+    acmr = triangles_count == 0 ? 0.0f : static_cast<float>(transformed) / static_cast<float>(triangles_count);
+    atvr = unique_vertices == 0 ? 0.0f : static_cast<float>(transformed) / static_cast<float>(unique_vertices);
+}
@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include "../include/mesh_simplifier.h"
+#include "../include/mesh_optimizer.h"
+
+namespace {
+    void cross(const float* a, const float* b, const float* c, double* normal)
+    {
+        double edge1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        double edge2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        normal[0] = edge1[1] * edge2[2] - edge1[2] * edge2[1];
+        normal[1] = edge1[2] * edge2[0] - edge1[0] * edge2[2];
+        normal[2] = edge1[0] * edge2[1] - edge1[1] * edge2[0];
+    }
+}
+
+
+void MeshSimplifier::buildLodChain(MeshData& mesh, const MeshLoadOptions& options)
+/** Simplifies the full mesh into options.lod_levels levels (including the full mesh), every level targets half of the
+triangles of the previous one. Levels are appended to mesh.indices; if the mesh is optimized, the triangles of every
+level are reordered for the vertex cache as well. Meshes read from the mesh cache already have their LOD chain. */
+{
+    if (mesh.isMapped())
+    {
+        return;
+    }
+    mesh.lods.clear();
+    size_t full_count = mesh.indices.size();
+    mesh.lods.push_back({0, static_cast<unsigned int>(full_count), 0.0f});
+
+    std::vector<size_t> targets;
+    size_t target = full_count;
+    for (unsigned int level = 1; level < options.lod_levels; level++)
+    {
+        target = target / 6 * 3;
+        if (target < MIN_LOD_TRIANGLES * 3)
+        {
+            break;
+        }
+        targets.push_back(target);
+    }
+    if (targets.empty())
+    {
+        return;
+    }
+
+    std::vector<std::vector<unsigned int>> lod_indices;
+    std::vector<float> lod_errors;
+    simplify(mesh.vertices, mesh.indices, targets, lod_indices, lod_errors);
+
+    for (size_t level = 0; level < lod_indices.size(); level++)
+    {
+        auto& indices = lod_indices[level];
+        if (options.optimize)
+        {
+            MeshOptimizer::optimizeVertexCache(indices, mesh.vertexCount());
+        }
+        mesh.lods.push_back({static_cast<unsigned int>(mesh.indices.size()), static_cast<unsigned int>(indices.size()), lod_errors[level]});
+        mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
+    }
+}
+
+void MeshSimplifier::simplify(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                              const std::vector<size_t>& target_index_counts,
+                              std::vector<std::vector<unsigned int>>& lod_indices, std::vector<float>& lod_errors)
+/** Collapses edges in order of increasing quadric error until the mesh has at most target_index_counts[i] indices,
+then stores the current index buffer and the largest error so far as level i (targets are in decreasing order).
+Every pass collects collapse candidates of all edges, sorts them by error and applies the cheapest ones whose
+neighbourhoods do not overlap and that do not flip any triangle. If no collapse is possible anymore, the
+remaining levels are not generated. */
+{
+    lod_indices.clear();
+    lod_errors.clear();
+    size_t vertices_count = vertices.size() / 3;
+
+    std::vector<Quadric> quadrics;
+    buildQuadrics(vertices, indices, quadrics);
+    std::vector<char> locked;
+    findLockedVertices(indices, vertices_count, locked);
+
+    std::vector<unsigned int> current = indices;
+    std::vector<unsigned int> remap(vertices_count);
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> vertex_triangles;
+    std::vector<Collapse> collapses;
+    std::vector<char> touched;
+    float max_error = 0.0f;
+    size_t next_target = 0;
+
+    while (next_target < target_index_counts.size())
+    {
+        if (current.size() <= target_index_counts[next_target])
+        {
+            lod_indices.push_back(current);
+            lod_errors.push_back(max_error);
+            next_target++;
+            continue;
+        }
+
+        // 1. the cheapest direction of every edge that can be collapsed
+        collapses.clear();
+        for (size_t i = 0; i < current.size(); i += 3)
+        {
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int a = current[i + corner];
+                unsigned int b = current[i + (corner + 1) % 3];
+                if (a > b)
+                {
+                    // an inner edge is seen from both of its triangles, border edges are locked anyway
+                    continue;
+                }
+                float error_ab = locked[a] ? std::numeric_limits<float>::max() : collapseError(quadrics[a], quadrics[b], &vertices[b * 3]);
+                float error_ba = locked[b] ? std::numeric_limits<float>::max() : collapseError(quadrics[b], quadrics[a], &vertices[a * 3]);
+                if (error_ab == std::numeric_limits<float>::max() && error_ba == std::numeric_limits<float>::max())
+                {
+                    continue;
+                }
+                collapses.push_back(error_ab <= error_ba ? Collapse{a, b, error_ab} : Collapse{b, a, error_ba});
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) {
+            return lhs.error < rhs.error;
+        });
+
+        // 2. apply independent collapses, each removes about two triangles
+        MeshOptimizer::buildVertexTriangles(current, vertices_count, offsets, vertex_triangles);
+        touched.assign(vertices_count, 0);
+        for (size_t v = 0; v < vertices_count; v++)
+        {
+            remap[v] = static_cast<unsigned int>(v);
+        }
+        size_t triangles_to_remove = (current.size() - target_index_counts[next_target]) / 3;
+        size_t removed = 0;
+        size_t applied = 0;
+
+        for (const auto& collapse : collapses)
+        {
+            if (removed >= triangles_to_remove)
+            {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to] ||
+                flipsTriangles(vertices, current, offsets, vertex_triangles, collapse.from, collapse.to))
+            {
+                continue;
+            }
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            max_error = std::max(max_error, collapse.error);
+
+            // triangles around the removed vertex change, so no other collapse of this pass may touch them
+            for (unsigned int i = offsets[collapse.from]; i < offsets[collapse.from + 1]; i++)
+            {
+                const unsigned int* triangle = &current[vertex_triangles[i] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+            }
+            removed += 2;
+            applied++;
+        }
+        if (applied == 0)
+        {
+            break;
+        }
+
+        // 3. rewrite the index buffer and drop collapsed triangles
+        for (auto& index : current)
+        {
+            index = remap[index];
+        }
+        MeshOptimizer::removeDegenerateTriangles(current);
+    }
+}
+
+void MeshSimplifier::buildQuadrics(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                                   std::vector<Quadric>& quadrics)
+/** Every vertex gets the sum of the plane quadrics of its triangles, weighted by triangle area. */
+{
+    quadrics.assign(vertices.size() / 3, Quadric());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const float* a = &vertices[indices[i] * 3];
+        const float* b = &vertices[indices[i + 1] * 3];
+        const float* c = &vertices[indices[i + 2] * 3];
+
+        double normal[3];
+        cross(a, b, c, normal);
+        double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (length <= 0)
+        {
+            continue;
+        }
+        normal[0] /= length;
+        normal[1] /= length;
+        normal[2] /= length;
+        double distance = -(normal[0] * a[0] + normal[1] * a[1] + normal[2] * a[2]);
+        double area = length * 0.5;
+
+        for (int corner = 0; corner < 3; corner++)
+        {
+            quadrics[indices[i + corner]].addPlane(normal[0], normal[1], normal[2], distance, area);
+        }
+    }
+}
+
+void MeshSimplifier::findLockedVertices(const std::vector<unsigned int>& indices, size_t vertices_count, std::vector<char>& locked)
+/** Marks vertices of border edges (used by one triangle) and non-manifold edges (used by more than two triangles). */
+{
+    std::vector<uint64_t> edges;
+    edges.reserve(indices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        for (int corner = 0; corner < 3; corner++)
+        {
+            uint64_t a = indices[i + corner];
+            uint64_t b = indices[i + (corner + 1) % 3];
+            edges.push_back(a < b ? (a << 32 | b) : (b << 32 | a));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    locked.assign(vertices_count, 0);
+    for (size_t i = 0; i < edges.size();)
+    {
+        size_t j = i;
+        while (j < edges.size() && edges[j] == edges[i])
+        {
+            j++;
+        }
+        if (j - i != 2)
+        {
+            locked[edges[i] >> 32] = 1;
+            locked[edges[i] & 0xffffffffULL] = 1;
+        }
+        i = j;
+    }
+}
+
+float MeshSimplifier::collapseError(const Quadric& from, const Quadric& to, const float* point)
+/** Root mean square distance of the point to the planes of both quadrics. */
+{
+    Quadric sum = from;
+    sum.add(to);
+    if (sum.weight <= 0)
+    {
+        return 0.0f;
+    }
+    return static_cast<float>(std::sqrt(std::max(0.0, sum.evaluate(point)) / sum.weight));
+}
+
+bool MeshSimplifier::flipsTriangles(const std::vector<float>& vertices, const std::vector<unsigned int>& indices,
+                                    const std::vector<unsigned int>& offsets, const std::vector<unsigned int>& vertex_triangles,
+                                    unsigned int from, unsigned int to)
+/** Checks whether moving vertex 'from' onto vertex 'to' turns any of the remaining triangles around 'from' upside down. */
+{
+    for (unsigned int i = offsets[from]; i < offsets[from + 1]; i++)
+    {
+        const unsigned int* triangle = &indices[vertex_triangles[i] * 3];
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+        {
+            // this triangle is removed by the collapse
+            continue;
+        }
+        const float* before[3];
+        const float* after[3];
+        for (int corner = 0; corner < 3; corner++)
+        {
+            before[corner] = &vertices[triangle[corner] * 3];
+            after[corner]  = triangle[corner] == from ? &vertices[to * 3] : before[corner];
+        }
+        double normal_before[3];
+        double normal_after[3];
+        cross(before[0], before[1], before[2], normal_before);
+        cross(after[0], after[1], after[2], normal_after);
+
+        double dot = normal_before[0] * normal_after[0] + normal_before[1] * normal_after[1] + normal_before[2] * normal_after[2];
+        if (dot <= 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MeshSimplifier::Quadric::addPlane(double a, double b, double c, double d, double plane_weight)
+{
+    a2 += a * a * plane_weight; ab += a * b * plane_weight; ac += a * c * plane_weight; ad += a * d * plane_weight;
+    b2 += b * b * plane_weight; bc += b * c * plane_weight; bd += b * d * plane_weight;
+    c2 += c * c * plane_weight; cd += c * d * plane_weight;
+    d2 += d * d * plane_weight;
+    weight += plane_weight;
+}
+
+void MeshSimplifier::Quadric::add(const Quadric& other)
+{
+    a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+    b2 += other.b2; bc += other.bc; bd += other.bd;
+    c2 += other.c2; cd += other.cd;
+    d2 += other.d2;
+    weight += other.weight;
+}
+
+double MeshSimplifier::Quadric::evaluate(const float* point) const
+/** Weighted sum of squared distances of the point to the planes: p^T Q p for p = (x, y, z, 1). */
+{
+    double x = point[0], y = point[1], z = point[2];
+    return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+           b2 * y * y + 2 * bc * y * z + 2 * bd * y +
+           c2 * z * z + 2 * cd * z +
+           d2;
+}
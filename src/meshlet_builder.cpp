@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include "../include/meshlet_builder.h"
+#include "../include/geometry_kernels.h"
+#include "../include/mesh_optimizer.h"
+
+namespace {
+    const unsigned int NO_TRIANGLE = std::numeric_limits<unsigned int>::max();
+}
+
+
+void MeshletBuilder::buildMeshlets(MeshData& mesh)
+/** Builds meshlets for every level of detail of a freshly loaded mesh and stores them in mesh.meshlets,
+MeshLod::meshlet_offset and meshlet_count point to the meshlets of a level. Backface culling by the normal cone is
+enabled only for closed meshes: the back side of an open mesh is visible through its borders. Meshes read from the mesh
+cache already have their meshlets. */
+{
+    if (mesh.isMapped() || mesh.indices.empty())
+    {
+        return;
+    }
+    if (mesh.lods.empty())
+    {
+        mesh.lods.push_back({0, static_cast<unsigned int>(mesh.indices.size()), 0.0f});
+    }
+    mesh.meshlets.clear();
+    bool cone_culling = isClosed(mesh.indices.data(), mesh.lods[0].index_count);
+
+    std::vector<unsigned int> meshlet_index_counts;
+    for (auto& lod : mesh.lods)
+    {
+        partition(mesh.vertices, mesh.indices.data() + lod.index_offset, lod.index_count, meshlet_index_counts);
+
+        lod.meshlet_offset = static_cast<unsigned int>(mesh.meshlets.size());
+        lod.meshlet_count  = static_cast<unsigned int>(meshlet_index_counts.size());
+        unsigned int offset = lod.index_offset;
+        for (auto count : meshlet_index_counts)
+        {
+            mesh.meshlets.push_back(computeBounds(mesh.vertices, mesh.indices.data(), offset, count, cone_culling));
+            offset += count;
+        }
+    }
+}
+
+void MeshletBuilder::partition(const std::vector<float>& vertices, unsigned int* indices, size_t index_count,
+                               std::vector<unsigned int>& meshlet_index_counts)
+/** Reorders the triangles of an index range into meshlets of at most MAX_VERTICES vertices and MAX_TRIANGLES triangles
+and returns the number of indices of every meshlet. The next triangle of a meshlet is chosen among the unused triangles
+around the vertices of the last added triangle (or, if there are none, around all vertices of the meshlet) as the one that
+adds the fewest new vertices, ties are broken by the distance to the centroid of the meshlet to keep meshlets compact.
+A meshlet is closed when it is full or has no unused neighbouring triangle left. Finally the triangles inside every meshlet
+are reordered for the vertex cache. */
+{
+    meshlet_index_counts.clear();
+    size_t vertices_count  = vertices.size() / 3;
+    size_t triangles_count = index_count / 3;
+    if (triangles_count == 0)
+    {
+        return;
+    }
+
+    // vertex -> triangles adjacency of the range
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> vertex_triangles;
+    MeshOptimizer::buildVertexTriangles(indices, index_count, vertices_count, offsets, vertex_triangles);
+
+    std::vector<char> emitted(triangles_count, 0);
+    std::vector<unsigned int> vertex_meshlet(vertices_count, NO_TRIANGLE);
+    std::vector<unsigned int> meshlet_vertices;
+    std::vector<unsigned int> output;
+    output.reserve(index_count);
+    size_t seed = 0;
+    float centroid_sum[3] = {0, 0, 0};
+    size_t centroid_count = 0;
+
+    auto newVertices = [&](unsigned int triangle, unsigned int meshlet) {
+        size_t count = 0;
+        for (int corner = 0; corner < 3; corner++)
+        {
+            count += vertex_meshlet[indices[triangle * 3 + corner]] != meshlet;
+        }
+        return count;
+    };
+    auto distanceToCentroid = [&](unsigned int triangle) {
+        float distance_sq = 0.0f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float triangle_center = (vertices[indices[triangle * 3] * 3 + axis] + vertices[indices[triangle * 3 + 1] * 3 + axis] +
+                                     vertices[indices[triangle * 3 + 2] * 3 + axis]) / 3.0f;
+            float delta = triangle_center - centroid_sum[axis] / static_cast<float>(centroid_count);
+            distance_sq += delta * delta;
+        }
+        return distance_sq;
+    };
+    auto bestAround = [&](const unsigned int* around, size_t around_count, unsigned int meshlet) {
+        unsigned int best = NO_TRIANGLE;
+        size_t best_new = 4;
+        float best_distance = 0.0f;
+        for (size_t i = 0; i < around_count; i++)
+        {
+            unsigned int v = around[i];
+            for (unsigned int k = offsets[v]; k < offsets[v + 1]; k++)
+            {
+                unsigned int triangle = vertex_triangles[k];
+                if (emitted[triangle])
+                {
+                    continue;
+                }
+                size_t added = newVertices(triangle, meshlet);
+                if (added > best_new || meshlet_vertices.size() + added > MAX_VERTICES)
+                {
+                    continue;
+                }
+                float distance = distanceToCentroid(triangle);
+                if (added < best_new || distance < best_distance)
+                {
+                    best = triangle;
+                    best_new = added;
+                    best_distance = distance;
+                }
+            }
+        }
+        return best;
+    };
+
+    while (output.size() < index_count)
+    {
+        while (emitted[seed])
+        {
+            seed++;
+        }
+        auto meshlet = static_cast<unsigned int>(meshlet_index_counts.size());
+        size_t meshlet_start = output.size();
+        meshlet_vertices.clear();
+        centroid_sum[0] = centroid_sum[1] = centroid_sum[2] = 0.0f;
+        centroid_count = 0;
+        auto triangle = static_cast<unsigned int>(seed);
+
+        while (triangle != NO_TRIANGLE)
+        {
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = indices[triangle * 3 + corner];
+                output.push_back(v);
+                if (vertex_meshlet[v] != meshlet)
+                {
+                    vertex_meshlet[v] = meshlet;
+                    meshlet_vertices.push_back(v);
+                }
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    centroid_sum[axis] += vertices[v * 3 + axis];
+                }
+                centroid_count++;
+            }
+            emitted[triangle] = 1;
+            if ((output.size() - meshlet_start) / 3 >= MAX_TRIANGLES)
+            {
+                break;
+            }
+            unsigned int last[3] = {indices[triangle * 3], indices[triangle * 3 + 1], indices[triangle * 3 + 2]};
+            triangle = bestAround(last, 3, meshlet);
+            if (triangle == NO_TRIANGLE)
+            {
+                triangle = bestAround(meshlet_vertices.data(), meshlet_vertices.size(), meshlet);
+            }
+        }
+        meshlet_index_counts.push_back(static_cast<unsigned int>(output.size() - meshlet_start));
+    }
+
+    // vertex cache order inside every meshlet, on meshlet-local vertex numbers
+    std::vector<unsigned int> local_indices;
+    std::vector<unsigned int> local_vertices;
+    size_t meshlet_start = 0;
+    for (auto count : meshlet_index_counts)
+    {
+        local_indices.assign(output.begin() + meshlet_start, output.begin() + meshlet_start + count);
+        local_vertices.clear();
+        for (auto& index : local_indices)
+        {
+            auto found = std::find(local_vertices.begin(), local_vertices.end(), index);
+            if (found == local_vertices.end())
+            {
+                local_vertices.push_back(index);
+                found = local_vertices.end() - 1;
+            }
+            index = static_cast<unsigned int>(found - local_vertices.begin());
+        }
+        MeshOptimizer::optimizeVertexCache(local_indices, local_vertices.size());
+        for (size_t i = 0; i < count; i++)
+        {
+            output[meshlet_start + i] = local_vertices[local_indices[i]];
+        }
+        meshlet_start += count;
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+bool MeshletBuilder::isClosed(const unsigned int* indices, size_t index_count)
+/** Checks that every edge is shared by exactly two triangles with opposite directions (a closed, consistently oriented surface). */
+{
+    std::vector<uint64_t> edges;
+    edges.reserve(index_count);
+    for (size_t i = 0; i + 2 < index_count; i += 3)
+    {
+        for (int corner = 0; corner < 3; corner++)
+        {
+            uint64_t a = indices[i + corner];
+            uint64_t b = indices[i + (corner + 1) % 3];
+            edges.push_back(a << 32 | b);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    for (size_t i = 0; i < edges.size(); i++)
+    {
+        // a directed edge appears once and its reverse exists
+        uint64_t reversed = edges[i] << 32 | edges[i] >> 32;
+        if ((i + 1 < edges.size() && edges[i + 1] == edges[i]) || !std::binary_search(edges.begin(), edges.end(), reversed))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+Meshlet MeshletBuilder::computeBounds(const std::vector<float>& vertices, const unsigned int* indices, unsigned int index_offset,
+                                      unsigned int index_count, bool cone_culling)
+/** Calculates the bounding sphere (center of the bounding box and the farthest vertex) and the normal cone of a meshlet.
+The cone axis is the average of the unit triangle normals, cone_cutoff is the sine of the largest angle between the axis
+and a triangle normal. Meshlets whose normals spread over a half-space or more are never backface culled. */
+{
+    Meshlet meshlet{};
+    meshlet.index_offset = index_offset;
+    meshlet.index_count  = index_count;
+    meshlet.cone_cutoff  = 1.0f;
+    const unsigned int* meshlet_indices = indices + index_offset;
+
+    SoaVectors positions;
+    positions.resize(index_count);
+    for (unsigned int i = 0; i < index_count; i++)
+    {
+        const float* position = &vertices[meshlet_indices[i] * 3];
+        positions.x[i] = position[0];
+        positions.y[i] = position[1];
+        positions.z[i] = position[2];
+    }
+    float bounds_min[3];
+    float bounds_max[3];
+    GeometryKernels::bounds(positions, bounds_min, bounds_max);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        meshlet.center[axis] = (bounds_min[axis] + bounds_max[axis]) * 0.5f;
+    }
+    meshlet.radius = GeometryKernels::boundingRadius(positions, meshlet.center);
+
+    if (!cone_culling)
+    {
+        return meshlet;
+    }
+    std::vector<float> normals;
+    normals.reserve(index_count);
+    float axis[3] = {0, 0, 0};
+    for (unsigned int i = 0; i + 2 < index_count; i += 3)
+    {
+        const float* a = &vertices[meshlet_indices[i] * 3];
+        const float* b = &vertices[meshlet_indices[i + 1] * 3];
+        const float* c = &vertices[meshlet_indices[i + 2] * 3];
+        float edge1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float edge2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        float normal[3] = {edge1[1] * edge2[2] - edge1[2] * edge2[1],
+                           edge1[2] * edge2[0] - edge1[0] * edge2[2],
+                           edge1[0] * edge2[1] - edge1[1] * edge2[0]};
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (length <= 0)
+        {
+            continue;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            normals.push_back(normal[k] / length);
+            axis[k] += normal[k] / length;
+        }
+    }
+    float axis_length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    if (normals.empty() || axis_length <= 0)
+    {
+        return meshlet;
+    }
+    float min_dot = 1.0f;
+    for (int k = 0; k < 3; k++)
+    {
+        meshlet.cone_axis[k] = axis[k] / axis_length;
+    }
+    for (size_t i = 0; i < normals.size(); i += 3)
+    {
+        float dot = normals[i] * meshlet.cone_axis[0] + normals[i + 1] * meshlet.cone_axis[1] + normals[i + 2] * meshlet.cone_axis[2];
+        min_dot = std::min(min_dot, dot);
+    }
+    if (min_dot > 0)
+    {
+        meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    }
+    return meshlet;
+}
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cmath>
+#include "../include/geometry_kernels.h"
+#include "../include/normal_builder.h"
+#include "../include/parallel.h"
+
+
+void NormalBuilder::buildVertexNormals(const std::vector<float>& object_vertices,
+                                       const std::vector<unsigned int>& indices,
+                                       std::vector<float>& object_normals,
+                                       NormalWeighting weighting,
+                                       unsigned int thread_count)
+/** Calculates a normal for every vertex of an indexed triangle mesh in linear time.
+Face normals are computed into a flat array, faces are linked to their vertices with a CSR adjacency
+(vertex -> list of triangle corners in triangle order) and every vertex sums the normals of its faces.
+Both the face pass and the vertex pass are split across worker threads and run the SIMD loops of GeometryKernels on
+positions staged in SoA layout. Because each vertex sums its faces in the same order as the triangles appear in the
+index buffer, the result depends neither on the thread count nor on the SIMD level.
+Vertices that are not referenced by any triangle get a zero normal. */
+{
+    size_t vertices_count  = object_vertices.size() / 3;
+    size_t triangles_count = indices.size() / 3;
+
+    object_normals.assign(vertices_count * 3, 0.0f);
+    if (triangles_count == 0)
+    {
+        return;
+    }
+    unsigned int threads = Parallel::threadCount(triangles_count, MIN_TRIANGLES_PER_THREAD, thread_count);
+
+    // 1. vertex -> adjacent triangle corners, this also checks the indices before the face pass reads through them
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> corners;
+    GeometryKernels::vertexCorners(indices, vertices_count, offsets, corners);
+
+    // 2. surface normal (and corner weights for angle weighting) of every triangle
+    SoaVectors positions;
+    positions.assign(object_vertices.data(), vertices_count);
+    SoaVectors face_normals;
+    face_normals.resize(triangles_count);
+    std::vector<float> corner_weights;
+    if (weighting == NormalWeighting::Angle)
+    {
+        corner_weights.resize(triangles_count * 3);
+    }
+    Parallel::forChunks(triangles_count, threads, [&](size_t first, size_t last) {
+        // area weighting keeps the length of the cross product (twice the triangle area)
+        GeometryKernels::faceNormals(positions, indices.data(), first, last, weighting != NormalWeighting::Area, face_normals);
+        if (weighting == NormalWeighting::Angle)
+        {
+            computeCornerAngles(object_vertices, indices, first, last, corner_weights);
+        }
+    });
+
+    // 3. weighted sum of adjacent face normals, normalized to unit length
+    SoaVectors normals;
+    normals.resize(vertices_count);
+    Parallel::forChunks(vertices_count, threads, [&](size_t first, size_t last) {
+        GeometryKernels::accumulateNormals(face_normals, offsets.data(), corners.data(),
+                                           corner_weights.empty() ? nullptr : corner_weights.data(), first, last, normals);
+        GeometryKernels::normalize(normals, first, last);
+    });
+    normals.store(object_normals.data());
+}
+
+void NormalBuilder::computeCornerAngles(const std::vector<float>& object_vertices, const std::vector<unsigned int>& indices,
+                                        size_t first_triangle, size_t last_triangle, std::vector<float>& corner_weights)
+/** Stores the interior angle of every corner of the triangles in range [first_triangle, last_triangle) in
+corner_weights. */
+{
+    for (size_t triangle = first_triangle; triangle < last_triangle; triangle++)
+    {
+        const unsigned int* corner = &indices[triangle * 3];
+        Vertex a = {object_vertices[corner[0] * 3 + 0], object_vertices[corner[0] * 3 + 1], object_vertices[corner[0] * 3 + 2]};
+        Vertex b = {object_vertices[corner[1] * 3 + 0], object_vertices[corner[1] * 3 + 1], object_vertices[corner[1] * 3 + 2]};
+        Vertex c = {object_vertices[corner[2] * 3 + 0], object_vertices[corner[2] * 3 + 1], object_vertices[corner[2] * 3 + 2]};
+
+        const Vertex* points[3] = {&a, &b, &c};
+        for (int i = 0; i < 3; i++)
+        {
+            const Vertex& p    = *points[i];
+            const Vertex& next = *points[(i + 1) % 3];
+            const Vertex& prev = *points[(i + 2) % 3];
+
+            Vertex edge1 = {next.x - p.x, next.y - p.y, next.z - p.z};
+            Vertex edge2 = {prev.x - p.x, prev.y - p.y, prev.z - p.z};
+            normalize(edge1);
+            normalize(edge2);
+
+            float cos_angle = edge1.x * edge2.x + edge1.y * edge2.y + edge1.z * edge2.z;
+            corner_weights[triangle * 3 + i] = std::acos(std::max(-1.0f, std::min(1.0f, cos_angle)));
+        }
+    }
+}
+
+Vertex NormalBuilder::calculateSurfaceNormal(const Vertex& v1, const Vertex& v2, const Vertex& v3)
+/** This function computes the normal vector for a surface defined by three vertices.
+It uses the cross product of two edges of the triangle to find the surface normal. */
+{
+    // Calculate the vectors representing two edges of the triangle
+    Vertex edge1 = {v2.x - v1.x, v2.y - v1.y, v2.z - v1.z};
+    Vertex edge2 = {v3.x - v1.x, v3.y - v1.y, v3.z - v1.z};
+
+    // Compute the cross product of the two edges to get the normal vector
+    Vertex normal = {edge1.y * edge2.z - edge1.z * edge2.y,
+                     edge1.z * edge2.x - edge1.x * edge2.z,
+                     edge1.x * edge2.y - edge1.y * edge2.x};
+
+    // Normalize the normal vector (make it a unit vector)
+    normalize(normal);
+
+    return normal;
+}
+
+void NormalBuilder::normalize(Vertex& vertex)
+/** Scales the vector to unit length, zero vectors are left untouched. */
+{
+    float length = std::sqrt(vertex.x * vertex.x + vertex.y * vertex.y + vertex.z * vertex.z);
+
+    if (length > 0)
+    {
+        vertex.x /= length;
+        vertex.y /= length;
+        vertex.z /= length;
+    }
+}
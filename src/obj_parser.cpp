@@ -0,0 +1,395 @@
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <cstring>
+#include "../include/obj_parser.h"
+#include "../include/mapped_file.h"
+#include "../include/parallel.h"
+
+namespace {
+    enum class Statement {Other, Position, Face};
+
+    const double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    inline bool isDigit(char c)
+    {
+        return static_cast<unsigned char>(c - '0') < 10;
+    }
+
+    inline bool isBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline const char* lineEnd(const char* pos, const char* end)
+    {
+        auto new_line = static_cast<const char*>(std::memchr(pos, '\n', static_cast<size_t>(end - pos)));
+        return new_line != nullptr ? new_line : end;
+    }
+
+    inline const char* skipBlanks(const char* pos, const char* end)
+    {
+        while (pos < end && isBlank(*pos)) pos++;
+        return pos;
+    }
+
+    inline const char* skipToken(const char* pos, const char* end)
+    {
+        while (pos < end && !isBlank(*pos)) pos++;
+        return pos;
+    }
+
+    Statement readStatement(const char*& pos, const char* end)
+    /** Detects the statement of a line and moves pos behind its keyword. */
+    {
+        pos = skipBlanks(pos, end);
+        if (end - pos < 2 || !isBlank(pos[1]))
+        {
+            return Statement::Other;
+        }
+        Statement statement = Statement::Other;
+        if (pos[0] == 'v') statement = Statement::Position;
+        if (pos[0] == 'f') statement = Statement::Face;
+        if (statement != Statement::Other) pos += 2;
+
+        return statement;
+    }
+
+    inline const char* statementEnd(const char* pos, const char* line_end)
+    /** Returns the end of statement data: end of line or start of a trailing comment. */
+    {
+        auto comment = static_cast<const char*>(std::memchr(pos, '#', static_cast<size_t>(line_end - pos)));
+        return comment != nullptr ? comment : line_end;
+    }
+}
+
+
+bool ObjParser::parse(const std::string& filepath,
+                      std::vector<float>& object_vertices,
+                      std::vector<unsigned int>& indices,
+                      std::string& error,
+                      unsigned int thread_count)
+/** Parses positions and faces of an .obj file, replacing content of object_vertices and indices.
+The mapped file is split into chunks at line boundaries. The first pass counts positions and triangles of every chunk
+in parallel, so the output vectors are sized once and every chunk knows where its data starts; the second pass parses
+numbers straight into the final place. Returns false with an error message if the file cannot be read
+or contains statements this parser does not support, the caller may fall back to a full .obj loader then. */
+{
+    std::unique_ptr<MappedFile> file;
+    try
+    {
+        file.reset(new MappedFile(filepath));
+    }
+    catch (const std::string& message)
+    {
+        error = message;
+        return false;
+    }
+    const char* data = file->data();
+    const char* end  = data + file->size();
+
+    // 1. split at line boundaries
+    unsigned int chunks_count = Parallel::threadCount(file->size(), MIN_BYTES_PER_THREAD, thread_count);
+    std::vector<Chunk> chunks(chunks_count);
+    const char* chunk_begin = data;
+    for (unsigned int i = 0; i < chunks_count; i++)
+    {
+        const char* chunk_end = end;
+        if (i + 1 < chunks_count)
+        {
+            chunk_end = std::max(chunk_begin, data + file->size() / chunks_count * (i + 1));
+            chunk_end = chunk_end < end ? lineEnd(chunk_end, end) : end;
+            chunk_end = chunk_end < end ? chunk_end + 1 : end;
+        }
+        chunks[i].begin = chunk_begin;
+        chunks[i].end   = chunk_end;
+        chunk_begin = chunk_end;
+    }
+
+    // 2. count positions and triangles of every chunk
+    Parallel::forEachChunk(chunks_count, [&](unsigned int i) { countChunk(chunks[i]); });
+
+    size_t total_vertices  = 0;
+    size_t total_triangles = 0;
+    for (auto& chunk : chunks)
+    {
+        if (!chunk.error.empty())
+        {
+            error = chunk.error;
+            return false;
+        }
+        chunk.vertices_offset  = total_vertices;
+        chunk.triangles_offset = total_triangles;
+        total_vertices  += chunk.vertices_count;
+        total_triangles += chunk.triangles_count;
+    }
+
+    // 3. parse every chunk straight into the output vectors
+    object_vertices.resize(total_vertices * 3);
+    indices.resize(total_triangles * 3);
+    Parallel::forEachChunk(chunks_count, [&](unsigned int i) {
+        parseChunk(chunks[i], total_vertices, object_vertices.data(), indices.data());
+    });
+
+    for (auto& chunk : chunks)
+    {
+        if (!chunk.error.empty())
+        {
+            error = chunk.error;
+            object_vertices.clear();
+            indices.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ObjParser::countChunk(Chunk& chunk)
+/** Counts position statements and triangles (a face with n vertices gives n - 2 triangles) of a chunk. */
+{
+    const char* pos = chunk.begin;
+    while (pos < chunk.end)
+    {
+        const char* line_end = lineEnd(pos, chunk.end);
+        Statement statement = readStatement(pos, line_end);
+
+        if (statement == Statement::Position)
+        {
+            chunk.vertices_count++;
+        }
+        else if (statement == Statement::Face)
+        {
+            const char* data_end = statementEnd(pos, line_end);
+            size_t corners = 0;
+            for (pos = skipBlanks(pos, data_end); pos < data_end; pos = skipBlanks(skipToken(pos, data_end), data_end))
+            {
+                corners++;
+            }
+            if (corners < 3)
+            {
+                chunk.error = "ObjParser: face with less than 3 vertices.";
+                return;
+            }
+            chunk.triangles_count += corners - 2;
+        }
+        pos = line_end + 1;
+    }
+}
+
+void ObjParser::parseChunk(Chunk& chunk, size_t total_vertices, float* vertices, unsigned int* indices)
+/** Parses positions and faces of a chunk into its ranges of the output arrays. Relative (negative) face indices
+are resolved against the amount of positions defined before the face, like in the rest of .obj loaders. */
+{
+    float* vertex_out = vertices + chunk.vertices_offset * 3;
+    unsigned int* index_out = indices + chunk.triangles_offset * 3;
+    size_t vertices_seen = chunk.vertices_offset;
+
+    const char* pos = chunk.begin;
+    while (pos < chunk.end)
+    {
+        const char* line_end = lineEnd(pos, chunk.end);
+        Statement statement  = readStatement(pos, line_end);
+        const char* data_end = statementEnd(pos, line_end);
+
+        if (statement == Statement::Position)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                pos = skipBlanks(pos, data_end);
+                if (!parseFloat(pos, data_end, vertex_out[axis]))
+                {
+                    chunk.error = "ObjParser: invalid vertex position.";
+                    return;
+                }
+            }
+            vertex_out += 3;
+            vertices_seen++;
+        }
+        else if (statement == Statement::Face)
+        {
+            unsigned int first = 0, previous = 0;
+            int corner = 0;
+            for (pos = skipBlanks(pos, data_end); pos < data_end; pos = skipBlanks(skipToken(pos, data_end), data_end), corner++)
+            {
+                // only the position index is used: v, v/vt, v//vn and v/vt/vn are accepted
+                long long index = 0;
+                if (!parseIndex(pos, data_end, index) || index == 0)
+                {
+                    chunk.error = "ObjParser: invalid face index.";
+                    return;
+                }
+                index = index > 0 ? index - 1 : static_cast<long long>(vertices_seen) + index;
+                if (index < 0 || static_cast<size_t>(index) >= total_vertices)
+                {
+                    chunk.error = "ObjParser: face index is out of range.";
+                    return;
+                }
+                auto current = static_cast<unsigned int>(index);
+
+                if (corner == 0)
+                {
+                    first = current;
+                }
+                else if (corner >= 2)
+                {
+                    index_out[0] = first;
+                    index_out[1] = previous;
+                    index_out[2] = current;
+                    index_out += 3;
+                }
+                previous = current;
+            }
+        }
+        pos = line_end + 1;
+    }
+}
+
+bool ObjParser::parseFloat(const char*& pos, const char* end, float& value)
+/** Parses a decimal floating point number and moves pos behind it. Digits are consumed eight at a time with SWAR
+arithmetic; numbers with a mantissa that fits into 53 bits and a small decimal exponent are converted exactly with
+a single multiplication or division in double precision. Everything else (long mantissas, big exponents, inf/nan)
+goes through strtod. */
+{
+    const char* p = pos;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits   = 0;
+    int exponent = 0;
+    auto readDigits = [&](bool fraction) {
+        while (end - p >= 8 && digits <= 11 && isEightDigits(p))
+        {
+            mantissa = mantissa * 100000000ULL + parseEightDigits(p);
+            p += 8;
+            digits += 8;
+            if (fraction) exponent -= 8;
+        }
+        while (p < end && isDigit(*p) && digits < 19)
+        {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+            p++;
+            digits++;
+            if (fraction) exponent--;
+        }
+    };
+
+    readDigits(false);
+    if (p < end && *p == '.')
+    {
+        p++;
+        readDigits(true);
+    }
+    bool fast_path = digits > 0 && (p == end || !isDigit(*p));
+
+    if (fast_path && p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negative_exponent = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative_exponent = *p == '-';
+            p++;
+        }
+        int exponent_value = 0;
+        const char* exponent_start = p;
+        while (p < end && isDigit(*p) && exponent_value < 10000)
+        {
+            exponent_value = exponent_value * 10 + (*p - '0');
+            p++;
+        }
+        fast_path = p > exponent_start;
+        exponent += negative_exponent ? -exponent_value : exponent_value;
+    }
+    fast_path = fast_path && (p == end || isBlank(*p) || *p == '\n' || *p == '#') &&
+                mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22;
+
+    if (fast_path)
+    {
+        double result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+        value = static_cast<float>(negative ? -result : result);
+        pos = p;
+        return true;
+    }
+
+    // slow path: the mapped file is not null-terminated, so the token is copied before calling strtod
+    const char* token_end = pos;
+    while (token_end < end && !isBlank(*token_end) && *token_end != '\n' && *token_end != '#') token_end++;
+    char buffer[64];
+    size_t length = static_cast<size_t>(token_end - pos);
+    if (length == 0 || length >= sizeof(buffer))
+    {
+        return false;
+    }
+    std::memcpy(buffer, pos, length);
+    buffer[length] = '\0';
+
+    char* parsed_end = nullptr;
+    double result = std::strtod(buffer, &parsed_end);
+    if (parsed_end != buffer + length)
+    {
+        return false;
+    }
+    value = static_cast<float>(result);
+    pos = token_end;
+    return true;
+}
+
+bool ObjParser::parseIndex(const char*& pos, const char* end, long long& value)
+/** Parses a signed integer and moves pos behind it. */
+{
+    const char* p = pos;
+    bool negative = false;
+    if (p < end && *p == '-')
+    {
+        negative = true;
+        p++;
+    }
+    const char* digits_start = p;
+    long long result = 0;
+    while (p < end && isDigit(*p) && p - digits_start < 18)
+    {
+        result = result * 10 + (*p - '0');
+        p++;
+    }
+    if (p == digits_start || (p < end && isDigit(*p)))
+    {
+        return false;
+    }
+    value = negative ? -result : result;
+    pos = p;
+    return true;
+}
+
+bool ObjParser::isEightDigits(const char* digits)
+/** Checks with a single 64-bit operation that the next 8 characters are all decimal digits. */
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t chunk;
+    std::memcpy(&chunk, digits, sizeof(chunk));
+    return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) | (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+           0x3333333333333333ULL;
+#else
+    return false;
+#endif
+}
+
+uint32_t ObjParser::parseEightDigits(const char* digits)
+/** Converts 8 decimal digits to their value with three multiplications: pairs of digits are combined first,
+then pairs of pairs, then the two halves (SWAR - SIMD within a register). */
+{
+    uint64_t chunk;
+    std::memcpy(&chunk, digits, sizeof(chunk));
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+             (((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+
+    return static_cast<uint32_t>(chunk);
+}
@@ -1,367 +1,768 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <glad/glad.h>
 
 #include "../include/object.h"
+#include "../include/geometry_kernels.h"
 #include "../include/loader.h"
+#include "../include/mesh_cache.h"
 
-Object::Object(const std::string& obj_filepath, const std::string& shader_vert, const std::string& shader_frag): shaderProgram_(shader_vert.c_str(), shader_frag.c_str()) {
-    loadObjectFile(obj_filepath);
+namespace {
+    // tag of the batch of all gizmo draws in the render queue
+    const char gizmo_batch = 0;
+}
 
-    // generates a single Vertex Array Object (VAO)  that stores the state needed to supply vertex data,
-    // including information about vertex attribute pointers
-    glGenVertexArrays(1, &VAO_);
+Object::Object(const std::string& obj_filepath, const std::string& shader_vert, const std::string& shader_frag,
+               const MeshLoadOptions& options): Object(MeshData(), PackedMesh(), shader_vert, shader_frag) {
+    loadObjectFile(obj_filepath, options);
+}
 
-    // generates a single Vertex Buffer Object (VBO) that stores the actual vertex data.
-    glGenBuffers(1, &VBO_);
-    // buffer for normals
-    glGenBuffers(1, &NBO_);
-    // buffer for indices
-    glGenBuffers(1, &EBO_);
+Object::Object(MeshData mesh, PackedMesh packed, const std::string& shader_vert, const std::string& shader_frag):
+               Object(std::make_shared<MeshAsset>(std::move(mesh), std::move(packed)), shader_vert, shader_frag) {}
+
+Object::Object(std::shared_ptr<MeshAsset> asset, const std::string& shader_vert, const std::string& shader_frag):
+               asset_(std::move(asset)),
+               shader_variants_(shader_vert, shader_frag, ShaderFeatures::defineNames()),
+               shaderProgram_(shader_variants_.variant(ShaderFeatures::ALL)) {
+    if (asset_->packed.vertex_bytes == 0 && asset_->mesh.vertexCount() > 0)
+    {
+        ensureNormals();
+        VertexPacker::pack(asset_->mesh, VertexFormat(), asset_->packed);
+    }
+
+    // vertices and indices are stored in the shared mesh arena (see loadObjectBuffers), the Object has only a buffer
+    // for per-instance transforms and colors
+    glGenBuffers(1, &instance_VBO_);
+
+    setupShaderProgram();
 }
 
+void Object::useShaderVariant(unsigned int key)
+/** Switches the shader program to the variant compiled with the features of the key (compiled on first use). */
+{
+    if (key == shader_key_)
+    {
+        return;
+    }
+    shaderProgram_ = shader_variants_.variant(key);
+    shader_key_ = key;
+    setupShaderProgram();
+}
 
-void Object::loadObjectFile(const std::string &filepath)
-/**Loads vertices and indices from an .obj file using Loader class. If normals are not loaded by Loader, they are calculated with
-class method 'calculateNormalsSimple'.*/
+void Object::setupShaderProgram()
+/** Connects the uniform blocks and samplers of the current shader program. */
+{
+    shaderProgram_.bindUniformBlock("Transforms", UniformBuffer::TRANSFORMS_BINDING);
+    shaderProgram_.bindUniformBlock("Lights", UniformBuffer::LIGHTS_BINDING);
+    shaderProgram_.bindUniformBlock("Material", UniformBuffer::MATERIAL_BINDING);
+    shaderProgram_.bindUniformBlock("Shadows", UniformBuffer::SHADOWS_BINDING);
+    // samplers of the clustered light buffers and of the shadow atlas read fixed texture units (see LightClusters::bind
+    // and ShadowAtlas::bind)
+    shaderProgram_.use();
+    shaderProgram_.setInt(shaderProgram_.uniformLocation("lightData"), LightsBlock::LIGHT_DATA_UNIT);
+    shaderProgram_.setInt(shaderProgram_.uniformLocation("clusters"), LightsBlock::CLUSTER_UNIT);
+    shaderProgram_.setInt(shaderProgram_.uniformLocation("lightIndices"), LightsBlock::LIGHT_INDEX_UNIT);
+    shaderProgram_.setInt(shaderProgram_.uniformLocation("shadowAtlas"), ShadowsBlock::ATLAS_UNIT);
+    shaderProgram_.setInt(shaderProgram_.uniformLocation("shadowLights"), ShadowsBlock::SHADOW_LIGHT_UNIT);
+    shaderProgram_.setInt(shaderProgram_.uniformLocation("shadowMatrices"), ShadowsBlock::SHADOW_MATRIX_UNIT);
+}
+
+void Object::loadObjectFile(const std::string &filepath, const MeshLoadOptions& options)
+/**Loads vertices, normals and indices of an .obj file through the binary mesh cache (the .obj is parsed by Loader class
+only if it has no valid cache file yet), normals are averaged from adjacent faces with the given weighting.
+If normals are not loaded by Loader, they are calculated with class method 'calculateNormalsSimple'.
+Afterwards the mesh is packed into the GPU vertex format of the options. If another Object uses the file loaded with
+the same options, its mesh is shared instead and the file is not read at all (see MeshAssets).*/
 {
     if (filepath.empty()){
         return;
     }
-    vertices_.clear();
-    normals_.clear();
-    indices_.clear();
+    std::shared_ptr<MeshAsset> shared_asset = MeshAssets::find(filepath, options);
+    if (shared_asset)
+    {
+        asset_ = std::move(shared_asset);
+        return;
+    }
+    asset_ = std::make_shared<MeshAsset>();
 
     try{
-        ObjectLoader::loadObjFileData(filepath, vertices_, normals_, indices_);
+        MeshCache::loadObjMesh(filepath, options, asset_->mesh);
     }
     catch(...) {
         std::cerr << "Error: Unable to load file: " << filepath;
         return;
     }
-    if (normals_.empty() || normals_.size() != vertices_.size()){
-        normals_ = calculateNormalsSimple(vertices_);
+    ensureNormals();
+    VertexPacker::pack(asset_->mesh, options.vertex_format, asset_->packed);
+    MeshAssets::add(filepath, options, asset_);
+}
+
+void Object::ensureNormals()
+/** Calculates normals with 'calculateNormalsSimple' if the mesh does not have a normal per vertex. */
+{
+    if (!asset_->mesh.isMapped() && !asset_->mesh.vertices.empty() && asset_->mesh.normals.size() != asset_->mesh.vertices.size()){
+        asset_->mesh.normals = calculateNormalsSimple(asset_->mesh.vertices);
     }
 }
 
 void Object::loadObjectBuffers()
-/** Loads data into all Object's buffers: vertices, indices, normals. */
+/** Loads interleaved vertices and indices into ranges of the shared mesh arena (see MeshArena) at once. The CPU copy
+of the packed data is released afterwards. */
 {
-    // Binds the VAO_ so that subsequent vertex attribute calls (like setting vertex attributes) are stored in this VAO.
-    glBindVertexArray(VAO_);
-
-    // Binds the VBO_ to the GL_ARRAY_BUFFER target, meaning that any subsequent calls related to GL_ARRAY_BUFFER will affect this VBO.
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-    // Allocates memory in the GPU and copies the vertex data from the CPU to this allocated GPU memory.
-    // GL_STATIC_DRAW indicates that the data will not change frequently, allowing the GPU to optimize memory storage for better performance.
-    glBufferData(GL_ARRAY_BUFFER,
-                 sizeof(GLfloat) * vertices_.size(),
-                 vertices_.data(),
-                 GL_STATIC_DRAW);
-    // Specifies how the vertex data is laid out in memory, so the GPU knows how to interpret it.
-    // Stride is the byte offset between consecutive vertex attributes.
-    // Pointer is the offset of the first component in the array (0 means the data starts at the beginning).
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    // Enables the vertex attribute array at the specified index (0 corresponds to the vertex positions) within the currently bound VAO..
-    glEnableVertexAttribArray(0);
-
-    // GL_ELEMENT_ARRAY_BUFFER is a target to store indices of each element in the VBO/NBO buffers.
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 sizeof(GLuint) * indices_.size(),
-                 indices_.data(),
-                 GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ARRAY_BUFFER, NBO_);
-    glBufferData(GL_ARRAY_BUFFER,
-                 sizeof(GLfloat) * normals_.size(),
-                 normals_.data(),
-                 GL_STATIC_DRAW);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-
-    glBindVertexArray(0);
+    beginBufferUpload();
+    uploadBufferChunk(asset_->packed.vertex_bytes + asset_->packed.index_bytes);
 }
 
-void Object::draw(glm::mat4& view, glm::mat4& projection, glm::vec3 camera_position, std::vector<Light> lights)
-/** Render Object considering lighting parameters from Light source objects.*/
+void Object::beginBufferUpload()
+/** Reserves the ranges of the vertices and indices in the mesh arena without copying any data, the vertex attributes
+are defined by the VAO of the pool. The data is copied afterwards in parts by 'uploadBufferChunk', so a large mesh can
+be uploaded across several frames. A shared mesh is reserved only once, its upload continues where it is. */
 {
-    // glPolygonMode sets the polygon drawing mode, determining how polygons will be rasterized.
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    int numLights = static_cast<int>(lights.size());
-
-    // sets ShaderProgram with its id as active current shader program to use for subsequent drawing functions.
-    shaderProgram_.use();
-
-    // all subsequent steps until binding VAO set various uniforms for vertex and fragment shaders.
-    shaderProgram_.setInt("numLights", numLights);
-
-    shaderProgram_.setVec3("objectColor", rgb_[0], rgb_[1], rgb_[2]);
-    // Camera position (or viewer position in this context) is used to calculate specular lighting on the central object
-    shaderProgram_.setVec3("viewPos", camera_position);
-
-    // iterate through Light objects' parameters to pass to fragment shader
-    for (int i = 0; i < numLights; ++i) {
-        std::string typeName = "lightType[" + std::to_string(i) + "]";
-        shaderProgram_.setInt(typeName, lights[i].type);
-
-        std::string posName = "lightPos[" + std::to_string(i) + "]";
-        shaderProgram_.setVec3(posName, lights[i].light_pos);
+    if (!asset_->arena_mesh.allocated() && asset_->packed.vertex_bytes > 0)
+    {
+        asset_->arena_mesh = MeshArena::shared().allocate(asset_->packed);
+        asset_->uploaded_bytes = 0;
+    }
+}
 
-        std::string dirName = "lightDir[" + std::to_string(i) + "]";
-        shaderProgram_.setVec3(dirName, lights[i].light_dir);
+bool Object::uploadBufferChunk(size_t max_bytes)
+/** Copies at most max_bytes of not yet uploaded data to the ranges reserved by 'beginBufferUpload'.
+Vertices are uploaded first, then indices. Returns true when all data is on the GPU, the CPU copy of the packed data
+is released then. */
+{
+    struct Stream {
+        bool indices;
+        const unsigned char* data;
+        size_t size;
+    };
+    Stream streams[2] = {
+            {false, asset_->packed.vertices.data(), asset_->packed.vertices.size()},
+            {true, asset_->packed.indices.data(), asset_->packed.indices.size()}
+    };
+    MeshArena& arena = MeshArena::shared();
 
-        std::string colorName = "lightColor[" + std::to_string(i) + "]";
-        shaderProgram_.setVec3(colorName, lights[i].rgb[0], lights[i].rgb[1], lights[i].rgb[2]);
+    size_t stream_start = 0;
+    for (auto& stream : streams)
+    {
+        size_t stream_end = stream_start + stream.size;
+        if (max_bytes > 0 && asset_->uploaded_bytes < stream_end)
+        {
+            size_t offset = asset_->uploaded_bytes - stream_start;
+            size_t size   = std::min(stream.size - offset, max_bytes);
+
+            if (stream.indices)
+            {
+                arena.writeIndices(asset_->arena_mesh, offset, size, stream.data + offset);
+            }
+            else
+            {
+                arena.writeVertices(asset_->arena_mesh, offset, size, stream.data + offset);
+            }
+            asset_->uploaded_bytes += size;
+            max_bytes -= size;
+        }
+        stream_start = stream_end;
+    }
 
-        std::string intensityName = "lightIntensity[" + std::to_string(i) + "]";
-        shaderProgram_.setFloat(intensityName, lights[i].intensity);
+    if (asset_->uploaded_bytes < stream_start)
+    {
+        return false;
+    }
+    asset_->packed.releaseData();
+    return true;
+}
 
-        std::string linearName = "linear[" + std::to_string(i) + "]";
-        shaderProgram_.setFloat(linearName, lights[i].linear);
+float Object::uploadProgress() const
+/** Returns the fraction of Object's data that is already uploaded by 'uploadBufferChunk'. */
+{
+    size_t total = asset_->packed.vertex_bytes + asset_->packed.index_bytes;
+    return total == 0 ? 1.0f : static_cast<float>(asset_->uploaded_bytes) / static_cast<float>(total);
+}
 
-        std::string quadraticName = "quadratic[" + std::to_string(i) + "]";
-        shaderProgram_.setFloat(quadraticName, lights[i].quadratic);
+void Object::releaseBuffers()
+/** Releases the mesh (its ranges return to the mesh arena with the last Object that uses it) and deletes all Object's
+OpenGL buffers, the Object is empty and must not be drawn afterwards. */
+{
+    asset_ = std::make_shared<MeshAsset>();
+    glDeleteBuffers(1, &instance_VBO_);
+    instance_VBO_ = 0;
+    instance_capacity_ = 0;
+    material_buffer_.release();
+}
 
-        std::string cutOffName = "cutOff[" + std::to_string(i) + "]";
-        shaderProgram_.setFloat(cutOffName, glm::cos(glm::radians(lights[i].cutOff)));
+LightData LightData::fromLight(const Light& light)
+/** Packs the parameters of a light into texels of the light data buffer, cut-off angles are converted to cosines. */
+{
+    LightData data{};
+    data.position[0] = light.light_pos.x;
+    data.position[1] = light.light_pos.y;
+    data.position[2] = light.light_pos.z;
+    data.position[3] = static_cast<float>(light.type);
+    data.direction[0] = light.light_dir.x;
+    data.direction[1] = light.light_dir.y;
+    data.direction[2] = light.light_dir.z;
+    data.direction[3] = light.intensity;
+    std::copy(light.rgb, light.rgb + 3, data.color);
+    data.color[3] = light.linear;
+    data.attenuation[0] = light.quadratic;
+    data.attenuation[1] = glm::cos(glm::radians(light.cutOff));
+    data.attenuation[2] = glm::cos(glm::radians(light.outerCutOff));
+    return data;
+}
 
-        std::string outerCutOffName = "outerCutOff[" + std::to_string(i) + "]";
-        shaderProgram_.setFloat(outerCutOffName, glm::cos(glm::radians(lights[i].outerCutOff)));
+void Object::setInstances(std::vector<InstanceData> instances)
+/** Replaces the instances of the Object, they are uploaded to the instance buffer on the next draw.
+An empty vector is replaced with a single instance with identity transform. */
+{
+    if (instances.empty())
+    {
+        instances.push_back(InstanceData());
     }
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::scale(model, glm::vec3(scale_, scale_, scale_));
+    instances_ = std::move(instances);
+    instances_dirty_ = true;
+}
 
-    shaderProgram_.setMat4("projection", projection);
-    shaderProgram_.setMat4("view", view);
-    shaderProgram_.setMat4("model", model);
+void Object::uploadInstances()
+/** Copies the instances to the instance buffer if they changed since the last upload. The buffer grows to the next
+power of two, otherwise the old storage is orphaned and refilled, so the driver does not wait for draws that still read it. */
+{
+    if (!instances_dirty_)
+    {
+        return;
+    }
+    size_t bytes = instances_.size() * sizeof(InstanceData);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_VBO_);
+    if (instances_.size() > instance_capacity_)
+    {
+        instance_capacity_ = 1;
+        while (instance_capacity_ < instances_.size())
+        {
+            instance_capacity_ *= 2;
+        }
+    }
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(instance_capacity_ * sizeof(InstanceData)), nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(bytes), instances_.data());
+    instances_dirty_ = false;
+}
 
-    // After binding VAO, OpenGL will use the vertex data, indices, and attribute configurations associated with this VAO for rendering.
-    glBindVertexArray(VAO_);
-    // glDrawElements is a rendering command that draws elements (typically triangles) from the currently bound VAO.
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices_.size()), GL_UNSIGNED_INT, 0);
+const glm::mat4& Object::getModelMatrix() const
+/** Returns the transform from object space to the space of the instances: the scale of the Object. */
+{
+    transform_.setScale(glm::vec3(scale_));
+    return transform_.getMatrix();
 }
 
-std::vector<float> Object::calculateNormalsSimple(std::vector<float> vertices)
-/** Calculates normal by first determining the geometric center of the object, then computes the direction
-from the center to each vertex and normalizes these directions to unit length. */
+float Object::getBoundingRadius() const
+/** Returns the radius of the sphere around the bounding box of the mesh in world units (the scale is applied). */
 {
-    std::vector<float> normals;
-    Vertex center     = {0.0f, 0.0f, 0.0f};
-    int num_vertices  = static_cast<int>(vertices.size()) / 3;
-    int vertices_size = static_cast<int>(vertices.size());
+    const auto& bounds = asset_->mesh.bounds;
+    glm::vec3 extent = glm::vec3(bounds.max[0] - bounds.min[0], bounds.max[1] - bounds.min[1], bounds.max[2] - bounds.min[2]);
+    return glm::length(extent) * 0.5f * scale_;
+}
 
-    // Loop through all vertices to compute the center of the object
-    for (int i = 0; i < vertices_size; i += 3)
+void Object::prepareDraw(JobSystem& jobs, const glm::mat4& view, const glm::mat4& projection,
+                         const glm::vec3& camera_position, float viewport_height)
+/** Selects the level of detail and culls its meshlets for the next draw of the Object. It does not call OpenGL, so it
+runs on any thread of the job system and splits its loops into jobs. */
+{
+    selectLod(jobs, projection, camera_position, viewport_height);
+    // meshlets are culled for a single instance only, copies of the Object are drawn whole with one instanced draw
+    meshlet_draws_ = meshlet_culling_ && instances_.size() == 1 && asset_->mesh.lod(current_lod_).meshlet_count > 0;
+    if (meshlet_draws_)
     {
-        // Accumulate the x, y, z coordinates of each vertex
-        center.x += vertices[i];
-        center.y += vertices[i + 1];
-        center.z += vertices[i + 2];
+        // only meshlets that survive culling are drawn, neighbouring ones are merged into a single draw
+        cullMeshlets(jobs, view, projection, camera_position);
     }
+    else
+    {
+        meshlet_cull_stats_ = MeshletCullStats();
+    }
+}
 
-    // Calculate the average to find the center position
-    center.x /= num_vertices;
-    center.y /= num_vertices;
-    center.z /= num_vertices;
-
-    // Loop through all vertices to calculate normals
-    for (int i = 0; i < vertices_size; i += 3)
+void Object::submit(RenderQueue& queue, StreamBuffer& stream, glm::mat4& view, glm::mat4& projection,
+                    glm::vec3 camera_position)
+/** Submits the draw of the Object considering lighting parameters from Light source objects, they are read from the
+"Lights" uniform buffer and the light texture buffers that are filled by Session::drawSession. The shader variant
+compiles only the code of the light types that are present (see setLightFeatures) and of specular highlights if they
+are on; it is selected now, as the queue sorts the draws by their programs. */
+{
+    unsigned int key = light_features_;
+    if (specular_)
+    {
+        key |= ShaderFeatures::SPECULAR;
+    }
+    useShaderVariant(key);
+    if (!asset_->arena_mesh.allocated())
     {
-        // Calculate the normal by subtracting the center position from each vertex
-        Vertex normal = {vertices[i] - center.x,
-                         vertices[i + 1] - center.y,
-                         vertices[i + 2] - center.z};
+        return;
+    }
+    queue.submit(RenderPass::CentralObject, shaderProgram_, MeshArena::shared().vao(asset_->arena_mesh), GL_FILL, [this, &stream, view, projection, camera_position]() {
+        drawBound(stream, view, projection, camera_position);
+    });
+}
 
-        // Calculate the length (magnitude) of the normal vector
-        float length  = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+void Object::drawWithProgram(const ShaderProgram& program, StreamBuffer& stream, glm::mat4& view,
+                             glm::mat4& projection, glm::vec3 camera_position)
+/** Render Object with another shader program that takes the same vertex attributes and uniform blocks as the Object's
+own program, e.g. the G-buffer pass of DeferredRenderer. */
+{
+    drawWith(program, stream, view, projection, camera_position);
+}
 
-        // Normalize the normal vector (make it unit length)
-        if (length > 0)
-        {
-            normal.x /= length;
-            normal.y /= length;
-            normal.z /= length;
-        }
-        normals.push_back(normal.x);
-        normals.push_back(normal.y);
-        normals.push_back(normal.z);
-    }
+void Object::drawShadowCaster(const ShaderProgram& program, const glm::mat4& light_view_projection)
+/** Draws the depth of all instances into a shadow map with a depth-only shader program (see ShadowAtlas). The level of
+detail is the one selected for the camera, meshlets are not culled. */
+{
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    program.use();
 
-    return normals;
+    program.setMat4(program.uniformLocation("lightViewProjection"), light_view_projection);
+    program.setMat4(program.uniformLocation("model"), getModelMatrix() * dequantizationMatrix());
+
+    uploadInstances();
+    glBindVertexArray(MeshArena::shared().vao(asset_->arena_mesh));
+    MeshArena::setupInstanceAttributes(instance_VBO_, 0);
+    drawLod(current_lod_);
 }
 
-FlashLightObject::FlashLightObject(const std::string &obj_filepath, const std::string &shader_vert,
-                                   const std::string &shader_frag, int id, int pick_id, float pick_r, float pick_g,
-                                   float pick_b): Object(obj_filepath, shader_vert, shader_frag), id_(id), pick_id_(pick_id) {
-    pick_rgb_[0] = pick_r/255.0;
-    pick_rgb_[1] = pick_g/255.0;
-    pick_rgb_[2] = pick_b/255.0;
+void Object::drawWith(const ShaderProgram& program, StreamBuffer& stream, glm::mat4& view, glm::mat4& projection,
+                      glm::vec3 camera_position)
+/** Draws all instances of the Object with a shader program right away (outside of the render queue). */
+{
+    // glPolygonMode sets the polygon drawing mode, determining how polygons will be rasterized.
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-    glGenVertexArrays(1, &arrow_VAO_);
-    glGenBuffers(1, &arrow_VBO_);
-    glGenBuffers(1, &arrow_EBO_);
+    // sets ShaderProgram with its id as active current shader program to use for subsequent drawing functions.
+    program.use();
+    // After binding VAO, OpenGL will use the vertex data, indices, and attribute configurations associated with this VAO for rendering.
+    glBindVertexArray(MeshArena::shared().vao(asset_->arena_mesh));
+    drawBound(stream, view, projection, camera_position);
 }
 
-void FlashLightObject::loadObjectBuffers()
-/** Loads data into all Object's buffers: vertices, indices, normals. */
+void Object::drawBound(StreamBuffer& stream, const glm::mat4& view, const glm::mat4& projection,
+                       const glm::vec3& camera_position)
+/** Draws all instances of the Object with the program and the VAO that are bound already (by drawWith or by the
+render queue) at the level of detail and with the meshlets chosen by prepareDraw, the material uniform buffer is
+uploaded only if the color changed. The VAO is shared with the other meshes of the pool, so the instance attributes
+are pointed at the instance buffer of the Object first. */
 {
-    Object::loadObjectBuffers();
-    // if the Light object has a type of spotlight, then additional VAO, VBO and EBO buffers for central arrow are loaded.
-    if (light_.type == 0)
+    std::copy(rgb_, rgb_ + 3, material_.color);
+    material_buffer_.update(&material_, sizeof(material_));
+    material_buffer_.bind();
+
+    // quantized vertex positions are converted back to object space by the model matrix; normals are not quantized,
+    // the uniform scale of the dequantization is still divided out of the normal matrix so that it stays the inverse
+    // transpose of the model matrix (the fragment shaders normalize the normals anyway). The camera position is used
+    // to calculate specular lighting on the central object.
+    bindTransforms(stream, view, projection, getModelMatrix() * dequantizationMatrix(),
+                   transform_.getNormalMatrix() * (1.0f / asset_->packed.dequantization_scale), camera_position);
+
+    uploadInstances();
+    MeshArena::setupInstanceAttributes(instance_VBO_, 0);
+    if (meshlet_draws_)
     {
-        glBindVertexArray(arrow_VAO_);
-
-        glBindBuffer(GL_ARRAY_BUFFER, arrow_VBO_);
-        glBufferData(GL_ARRAY_BUFFER,
-                     sizeof(GLfloat) * arrow_vertices_.size(),
-                     arrow_vertices_.data(),
-                     GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arrow_EBO_);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                     sizeof(GLuint) * arrow_indices_.size(),
-                     arrow_indices_.data(),
-                     GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, draw_counts_.data(), indexType(), draw_offsets_.data(),
+                                      static_cast<GLsizei>(draw_counts_.size()), draw_base_vertices_.data());
+    }
+    else
+    {
+        drawLod(current_lod_);
     }
 }
 
-bool FlashLightObject::checkPickColor(int pick_color_id) const
-/** Checks if Object's pick_color_id is equal to the provided id. */
+void Object::bindTransforms(StreamBuffer& stream, const glm::mat4& view, const glm::mat4& projection,
+                            const glm::mat4& model, const glm::mat3& normal_matrix, const glm::vec3& camera_position)
+/** Writes the "Transforms" block of a draw into the stream buffer and binds it, instead of setting the matrices as
+uniforms of the program one by one. */
 {
-    if (pick_color_id == pick_id_)
+    TransformsBlock transforms;
+    transforms.projection = projection;
+    transforms.view = view;
+    transforms.model = model;
+    for (int column = 0; column < 3; column++)
     {
-        return true;
+        transforms.normal_matrix[column] = glm::vec4(normal_matrix[column], 0.0f);
     }
-    return false;
+    transforms.view_pos = glm::vec4(camera_position, 1.0f);
+    stream.writeUniform(&transforms, sizeof(transforms)).bindUniform(UniformBuffer::TRANSFORMS_BINDING);
 }
 
-void FlashLightObject::draw(glm::mat4 &view, glm::mat4 &projection, bool get_pick_color)
-/** Render Light Object using OpenGL.*/
+void Object::cullMeshlets(JobSystem& jobs, const glm::mat4& view, const glm::mat4& projection,
+                          const glm::vec3& camera_position)
+/** Tests the meshlets of the current level of detail against the view frustum (bounding sphere against the six planes
+of projection * view) and against the camera position (normal cone) and collects index ranges of the visible meshlets
+for glMultiDrawElementsBaseVertex into draw_counts_, draw_offsets_ and draw_base_vertices_. The tests run in parallel jobs that only mark the meshlets,
+the ranges are collected in order afterwards: meshlets of a level are stored one after another in the index buffer, so
+consecutive visible meshlets are merged into one range. */
 {
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-    shaderProgram_.use();
-    glm::mat4 model = getTranslationMatrix(true);
+    // frustum planes in world space (Gribb and Hartmann), glm matrices are indexed as [column][row]
+    glm::mat4 clip = projection * view;
+    glm::vec4 planes[6];
+    for (int i = 0; i < 3; i++)
+    {
+        glm::vec4 row = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+        glm::vec4 w   = glm::vec4(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+        planes[i * 2]     = w + row;
+        planes[i * 2 + 1] = w - row;
+    }
+    for (auto& plane : planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
 
-    shaderProgram_.setMat4("projection", projection);
-    shaderProgram_.setMat4("view", view);
-    shaderProgram_.setMat4("model", model);
+    // visibility of every meshlet: 0 visible, 1 outside of the frustum, 2 facing away from the camera
+    MeshLod lod = asset_->mesh.lod(current_lod_);
+    meshlet_visibility_.resize(lod.meshlet_count);
+    JobCounter counter;
+    jobs.parallelFor("meshlet culling", counter, lod.meshlet_count, 256, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+        {
+            const Meshlet& meshlet = asset_->mesh.meshlets[lod.meshlet_offset + i];
+            // the model matrix is a uniform scale
+            glm::vec3 center = glm::vec3(meshlet.center[0], meshlet.center[1], meshlet.center[2]) * scale_;
+            float radius = meshlet.radius * scale_;
+
+            unsigned char visibility = 0;
+            for (const auto& plane : planes)
+            {
+                if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                {
+                    visibility = 1;
+                    break;
+                }
+            }
+            glm::vec3 to_center = center - camera_position;
+            glm::vec3 cone_axis = glm::vec3(meshlet.cone_axis[0], meshlet.cone_axis[1], meshlet.cone_axis[2]);
+            if (visibility == 0 && glm::dot(to_center, cone_axis) >= meshlet.cone_cutoff * glm::length(to_center) + radius)
+            {
+                visibility = 2;
+            }
+            meshlet_visibility_[i] = visibility;
+        }
+    });
+    jobs.wait(counter);
+
+    meshlet_cull_stats_ = MeshletCullStats();
+    meshlet_cull_stats_.meshlets  = lod.meshlet_count;
+    meshlet_cull_stats_.triangles = lod.index_count / 3;
+    draw_counts_.clear();
+    draw_offsets_.clear();
+    draw_base_vertices_.clear();
+    unsigned int range_end = 0;
+    for (unsigned int i = 0; i < lod.meshlet_count; i++)
+    {
+        const Meshlet& meshlet = asset_->mesh.meshlets[lod.meshlet_offset + i];
+        if (meshlet_visibility_[i] != 0)
+        {
+            if (meshlet_visibility_[i] == 1)
+            {
+                meshlet_cull_stats_.frustum_culled++;
+            }
+            else
+            {
+                meshlet_cull_stats_.backface_culled++;
+            }
+            meshlet_cull_stats_.culled_triangles += meshlet.index_count / 3;
+            continue;
+        }
+        if (!draw_counts_.empty() && range_end == meshlet.index_offset)
+        {
+            draw_counts_.back() += static_cast<GLsizei>(meshlet.index_count);
+        }
+        else
+        {
+            draw_counts_.push_back(static_cast<GLsizei>(meshlet.index_count));
+            draw_offsets_.push_back(indexPointer(meshlet.index_offset));
+            draw_base_vertices_.push_back(static_cast<GLint>(asset_->arena_mesh.first_vertex));
+        }
+        range_end = meshlet.index_offset + meshlet.index_count;
+    }
+    meshlet_cull_stats_.draws = draw_counts_.size();
+}
 
-    // if the Light object is picked, it's rendered with its pick_color (buffers will not be switched in this case)
-    if (get_pick_color)
+void Object::selectLod(JobSystem& jobs, const glm::mat4& projection, const glm::vec3& camera_position,
+                       float viewport_height)
+/** Picks the coarsest level of detail whose simplification error, projected on the screen, stays below LOD_ERROR_PIXELS.
+The error is projected at the point of the bounding sphere closest to the camera, all instances share the level,
+so the instance nearest to the camera decides (the instances are searched in parallel jobs). Starting from the current
+level, the level gets coarser only with a margin (LOD_HYSTERESIS), so it does not flicker around a switching distance. */
+{
+    size_t lod_count = asset_->mesh.lodCount();
+    if (lod_count <= 1)
     {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        shaderProgram_.setVec4("ourColor", pick_rgb_[0], pick_rgb_[1], pick_rgb_[2], 1.0f);
+        current_lod_ = 0;
+        return;
     }
-    else
+    const auto& bounds = asset_->mesh.bounds;
+    glm::vec3 bounds_min = glm::vec3(bounds.min[0], bounds.min[1], bounds.min[2]) * scale_;
+    glm::vec3 bounds_max = glm::vec3(bounds.max[0], bounds.max[1], bounds.max[2]) * scale_;
+    glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+    float radius   = glm::length(bounds_max - bounds_min) * 0.5f;
+    float distance = std::numeric_limits<float>::max();
+    std::mutex distance_mutex;
+    JobCounter counter;
+    jobs.parallelFor("LOD selection", counter, instances_.size(), 1024, [&](size_t first, size_t last) {
+        float nearest = std::numeric_limits<float>::max();
+        for (size_t i = first; i < last; i++)
+        {
+            glm::vec3 instance_center = glm::vec3(instances_[i].model * glm::vec4(center, 1.0f));
+            nearest = std::min(nearest, glm::length(camera_position - instance_center) - radius);
+        }
+        std::lock_guard<std::mutex> lock(distance_mutex);
+        distance = std::min(distance, nearest);
+    });
+    jobs.wait(counter);
+    if (distance <= 0)
     {
-        shaderProgram_.setVec4("ourColor", 1, 1, 1, 1.0f);
+        current_lod_ = 0;
+        return;
     }
 
-    glBindVertexArray(VAO_);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices_.size()), GL_UNSIGNED_INT, 0);
+    // projection[1][1] is cot(fov / 2): a length l at the distance d covers l * projection[1][1] / d of the half viewport height
+    float pixels_per_unit = projection[1][1] / distance * viewport_height * 0.5f * scale_;
+    auto projectedError = [&](size_t lod) {
+        return asset_->mesh.lod(lod).error * pixels_per_unit;
+    };
 
-    // if the Light object has a type of spotlight, then the arrow through the center of Flashlight object is rendered
-    if (light_.type == 0)
+    size_t lod = current_lod_ < lod_count ? current_lod_ : lod_count - 1;
+    while (lod + 1 < lod_count && projectedError(lod + 1) <= LOD_ERROR_PIXELS * LOD_HYSTERESIS)
+    {
+        lod++;
+    }
+    while (lod > 0 && projectedError(lod) > LOD_ERROR_PIXELS)
     {
-        shaderProgram_.setVec4("ourColor", light_.rgb[0], light_.rgb[1], light_.rgb[2], 1.0f);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glBindVertexArray(arrow_VAO_);
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(arrow_indices_.size()), GL_UNSIGNED_INT, 0);
+        lod--;
     }
+    current_lod_ = lod;
 }
 
-void FlashLightObject::rotateObject(float delta_x, float delta_y)
-/** Adjusts the rotation of a Light object based on the changes in the x-axis (delta_x) and y-axis (delta_y).*/
+void Object::drawLod(size_t level) const
+/** Draws the index range of one level of detail for all instances, the VAO of the pool of the Object has to be bound
+and its instance attributes pointed at the instances. */
 {
-    light_obj_params_[light_.type].frame_rotate_xy_[0] += delta_y*20;
-    light_obj_params_[light_.type].frame_rotate_xy_[1] += delta_x*20;
+    MeshLod lod = asset_->mesh.lod(level);
+    // glDrawElementsInstancedBaseVertex draws the elements of the currently bound VAO once per instance, the indices of
+    // the mesh are relative to its first vertex in the pool.
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(lod.index_count), indexType(),
+                                      indexPointer(lod.index_offset), static_cast<GLsizei>(instances_.size()),
+                                      static_cast<GLint>(asset_->arena_mesh.first_vertex));
 }
 
-void FlashLightObject::reset()
-/** Resets the rotation of the Light object to its original state by setting the rotation angles to zero.*/
+GLenum Object::indexType() const
+/** Returns the type of the indices in the element buffer: 16-bit for meshes with fewer than 65536 vertices. */
 {
-    light_obj_params_[light_.type].frame_rotate_xy_[0] = 0;
-    light_obj_params_[light_.type].frame_rotate_xy_[1] = 0;
-    rotateObject();
+    return asset_->packed.index_size == sizeof(GLushort) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 }
 
-glm::mat4 FlashLightObject::getTranslationMatrix(bool initial_rotate)
-/** Constructs and returns the transformation matrix for the Light object.
-The matrix includes translation, optional initial rotation, dynamic frame rotation, and scaling transformations applied to the object.*/
+const void* Object::indexPointer(size_t first_index) const
+/** Returns the offset of an index of the mesh in the element buffer of its pool, as a pointer for the draw calls. */
+{
+    return reinterpret_cast<const void*>(static_cast<uintptr_t>(asset_->arena_mesh.index_offset + asset_->packed.index_size * first_index));
+}
+
+glm::mat4 Object::dequantizationMatrix() const
+/** Returns the transform from packed vertex positions to object space (identity for float positions). */
+{
+    glm::mat4 dequantization = glm::translate(glm::mat4(1.0f), glm::vec3(asset_->packed.dequantization_offset[0],
+                                                                          asset_->packed.dequantization_offset[1],
+                                                                          asset_->packed.dequantization_offset[2]));
+    return glm::scale(dequantization, glm::vec3(asset_->packed.dequantization_scale));
+}
+
+std::vector<float> Object::calculateNormalsSimple(std::vector<float> vertices)
+/** Calculates normal by first determining the geometric center of the object, then computes the direction
+from the center to each vertex and normalizes these directions to unit length. */
 {
-    // the order of applied transformations (from right to left): scaling -> rotation -> translation.
-    glm::mat4 model = glm::mat4(1.0f);
-    translate_vec_ = glm::vec3(xyz_[0], xyz_[1], xyz_[2]);
+    size_t num_vertices = vertices.size() / 3;
+    SoaVectors directions;
+    directions.assign(vertices.data(), num_vertices);
 
-    model = glm::translate(model, translate_vec_);
-    if (initial_rotate)
+    // Compute the center of the object
+    float center[3];
+    GeometryKernels::centroid(directions, center);
+
+    // Direction from the center to each vertex, normalized to unit length
+    for (size_t i = 0; i < num_vertices; i++)
     {
-        model = glm::rotate(model, glm::radians(light_obj_params_[light_.type].initial_rotate), light_obj_params_[light_.type].rotate_vec);
+        directions.x[i] -= center[0];
+        directions.y[i] -= center[1];
+        directions.z[i] -= center[2];
     }
-    model = glm::rotate(model, glm::radians(light_obj_params_[light_.type].frame_rotate_xy_[0]), glm::vec3(1.0f, 0.0f, 0.0f));
-    model = glm::rotate(model, glm::radians(light_obj_params_[light_.type].frame_rotate_xy_[1]), glm::vec3(0.0f, 0.0f, 1.0f));
+    GeometryKernels::normalize(directions, 0, num_vertices);
+
+    std::vector<float> normals(num_vertices * 3);
+    directions.store(normals.data());
+    return normals;
+}
 
-    model = glm::scale(model, glm::vec3(light_obj_params_[light_.type].scale));
+FlashLightObject::FlashLightObject(int id): id_(id) {
+    // the light shines along the arrow of the gizmo, from (0, 8, 0) to (0, -3, 0) in the frame of the Light object
+    transform_.setForward(glm::vec3(0.0f, -11.0f, 0.0f));
+}
+
+MeshData FlashLightObject::arrowMesh()
+/** Returns the mesh of the arrow through the center of the Flashlight object, it is shared by all spotlights. */
+{
+    MeshData arrow;
+    arrow.vertices = { -0.05f, 0.0f, -3.0f,
+                       0.05f, 0.0f, -3.0f,
+                       -0.05f, 0.0f, 8.0f,
+                       0.05f, 0.0f, 8.0f,
+
+                       -1.0f,  0.0f, 8.0f,
+                       0.0f, 0.1f, 9.0f,
+                       1.0f,  0.0f, 8.0f,
+    };
+    arrow.indices = {
+            0,2,3,
+            0,1,3,
+            4,5,6
+    };
+    arrow.computeBounds();
+    return arrow;
+}
 
-    return model;
+InstanceData FlashLightObject::getGizmoInstance()
+/** Returns the instance of the Light object in the gizmo mesh of its type, gizmos are drawn white. The model matrix
+is also the transform of the gizmo for ray casts (see Picker). */
+{
+    updateTransform_();
+    InstanceData instance;
+    instance.model = transform_.getAlignedMatrix();
+    instance.color = glm::vec4(1.0f);
+    return instance;
 }
 
-glm::vec3 FlashLightObject::getFlashLightDirection()
-/** Calculates and returns the direction vector of the Light object by transforming a start and end point using
-the object's transformation matrix. */
+InstanceData FlashLightObject::getArrowInstance()
+/** Returns the instance of the spotlight arrow, the arrow is drawn in the light color. */
 {
-    // Define the start and end points of the Light object's direction vector
-    glm::vec3 dir_start = glm::vec3(0.0, 8.0, 0.0);
-    glm::vec3 dir_end = glm::vec3(0.0, -3.0, 0.0);
+    updateTransform_();
+    InstanceData instance;
+    instance.model = transform_.getAlignedMatrix();
+    instance.color = glm::vec4(light_.rgb[0], light_.rgb[1], light_.rgb[2], 1.0f);
+    return instance;
+}
 
-    // Get the current transformation matrix that includes all transformations
-    glm::mat4 model = getTranslationMatrix();
-    // Apply translation and scaling
-    glm::vec4 transformedStart = model * glm::vec4(dir_start, 1.0);
-    glm::vec4 transformedEnd = model * glm::vec4(dir_end, 1.0);
+void FlashLightObject::rotateObject(float delta_x, float delta_y)
+/** Adjusts the rotation of a Light object based on the changes in the x-axis (delta_x) and y-axis (delta_y).*/
+{
+    light_obj_params_[light_.type].frame_rotate_xy_[0] += delta_y*20;
+    light_obj_params_[light_.type].frame_rotate_xy_[1] += delta_x*20;
+    shadow_dirty_ = true;
+}
 
-    // Calculate the direction vector by subtracting the transformed start point from the end point
-    glm::vec3 result = glm::vec3(transformedEnd) - glm::vec3(transformedStart);
+bool FlashLightObject::takeShadowDirty()
+/** Returns true if the light moved, turned, changed its type or its cone since the previous call, i.e. its shadow map
+has to be rendered again, and clears the dirty flag. The GUI changes xyz_ and frame_rotate_xy_ through pointers,
+so they are compared with their values at the previous call. */
+{
+    const float* rotation = light_obj_params_[light_.type].frame_rotate_xy_;
+    const float state[7] = {xyz_[0], xyz_[1], xyz_[2], rotation[0], rotation[1], static_cast<float>(light_.type),
+                            light_.outerCutOff};
+    bool dirty = shadow_dirty_ || !std::equal(state, state + 7, shadow_state_);
+    std::copy(state, state + 7, shadow_state_);
+    shadow_dirty_ = false;
+    return dirty;
+}
 
-    return result;
+bool FlashLightObject::takeChanged()
+/** Returns true if anything that is drawn or lights the scene changed since the previous call: position, rotation,
+type, color, the light parameters, the light switch or its GUI panel (see Session::takeChanged). */
+{
+    const float* rotation = light_obj_params_[light_.type].frame_rotate_xy_;
+    const float state[16] = {xyz_[0], xyz_[1], xyz_[2], rotation[0], rotation[1], static_cast<float>(light_.type),
+                             light_.rgb[0], light_.rgb[1], light_.rgb[2], light_.intensity, light_.linear,
+                             light_.quadratic, light_.cutOff, light_.outerCutOff, lightOnOff_ ? 1.0f : 0.0f,
+                             object_gui_ ? 1.0f : 0.0f};
+    bool changed = !std::equal(state, state + 16, redraw_state_);
+    std::copy(state, state + 16, redraw_state_);
+    return changed;
 }
 
-glm::vec3 FlashLightObject::getFlashLightPosition()
-/** Calculates and returns the position of the Light object by transforming its origin (center) point using
-the object's transformation matrix.*/
+void FlashLightObject::reset()
+/** Resets the rotation of the Light object to its original state by setting the rotation angles to zero.*/
 {
-    // define the default center point of the Light object
-    glm::vec3 center = glm::vec3(0.0, 0.0, 0.0);
-    // Get the current transformation matrix that includes all transformations
-    glm::mat4 model = getTranslationMatrix();
-    // Transform the center point using the transformation matrix
-    glm::vec4 transformedCenter = model * glm::vec4(center, 1.0);
+    light_obj_params_[light_.type].frame_rotate_xy_[0] = 0;
+    light_obj_params_[light_.type].frame_rotate_xy_[1] = 0;
+    rotateObject();
+}
 
-    return transformedCenter;
+void FlashLightObject::updateTransform_()
+/** Passes the position and the rotation (edited by the GUI through pointers) and the scale and alignment of the
+current type to the transform, which computes its matrices again only if one of them changed. */
+{
+    const LightObjParams& params = light_obj_params_[light_.type];
+    transform_.setTranslation(glm::vec3(xyz_[0], xyz_[1], xyz_[2]));
+    transform_.setRotation(glm::vec3(params.frame_rotate_xy_[0], 0.0f, params.frame_rotate_xy_[1]));
+    transform_.setAlignment(params.initial_rotate, params.rotate_vec);
+    transform_.setScale(params.scale);
 }
 
 Light &FlashLightObject::getLight()
 /** Updates the flashlight's direction and position based on its current transformations and returns
 a reference to the Light struct. */
 {
-    light_.light_dir = getFlashLightDirection();
-    light_.light_pos = getFlashLightPosition();
+    updateTransform_();
+    light_.light_dir = transform_.getDirection();
+    light_.light_pos = transform_.getPosition();
 
     return light_;
 }
 
+GizmoObject::GizmoObject(const std::string &obj_filepath, const std::string &shader_vert, const std::string &shader_frag)
+        : Object(obj_filepath, shader_vert, shader_frag){}
+
+GizmoObject::GizmoObject(MeshData mesh, const std::string &shader_vert, const std::string &shader_frag)
+        : Object(std::move(mesh), PackedMesh(), shader_vert, shader_frag){}
+
+void GizmoObject::submit(RenderQueue& queue, StreamBuffer& stream, glm::mat4 &view, glm::mat4 &projection,
+                         bool wireframe)
+/** Submits all instances of the gizmo as one draw command of the gizmo batch. The instances change every frame, so they
+are written into the stream buffer, with the dequantization of the mesh in their model matrices: the gizmos of one
+polygon mode share the VAO of their pool and the transforms, the queue binds the transforms once and draws them one
+after another. */
+{
+    if (!asset_->arena_mesh.allocated())
+    {
+        return;
+    }
+    // the per-instance model matrix is applied after the conversion of quantized positions to object space
+    glm::mat4 dequantization = dequantizationMatrix();
+    stream_instances_.resize(instances_.size());
+    for (size_t i = 0; i < instances_.size(); i++)
+    {
+        stream_instances_[i].model = instances_[i].model * dequantization;
+        stream_instances_[i].color = instances_[i].color;
+    }
+    StreamRange instances = stream.write(stream_instances_.data(), stream_instances_.size() * sizeof(InstanceData));
+
+    MeshLod lod = asset_->mesh.lod(0);
+    DrawElementsCommand command;
+    command.count = static_cast<GLsizei>(lod.index_count);
+    command.index_type = indexType();
+    command.index_offset = static_cast<GLintptr>(reinterpret_cast<uintptr_t>(indexPointer(lod.index_offset)));
+    command.base_vertex = static_cast<GLint>(asset_->arena_mesh.first_vertex);
+    command.instance_count = static_cast<GLsizei>(instances_.size());
+    command.instance_buffer = instances.buffer;
+    command.instance_offset = instances.offset;
+    queue.submitBatched(RenderPass::LightGizmos, shaderProgram_, MeshArena::shared().vao(asset_->arena_mesh),
+                        wireframe ? GL_LINE : GL_FILL, &gizmo_batch, [&stream, view, projection]() {
+        bindTransforms(stream, view, projection, glm::mat4(1.0f), glm::mat3(1.0f), glm::vec3(0.0f));
+    }, command);
+}
+
 AxisObject::AxisObject(const std::string &shader_vert, const std::string &shader_frag)
         : Object("", shader_vert, shader_frag){
 
     // A single vertex of an ais-arrow consists of position and color values: x, y, z, r,g,b
-    vertices_ = {
+    asset_->mesh.vertices = {
                  -axis_scale_, 0,0, 1.0f, 0.0f, 0.0f,  // vertex 1: red
                  axis_scale_, 0,0, 1.0f, 0.0f, 0.0f,  // vertex 2: red
                  0, -axis_scale_, 0, 0.0f, 1.0f, 0.0f,  // vertex 3: green
@@ -388,60 +789,66 @@ AxisObject::AxisObject(const std::string &shader_vert, const std::string &shader
                        3,4,5,
                        6,7,8};
 
+    glGenVertexArrays(1, &VAO_);
+    glGenBuffers(1, &VBO_);
+    glGenVertexArrays(1, &arrows_VAO_);
     glGenBuffers(1, &arrows_VBO_);
     glGenBuffers(1, &arrows_EBO_);
 
 }
 
 void AxisObject::loadObjectBuffers()
-/** Loads data into all Object's buffers: vertices (position + color), indices. */
+/** Loads data into all Object's buffers: vertices (position + color), indices. The attributes of the lines and of
+the arrow heads are defined once in their VAOs. */
 {
     glBindVertexArray(VAO_);
-
     glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-    glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(float), vertices_.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, asset_->mesh.vertices.size() * sizeof(float), asset_->mesh.vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
 
+    glBindVertexArray(arrows_VAO_);
     glBindBuffer(GL_ARRAY_BUFFER, arrows_VBO_);
     glBufferData(GL_ARRAY_BUFFER,
                  sizeof(GLfloat) * arrows_vertices_.size(),
                  arrows_vertices_.data(),
                  GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arrows_EBO_);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER,
                  sizeof(GLuint) * arrows_indices_.size(),
                  arrows_indices_.data(),
                  GL_STATIC_DRAW);
+    glBindVertexArray(0);
 }
 
-void AxisObject::draw(glm::mat4 &view, glm::mat4 &projection)
-/** Render coordinate system using OpenGL. */
+void AxisObject::releaseBuffers()
+/** Deletes the VAOs and buffers of the lines and of the arrow heads in addition to the buffers of every Object. */
 {
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-    shaderProgram_.use();
-
-    shaderProgram_.setMat4("projection", projection);
-    shaderProgram_.setMat4("view", view);
-    shaderProgram_.setMat4("model", model_);
-
-    glBindVertexArray(VAO_);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glDrawArrays(GL_LINES, 0, vertices_.size());
-
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-
-    glBindBuffer(GL_ARRAY_BUFFER, arrows_VBO_);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    glDeleteVertexArrays(1, &VAO_);
+    glDeleteBuffers(1, &VBO_);
+    glDeleteVertexArrays(1, &arrows_VAO_);
+    glDeleteBuffers(1, &arrows_VBO_);
+    glDeleteBuffers(1, &arrows_EBO_);
+    VAO_ = VBO_ = arrows_VAO_ = arrows_VBO_ = arrows_EBO_ = 0;
+    Object::releaseBuffers();
+}
 
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(arrows_indices_.size()), GL_UNSIGNED_INT, 0);
+void AxisObject::submit(RenderQueue& queue, StreamBuffer& stream, glm::mat4 &view, glm::mat4 &projection)
+/** Submits the coordinate system: the lines (independent of the polygon mode) and the filled arrow heads. */
+{
+    queue.submit(RenderPass::Axes, shaderProgram_, VAO_, RenderQueue::ANY_POLYGON_MODE, [this, &stream, view, projection]() {
+        bindTransforms(stream, view, projection, model_, glm::mat3(1.0f), glm::vec3(0.0f));
+        glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(asset_->mesh.vertices.size() / 6));
+    });
+    queue.submit(RenderPass::Axes, shaderProgram_, arrows_VAO_, GL_FILL, [this, &stream, view, projection]() {
+        bindTransforms(stream, view, projection, model_, glm::mat3(1.0f), glm::vec3(0.0f));
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(arrows_indices_.size()), GL_UNSIGNED_INT, 0);
+    });
 }
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "../include/parallel.h"
+
+
+unsigned int Parallel::threadCount(size_t items_count, size_t min_items_per_thread, unsigned int requested)
+/** Returns the amount of threads to use: the requested one or the hardware concurrency, limited so that
+every thread gets at least min_items_per_thread items. */
+{
+    if (requested == 0)
+    {
+        requested = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t useful_threads = std::max<size_t>(1, items_count / std::max<size_t>(1, min_items_per_thread));
+
+    return static_cast<unsigned int>(std::min<size_t>(requested, useful_threads));
+}
+
+void Parallel::forChunks(size_t count, unsigned int thread_count, const std::function<void(size_t, size_t)>& task)
+/** Splits range [0, count) into thread_count contiguous chunks and runs the task for every chunk.
+The last chunk is processed on the calling thread. */
+{
+    if (thread_count <= 1 || count < thread_count)
+    {
+        task(0, count);
+        return;
+    }
+    size_t chunk = (count + thread_count - 1) / thread_count;
+
+    forEachChunk(thread_count, [&](unsigned int i) {
+        size_t first = std::min(count, i * chunk);
+        task(first, std::min(count, first + chunk));
+    });
+}
+
+void Parallel::forEachChunk(unsigned int chunks_count, const std::function<void(unsigned int)>& task)
+/** Runs task(i) for every i in [0, chunks_count), each on its own thread; the last one runs on the calling thread. */
+{
+    if (chunks_count == 0)
+    {
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i + 1 < chunks_count; i++)
+    {
+        workers.emplace_back(task, i);
+    }
+    task(chunks_count - 1);
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
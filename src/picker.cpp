@@ -0,0 +1,128 @@
+#include <chrono>
+#include "../include/picker.h"
+
+PickResult Picker::pick(const Ray& ray, const Object& central_object, unsigned int central_mesh_version,
+                        unsigned int central_layout_version, const std::vector<GizmoObject>& light_gizmos,
+                        std::vector<FlashLightObject>& light_objects)
+/** Returns the nearest Light object gizmo or copy of the central object hit by the ray. Gizmos are tested first:
+they are small and usually in front, so the central object is tested only up to the nearest gizmo hit. */
+{
+    auto start = std::chrono::steady_clock::now();
+    updateCentralObject_(central_object, central_mesh_version, central_layout_version);
+    updateLights_(light_gizmos, light_objects);
+
+    PickResult result;
+    float nearest = FLT_MAX;
+    int hit = -1;
+    nearest = lights_bvh_.intersect(ray, nearest, [this](unsigned int light, const Ray& r, float max_distance) {
+        return gizmo_bvhs_[light_types_[light]].intersect(r.transformed(light_to_object_[light]), max_distance);
+    }, &hit);
+    if (hit >= 0)
+    {
+        result.target = PickTarget::Light;
+        result.index = hit;
+    }
+
+    hit = -1;
+    float central_distance = central_copies_bvh_.intersect(ray, nearest, [this](unsigned int copy, const Ray& r, float max_distance) {
+        return central_mesh_bvh_.intersect(r.transformed(central_to_object_[copy]), max_distance);
+    }, &hit);
+    if (hit >= 0)
+    {
+        result.target = PickTarget::CentralObject;
+        result.index = hit;
+        nearest = central_distance;
+    }
+
+    if (result.target != PickTarget::None)
+    {
+        result.distance = nearest * glm::length(ray.direction);
+        result.point = ray.at(nearest);
+    }
+    result.time_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+size_t Picker::nodeCount() const
+/** Returns the number of nodes of all hierarchies (shown in the menu). */
+{
+    size_t nodes = central_mesh_bvh_.nodeCount() + central_copies_bvh_.nodeCount() + lights_bvh_.nodeCount();
+    for (const auto& gizmo_bvh : gizmo_bvhs_)
+    {
+        nodes += gizmo_bvh.nodeCount();
+    }
+    return nodes;
+}
+
+void Picker::updateCentralObject_(const Object& central_object, unsigned int mesh_version, unsigned int layout_version)
+/** Rebuilds the triangle hierarchy of the central mesh if the mesh was replaced and the hierarchy of its copies if
+they were moved or scaled. */
+{
+    if (mesh_version != central_mesh_version_)
+    {
+        central_mesh_bvh_.build(central_object.getMesh());
+        central_mesh_version_ = mesh_version;
+        central_layout_version_ = 0;
+    }
+    if (layout_version == central_layout_version_)
+    {
+        return;
+    }
+    const auto& instances = central_object.getInstances();
+    Aabb mesh_bounds;
+    const MeshBounds& bounds = central_object.getMesh().bounds;
+    mesh_bounds.grow(glm::vec3(bounds.min[0], bounds.min[1], bounds.min[2]));
+    mesh_bounds.grow(glm::vec3(bounds.max[0], bounds.max[1], bounds.max[2]));
+
+    std::vector<Aabb> boxes(instances.size());
+    central_to_object_.resize(instances.size());
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        glm::mat4 object_to_world = instances[i].model * central_object.getModelMatrix();
+        boxes[i] = mesh_bounds.transformed(object_to_world);
+        central_to_object_[i] = glm::inverse(object_to_world);
+    }
+    central_copies_bvh_.build(boxes);
+    central_layout_version_ = layout_version;
+}
+
+void Picker::updateLights_(const std::vector<GizmoObject>& light_gizmos, std::vector<FlashLightObject>& light_objects)
+/** Builds the triangle hierarchies of the gizmo meshes once and the hierarchy of the Light objects from their
+current transforms. */
+{
+    if (gizmo_bvhs_.size() != light_gizmos.size())
+    {
+        gizmo_bvhs_.resize(light_gizmos.size());
+        for (size_t type = 0; type < light_gizmos.size(); type++)
+        {
+            gizmo_bvhs_[type].build(light_gizmos[type].getMesh());
+        }
+    }
+
+    std::vector<Aabb> boxes;
+    light_to_object_.clear();
+    light_types_.clear();
+    for (auto& light_object : light_objects)
+    {
+        auto type = static_cast<size_t>(light_object.lightObjectType());
+        Aabb box;
+        // gizmo meshes are drawn with the instance transforms only, their scale is part of the Light object
+        glm::mat4 object_to_world = light_object.getGizmoInstance().model;
+        // Light objects without a gizmo mesh (the gizmos are not loaded) get an empty box, rays never reach them
+        if (type < light_gizmos.size())
+        {
+            const MeshBounds& bounds = light_gizmos[type].getMesh().bounds;
+            box.grow(glm::vec3(bounds.min[0], bounds.min[1], bounds.min[2]));
+            box.grow(glm::vec3(bounds.max[0], bounds.max[1], bounds.max[2]));
+            box = box.transformed(object_to_world);
+        }
+        else
+        {
+            type = 0;
+        }
+        boxes.push_back(box);
+        light_to_object_.push_back(glm::inverse(object_to_world));
+        light_types_.push_back(type);
+    }
+    lights_bvh_.build(boxes);
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include "../include/render_queue.h"
+#include "../include/mesh_arena.h"
+
+void RenderQueue::submit(RenderPass pass, const ShaderProgram& program, GLuint vao, GLenum polygon_mode,
+                         std::function<void()> draw)
+/** Adds a draw to the queue of the frame. The program has to stay alive until the queue is executed. */
+{
+    std::uint64_t polygon_bits = polygon_mode == GL_LINE ? 1u : (polygon_mode == GL_POINT ? 2u : 0u);
+    std::uint64_t key = (static_cast<std::uint64_t>(pass) & 0xFFu) << 56 |
+                        (static_cast<std::uint64_t>(program.id()) & 0xFFFFu) << 40 |
+                        (static_cast<std::uint64_t>(vao) & 0xFFFFu) << 24 |
+                        polygon_bits << 22 |
+                        (static_cast<std::uint64_t>(packets_.size()) & 0x3FFFFFu);
+    packets_.push_back(Packet{key, pass, &program, vao, polygon_mode, std::move(draw), nullptr, DrawElementsCommand()});
+}
+
+void RenderQueue::submitBatched(RenderPass pass, const ShaderProgram& program, GLuint vao, GLenum polygon_mode,
+                                const void* batch, std::function<void()> setup, const DrawElementsCommand& command)
+/** Adds a draw command of a batch to the queue of the frame. All packets of a batch must have equal setup functions
+(they set the same uniform blocks), the setup of any of them is called for a run of packets of the batch. */
+{
+    submit(pass, program, vao, polygon_mode, std::move(setup));
+    packets_.back().batch = batch;
+    packets_.back().command = command;
+}
+
+void RenderQueue::execute(GpuProfiler& profiler)
+/** Draws the packets in the order of their keys and clears the queue. Every pass is measured by the GPU profiler. */
+{
+    order_.resize(packets_.size());
+    for (size_t i = 0; i < packets_.size(); i++)
+    {
+        order_[i] = i;
+    }
+    std::sort(order_.begin(), order_.end(), [this](size_t a, size_t b) {return packets_[a].key < packets_[b].key;});
+
+    stats_ = RenderQueueStats();
+    stats_.packets = packets_.size();
+    stats_.immediate_changes = 3 * packets_.size();
+    // 0 is never a program or VAO of a packet, the state is set by the first packet
+    GLuint current_program = 0;
+    GLuint current_vao = 0;
+    GLenum current_polygon_mode = ANY_POLYGON_MODE;
+    bool pass_open = false;
+    RenderPass current_pass = RenderPass::CentralObject;
+    // batch whose setup is in effect, a packet that changes the state or draws by itself ends it
+    const void* current_batch = nullptr;
+    for (size_t index : order_)
+    {
+        const Packet& packet = packets_[index];
+        if (!pass_open || packet.pass != current_pass)
+        {
+            if (pass_open)
+            {
+                profiler.endPass(gpuPass_(current_pass));
+            }
+            profiler.beginPass(gpuPass_(packet.pass));
+            current_pass = packet.pass;
+            pass_open = true;
+            current_batch = nullptr;
+        }
+        if (packet.polygon_mode != ANY_POLYGON_MODE && packet.polygon_mode != current_polygon_mode)
+        {
+            glPolygonMode(GL_FRONT_AND_BACK, packet.polygon_mode);
+            current_polygon_mode = packet.polygon_mode;
+            stats_.polygon_mode_changes++;
+            current_batch = nullptr;
+        }
+        if (packet.program->id() != current_program)
+        {
+            packet.program->use();
+            current_program = packet.program->id();
+            stats_.program_changes++;
+            current_batch = nullptr;
+        }
+        if (packet.vao != current_vao)
+        {
+            glBindVertexArray(packet.vao);
+            current_vao = packet.vao;
+            stats_.vao_changes++;
+            current_batch = nullptr;
+        }
+        if (packet.batch == nullptr)
+        {
+            packet.draw();
+            current_batch = nullptr;
+            continue;
+        }
+        if (packet.batch == current_batch)
+        {
+            stats_.batched_draws++;
+        }
+        else
+        {
+            packet.draw();
+            current_batch = packet.batch;
+        }
+        drawCommand_(packet.command);
+    }
+    if (pass_open)
+    {
+        profiler.endPass(gpuPass_(current_pass));
+    }
+    // the other passes (shadow maps, G-buffer, ImGui) expect filled polygons
+    if (current_polygon_mode != GL_FILL)
+    {
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        stats_.polygon_mode_changes++;
+    }
+    packets_.clear();
+}
+
+GpuPass RenderQueue::gpuPass_(RenderPass pass)
+{
+    switch (pass)
+    {
+        case RenderPass::CentralObject:
+            return GpuPass::CentralObject;
+        case RenderPass::LightGizmos:
+            return GpuPass::LightGizmos;
+        default:
+            return GpuPass::Axes;
+    }
+}
+
+void RenderQueue::drawCommand_(const DrawElementsCommand& command)
+/** Points the instance attributes of the bound VAO at the instances of the command and draws them. */
+{
+    MeshArena::setupInstanceAttributes(command.instance_buffer, command.instance_offset);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, command.index_type,
+                                      reinterpret_cast<const void*>(static_cast<uintptr_t>(command.index_offset)),
+                                      command.instance_count, command.base_vertex);
+}
@@ -1,6 +1,9 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
 #include "portable-file-dialogs.h"
 #include "../include/session.h"
 
@@ -9,10 +12,146 @@ void Session::loadCentralObject(const std::string& obj_filepath )
 /** Loads a central object from a specified OBJ file into the session.
 The object is initialized by loading its buffer data.*/
 {
+    central_object_loader_.cancel();
+    for (auto& central_obj: central_objects_)
+    {
+        central_obj.releaseBuffers();
+    }
     central_objects_.clear();
-    Object central_object = Object(obj_filepath, "../shaders/shader_central.vert", "../shaders/shader_central.frag");
+    central_object_path_ = obj_filepath;
+    Object central_object = Object(obj_filepath, "../shaders/shader_central.vert", "../shaders/shader_central.frag", central_load_options_);
     central_object.loadObjectBuffers();
     central_objects_.push_back(std::move(central_object));
+    central_copies_dirty_ = true;
+    shadow_casters_version_++;
+    central_mesh_version_++;
+}
+
+void Session::loadCentralMesh(MeshData mesh)
+/** Replaces the central object with an object built from a mesh in memory (generated scenes of lighting_bench),
+the mesh is packed in the default vertex format. */
+{
+    central_object_loader_.cancel();
+    for (auto& central_obj: central_objects_)
+    {
+        central_obj.releaseBuffers();
+    }
+    central_objects_.clear();
+    central_object_path_.clear();
+    Object central_object = Object(std::move(mesh), PackedMesh(), "../shaders/shader_central.vert", "../shaders/shader_central.frag");
+    central_object.loadObjectBuffers();
+    central_objects_.push_back(std::move(central_object));
+    central_copies_dirty_ = true;
+    shadow_casters_version_++;
+    central_mesh_version_++;
+}
+
+void Session::loadCentralObjectAsync(const std::string& obj_filepath)
+/** Starts loading a new central object in the background. The current central object is drawn until the new one
+is parsed and uploaded (see 'update'), a load that is still in progress is cancelled. */
+{
+    keep_central_object_appearance_ = false;
+    central_object_loader_.start(obj_filepath, central_load_options_);
+}
+
+void Session::update()
+/** Per-frame housekeeping that has to run on the render thread: advances the background load of the central object
+and replaces the central object once the new one is ready, places copies of the central object if their number or
+the scale changed. Load errors are shown as a notification. */
+{
+    auto new_object = central_object_loader_.update();
+    if (new_object)
+    {
+        if (!central_objects_.empty())
+        {
+            auto& old_object = central_objects_[0];
+            if (keep_central_object_appearance_)
+            {
+                std::copy(old_object.getObjectColor(), old_object.getObjectColor() + 3, new_object->getObjectColor());
+                new_object->getScale() = old_object.getScale();
+                new_object->specularHighlights() = old_object.specularHighlights();
+            }
+            old_object.releaseBuffers();
+        }
+        central_objects_.clear();
+        central_objects_.push_back(std::move(*new_object));
+        central_object_path_ = central_object_loader_.filepath();
+        central_copies_dirty_ = true;
+        shadow_casters_version_++;
+        central_mesh_version_++;
+    }
+    if (!central_objects_.empty() && (central_copies_dirty_ || central_objects_[0].getScale() != central_copies_scale_))
+    {
+        layoutCentralCopies_();
+    }
+
+    auto error = central_object_loader_.takeError();
+    if (!error.empty())
+    {
+        pfd::notify("System event", error, pfd::icon::error);
+    }
+}
+
+void Session::setCentralObjectLoadOptions(const MeshLoadOptions& options)
+/** Changes how the central object is loaded (normal weighting, mesh optimization) and reloads the central object
+in the background if the options changed. Color and scale of the current central object are kept. */
+{
+    if (options == central_load_options_)
+    {
+        return;
+    }
+    central_load_options_ = options;
+    if (!central_object_path_.empty())
+    {
+        central_object_loader_.start(central_object_path_, central_load_options_);
+        keep_central_object_appearance_ = true;
+    }
+}
+
+void Session::setCentralObjectCopies(int copies)
+/** Changes the number of copies of the central object, all copies are drawn with one instanced draw call. */
+{
+    copies = std::max(1, copies);
+    if (copies != central_copies_)
+    {
+        central_copies_ = copies;
+        central_copies_dirty_ = true;
+    }
+}
+
+int Session::copiesGridSide_() const
+/** Returns the number of copies along an edge of the cubic grid, the smallest side whose cube holds all copies
+(counted in integers, std::cbrt(27.0) is slightly above 3). */
+{
+    int side = 1;
+    while (side * side * side < central_copies_)
+    {
+        side++;
+    }
+    return side;
+}
+
+void Session::layoutCentralCopies_()
+/** Places copies of the central object on a cubic grid centered in the origin, neighbouring copies are COPIES_SPACING
+bounding radii apart. A single copy stays in the origin. */
+{
+    Object& central_object = central_objects_[0];
+    int side = copiesGridSide_();
+    float spacing = COPIES_SPACING * central_object.getBoundingRadius();
+    glm::vec3 grid_center = glm::vec3(static_cast<float>(side - 1) * 0.5f);
+
+    std::vector<InstanceData> instances(central_copies_);
+    for (int i = 0; i < central_copies_; i++)
+    {
+        glm::vec3 cell = glm::vec3(static_cast<float>(i % side), static_cast<float>((i / side) % side),
+                                   static_cast<float>(i / (side * side)));
+        instances[i].model = glm::translate(glm::mat4(1.0f), (cell - grid_center) * spacing);
+    }
+    central_object.setInstances(std::move(instances));
+    central_copies_scale_ = central_object.getScale();
+    central_copies_dirty_ = false;
+    shadow_casters_version_++;
+    changed_ = true;
 }
 
 void Session::loadCoordinateSystem()
@@ -24,27 +163,63 @@ for rendering the coordinate axes. */
     axis_objects_.push_back(std::move(axis));
 }
 
-void Session::addLightObject()
-/** Adds a new light object to the session, provided the current number of light objects is less than 4.
-It generates a unique pick color for object selection, and creates a new FlashLightObject using predefined shaders.
-The new light object is initialized by loading its buffers.
-If there are already 4 light objects, it shows a warning notification.*/
+void Session::loadLightGizmos()
+/** Loads the meshes that represent Light objects: one mesh per light type (flashlight for spotlight, light bulb for
+point light) and the spotlight arrow. They are loaded once and shared by all Light objects as instances. */
 {
-    if (light_objects_.size() < 4)
+    const std::string shader_vert = "../shaders/shader_flashlight.vert";
+    const std::string shader_frag = "../shaders/shader_flashlight.frag";
+    for (const auto& filepath : {"../objects/Flashlight.obj", "../objects/LightBulb.obj"})
     {
-        current_object_id_ = current_object_id_ + 1;
-        generateNewPickColor_();
+        GizmoObject gizmo = GizmoObject(filepath, shader_vert, shader_frag);
+        gizmo.loadObjectBuffers();
+        light_gizmos_.push_back(std::move(gizmo));
+    }
+    GizmoObject arrow = GizmoObject(FlashLightObject::arrowMesh(), shader_vert, shader_frag);
+    arrow.loadObjectBuffers();
+    arrow_gizmos_.push_back(std::move(arrow));
+}
 
-        auto pick_color_id = generatePickColorID_();
-        auto new_object = FlashLightObject("../objects/Flashlight.obj", "../shaders/shader_flashlight.vert", "../shaders/shader_flashlight.frag", current_object_id_, pick_color_id,current_pick_color_[0], current_pick_color_[1], current_pick_color_[2]);
+void Session::addLightObject()
+/** Adds a new light object to the session with a new id, the Light object is drawn as an instance of the shared
+gizmo mesh of its type. */
+{
+    current_object_id_ = current_object_id_ + 1;
+    auto new_object = FlashLightObject(current_object_id_);
+    light_objects_.push_back(std::move(new_object));
+    changed_ = true;
+}
 
-        new_object.loadObjectBuffers();
-        light_objects_.push_back(std::move(new_object));
-    }
-    else
+void Session::addLightObjects(int count)
+/** Adds a number of point lights with random colors at random positions around the copies of the central object
+(to see how the lighting scales with many lights). Their attenuation is much stronger than the default one, a light
+reaches about as far as the distance between neighbouring copies. The random sequence continues between calls. */
+{
+    const Object& central_object = central_objects_[0];
+    int side = copiesGridSide_();
+    float spacing = COPIES_SPACING * central_object.getBoundingRadius();
+    float extent = static_cast<float>(side - 1) * 0.5f * spacing + central_object.getBoundingRadius();
+
+    std::mt19937 generator(light_seed_++);
+    std::uniform_real_distribution<float> position(-extent, extent);
+    std::uniform_real_distribution<float> channel(0.2f, 1.0f);
+    for (int i = 0; i < count; i++)
     {
-        pfd::notify("System event", "The maximum amount of light sources is 4.",
-                    pfd::icon::warning);
+        addLightObject();
+        auto& light_object = light_objects_.back();
+        float* xyz = light_object.getObjectCoordinates();
+        for (int axis = 0; axis < 3; axis++)
+        {
+            xyz[axis] = position(generator);
+        }
+        float* rgb = light_object.getObjectColor();
+        for (int c = 0; c < 3; c++)
+        {
+            rgb[c] = channel(generator);
+        }
+        light_object.lightObjectType() = 1;
+        light_object.getLight().linear = 2.0f / spacing;
+        light_object.getLight().quadratic = 250.0f / (spacing * spacing);
     }
 }
 
@@ -61,24 +236,154 @@ void Session::removeLightObject(const std::string& id)
     }
 }
 
-void Session::drawSession(glm::mat4& view, glm::mat4& projection, glm::vec3& camera_position, bool get_pick_color)
-/** Iterates through the vector of Light objects, central object and axis and applies member function to draw every object. */
+void Session::drawSession(glm::mat4& view, glm::mat4& projection, glm::vec3& camera_position)
+/** Iterates through the vector of Light objects, central object and axis and submits their draws to the render queue,
+which draws them sorted by their state. The CPU work before the draws (transforms of the Light objects, light
+assignment, level of detail and meshlet culling) runs on the job system. Light objects are collected as instances of
+the gizmo mesh of their type, so every gizmo mesh is drawn with one draw call. Shadow maps and the deferred passes
+render into their own framebuffers before the queue is executed. The data that changes every frame (transforms of the
+draws, the "Lights" block, gizmo instances) is written into the region of the frame in the stream buffer. */
 {
-    std::vector<Light> lights;
+    job_system_.beginFrame();
+    stream_buffer_.beginFrame();
+    lights_.clear();
+    std::vector<std::vector<InstanceData>> gizmo_instances(light_gizmos_.size());
+    std::vector<InstanceData> arrow_instances;
+    // Light objects of the lights and whether they moved since the last frame, for the shadow maps
+    std::vector<int> light_ids;
+    std::vector<bool> lights_dirty;
+    // types of the active lights select the variant of the central shader (see ShaderFeatures)
+    unsigned int light_features = 0;
+    // the transforms of the Light objects are updated in parallel jobs, every job writes only the updates of its own
+    // Light objects, they are collected in the order of the Light objects afterwards
+    light_updates_.resize(light_objects_.size());
+    JobCounter lights_counter;
+    job_system_.parallelFor("light objects", lights_counter, light_objects_.size(), 64, [this](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+        {
+            FlashLightObject& light_obj = light_objects_[i];
+            LightUpdate& update = light_updates_[i];
+            update.on = light_obj.lightOnOff();
+            if (update.on)
+            {
+                update.light = light_obj.getLight();
+                update.shadow_dirty = light_obj.takeShadowDirty();
+            }
+            update.gizmo = light_obj.getGizmoInstance();
+            if (light_obj.lightObjectType() == 0)
+            {
+                update.arrow = light_obj.getArrowInstance();
+            }
+        }
+    });
+    job_system_.wait(lights_counter);
+
     // if Light object is On, include its data relating to light (position, direction, type, color etc) to the vector,
-    // that is passed to the drawing function of the central object. It will be used in fragment shader of the central object.
-    for (auto& light_obj: light_objects_)
+    // that is assigned to the light clusters. It will be used in fragment shader of the central object.
+    for (size_t i = 0; i < light_objects_.size(); i++)
     {
-        if (light_obj.lightOnOff())
+        const LightUpdate& update = light_updates_[i];
+        if (update.on)
         {
-            lights.push_back(light_obj.getLight());
+            lights_.push_back(update.light);
+            light_ids.push_back(light_objects_[i].getId());
+            lights_dirty.push_back(update.shadow_dirty);
+            if (lights_.back().type == 0)
+            {
+                light_features |= ShaderFeatures::SPOTLIGHTS;
+            }
+            else
+            {
+                light_features |= ShaderFeatures::POINT_LIGHTS;
+            }
+        }
+        auto type = static_cast<size_t>(light_objects_[i].lightObjectType());
+        if (type < gizmo_instances.size())
+        {
+            gizmo_instances[type].push_back(update.gizmo);
+        }
+        // if the Light object has a type of spotlight, then the arrow through the center of Flashlight object is rendered
+        if (type == 0)
+        {
+            arrow_instances.push_back(update.arrow);
         }
-        light_obj.draw(view, projection, get_pick_color);
     }
-    // draw central object
+    for (size_t type = 0; type < light_gizmos_.size(); type++)
+    {
+        if (!gizmo_instances[type].empty())
+        {
+            light_gizmos_[type].setInstances(std::move(gizmo_instances[type]));
+            light_gizmos_[type].submit(render_queue_, stream_buffer_, view, projection, true);
+        }
+    }
+    for (auto& arrow: arrow_gizmos_)
+    {
+        if (!arrow_instances.empty())
+        {
+            arrow.setInstances(arrow_instances);
+            arrow.submit(render_queue_, stream_buffer_, view, projection, false);
+        }
+    }
+    // deferred shading reads the lights directly, the lights are not assigned to clusters then
+    bool deferred = render_mode_ == RenderMode::Deferred;
+    // the levels of detail and the visible meshlets of the central objects are chosen on the workers while the render
+    // thread assigns the lights to the clusters, the shadow maps below use the chosen levels
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    auto viewport_height = static_cast<float>(viewport[3]);
+    JobCounter central_counter;
     for (auto& central_obj: central_objects_)
     {
-        central_obj.draw(view, projection, camera_position, lights);
+        Object* object = &central_obj;
+        job_system_.run("central object", central_counter, [this, object, &view, &projection, &camera_position,
+                                                             viewport_height]() {
+            object->prepareDraw(job_system_, view, projection, camera_position, viewport_height);
+        });
+    }
+    light_clusters_.update(lights_, view, projection, job_system_, stream_buffer_, !deferred);
+    job_system_.wait(central_counter);
+    light_clusters_.bind();
+
+    // shadow maps are rendered before the central object, only those of lights that changed
+    if (shadows_ && !central_objects_.empty())
+    {
+        if (central_objects_[0].getLod() != shadow_casters_lod_)
+        {
+            shadow_casters_lod_ = central_objects_[0].getLod();
+            shadow_casters_version_++;
+        }
+        gpu_profiler_.beginPass(GpuPass::ShadowMaps);
+        shadow_atlas_.update(lights_, light_ids, lights_dirty, central_objects_, shadow_casters_version_, light_clusters_);
+        gpu_profiler_.endPass(GpuPass::ShadowMaps);
+        light_features |= ShaderFeatures::SHADOWS;
+    }
+    else
+    {
+        shadow_atlas_.disable();
+    }
+    shadow_atlas_.bind();
+
+    // draw central object, the deferred passes draw it right away (the lighting pass writes its depth, so the gizmos
+    // and axes drawn by the queue afterwards are occluded by it)
+    if (deferred)
+    {
+        gpu_profiler_.beginPass(GpuPass::CentralObject);
+        deferred_renderer_.beginGeometryPass();
+        for (auto& central_obj: central_objects_)
+        {
+            central_obj.drawWithProgram(deferred_renderer_.geometryProgram(), stream_buffer_, view, projection,
+                                        camera_position);
+        }
+        deferred_renderer_.lightingPass(lights_, light_clusters_, view, projection, camera_position);
+        gpu_profiler_.endPass(GpuPass::CentralObject);
+    }
+    else
+    {
+        for (auto& central_obj: central_objects_)
+        {
+            central_obj.setLightFeatures(light_features);
+            central_obj.submit(render_queue_, stream_buffer_, view, projection, camera_position);
+        }
     }
 
     // draw coordinate system
@@ -86,62 +391,85 @@ void Session::drawSession(glm::mat4& view, glm::mat4& projection, glm::vec3& cam
     {
         for (auto& axis_obj: axis_objects_)
         {
-            axis_obj.draw(view, projection);
+            axis_obj.submit(render_queue_, stream_buffer_, view, projection);
         }
     }
+    render_queue_.execute(gpu_profiler_);
+    stream_buffer_.endFrame();
 
     if (id_to_remove_ >= 0)
     {
         light_objects_.erase(light_objects_.begin() + id_to_remove_);
         id_to_remove_ = -1;
+        changed_ = true;
     }
 }
 
-int Session::getObjectIdByPickColor(const unsigned char *pick_color)
-/** Calculates pick_color_id for a colour values (see formula above), iterates through the vector of Objects to get an id
-of an Object with specified pick colour. */
+void Session::releaseGL()
+/** Deletes the OpenGL objects of the Session while its context is current: the buffers of the central object, the
+gizmos and the coordinate system, the light clusters, the G-buffer, the shadow atlas, the stream buffer and the
+profiler queries. The Session must not be drawn afterwards, lighting_bench calls this at the end of every scene. */
 {
-
-    int pick_color_id = pick_color[0] * (256 * 256) + pick_color[1] * 256 + pick_color[2];
-
-    for (std::vector<FlashLightObject>::size_type i = 0; i < light_objects_.size(); i++)
+    central_object_loader_.cancel();
+    for (auto& central_obj: central_objects_)
     {
-        if (light_objects_[i].checkPickColor(pick_color_id))
-        {
-            return static_cast<int>(i);
-        }
+        central_obj.releaseBuffers();
     }
-    return -1;
+    for (auto& gizmo: light_gizmos_)
+    {
+        gizmo.releaseBuffers();
+    }
+    for (auto& arrow: arrow_gizmos_)
+    {
+        arrow.releaseBuffers();
+    }
+    for (auto& axis: axis_objects_)
+    {
+        axis.releaseBuffers();
+    }
+    light_clusters_.release();
+    deferred_renderer_.release();
+    shadow_atlas_.release();
+    stream_buffer_.release();
+    gpu_profiler_.release();
 }
 
-int Session::generatePickColorID_()
-/** Calculates pick color id using with the formula: R*256^2 + G*256^1 + B*256^0. Afterwards, pick_color_id is assigned
-to an Object instance. */
+bool Session::takeChanged()
+/** Returns true if the scene changed since the previous call and has to be drawn again (see FrameScheduler): Light
+objects or copies were added, removed or moved, a Light object or the central object changed its appearance. The GUI
+changes them through pointers, so their state is compared with the state at the previous call. */
 {
-    int pick_color_id = current_pick_color_[0] * (256 * 256) + current_pick_color_[1] * 256 +
-                        current_pick_color_[2];
-    return pick_color_id;
+    bool changed = changed_;
+    changed_ = false;
+    for (auto& light_obj : light_objects_)
+    {
+        // every Light object takes its own state, so all of them are visited
+        changed = light_obj.takeChanged() || changed;
+    }
+    if (!central_objects_.empty())
+    {
+        Object& central_object = central_objects_[0];
+        const float* rgb = central_object.getObjectColor();
+        const float state[4] = {rgb[0], rgb[1], rgb[2], central_object.getScale()};
+        changed = changed || !std::equal(state, state + 4, central_state_);
+        std::copy(state, state + 4, central_state_);
+    }
+    return changed;
 }
 
-void Session::generateNewPickColor_()
-/** Generates a new pick color by incrementing the RGB values by 10.
-If a component reaches 255, it resets to 0 and increments the previous component. */
+const PickResult& Session::pick(const Ray& ray)
+/** Finds the Light object or the copy of the central object under a ray from the camera and the hit point on its
+surface (see Picker). Any change of the shadow casters (mesh, copies, scale or level of detail) also moves the copies
+for the picker. The result stays available for the menu. */
 {
-
-    for (int i = 2; i >= 0; --i)
+    if (central_objects_.empty())
     {
-        if (current_pick_color_[i] < 255)
-        {
-            current_pick_color_[i] += 10;
-            return;
-        }
-        if (current_pick_color_[i] == 255)
-        {
-            current_pick_color_[i] = 0;
-            current_pick_color_[i - 1]++;
-            return;
-        }
+        last_pick_ = PickResult();
+        return last_pick_;
     }
+    last_pick_ = picker_.pick(ray, central_objects_[0], central_mesh_version_, shadow_casters_version_, light_gizmos_,
+                              light_objects_);
+    return last_pick_;
 }
 
 
@@ -2,11 +2,14 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <utility>
 #include <glad/glad.h>
 
 #include "../include/shader.h"
 
-ShaderProgram::ShaderProgram(const char *vertexPath, const char *fragmentPath)
+ShaderProgram::ShaderProgram(const char *vertexPath, const char *fragmentPath, const std::string& defines)
+/** Compiles and links a program from vertex and fragment shader files, the defines (lines of "#define NAME") are
+inserted into both sources after the #version directive. */
 {
     // 1. retrieve the vertex/fragment source code from filePath
     std::string vertexCode;
@@ -30,8 +33,8 @@ ShaderProgram::ShaderProgram(const char *vertexPath, const char *fragmentPath)
         vShaderFile.close();
         fShaderFile.close();
         // convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
+        vertexCode = injectDefines(vShaderStream.str(), defines);
+        fragmentCode = injectDefines(fShaderStream.str(), defines);
     }
     catch (std::ifstream::failure& e)
     {
@@ -64,6 +67,77 @@ ShaderProgram::ShaderProgram(const char *vertexPath, const char *fragmentPath)
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+
+    cacheUniformLocations();
+}
+
+std::string ShaderProgram::injectDefines(const std::string& source, const std::string& defines)
+/** Inserts the defines after the first line of the source (#version has to stay the first directive). */
+{
+    if (defines.empty())
+    {
+        return source;
+    }
+    auto line_end = source.find('\n');
+    if (line_end == std::string::npos)
+    {
+        return source + "\n" + defines;
+    }
+    return source.substr(0, line_end + 1) + defines + source.substr(line_end + 1);
+}
+
+void ShaderProgram::cacheUniformLocations()
+/** Queries locations of all active uniforms of the linked program once, so setters do not call glGetUniformLocation
+every frame. Every element of a uniform array is stored under its own name ("lightPos[2]"), the first one also under
+the name of the array. Uniforms of uniform blocks have no location and are skipped. */
+{
+    GLint uniform_count = 0;
+    glGetProgramiv(id_, GL_ACTIVE_UNIFORMS, &uniform_count);
+    GLchar name[256];
+    for (GLint i = 0; i < uniform_count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(id_, static_cast<GLuint>(i), sizeof(name), &length, &size, &type, name);
+        GLint location = glGetUniformLocation(id_, name);
+        if (location < 0)
+        {
+            continue;
+        }
+        std::string uniform_name(name, static_cast<size_t>(length));
+        uniform_locations_[uniform_name] = location;
+
+        auto bracket = uniform_name.find('[');
+        if (bracket != std::string::npos)
+        {
+            std::string array_name = uniform_name.substr(0, bracket);
+            uniform_locations_[array_name] = location;
+            for (GLint element = 1; element < size; element++)
+            {
+                std::string element_name = array_name + "[" + std::to_string(element) + "]";
+                uniform_locations_[element_name] = glGetUniformLocation(id_, element_name.c_str());
+            }
+        }
+    }
+}
+
+int ShaderProgram::uniformLocation(const std::string &name) const
+/** Returns the cached location of an active uniform, -1 if the program has no such uniform (setters ignore -1). */
+{
+    auto location = uniform_locations_.find(name);
+    return location == uniform_locations_.end() ? -1 : location->second;
+}
+
+void ShaderProgram::bindUniformBlock(const char* block_name, unsigned int binding) const
+/** Connects a uniform block of the program to a binding point of uniform buffers (GLSL 3.30 has no binding layout qualifier).
+Programs without this block are left untouched. */
+{
+    GLuint block_index = glGetUniformBlockIndex(id_, block_name);
+    if (block_index != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(id_, block_index, binding);
+    }
 }
 
 void ShaderProgram::use() const
@@ -75,31 +149,66 @@ void ShaderProgram::use() const
 void ShaderProgram::setInt(const std::string &name, int value) const
 /** Sets value to the Uniform of 1 int type with the given name.*/
 {
-    // glGetUniformLocation retrieves location of the specific uniform of the ShaderProgram.
+    // the location of the specific uniform of the ShaderProgram is taken from the cache built after linking.
     // sets uniform value of 1 int type.
-    glUniform1i(glGetUniformLocation(id_, name.c_str()), value);
+    setInt(uniformLocation(name), value);
 }
 
 // Following functions have the same functionality as setInt, but for uniforms of different types.
 void ShaderProgram::setFloat(const std::string &name, float value) const
 {
-    glUniform1f(glGetUniformLocation(id_, name.c_str()), value);
+    setFloat(uniformLocation(name), value);
 }
 void ShaderProgram::setVec3(const std::string &name, const glm::vec3 &value) const
 {
-    glUniform3fv(glGetUniformLocation(id_, name.c_str()), 1, &value[0]);
+    setVec3(uniformLocation(name), value);
 }
 void ShaderProgram::setVec3(const std::string &name, float x, float y, float z) const
 {
-    glUniform3f(glGetUniformLocation(id_, name.c_str()), x, y, z);
+    setVec3(uniformLocation(name), x, y, z);
 }
 void ShaderProgram::setVec4(const std::string &name, float x, float y, float z, float w) const
 {
-    glUniform4f(glGetUniformLocation(id_, name.c_str()), x, y, z, w);
+    setVec4(uniformLocation(name), x, y, z, w);
 }
+void ShaderProgram::setMat3(const std::string &name, const glm::mat3 &mat) const
+{
+    setMat3(uniformLocation(name), mat);
+}
+
 void ShaderProgram::setMat4(const std::string &name, const glm::mat4 &mat) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(id_, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    setMat4(uniformLocation(name), mat);
+}
+
+void ShaderProgram::setInt(int location, int value) const
+{
+    glUniform1i(location, value);
+}
+void ShaderProgram::setFloat(int location, float value) const
+{
+    glUniform1f(location, value);
+}
+void ShaderProgram::setVec3(int location, const glm::vec3 &value) const
+{
+    glUniform3fv(location, 1, &value[0]);
+}
+void ShaderProgram::setVec3(int location, float x, float y, float z) const
+{
+    glUniform3f(location, x, y, z);
+}
+void ShaderProgram::setVec4(int location, float x, float y, float z, float w) const
+{
+    glUniform4f(location, x, y, z, w);
+}
+void ShaderProgram::setMat3(int location, const glm::mat3 &mat) const
+{
+    glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void ShaderProgram::setMat4(int location, const glm::mat4 &mat) const
+{
+    glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
 }
 
 void ShaderProgram::checkCompileErrors(unsigned int shader, const std::string& type)
@@ -126,3 +235,38 @@ void ShaderProgram::checkCompileErrors(unsigned int shader, const std::string& t
         }
     }
 }
+
+ShaderPermutations::ShaderPermutations(std::string vertex_path, std::string fragment_path,
+                                       std::vector<std::string> define_names)
+        : vertex_path_(std::move(vertex_path)), fragment_path_(std::move(fragment_path)),
+          define_names_(std::move(define_names)){}
+
+const ShaderProgram& ShaderPermutations::variant(unsigned int key)
+/** Returns the variant of the program for a key, compiles it if it is used for the first time. Compiled programs are
+shared by all permutations of the same shader files: objects with the same shaders draw with one program (the render
+queue sorts their draws together) and a reloaded central object does not compile its shaders again. */
+{
+    auto found = variants_.find(key);
+    if (found != variants_.end())
+    {
+        return found->second;
+    }
+    std::string defines;
+    for (size_t bit = 0; bit < define_names_.size(); bit++)
+    {
+        if (key & (1u << bit))
+        {
+            defines += "#define " + define_names_[bit] + "\n";
+        }
+    }
+    static std::unordered_map<std::string, ShaderProgram> compiled_programs;
+    std::string program_key = vertex_path_ + "\n" + fragment_path_ + "\n" + defines;
+    auto compiled = compiled_programs.find(program_key);
+    if (compiled == compiled_programs.end())
+    {
+        compiled = compiled_programs.emplace(program_key, ShaderProgram(vertex_path_.c_str(), fragment_path_.c_str(),
+                                                                        defines)).first;
+    }
+    auto inserted = variants_.emplace(key, compiled->second);
+    return inserted.first->second;
+}
@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include "../include/shadow_atlas.h"
+
+void ShadowAtlas::update(const std::vector<Light>& lights, const std::vector<int>& light_ids,
+                         const std::vector<bool>& lights_dirty, std::vector<Object>& casters, unsigned int casters_version,
+                         const LightClusters& clusters)
+/** Renders the shadow maps that are missing or out of date and uploads the tiles of every light (light i of 'lights'
+is light i of the light data of 'clusters', it is identified by light_ids[i] between frames). Maps of lights that are
+gone are freed first, so their tiles can be given to new lights; lights that do not fit into the atlas are not shadowed.
+The framebuffer and the viewport are restored afterwards. */
+{
+    createResources_();
+    auto start = std::chrono::steady_clock::now();
+
+    // free the maps of the lights that were removed or turned off
+    for (auto& entry : entries_)
+    {
+        readTimes_(entry.second);
+        entry.second.used = false;
+    }
+    for (int id : light_ids)
+    {
+        auto found = entries_.find(id);
+        if (found != entries_.end())
+        {
+            found->second.used = true;
+        }
+    }
+    for (auto entry = entries_.begin(); entry != entries_.end();)
+    {
+        if (entry->second.used)
+        {
+            ++entry;
+            continue;
+        }
+        free_(entry->second);
+        entry = entries_.erase(entry);
+    }
+
+    GLint target_framebuffer = 0;
+    GLint target_viewport[4];
+    GLint depth_func = GL_LEQUAL;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target_framebuffer);
+    glGetIntegerv(GL_VIEWPORT, target_viewport);
+    glGetIntegerv(GL_DEPTH_FUNC, &depth_func);
+
+    stats_ = ShadowStats();
+    light_tiles_.assign(lights.size() * 8, -1.0f);
+    bool atlas_bound = false;
+    for (size_t i = 0; i < lights.size(); i++)
+    {
+        const Light& light = lights[i];
+        int faces = light.type == 0 ? 1 : 6;
+        float range = clusters.lightRadius(light);
+        if (range <= NEAR_PLANE)
+        {
+            continue;
+        }
+        bool render = lights_dirty[i];
+        auto found = entries_.find(light_ids[i]);
+        if (found == entries_.end())
+        {
+            Entry entry;
+            if (!allocate_(entry, faces))
+            {
+                stats_.missing_lights++;
+                continue;
+            }
+            found = entries_.emplace(light_ids[i], entry).first;
+            render = true;
+        }
+        Entry& entry = found->second;
+        // the type of the light changed, a spotlight needs one tile and a point light six
+        if (entry.faces != faces)
+        {
+            free_(entry);
+            if (!allocate_(entry, faces))
+            {
+                entries_.erase(found);
+                stats_.missing_lights++;
+                continue;
+            }
+            render = true;
+        }
+        if (render || entry.range != range || entry.casters_version != casters_version)
+        {
+            if (!atlas_bound)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+                glEnable(GL_DEPTH_TEST);
+                glDepthFunc(GL_LESS);
+                glDepthMask(GL_TRUE);
+                glEnable(GL_SCISSOR_TEST);
+                // slope-scaled bias against shadow acne on surfaces at grazing angles to the light
+                glEnable(GL_POLYGON_OFFSET_FILL);
+                glPolygonOffset(2.0f, 4.0f);
+                atlas_bound = true;
+            }
+            entry.range = range;
+            entry.casters_version = casters_version;
+            renderLight_(entry, light, casters);
+            stats_.rendered_lights++;
+        }
+
+        for (int face = 0; face < faces; face++)
+        {
+            light_tiles_[i * 8 + (face / 4) * 4 + face % 4] = static_cast<float>(entry.tiles[face]);
+        }
+        // size of a shadow map texel at unit distance from the light, the normal offset grows with the distance
+        float fov = light.type == 0 ? std::min(2.0f * light.outerCutOff + 2.0f, 170.0f) : 90.0f;
+        light_tiles_[i * 8 + 7] = 2.0f * std::tan(glm::radians(fov) * 0.5f) / static_cast<float>(TILE_SIZE);
+
+        LightShadowStats light_stats;
+        light_stats.light_id = light_ids[i];
+        light_stats.faces = faces;
+        light_stats.cpu_ms = entry.cpu_ms;
+        light_stats.gpu_ms = entry.gpu_ms;
+        stats_.lights.push_back(light_stats);
+        stats_.shadowed_lights++;
+    }
+
+    if (atlas_bound)
+    {
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDisable(GL_SCISSOR_TEST);
+        glDepthFunc(static_cast<GLenum>(depth_func));
+        glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(target_framebuffer));
+        glViewport(target_viewport[0], target_viewport[1], target_viewport[2], target_viewport[3]);
+    }
+
+    const int tiles_per_row = ATLAS_SIZE / TILE_SIZE;
+    stats_.tiles = static_cast<size_t>(tiles_per_row * tiles_per_row);
+    stats_.used_tiles = stats_.tiles - free_tiles_.size();
+    // DEPTH_COMPONENT24 is stored in 4 bytes per texel
+    stats_.atlas_bytes = static_cast<size_t>(ATLAS_SIZE) * ATLAS_SIZE * 4 + tile_matrices_.size() * sizeof(glm::mat4) +
+                         light_tiles_.size() * sizeof(float);
+    stats_.cpu_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    pcf_radius_ = std::min(std::max(pcf_radius_, 0), static_cast<int>(MAX_PCF_RADIUS));
+    shadows_block_.params[0] = pcf_radius_;
+    shadows_block_.params[1] = tiles_per_row;
+    shadows_block_.params[2] = 1;
+    shadows_block_.scale[0] = 1.0f / static_cast<float>(ATLAS_SIZE);
+    shadows_block_.scale[1] = static_cast<float>(TILE_SIZE) / static_cast<float>(ATLAS_SIZE);
+    shadows_block_.scale[2] = 0.0f;
+    shadows_block_.scale[3] = 1.5f;
+    uploadBuffers_();
+}
+
+void ShadowAtlas::disable()
+/** Frees all shadow maps and turns shadows off in the shaders that check the "Shadows" block (deferred shading). */
+{
+    for (auto& entry : entries_)
+    {
+        free_(entry.second);
+    }
+    entries_.clear();
+    stats_ = ShadowStats();
+    light_tiles_.clear();
+    shadows_block_.params[2] = 0;
+    uploadBuffers_();
+}
+
+void ShadowAtlas::bind() const
+/** Binds the "Shadows" uniform buffer, the atlas and the texture buffers to the units the shaders read them from. */
+{
+    shadows_buffer_.bind();
+    light_buffer_.bind(ShadowsBlock::SHADOW_LIGHT_UNIT);
+    matrix_buffer_.bind(ShadowsBlock::SHADOW_MATRIX_UNIT);
+    glActiveTexture(GL_TEXTURE0 + ShadowsBlock::ATLAS_UNIT);
+    glBindTexture(GL_TEXTURE_2D, atlas_texture_);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void ShadowAtlas::release()
+/** Deletes the atlas, the buffers and the timer queries, the next update creates them again and renders all maps. */
+{
+    for (auto& entry : entries_)
+    {
+        free_(entry.second);
+    }
+    entries_.clear();
+    if (framebuffer_ != 0)
+    {
+        glDeleteFramebuffers(1, &framebuffer_);
+        glDeleteTextures(1, &atlas_texture_);
+    }
+    framebuffer_ = atlas_texture_ = 0;
+    free_tiles_.clear();
+    tile_matrices_.clear();
+    light_buffer_.release();
+    matrix_buffer_.release();
+    shadows_buffer_.release();
+}
+
+void ShadowAtlas::createResources_()
+/** Compiles the depth-only shader program and creates the atlas texture with its framebuffer. */
+{
+    if (depth_program_ == nullptr)
+    {
+        depth_program_.reset(new ShaderProgram("../shaders/shader_shadow.vert", "../shaders/shader_shadow.frag"));
+    }
+    if (framebuffer_ != 0)
+    {
+        return;
+    }
+    glGenTextures(1, &atlas_texture_);
+    glBindTexture(GL_TEXTURE_2D, atlas_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, ATLAS_SIZE, ATLAS_SIZE, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    // depth comparison with linear filtering: every tap of the PCF kernel is a bilinear 2x2 comparison
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLint previous_framebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer);
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlas_texture_, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::string("Shadow atlas framebuffer is incomplete");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previous_framebuffer));
+
+    const int tiles = (ATLAS_SIZE / TILE_SIZE) * (ATLAS_SIZE / TILE_SIZE);
+    tile_matrices_.assign(tiles, glm::mat4(1.0f));
+    // tiles are taken from the back, so the first lights get the first tiles
+    free_tiles_.clear();
+    for (int tile = tiles - 1; tile >= 0; tile--)
+    {
+        free_tiles_.push_back(tile);
+    }
+}
+
+bool ShadowAtlas::allocate_(Entry& entry, int faces)
+/** Takes tiles for the faces of a shadow map from the free tiles, returns false if there are not enough of them. */
+{
+    if (free_tiles_.size() < static_cast<size_t>(faces))
+    {
+        return false;
+    }
+    entry.faces = faces;
+    for (int face = 0; face < faces; face++)
+    {
+        entry.tiles[face] = free_tiles_.back();
+        free_tiles_.pop_back();
+    }
+    entry.casters_version = 0;
+    return true;
+}
+
+void ShadowAtlas::free_(Entry& entry)
+/** Returns the tiles of a shadow map to the free tiles and deletes its timer queries. */
+{
+    for (int face = 0; face < entry.faces; face++)
+    {
+        free_tiles_.push_back(entry.tiles[face]);
+        entry.tiles[face] = -1;
+    }
+    entry.faces = 0;
+    if (entry.queries[0] != 0)
+    {
+        glDeleteQueries(2, entry.queries);
+        entry.queries[0] = entry.queries[1] = 0;
+    }
+    entry.query_pending = false;
+}
+
+void ShadowAtlas::readTimes_(Entry& entry)
+/** Reads the GPU time of the last shadow pass of a light if its timestamps are available, it never waits for them. */
+{
+    if (!entry.query_pending)
+    {
+        return;
+    }
+    GLint available = 0;
+    glGetQueryObjectiv(entry.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == 0)
+    {
+        return;
+    }
+    GLuint64 start = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(entry.queries[0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(entry.queries[1], GL_QUERY_RESULT, &end);
+    entry.gpu_ms = end > start ? static_cast<double>(end - start) * 1e-6 : 0.0;
+    entry.query_pending = false;
+}
+
+void ShadowAtlas::renderLight_(Entry& entry, const Light& light, std::vector<Object>& casters)
+/** Computes the matrices of the tiles of a light for its current range, clears the tiles and draws the depth of the
+shadow casters into them. Timestamps before and after
+measure the GPU time of the pass (time elapsed queries cannot be nested into the frame query of lighting_bench). */
+{
+    auto start = std::chrono::steady_clock::now();
+    if (entry.queries[0] == 0)
+    {
+        glGenQueries(2, entry.queries);
+    }
+    glQueryCounter(entry.queries[0], GL_TIMESTAMP);
+    const int tiles_per_row = ATLAS_SIZE / TILE_SIZE;
+    for (int face = 0; face < entry.faces; face++)
+    {
+        int tile = entry.tiles[face];
+        tile_matrices_[tile] = faceMatrix_(light, face, entry.range);
+        GLint x = (tile % tiles_per_row) * TILE_SIZE;
+        GLint y = (tile / tiles_per_row) * TILE_SIZE;
+        glViewport(x, y, TILE_SIZE, TILE_SIZE);
+        glScissor(x, y, TILE_SIZE, TILE_SIZE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        for (auto& caster : casters)
+        {
+            caster.drawShadowCaster(*depth_program_, tile_matrices_[tile]);
+        }
+    }
+    glQueryCounter(entry.queries[1], GL_TIMESTAMP);
+    entry.query_pending = true;
+    entry.cpu_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+glm::mat4 ShadowAtlas::faceMatrix_(const Light& light, int face, float range) const
+/** Returns the view-projection matrix of a face of the shadow map: the cone of a spotlight (with a margin for the
+PCF kernel) or one of the six 90 degree frustums of a point light along +x, -x, +y, -y, +z and -z; the shaders pick
+the face of a point light by the major axis of the direction from the light. */
+{
+    if (light.type == 0)
+    {
+        glm::vec3 direction = glm::length(light.light_dir) > 0.0f ? glm::normalize(light.light_dir) : glm::vec3(0, -1, 0);
+        glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+        float fov = std::min(2.0f * light.outerCutOff + 2.0f, 170.0f);
+        return glm::perspective(glm::radians(fov), 1.0f, NEAR_PLANE, range) *
+               glm::lookAt(light.light_pos, light.light_pos + direction, up);
+    }
+    const glm::vec3 directions[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    const glm::vec3 ups[6] = {{0, -1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0}};
+    return glm::perspective(glm::radians(90.0f), 1.0f, NEAR_PLANE, range) *
+           glm::lookAt(light.light_pos, light.light_pos + directions[face], ups[face]);
+}
+
+void ShadowAtlas::uploadBuffers_()
+/** Uploads the tiles of the lights, the matrices of the tiles and the "Shadows" block (only what changed). */
+{
+    light_buffer_.update(light_tiles_.data(), light_tiles_.size() * sizeof(float));
+    matrix_buffer_.update(tile_matrices_.data(), tile_matrices_.size() * sizeof(glm::mat4));
+    shadows_buffer_.update(&shadows_block_, sizeof(shadows_block_));
+}
@@ -0,0 +1,213 @@
+#include <chrono>
+#include <cstring>
+#include "../include/stream_buffer.h"
+
+BufferStorageProc StreamBuffer::buffer_storage_ = nullptr;
+
+void StreamRange::bindUniform(GLuint binding) const
+/** Binds the range to a uniform buffer binding point, the uniform blocks connected to it read from the range. */
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+}
+
+void StreamBuffer::beginFrame()
+/** Moves to the next region and waits until the GPU finished the frame that used it FRAME_COUNT frames ago. */
+{
+    if (!retired_buffers_.empty())
+    {
+        glDeleteBuffers(static_cast<GLsizei>(retired_buffers_.size()), retired_buffers_.data());
+        retired_buffers_.clear();
+    }
+    if (buffer_ == 0)
+    {
+        create_(INITIAL_REGION_BYTES);
+    }
+    region_ = (region_ + 1) % FRAME_COUNT;
+    offset_ = 0;
+    waitRegion_(region_);
+    stats_.frames++;
+    stats_.frame_writes = 0;
+}
+
+void StreamBuffer::endFrame()
+/** Fences the commands of the frame, its region is reused after they are finished. */
+{
+    if (buffer_ == 0)
+    {
+        return;
+    }
+    fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stats_.frame_bytes = offset_;
+}
+
+StreamRange StreamBuffer::write(const void* data, size_t size)
+/** Copies data into the region of the frame, between beginFrame and endFrame. */
+{
+    return write_(data, size, DEFAULT_ALIGNMENT);
+}
+
+StreamRange StreamBuffer::writeUniform(const void* data, size_t size)
+/** Copies a uniform block into the region of the frame at an offset that can be bound with StreamRange::bindUniform. */
+{
+    return write_(data, size, uniform_alignment_);
+}
+
+void StreamBuffer::release()
+/** Deletes the GL buffer and the fences, the next frame creates new ones. */
+{
+    deleteFences_();
+    if (!retired_buffers_.empty())
+    {
+        glDeleteBuffers(static_cast<GLsizei>(retired_buffers_.size()), retired_buffers_.data());
+        retired_buffers_.clear();
+    }
+    if (buffer_ != 0)
+    {
+        // deleting a mapped buffer unmaps it
+        glDeleteBuffers(1, &buffer_);
+        buffer_ = 0;
+    }
+    mapped_ = nullptr;
+    region_bytes_ = 0;
+    offset_ = 0;
+}
+
+void StreamBuffer::loadBufferStorage(GLADloadproc load_proc)
+/** Loads glBufferStorage with the loader of the context (glfwGetProcAddress or eglGetProcAddress) if the extension
+list of the current context has GL_ARB_buffer_storage. Without it the stream buffers map every write. */
+{
+    buffer_storage_ = nullptr;
+    GLint extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+    for (GLint i = 0; i < extension_count; i++)
+    {
+        const auto* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (extension != nullptr && std::strcmp(extension, "GL_ARB_buffer_storage") == 0)
+        {
+            buffer_storage_ = reinterpret_cast<BufferStorageProc>(load_proc("glBufferStorage"));
+            break;
+        }
+    }
+}
+
+StreamRange StreamBuffer::write_(const void* data, size_t size, size_t alignment)
+{
+    size_t start = (offset_ + alignment - 1) / alignment * alignment;
+    if (buffer_ == 0 || start + size > region_bytes_)
+    {
+        // the frame continues at the start of a larger buffer, its regions have no pending frames
+        size_t region_bytes = buffer_ != 0 ? region_bytes_ * 2 : INITIAL_REGION_BYTES;
+        while (region_bytes < size)
+        {
+            region_bytes *= 2;
+        }
+        if (buffer_ != 0)
+        {
+            retired_buffers_.push_back(buffer_);
+            stats_.resizes++;
+        }
+        deleteFences_();
+        create_(region_bytes);
+        start = 0;
+    }
+
+    StreamRange range;
+    range.buffer = buffer_;
+    range.offset = static_cast<GLintptr>(static_cast<size_t>(region_) * region_bytes_ + start);
+    range.size = static_cast<GLsizeiptr>(size);
+    if (size > 0 && mapped_ != nullptr)
+    {
+        // coherent mapping: the copy is visible to the commands issued after it without a flush
+        std::memcpy(mapped_ + range.offset, data, size);
+    }
+    else if (size > 0)
+    {
+        // the region is not read by the GPU any more (see beginFrame), so the driver does not have to synchronize
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+        void* target = glMapBufferRange(GL_COPY_WRITE_BUFFER, range.offset, range.size,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (target != nullptr)
+        {
+            std::memcpy(target, data, size);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    offset_ = start + size;
+    stats_.frame_writes++;
+    return range;
+}
+
+void StreamBuffer::create_(size_t region_bytes)
+/** Allocates the storage of all regions, the GL buffer is created on the first frame (it needs an OpenGL context).
+With ARB_buffer_storage the storage is immutable and stays mapped until the buffer is deleted. */
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment > 0)
+    {
+        uniform_alignment_ = static_cast<size_t>(alignment);
+    }
+    region_bytes_ = region_bytes;
+    auto buffer_bytes = static_cast<GLsizeiptr>(region_bytes_ * FRAME_COUNT);
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    mapped_ = nullptr;
+    if (buffer_storage_ != nullptr)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        buffer_storage_(GL_COPY_WRITE_BUFFER, buffer_bytes, nullptr, flags);
+        mapped_ = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, buffer_bytes, flags));
+        if (mapped_ == nullptr)
+        {
+            // immutable storage cannot be reallocated, the fallback needs a new buffer
+            glDeleteBuffers(1, &buffer_);
+            glGenBuffers(1, &buffer_);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+        }
+    }
+    if (mapped_ == nullptr)
+    {
+        glBufferData(GL_COPY_WRITE_BUFFER, buffer_bytes, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    stats_.region_bytes = region_bytes_;
+    stats_.persistent = mapped_ != nullptr;
+}
+
+void StreamBuffer::waitRegion_(int region)
+/** Waits for the fence of a region. The fence is first only checked, a frame that has to wait is counted as a stall. */
+{
+    GLsync fence = fences_[region];
+    if (fence == nullptr)
+    {
+        return;
+    }
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        auto start = std::chrono::steady_clock::now();
+        // the commands are flushed, otherwise the fence might never be reached
+        do
+        {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        }
+        while (status == GL_TIMEOUT_EXPIRED);
+        stats_.stalls++;
+        stats_.stall_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    glDeleteSync(fence);
+    fences_[region] = nullptr;
+}
+
+void StreamBuffer::deleteFences_()
+{
+    for (auto& fence : fences_)
+    {
+        if (fence != nullptr)
+        {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+}
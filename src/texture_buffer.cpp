@@ -0,0 +1,65 @@
+#include <cstring>
+#include "../include/texture_buffer.h"
+
+bool TextureBuffer::update(const void* data, size_t size)
+/** Uploads data to the buffer if it differs from the last uploaded data. The storage grows to the next power of two
+when the data does not fit, so the buffer is not reallocated every time the number of lights changes.
+Returns true if the data was uploaded. */
+{
+    if (buffer_ != 0 && mirror_.size() == size && std::memcmp(mirror_.data(), data, size) == 0)
+    {
+        return false;
+    }
+    if (buffer_ == 0)
+    {
+        glGenBuffers(1, &buffer_);
+        glGenTextures(1, &texture_);
+    }
+    // an empty buffer texture is not a valid texture, so there is always room for at least one texel
+    size_t required = size > 16 ? size : 16;
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer_);
+    if (required > capacity_)
+    {
+        capacity_ = 16;
+        while (capacity_ < required)
+        {
+            capacity_ *= 2;
+        }
+        glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(capacity_), nullptr, GL_DYNAMIC_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, texture_);
+        glTexBuffer(GL_TEXTURE_BUFFER, internal_format_, buffer_);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    if (size > 0)
+    {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, static_cast<GLsizeiptr>(size), data);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    mirror_.assign(bytes, bytes + size);
+    upload_count_++;
+    return true;
+}
+
+void TextureBuffer::bind(int unit) const
+/** Binds the buffer texture to a texture unit, the samplerBuffer uniforms set to this unit read from it.
+Texture unit 0 stays active afterwards. */
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_BUFFER, texture_);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void TextureBuffer::release()
+/** Deletes the GL buffer and texture, the next update creates new ones. */
+{
+    if (buffer_ != 0)
+    {
+        glDeleteTextures(1, &texture_);
+        glDeleteBuffers(1, &buffer_);
+    }
+    buffer_ = texture_ = 0;
+    capacity_ = 0;
+    mirror_.clear();
+}
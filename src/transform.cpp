@@ -0,0 +1,108 @@
+#include <glm/gtc/matrix_transform.hpp>
+#include "../include/transform.h"
+
+void Transform::setTranslation(const glm::vec3& translation)
+{
+    if (translation != translation_)
+    {
+        translation_ = translation;
+        dirty_ = true;
+    }
+}
+
+void Transform::setRotation(const glm::vec3& degrees)
+{
+    if (degrees != rotation_)
+    {
+        rotation_ = degrees;
+        dirty_ = true;
+    }
+}
+
+void Transform::setAlignment(float degrees, const glm::vec3& axis)
+{
+    if (degrees != alignment_degrees_ || axis != alignment_axis_)
+    {
+        alignment_degrees_ = degrees;
+        alignment_axis_ = axis;
+        dirty_ = true;
+    }
+}
+
+void Transform::setScale(const glm::vec3& scale)
+{
+    if (scale != scale_)
+    {
+        scale_ = scale;
+        dirty_ = true;
+    }
+}
+
+void Transform::setForward(const glm::vec3& forward)
+/** Sets the vector in the frame of the object that getDirection transforms to world space (not normalized). */
+{
+    if (forward != forward_)
+    {
+        forward_ = forward;
+        dirty_ = true;
+    }
+}
+
+const glm::mat4& Transform::getMatrix() const
+{
+    update_();
+    return matrix_;
+}
+
+const glm::mat3& Transform::getNormalMatrix() const
+{
+    update_();
+    return normal_matrix_;
+}
+
+const glm::mat4& Transform::getAlignedMatrix() const
+{
+    update_();
+    return aligned_matrix_;
+}
+
+const glm::vec3& Transform::getPosition() const
+{
+    update_();
+    return position_;
+}
+
+const glm::vec3& Transform::getDirection() const
+{
+    update_();
+    return direction_;
+}
+
+void Transform::update_() const
+/** Computes the cached matrices and vectors if a part changed since the last computation. */
+{
+    if (!dirty_)
+    {
+        return;
+    }
+    // the order of applied transformations (from right to left): scaling -> rotation -> alignment -> translation
+    glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), glm::radians(rotation_.x), glm::vec3(1.0f, 0.0f, 0.0f));
+    rotation = glm::rotate(rotation, glm::radians(rotation_.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    rotation = glm::rotate(rotation, glm::radians(rotation_.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 scaled_rotation = glm::scale(rotation, scale_);
+
+    glm::mat4 translation = glm::translate(glm::mat4(1.0f), translation_);
+    matrix_ = translation * scaled_rotation;
+    if (alignment_degrees_ != 0.0f)
+    {
+        aligned_matrix_ = glm::rotate(translation, glm::radians(alignment_degrees_), alignment_axis_) * scaled_rotation;
+    }
+    else
+    {
+        aligned_matrix_ = matrix_;
+    }
+    normal_matrix_ = glm::transpose(glm::inverse(glm::mat3(matrix_)));
+    position_ = translation_;
+    direction_ = glm::mat3(matrix_) * forward_;
+    dirty_ = false;
+}
@@ -0,0 +1,45 @@
+#include <cstring>
+#include "../include/uniform_buffer.h"
+
+bool UniformBuffer::update(const void* data, size_t size)
+/** Uploads data to the buffer if it differs from the last uploaded data, the buffer is (re)allocated when the size changes.
+Returns true if the data was uploaded. */
+{
+    if (buffer_ != 0 && mirror_.size() == size && std::memcmp(mirror_.data(), data, size) == 0)
+    {
+        return false;
+    }
+    if (buffer_ == 0)
+    {
+        glGenBuffers(1, &buffer_);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    if (mirror_.size() != size)
+    {
+        glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(size), data, GL_DYNAMIC_DRAW);
+    }
+    else
+    {
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, static_cast<GLsizeiptr>(size), data);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    mirror_.assign(bytes, bytes + size);
+    upload_count_++;
+    return true;
+}
+
+void UniformBuffer::bind() const
+/** Binds the buffer to its binding point, uniform blocks connected to this binding point read from it. */
+{
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding_, buffer_);
+}
+
+void UniformBuffer::release()
+/** Deletes the GL buffer, the next update creates a new one. */
+{
+    glDeleteBuffers(1, &buffer_);
+    buffer_ = 0;
+    mirror_.clear();
+}
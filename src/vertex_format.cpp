@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glad/glad.h>
+#include "../include/vertex_format.h"
+
+namespace {
+    const float INT16_RANGE = 32767.0f;
+    const float INT10_RANGE = 511.0f;
+
+    unsigned int alignToFour(unsigned int size)
+    {
+        return (size + 3) / 4 * 4;
+    }
+}
+
+
+void PackedMesh::releaseData()
+/** Frees the CPU copy of the packed data, the sizes are kept. */
+{
+    std::vector<unsigned char>().swap(vertices);
+    std::vector<unsigned char>().swap(indices);
+}
+
+void VertexPacker::pack(const MeshData& mesh, const VertexFormat& format, PackedMesh& packed)
+/** Converts positions and normals of the mesh into the interleaved vertex format and indices into 16-bit integers
+when all of them fit. Quantized positions are stored relative to the center of the mesh bounds and divided by the largest
+half extent: the scale is the same on all axes, so the dequantization transform does not change the directions of normals
+and the normal matrix in the shaders stays valid. A mesh without normals gets zero normals. */
+{
+    packed = PackedMesh();
+    packed.format = format;
+
+    unsigned int position_size = format.position == PositionFormat::Float32 ? 3 * sizeof(float) : 3 * sizeof(uint16_t);
+    unsigned int normal_size   = format.normal == NormalFormat::Float32 ? 3 * sizeof(float) : sizeof(uint32_t);
+    packed.normal_offset = alignToFour(position_size);
+    packed.stride        = packed.normal_offset + normal_size;
+
+    size_t vertices_count = mesh.vertexCount();
+    const float* positions = mesh.vertexData();
+    const float* normals   = mesh.isMapped() || mesh.normals.size() == mesh.vertices.size() ? mesh.normalData() : nullptr;
+
+    float extent = 0.0f;
+    if (format.position != PositionFormat::Float32)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            packed.dequantization_offset[axis] = (mesh.bounds.min[axis] + mesh.bounds.max[axis]) * 0.5f;
+            extent = std::max(extent, (mesh.bounds.max[axis] - mesh.bounds.min[axis]) * 0.5f);
+        }
+        if (extent <= 0)
+        {
+            extent = 1.0f;
+        }
+        // integer positions are read as unnormalized integers, the division by the integer range is a part of the scale
+        packed.dequantization_scale = format.position == PositionFormat::Int16 ? extent / INT16_RANGE : extent;
+    }
+
+    packed.vertex_bytes = vertices_count * packed.stride;
+    packed.vertices.assign(packed.vertex_bytes, 0);
+    for (size_t v = 0; v < vertices_count; v++)
+    {
+        unsigned char* vertex = packed.vertices.data() + v * packed.stride;
+        const float* position = positions + v * 3;
+
+        if (format.position == PositionFormat::Float32)
+        {
+            std::memcpy(vertex, position, 3 * sizeof(float));
+        }
+        else
+        {
+            uint16_t packed_position[3];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float relative = std::max(-1.0f, std::min(1.0f, (position[axis] - packed.dequantization_offset[axis]) / extent));
+                packed_position[axis] = format.position == PositionFormat::Int16
+                        ? static_cast<uint16_t>(static_cast<int16_t>(std::lround(relative * INT16_RANGE)))
+                        : floatToHalf(relative);
+            }
+            std::memcpy(vertex, packed_position, sizeof(packed_position));
+        }
+
+        float normal[3] = {0, 0, 0};
+        if (normals != nullptr)
+        {
+            std::copy(normals + v * 3, normals + v * 3 + 3, normal);
+        }
+        if (format.normal == NormalFormat::Float32)
+        {
+            std::memcpy(vertex + packed.normal_offset, normal, sizeof(normal));
+        }
+        else
+        {
+            uint32_t packed_normal = packNormal(normal);
+            std::memcpy(vertex + packed.normal_offset, &packed_normal, sizeof(packed_normal));
+        }
+    }
+
+    size_t index_count = mesh.indexCount();
+    const unsigned int* indices = mesh.indexData();
+    packed.index_size  = vertices_count < 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+    packed.index_bytes = index_count * packed.index_size;
+    packed.indices.resize(packed.index_bytes);
+    if (packed.index_size == sizeof(uint16_t))
+    {
+        auto* short_indices = reinterpret_cast<uint16_t*>(packed.indices.data());
+        for (size_t i = 0; i < index_count; i++)
+        {
+            short_indices[i] = static_cast<uint16_t>(indices[i]);
+        }
+    }
+    else if (index_count > 0)
+    {
+        std::memcpy(packed.indices.data(), indices, packed.index_bytes);
+    }
+}
+
+void VertexPacker::setupAttributes(const PackedMesh& packed)
+/** Defines vertex attributes 0 (position) and 1 (normal) of the bound VAO for the vertex buffer bound to GL_ARRAY_BUFFER.
+Shaders keep reading vec3 attributes: integer positions are converted to floats without normalization and packed normals
+are normalized to [-1, 1] by OpenGL. */
+{
+    auto stride = static_cast<GLsizei>(packed.stride);
+    switch (packed.format.position)
+    {
+        case PositionFormat::Float32:
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+            break;
+        case PositionFormat::Half16:
+            glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void*)0);
+            break;
+        case PositionFormat::Int16:
+            glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, stride, (void*)0);
+            break;
+    }
+    glEnableVertexAttribArray(0);
+
+    auto normal_offset = reinterpret_cast<const void*>(static_cast<uintptr_t>(packed.normal_offset));
+    if (packed.format.normal == NormalFormat::Float32)
+    {
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, normal_offset);
+    }
+    else
+    {
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, normal_offset);
+    }
+    glEnableVertexAttribArray(1);
+}
+
+uint16_t VertexPacker::floatToHalf(float value)
+/** Converts a float to an IEEE 754 half float with rounding to nearest even, out of range values become infinity. */
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign     = (bits >> 16) & 0x8000u;
+    uint32_t exponent = (bits >> 23) & 0xffu;
+    uint32_t mantissa = bits & 0x7fffffu;
+
+    if (exponent == 0xffu)
+    {
+        // infinity or NaN
+        return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+    }
+    int half_exponent = static_cast<int>(exponent) - 127 + 15;
+    if (half_exponent >= 31)
+    {
+        return static_cast<uint16_t>(sign | 0x7c00u);
+    }
+    if (half_exponent <= 0)
+    {
+        // subnormal half or zero
+        if (half_exponent < -10)
+        {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000u;
+        uint32_t shift = static_cast<uint32_t>(14 - half_exponent);
+        uint32_t half_mantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half_mantissa & 1u)))
+        {
+            half_mantissa++;
+        }
+        return static_cast<uint16_t>(sign | half_mantissa);
+    }
+    uint32_t half = sign | (static_cast<uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+    {
+        // a carry into the exponent is the correct rounding as well
+        half++;
+    }
+    return static_cast<uint16_t>(half);
+}
+
+uint32_t VertexPacker::packNormal(const float* normal)
+/** Packs a unit vector into 10_10_10_2 signed normalized integers (x in the lowest bits, w = 0). */
+{
+    uint32_t packed = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float component = std::max(-1.0f, std::min(1.0f, normal[axis]));
+        auto value = static_cast<int32_t>(std::lround(component * INT10_RANGE));
+        packed |= (static_cast<uint32_t>(value) & 0x3ffu) << (axis * 10);
+    }
+    return packed;
+}